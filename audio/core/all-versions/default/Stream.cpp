@@ -24,6 +24,7 @@
 #include <inttypes.h>
 
 #include <android/log.h>
+#include <cutils/properties.h>
 #include <hardware/audio.h>
 #include <hardware/audio_effect.h>
 #include <media/AudioContainers.h>
@@ -52,6 +53,14 @@ Result Stream::analyzeStatus(const char* funcName, int status,
     return util::analyzeStatus("stream", funcName, status, ignoreErrors);
 }
 
+// static
+bool Stream::isDataMQZeroCopyEnabled() {
+    // A transfer that wraps around the end of the data MQ reaches the HAL as two calls, each of
+    // them possibly a partial period. Only devices whose HAL handles that should turn this on.
+    static const bool enabled = property_get_bool("ro.vendor.audio.hal.zero_copy_data_mq", false);
+    return enabled;
+}
+
 char* Stream::halGetParameters(const char* keys) {
     return mStream->get_parameters(mStream, keys);
 }
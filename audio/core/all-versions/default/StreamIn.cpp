@@ -42,7 +42,8 @@ class ReadThread : public Thread {
    public:
     // ReadThread's lifespan never exceeds StreamIn's lifespan.
     ReadThread(std::atomic<bool>* stop, audio_stream_in_t* stream, StreamIn::CommandMQ* commandMQ,
-               StreamIn::DataMQ* dataMQ, StreamIn::StatusMQ* statusMQ, EventFlag* efGroup)
+               StreamIn::DataMQ* dataMQ, StreamIn::StatusMQ* statusMQ, EventFlag* efGroup,
+               bool zeroCopy)
         : Thread(false /*canCallJava*/),
           mStop(stop),
           mStream(stream),
@@ -50,8 +51,12 @@ class ReadThread : public Thread {
           mDataMQ(dataMQ),
           mStatusMQ(statusMQ),
           mEfGroup(efGroup),
+          mZeroCopy(zeroCopy),
           mBuffer(nullptr) {}
     bool init() {
+        if (mZeroCopy) {
+            return true;  // The HAL reads straight into the data MQ.
+        }
         mBuffer.reset(new (std::nothrow) uint8_t[mDataMQ->getQuantumCount()]);
         return mBuffer != nullptr;
     }
@@ -64,6 +69,7 @@ class ReadThread : public Thread {
     StreamIn::DataMQ* mDataMQ;
     StreamIn::StatusMQ* mStatusMQ;
     EventFlag* mEfGroup;
+    const bool mZeroCopy;
     std::unique_ptr<uint8_t[]> mBuffer;
     IStreamIn::ReadParameters mParameters;
     IStreamIn::ReadStatus mStatus;
@@ -72,6 +78,7 @@ class ReadThread : public Thread {
 
     void doGetCapturePosition();
     void doRead();
+    void doZeroCopyRead(size_t requestedToRead);
 };
 
 void ReadThread::doRead() {
@@ -84,6 +91,10 @@ void ReadThread::doRead() {
             (int32_t)requestedToRead, (int32_t)availableToWrite);
         requestedToRead = availableToWrite;
     }
+    if (mZeroCopy) {
+        doZeroCopyRead(requestedToRead);
+        return;
+    }
     ssize_t readResult = mStream->read(mStream, &mBuffer[0], requestedToRead);
     mStatus.retval = Result::OK;
     if (readResult >= 0) {
@@ -96,6 +107,34 @@ void ReadThread::doRead() {
     }
 }
 
+void ReadThread::doZeroCopyRead(size_t requestedToRead) {
+    StreamIn::DataMQ::MemTransaction tx;
+    mStatus.retval = Result::OK;
+    mStatus.reply.read = 0;
+    if (!mDataMQ->beginWrite(requestedToRead, &tx)) {
+        ALOGW("data message queue write failed");
+        return;
+    }
+    // The free space is in one region unless it wraps around the end of the queue.
+    const auto& first = tx.getFirstRegion();
+    const auto& second = tx.getSecondRegion();
+    ssize_t readResult = mStream->read(mStream, first.getAddress(), first.getLength());
+    if (readResult == static_cast<ssize_t>(first.getLength()) && second.getLength() > 0) {
+        ssize_t secondResult = mStream->read(mStream, second.getAddress(), second.getLength());
+        if (secondResult >= 0) {
+            readResult += secondResult;
+        }
+    }
+    if (readResult >= 0) {
+        mStatus.reply.read = readResult;
+        if (!mDataMQ->commitWrite(readResult)) {
+            ALOGW("data message queue write failed");
+        }
+    } else {
+        mStatus.retval = Stream::analyzeStatus("read", readResult);
+    }
+}
+
 void ReadThread::doGetCapturePosition() {
     mStatus.retval = StreamIn::getCapturePositionImpl(
         mStream, &mStatus.reply.capturePosition.frames, &mStatus.reply.capturePosition.time);
@@ -392,7 +431,8 @@ Return<void> StreamIn::prepareForReading(uint32_t frameSize, uint32_t framesCoun
     // Create and launch the thread.
     auto tempReadThread =
         std::make_unique<ReadThread>(&mStopReadThread, mStream, tempCommandMQ.get(),
-                                     tempDataMQ.get(), tempStatusMQ.get(), tempElfGroup.get());
+                                     tempDataMQ.get(), tempStatusMQ.get(), tempElfGroup.get(),
+                                     Stream::isDataMQZeroCopyEnabled());
     if (!tempReadThread->init()) {
         ALOGW("failed to start reader thread: %s", strerror(-status));
         sendError(Result::INVALID_ARGUMENTS);
@@ -41,7 +41,7 @@ class WriteThread : public Thread {
     // WriteThread's lifespan never exceeds StreamOut's lifespan.
     WriteThread(std::atomic<bool>* stop, audio_stream_out_t* stream,
                 StreamOut::CommandMQ* commandMQ, StreamOut::DataMQ* dataMQ,
-                StreamOut::StatusMQ* statusMQ, EventFlag* efGroup)
+                StreamOut::StatusMQ* statusMQ, EventFlag* efGroup, bool zeroCopy)
         : Thread(false /*canCallJava*/),
           mStop(stop),
           mStream(stream),
@@ -49,8 +49,12 @@ class WriteThread : public Thread {
           mDataMQ(dataMQ),
           mStatusMQ(statusMQ),
           mEfGroup(efGroup),
+          mZeroCopy(zeroCopy),
           mBuffer(nullptr) {}
     bool init() {
+        if (mZeroCopy) {
+            return true;  // The HAL writes straight from the data MQ.
+        }
         mBuffer.reset(new (std::nothrow) uint8_t[mDataMQ->getQuantumCount()]);
         return mBuffer != nullptr;
     }
@@ -63,6 +67,7 @@ class WriteThread : public Thread {
     StreamOut::DataMQ* mDataMQ;
     StreamOut::StatusMQ* mStatusMQ;
     EventFlag* mEfGroup;
+    const bool mZeroCopy;
     std::unique_ptr<uint8_t[]> mBuffer;
     IStreamOut::WriteStatus mStatus;
 
@@ -71,12 +76,17 @@ class WriteThread : public Thread {
     void doGetLatency();
     void doGetPresentationPosition();
     void doWrite();
+    void doZeroCopyWrite(size_t availToRead);
 };
 
 void WriteThread::doWrite() {
     const size_t availToRead = mDataMQ->availableToRead();
     mStatus.retval = Result::OK;
     mStatus.reply.written = 0;
+    if (mZeroCopy) {
+        doZeroCopyWrite(availToRead);
+        return;
+    }
     if (mDataMQ->read(&mBuffer[0], availToRead)) {
         ssize_t writeResult = mStream->write(mStream, &mBuffer[0], availToRead);
         if (writeResult >= 0) {
@@ -87,6 +97,30 @@ void WriteThread::doWrite() {
     }
 }
 
+void WriteThread::doZeroCopyWrite(size_t availToRead) {
+    StreamOut::DataMQ::MemTransaction tx;
+    if (!mDataMQ->beginRead(availToRead, &tx)) {
+        return;
+    }
+    // The data is in one region unless it wraps around the end of the queue.
+    const auto& first = tx.getFirstRegion();
+    const auto& second = tx.getSecondRegion();
+    ssize_t writeResult = mStream->write(mStream, first.getAddress(), first.getLength());
+    if (writeResult == static_cast<ssize_t>(first.getLength()) && second.getLength() > 0) {
+        ssize_t secondResult = mStream->write(mStream, second.getAddress(), second.getLength());
+        if (secondResult >= 0) {
+            writeResult += secondResult;
+        }
+    }
+    // Consume everything, like read() does on the copying path.
+    mDataMQ->commitRead(availToRead);
+    if (writeResult >= 0) {
+        mStatus.reply.written = writeResult;
+    } else {
+        mStatus.retval = Stream::analyzeStatus("write", writeResult);
+    }
+}
+
 void WriteThread::doGetPresentationPosition() {
     mStatus.retval =
         StreamOut::getPresentationPositionImpl(mStream, &mStatus.reply.presentationPosition.frames,
@@ -376,7 +410,8 @@ Return<void> StreamOut::prepareForWriting(uint32_t frameSize, uint32_t framesCou
     // Create and launch the thread.
     auto tempWriteThread =
         std::make_unique<WriteThread>(&mStopWriteThread, mStream, tempCommandMQ.get(),
-                                      tempDataMQ.get(), tempStatusMQ.get(), tempElfGroup.get());
+                                      tempDataMQ.get(), tempStatusMQ.get(), tempElfGroup.get(),
+                                      Stream::isDataMQZeroCopyEnabled());
     if (!tempWriteThread->init()) {
         ALOGW("failed to start writer thread: %s", strerror(-status));
         sendError(Result::INVALID_ARGUMENTS);
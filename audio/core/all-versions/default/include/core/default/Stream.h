@@ -109,6 +109,11 @@ struct Stream : public IStream, public ParametersUtil {
     static Result analyzeStatus(const char* funcName, int status,
                                 const std::vector<int>& ignoreErrors);
 
+    // Whether the read and write threads let the HAL access the data MQ memory directly
+    // instead of copying through an intermediate buffer. Controlled by
+    // ro.vendor.audio.hal.zero_copy_data_mq, off by default.
+    static bool isDataMQZeroCopyEnabled();
+
    private:
     audio_stream_t* mStream;
 
@@ -18,10 +18,16 @@
 #define android_hardware_automotive_vehicle_V2_0_ConcurrentQueue_H_
 
 #include <queue>
+#include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <thread>
 #include <condition_variable>
+#include <functional>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 namespace android {
 
@@ -151,6 +157,330 @@ private:
     ConcurrentQueue<T>* mQueue;
 };
 
+/**
+ * Bounded lock-free multi-producer / multi-consumer ring of items (Vyukov's bounded queue), its
+ * capacity rounded up to a power of two. tryPush() fails when the ring is full, tryPop() fails when
+ * it's empty, neither blocks.
+ */
+template<typename T>
+class BoundedRing {
+public:
+    explicit BoundedRing(size_t capacity)
+        : mMask(roundUpToPowerOfTwo(capacity) - 1), mSlots(new Slot[mMask + 1]) {
+        for (size_t i = 0; i <= mMask; i++) {
+            mSlots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    BoundedRing(const BoundedRing &) = delete;
+    BoundedRing &operator=(const BoundedRing &) = delete;
+
+    /* Leaves item untouched if the ring is full. */
+    template<typename U>
+    bool tryPush(U&& item) {
+        size_t pos = mTail.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot& slot = mSlots[pos & mMask];
+            size_t seq = slot.sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (mTail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    slot.item = std::forward<U>(item);
+                    slot.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;  // Full.
+            } else {
+                pos = mTail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool tryPop(T* out) {
+        size_t pos = mHead.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot& slot = mSlots[pos & mMask];
+            size_t seq = slot.sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (mHead.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    *out = std::move(slot.item);
+                    slot.item = T();
+                    slot.sequence.store(pos + mMask + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;  // Empty.
+            } else {
+                pos = mHead.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /* Only exact when there are no concurrent consumers. */
+    bool empty() const {
+        size_t pos = mHead.load(std::memory_order_relaxed);
+        return mSlots[pos & mMask].sequence.load(std::memory_order_acquire) != pos + 1;
+    }
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        T item;
+    };
+
+    static size_t roundUpToPowerOfTwo(size_t n) {
+        size_t result = 2;
+        while (result < n) result <<= 1;
+        return result;
+    }
+
+    const size_t mMask;
+    std::unique_ptr<Slot[]> mSlots;
+
+    alignas(64) std::atomic<size_t> mTail { 0 };
+    alignas(64) std::atomic<size_t> mHead { 0 };
+};
+
+/**
+ * Bounded multi-producer / single-consumer queue backed by a BoundedRing.
+ *
+ * Producers claim a slot with a single CAS on the tail and never take a lock on the fast path.
+ * The consumer only blocks on the condition variable when the ring is empty and producers only
+ * touch the mutex when the consumer is actually asleep. If the ring is full, producers block until
+ * the consumer frees a slot, so items are never dropped while the queue is active.
+ */
+template<typename T>
+class MpscRingQueue {
+public:
+    using TimePoint = std::chrono::steady_clock::time_point;
+
+    explicit MpscRingQueue(size_t capacity = 1024) : mRing(capacity) {}
+
+    MpscRingQueue(const MpscRingQueue &) = delete;
+    MpscRingQueue &operator=(const MpscRingQueue &) = delete;
+
+    /* Returns false if the queue was deactivated and the item was not enqueued. */
+    bool push(T&& item) {
+        if (!mIsActive.load(std::memory_order_acquire)) {
+            return false;
+        }
+        if (!mRing.tryPush(std::move(item)) && !waitAndPush(std::move(item))) {
+            return false;
+        }
+
+        // Pairs with the fence in waitForItemsUntil(), see comment there.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (mConsumerWaiting.load(std::memory_order_relaxed)) {
+            wakeConsumer();
+        }
+        return true;
+    }
+
+    /* Must only be called from the consumer thread. Returns false if the queue is empty. */
+    bool pop(T* out) {
+        if (!mRing.tryPop(out)) {
+            return false;
+        }
+        // Pairs with the fence in waitAndPush(), see comment there.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (mProducersWaiting.load(std::memory_order_relaxed) > 0) {
+            std::lock_guard<std::mutex> g(mLock);
+            mNotFullCond.notify_all();
+        }
+        return true;
+    }
+
+    /* Must only be called from the consumer thread. */
+    bool empty() const {
+        return mRing.empty();
+    }
+
+    /**
+     * Blocks consumer thread until there's at least one item in the queue, the deadline has passed
+     * or the queue has been deactivated. Returns true if items are available.
+     */
+    bool waitForItemsUntil(TimePoint deadline) {
+        std::unique_lock<std::mutex> g(mLock);
+        for (;;) {
+            mConsumerWaiting.store(true, std::memory_order_relaxed);
+            // Either push() sees mConsumerWaiting == true and notifies under mLock, or we see the
+            // item it has published.
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!empty() || !mIsActive.load(std::memory_order_acquire)) {
+                break;
+            }
+            if (deadline == TimePoint::max()) {
+                mCond.wait(g);
+            } else if (mCond.wait_until(g, deadline) == std::cv_status::timeout) {
+                break;
+            }
+        }
+        mConsumerWaiting.store(false, std::memory_order_relaxed);
+        return !empty() && mIsActive.load(std::memory_order_acquire);
+    }
+
+    void waitForItems() {
+        waitForItemsUntil(TimePoint::max());
+    }
+
+    /* Deactivates the queue, thus no one can push items to it, also
+     * notifies waiting consumer.
+     */
+    void deactivate() {
+        mIsActive.store(false, std::memory_order_release);
+        std::lock_guard<std::mutex> g(mLock);
+        mCond.notify_all();
+        mNotFullCond.notify_all();  // To unblock producers waiting for room.
+    }
+
+    bool isActive() const {
+        return mIsActive.load(std::memory_order_acquire);
+    }
+
+private:
+    void wakeConsumer() {
+        std::lock_guard<std::mutex> g(mLock);
+        mCond.notify_one();
+    }
+
+    /* Slow path of push() when the ring is full: blocks until pop() frees a slot. */
+    bool waitAndPush(T&& item) {
+        std::unique_lock<std::mutex> g(mLock);
+        mProducersWaiting.fetch_add(1, std::memory_order_relaxed);
+        // Either pop() sees mProducersWaiting > 0 and notifies under mLock, or we see the slot it
+        // has freed.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool pushed;
+        while (!(pushed = mRing.tryPush(std::move(item))) &&
+               mIsActive.load(std::memory_order_acquire)) {
+            mCond.notify_one();  // Make sure the consumer is draining.
+            mNotFullCond.wait(g);
+        }
+        mProducersWaiting.fetch_sub(1, std::memory_order_relaxed);
+        return pushed;
+    }
+
+private:
+    BoundedRing<T> mRing;
+
+    std::atomic<bool> mIsActive { true };
+    std::atomic<bool> mConsumerWaiting { false };
+    std::atomic<int> mProducersWaiting { 0 };
+    std::mutex mLock;
+    std::condition_variable mCond;
+    std::condition_variable mNotFullCond;
+};
+
+/**
+ * Consumes items from MpscRingQueue and delivers them in batches.
+ *
+ * Unlike BatchingConsumer it doesn't sleep for a fixed window: a batch is delivered as soon as
+ * one of the following happens:
+ *  - the batch reaches maxBatchSize items;
+ *  - no new item arrived within idleGap, so a lone event is delivered almost immediately;
+ *  - the earliest per-item deadline (provided by MaxDelayFunc, capped by maxDelay) has passed,
+ *    which bounds the latency when items keep arriving under heavy load.
+ */
+template<typename T>
+class DeadlineBatchingConsumer {
+private:
+    enum class State {
+        INIT = 0,
+        RUNNING = 1,
+        STOP_REQUESTED = 2,
+        STOPPED = 3,
+    };
+
+public:
+    struct Options {
+        size_t maxBatchSize;
+        std::chrono::nanoseconds maxDelay;
+        std::chrono::nanoseconds idleGap;
+    };
+
+    using OnBatchReceivedFunc = std::function<void(const std::vector<T>& vec)>;
+    /* Returns for how long given item may be held back to be batched with others. */
+    using MaxDelayFunc = std::function<std::chrono::nanoseconds(const T& item)>;
+
+    DeadlineBatchingConsumer() : mState(State::INIT) {}
+
+    DeadlineBatchingConsumer(const DeadlineBatchingConsumer &) = delete;
+    DeadlineBatchingConsumer &operator=(const DeadlineBatchingConsumer &) = delete;
+
+    void run(MpscRingQueue<T>* queue,
+             const Options& options,
+             const MaxDelayFunc& maxDelayFunc,
+             const OnBatchReceivedFunc& func) {
+        mQueue = queue;
+        mOptions = options;
+        mMaxDelayFunc = maxDelayFunc;
+
+        mWorkerThread = std::thread(
+            &DeadlineBatchingConsumer<T>::runInternal, this, func);
+    }
+
+    void requestStop() {
+        mState = State::STOP_REQUESTED;
+    }
+
+    void waitStopped() {
+        if (mWorkerThread.joinable()) {
+            mWorkerThread.join();
+        }
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void runInternal(const OnBatchReceivedFunc& onBatchReceived) {
+        if (mState.exchange(State::RUNNING) == State::INIT) {
+            std::vector<T> batch;
+            batch.reserve(mOptions.maxBatchSize);
+            while (State::RUNNING == mState && mQueue->isActive()) {
+                if (!mQueue->waitForItemsUntil(Clock::time_point::max())) continue;
+
+                collectBatch(&batch);
+                if (State::STOP_REQUESTED == mState) break;
+
+                if (batch.size() > 0) {
+                    onBatchReceived(batch);
+                    batch.clear();
+                }
+            }
+        }
+
+        mState = State::STOPPED;
+    }
+
+    void collectBatch(std::vector<T>* batch) {
+        auto deadline = Clock::time_point::max();
+        for (;;) {
+            auto now = Clock::now();
+            T item;
+            while (batch->size() < mOptions.maxBatchSize && mQueue->pop(&item)) {
+                auto delay = std::min(mOptions.maxDelay,
+                                      mMaxDelayFunc ? mMaxDelayFunc(item) : mOptions.maxDelay);
+                deadline = std::min(deadline, now + delay);
+                batch->push_back(std::move(item));
+            }
+
+            if (batch->size() >= mOptions.maxBatchSize || now >= deadline) return;
+            if (!mQueue->waitForItemsUntil(std::min(deadline, now + mOptions.idleGap))) return;
+            if (State::STOP_REQUESTED == mState) return;
+        }
+    }
+
+private:
+    std::thread mWorkerThread;
+
+    std::atomic<State> mState;
+    Options mOptions;
+    MaxDelayFunc mMaxDelayFunc;
+    MpscRingQueue<T>* mQueue;
+};
+
 }  // namespace android
 
 #endif //android_hardware_automotive_vehicle_V2_0_ConcurrentQueue_H_
@@ -17,6 +17,7 @@
 #ifndef android_hardware_automotive_vehicle_V2_0_RecurrentTimer_H_
 #define android_hardware_automotive_vehicle_V2_0_RecurrentTimer_H_
 
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <condition_variable>
@@ -28,15 +29,143 @@
 #include <unordered_map>
 #include <vector>
 
+/**
+ * Set of recurrent events ordered by the time they are due next.
+ *
+ * Events are kept in a binary min-heap, so scheduling costs O(log n) and a wake-up only touches
+ * events that are actually due instead of scanning all of them. Unregistered and re-registered
+ * events leave stale heap entries behind, these are recognized by their generation, skipped and
+ * periodically compacted away.
+ *
+ * This class is not thread-safe.
+ */
+class RecurrentEventQueue {
+public:
+    using Nanos = std::chrono::nanoseconds;
+    using Clock = std::chrono::steady_clock;
+    using TimePoint = std::chrono::time_point<Clock, Nanos>;
+
+    static constexpr TimePoint kInvalidTime = TimePoint(Nanos::max());
+
+    /**
+     * Adds recurrent event for a given interval. Calling this method multiple times with the same
+     * cookie will override the interval provided before.
+     */
+    void add(Nanos interval, int32_t cookie, TimePoint now) {
+        // Align event time point among all intervals. Thus if we have two intervals 1ms and 2ms,
+        // during every second wake-up both intervals will be triggered.
+        TimePoint absoluteTime = now - Nanos(now.time_since_epoch().count() % interval.count());
+        uint64_t generation = mNextGeneration++;
+
+        mEvents[cookie] = { interval, cookie, absoluteTime, generation };
+        pushHeapEntry({ absoluteTime, cookie, generation });
+        compactIfNeeded();
+    }
+
+    void remove(int32_t cookie) {
+        mEvents.erase(cookie);
+        compactIfNeeded();
+    }
+
+    void clear() {
+        mEvents.clear();
+        mHeap.clear();
+    }
+
+    size_t size() const {
+        return mEvents.size();
+    }
+
+    /**
+     * Appends cookies of all events that are due at given time to the provided vector and
+     * reschedules them. Returns the time of the next event or kInvalidTime if there are no events.
+     */
+    TimePoint takeDueEvents(TimePoint now, std::vector<int32_t>* cookies) {
+        mRescheduled.clear();
+        while (!mHeap.empty()) {
+            HeapEntry top = mHeap.front();
+            auto it = mEvents.find(top.cookie);
+            bool isStale = it == mEvents.end() || it->second.generation != top.generation;
+            if (!isStale && top.absoluteTime > now) break;
+
+            std::pop_heap(mHeap.begin(), mHeap.end(), std::greater<HeapEntry>());
+            mHeap.pop_back();
+            if (isStale) continue;
+
+            RecurrentEvent& event = it->second;
+            event.updateNextEventTime(now);
+            cookies->push_back(event.cookie);
+            // Pushed back once all due events are collected, so that an event which is still
+            // behind after rescheduling is reported only once per wake-up.
+            mRescheduled.push_back({ event.absoluteTime, event.cookie, event.generation });
+        }
+
+        for (const HeapEntry& entry : mRescheduled) {
+            pushHeapEntry(entry);
+        }
+        return mHeap.empty() ? kInvalidTime : mHeap.front().absoluteTime;
+    }
+
+private:
+    struct RecurrentEvent {
+        Nanos interval;
+        int32_t cookie;
+        TimePoint absoluteTime;  // Absolute time of the next event.
+        uint64_t generation;  // Distinguishes this registration from previous ones of the cookie.
+
+        void updateNextEventTime(TimePoint now) {
+            // We want to move time to next event by adding some number of intervals (usually 1)
+            // to previous absoluteTime.
+            int intervalMultiplier = (now - absoluteTime) / interval;
+            if (intervalMultiplier <= 0) intervalMultiplier = 1;
+            absoluteTime += intervalMultiplier * interval;
+        }
+    };
+
+    struct HeapEntry {
+        TimePoint absoluteTime;
+        int32_t cookie;
+        uint64_t generation;
+
+        bool operator>(const HeapEntry& other) const {
+            return absoluteTime > other.absoluteTime;
+        }
+    };
+
+    void pushHeapEntry(const HeapEntry& entry) {
+        mHeap.push_back(entry);
+        std::push_heap(mHeap.begin(), mHeap.end(), std::greater<HeapEntry>());
+    }
+
+    void compactIfNeeded() {
+        if (mHeap.size() <= 2 * mEvents.size() + kMinHeapSizeToCompact) return;
+
+        mHeap.clear();
+        for (auto&& it : mEvents) {
+            const RecurrentEvent& event = it.second;
+            mHeap.push_back({ event.absoluteTime, event.cookie, event.generation });
+        }
+        std::make_heap(mHeap.begin(), mHeap.end(), std::greater<HeapEntry>());
+    }
+
+private:
+    static constexpr size_t kMinHeapSizeToCompact = 16;
+
+    std::unordered_map<int32_t, RecurrentEvent> mEvents;
+    std::vector<HeapEntry> mHeap;
+    std::vector<HeapEntry> mRescheduled;  // Scratch space for takeDueEvents().
+    uint64_t mNextGeneration = 0;
+};
+
 /**
  * This class allows to specify multiple time intervals to receive
  * notifications. A single thread is used internally.
  */
 class RecurrentTimer {
 private:
-    using Nanos = std::chrono::nanoseconds;
-    using Clock = std::chrono::steady_clock;
-    using TimePoint = std::chrono::time_point<Clock, Nanos>;
+    using Nanos = RecurrentEventQueue::Nanos;
+    using Clock = RecurrentEventQueue::Clock;
+    using TimePoint = RecurrentEventQueue::TimePoint;
 public:
     using Action = std::function<void(const std::vector<int32_t>& cookies)>;
 
@@ -55,13 +184,9 @@ public:
      */
     void registerRecurrentEvent(std::chrono::nanoseconds interval, int32_t cookie) {
         TimePoint now = Clock::now();
-        // Align event time point among all intervals. Thus if we have two intervals 1ms and 2ms,
-        // during every second wake-up both intervals will be triggered.
-        TimePoint absoluteTime = now - Nanos(now.time_since_epoch().count() % interval.count());
-
         {
             std::lock_guard<std::mutex> g(mLock);
-            mCookieToEventsMap[cookie] = { interval, cookie, absoluteTime };
+            mEvents.add(interval, cookie, now);
         }
         mCond.notify_one();
     }
@@ -69,52 +194,24 @@ public:
     void unregisterRecurrentEvent(int32_t cookie) {
         {
             std::lock_guard<std::mutex> g(mLock);
-            mCookieToEventsMap.erase(cookie);
+            mEvents.remove(cookie);
         }
         mCond.notify_one();
     }
 
 
 private:
-
-    struct RecurrentEvent {
-        Nanos interval;
-        int32_t cookie;
-        TimePoint absoluteTime;  // Absolute time of the next event.
-
-        void updateNextEventTime(TimePoint now) {
-            // We want to move time to next event by adding some number of intervals (usually 1)
-            // to previous absoluteTime.
-            int intervalMultiplier = (now - absoluteTime) / interval;
-            if (intervalMultiplier <= 0) intervalMultiplier = 1;
-            absoluteTime += intervalMultiplier * interval;
-        }
-    };
-
     void loop(const Action& action) {
-        static constexpr auto kInvalidTime = TimePoint(Nanos::max());
-
         std::vector<int32_t> cookies;
 
         while (!mStopRequested) {
             auto now = Clock::now();
-            auto nextEventTime = kInvalidTime;
+            auto nextEventTime = RecurrentEventQueue::kInvalidTime;
             cookies.clear();
 
             {
                 std::unique_lock<std::mutex> g(mLock);
-
-                for (auto&& it : mCookieToEventsMap) {
-                    RecurrentEvent& event = it.second;
-                    if (event.absoluteTime <= now) {
-                        event.updateNextEventTime(now);
-                        cookies.push_back(event.cookie);
-                    }
-
-                    if (nextEventTime > event.absoluteTime) {
-                        nextEventTime = event.absoluteTime;
-                    }
-                }
+                nextEventTime = mEvents.takeDueEvents(now, &cookies);
             }
 
             if (cookies.size() != 0) {
@@ -130,7 +227,7 @@ private:
         mStopRequested = true;
         {
             std::lock_guard<std::mutex> g(mLock);
-            mCookieToEventsMap.clear();
+            mEvents.clear();
         }
         mCond.notify_one();
         if (mTimerThread.joinable()) {
@@ -143,7 +240,7 @@ private:
     std::condition_variable mCond;
     std::atomic_bool mStopRequested { false };
     Action mAction;
-    std::unordered_map<int32_t, RecurrentEvent> mCookieToEventsMap;
+    RecurrentEventQueue mEvents;
 };
 
 
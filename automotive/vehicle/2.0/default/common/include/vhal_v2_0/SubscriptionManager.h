@@ -21,6 +21,7 @@
 #include <map>
 #include <set>
 #include <list>
+#include <vector>
 
 #include <android/log.h>
 #include <hidl/HidlSupport.h>
@@ -78,6 +79,48 @@ struct HalClientValues {
     std::list<VehiclePropValue *> values;
 };
 
+/* Values ready to be delivered to the client with a single onPropertyEvent call. */
+struct HalClientHidlValues {
+    sp<HalClient> client;
+    hidl_vec<VehiclePropValue> values;  // Shallow copies, valid while the source values are.
+};
+
+/**
+ * Immutable inverted index from property ID and subscription flag to a dense bitset of the
+ * clients subscribed to it. Properties are kept in a sorted vector, and bitsets for all of them
+ * are stored back to back in one flat array, so a lookup is a binary search followed by a scan of
+ * a few machine words.
+ */
+class SubscriptionIndex {
+public:
+    using Word = uint64_t;
+    static constexpr size_t kBitsPerWord = 64;
+
+    SubscriptionIndex() = default;
+    SubscriptionIndex(std::vector<sp<HalClient>> clients,
+                      const std::map<int32_t, std::vector<std::pair<size_t, SubscribeFlags>>>&
+                          propToClientSlots);
+
+    size_t getClientCount() const { return mClients.size(); }
+    size_t getWordsPerRow() const { return mWordsPerRow; }
+    const sp<HalClient>& getClient(size_t slot) const { return mClients[slot]; }
+
+    /**
+     * Returns pointer to the bitset (getWordsPerRow() words) of clients subscribed to the
+     * property with given flag or nullptr if there are no such clients.
+     */
+    const Word* findClients(int32_t propId, SubscribeFlags flag) const;
+
+private:
+    static constexpr size_t kFlagCount = 2;  // EVENTS_FROM_CAR and EVENTS_FROM_ANDROID.
+    static int flagToRow(SubscribeFlags flag);
+
+    std::vector<sp<HalClient>> mClients;
+    std::vector<int32_t> mProps;  // Sorted.
+    std::vector<Word> mBits;      // mProps.size() * kFlagCount rows of mWordsPerRow words.
+    size_t mWordsPerRow = 0;
+};
+
 using ClientId = uint64_t;
 
 class SubscriptionManager {
@@ -114,6 +157,19 @@ public:
             const std::vector<recyclable_ptr<VehiclePropValue>>& propValues,
             SubscribeFlags flags) const;
 
+    /**
+     * Fan-out path for batches of HAL events. Resolves subscribers through the lock-free
+     * SubscriptionIndex and builds a hidl_vec for every subscribed client exactly once. Values
+     * are shallow-copied, so propValues must outlive the output.
+     *
+     * @param flag - single flag, EVENTS_FROM_CAR or EVENTS_FROM_ANDROID.
+     * @param out - cleared and filled with one entry per client that has values to receive.
+     */
+    void distributeValuesToClients(
+            const std::vector<recyclable_ptr<VehiclePropValue>>& propValues,
+            SubscribeFlags flag,
+            std::vector<HalClientHidlValues>* out) const;
+
     std::list<sp<HalClient>> getSubscribedClients(int32_t propId, SubscribeFlags flags) const;
     /**
      * If there are no clients subscribed to given properties than callback function provided
@@ -135,6 +191,9 @@ private:
 
     void onCallbackDead(uint64_t cookie);
 
+    // Must be called after every change of mClients or mPropToClients.
+    void rebuildIndexLocked();
+
 private:
     using OnClientDead = std::function<void(uint64_t)>;
 
@@ -164,6 +223,9 @@ private:
     std::map<int32_t, sp<HalClientVector>> mPropToClients;
     std::map<int32_t, SubscribeOptions> mHalEventSubscribeOptions;
 
+    // Published by rebuildIndexLocked(), accessed with std::atomic_load.
+    std::shared_ptr<const SubscriptionIndex> mIndex = std::make_shared<SubscriptionIndex>();
+
     OnPropertyUnsubscribed mOnPropertyUnsubscribed;
     sp<DeathRecipient> mCallbackDeathRecipient;
 };
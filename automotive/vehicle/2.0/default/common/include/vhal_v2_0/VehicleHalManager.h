@@ -25,6 +25,7 @@
 #include <map>
 #include <memory>
 #include <set>
+#include <unordered_map>
 
 #include <android/hardware/automotive/vehicle/2.0/IVehicle.h>
 
@@ -85,8 +86,11 @@ private:
                                int32_t areaId);
 
     // ---------------------------------------------------------------------------------------------
-    // This method will be called from BatchingConsumer thread
+    // This method will be called from DeadlineBatchingConsumer thread
     void onBatchHalEvent(const std::vector<VehiclePropValuePtr >& values);
+    // Returns for how long an event may wait to be batched, based on the subscription sample rate.
+    std::chrono::nanoseconds getMaxBatchingDelay(const VehiclePropValuePtr& value) const;
+    void updateMaxBatchingDelay(int32_t propId, float sampleRate);
 
     void handlePropertySetEvent(const VehiclePropValue& value);
 
@@ -107,10 +111,16 @@ private:
     std::unique_ptr<VehiclePropConfigIndex> mConfigIndex;
     SubscriptionManager mSubscriptionManager;
 
-    hidl_vec<VehiclePropValue> mHidlVecOfVehiclePropValuePool;
+    // Only accessed from the DeadlineBatchingConsumer thread.
+    std::vector<HalClientHidlValues> mClientValues;
 
-    ConcurrentQueue<VehiclePropValuePtr> mEventQueue;
-    BatchingConsumer<VehiclePropValuePtr> mBatchingConsumer;
+    using BatchingDelayMap = std::unordered_map<int32_t, std::chrono::nanoseconds>;
+    std::mutex mBatchingDelaysLock;  // Serializes writers, readers use std::atomic_load.
+    std::shared_ptr<const BatchingDelayMap> mBatchingDelays;
+
+    static constexpr size_t kHalEventQueueCapacity = 4096;
+    MpscRingQueue<VehiclePropValuePtr> mEventQueue { kHalEventQueueCapacity };
+    DeadlineBatchingConsumer<VehiclePropValuePtr> mBatchingConsumer;
     VehiclePropValuePool mValueObjectPool;
 };
 
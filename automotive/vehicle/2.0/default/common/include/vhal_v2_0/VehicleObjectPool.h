@@ -18,29 +18,38 @@
 #ifndef android_hardware_automotive_vehicle_V2_0_VehicleObjectPool_H_
 #define android_hardware_automotive_vehicle_V2_0_VehicleObjectPool_H_
 
-#include <deque>
-#include <map>
-#include <mutex>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
 
 #include <android/hardware/automotive/vehicle/2.0/types.h>
 
+#include "ConcurrentQueue.h"
+
 namespace android {
 namespace hardware {
 namespace automotive {
 namespace vehicle {
 namespace V2_0 {
 
-// Handy metric mostly for unit tests and debug.
-#define INC_METRIC_IF_DEBUG(val) PoolStats::instance()->val++;
+// Pool metrics are always collected, they are cheap relaxed atomic increments. They can be read
+// at runtime through PoolStats::instance() and are reported by IVehicle::debugDump.
+#define INC_METRIC(val) PoolStats::instance()->val.fetch_add(1, std::memory_order_relaxed);
 struct PoolStats {
-    std::atomic<uint32_t> Obtained {0};
-    std::atomic<uint32_t> Created {0};
-    std::atomic<uint32_t> Recycled {0};
+    std::atomic<uint32_t> Obtained {0};  // Recyclable objects handed out.
+    std::atomic<uint32_t> Created {0};   // Recyclable objects allocated.
+    std::atomic<uint32_t> Recycled {0};  // Recyclable objects returned.
+    std::atomic<uint32_t> Hits {0};      // Obtains served without allocating.
+    std::atomic<uint32_t> Misses {0};    // Obtains that had to allocate, including disposables.
+    std::atomic<uint32_t> Disposed {0};  // Objects deleted on release instead of being pooled.
 
     static PoolStats* instance() {
         static PoolStats inst;
         return &inst;
     }
+
+    std::string toString() const;
 };
 
 template<typename T>
@@ -70,29 +79,32 @@ using recyclable_ptr = typename std::unique_ptr<T, Deleter<T>>;
  * Generic abstract object pool class. Users of this class must implement
  * #createObject method.
  *
- * This class is thread-safe. Concurrent calls to #obtain(...) method from
- * multiple threads is OK, also client can obtain an object in one thread and
- * then move ownership to another thread.
- *
+ * This class is thread-safe and lock-free. Concurrent calls to #obtain(...)
+ * method from multiple threads is OK, also client can obtain an object in one
+ * thread and then move ownership to another thread. At most maxPooledObjects
+ * are kept, objects recycled beyond that are deleted.
  */
 template<typename T>
 class ObjectPool {
 public:
-    ObjectPool() = default;
-    virtual ~ObjectPool() = default;
+    ObjectPool(size_t maxPooledObjects = 256) : mObjects(maxPooledObjects) {}
+    virtual ~ObjectPool() {
+        T* o;
+        while (mObjects.tryPop(&o)) {
+            delete o;
+        }
+    }
 
     virtual recyclable_ptr<T> obtain() {
-        std::lock_guard<std::mutex> g(mLock);
-        INC_METRIC_IF_DEBUG(Obtained)
-        if (mObjects.empty()) {
-            INC_METRIC_IF_DEBUG(Created)
+        INC_METRIC(Obtained)
+        T* o;
+        if (!mObjects.tryPop(&o)) {
+            INC_METRIC(Created)
+            INC_METRIC(Misses)
             return wrap(createObject());
         }
-
-        auto o = wrap(mObjects.front().release());
-        mObjects.pop_front();
-
-        return o;
+        INC_METRIC(Hits)
+        return wrap(o);
     }
 
     ObjectPool& operator =(const ObjectPool &) = delete;
@@ -102,29 +114,21 @@ protected:
     virtual T* createObject() = 0;
 
     virtual void recycle(T* o) {
-        INC_METRIC_IF_DEBUG(Recycled)
-        std::lock_guard<std::mutex> g(mLock);
-        mObjects.push_back(std::unique_ptr<T> { o } );
-    }
-
-private:
-    const Deleter<T>& getDeleter() {
-        if (!mDeleter.get()) {
-            Deleter<T> *d = new Deleter<T>(std::bind(
-                &ObjectPool::recycle, this, std::placeholders::_1));
-            mDeleter.reset(d);
+        INC_METRIC(Recycled)
+        if (!mObjects.tryPush(o)) {
+            INC_METRIC(Disposed)
+            delete o;
         }
-        return *mDeleter.get();
     }
 
+private:
     recyclable_ptr<T> wrap(T* raw) {
-        return recyclable_ptr<T> { raw, getDeleter() };
+        return recyclable_ptr<T> { raw, mDeleter };
     }
 
 private:
-    mutable std::mutex mLock;
-    std::deque<std::unique_ptr<T>> mObjects;
-    std::unique_ptr<Deleter<T>> mDeleter;
+    BoundedRing<T*> mObjects;
+    const Deleter<T> mDeleter { std::bind(&ObjectPool::recycle, this, std::placeholders::_1) };
 };
 
 /**
@@ -138,11 +142,19 @@ private:
  * safely pass it around. Once this object goes out of scope, it will be
  * returned the the object pool.
  *
- * Some objects are not recycable: strings and vector data types with
- * vector length > maxRecyclableVectorSize (provided in the constructor). These
- * objects will be deleted immediately once the go out of scope. There's no
- * synchornization penalty for these objects since we do not store them in the
- * pool.
+ * Every pooled object owns a payload buffer whose capacity is a power of two
+ * (a size class). hidl_vecs and string of the value are pointed to that buffer
+ * with setToExternal(), so objects of any type and vector size falling into the
+ * same size class are interchangeable and obtaining them doesn't allocate.
+ * Values with vectors longer than maxRecyclableVectorSize or payloads larger
+ * than the biggest size class are deleted once they go out of scope. Since
+ * payloads live in the pool, hidl_vecs or strings of an obtained value must be
+ * copied, not moved, out of it.
+ *
+ * Released objects go to a small cache of the releasing thread first and
+ * spill over to a lock-free shared free list per size class, so neither
+ * obtain(...) nor release take a lock. Each thread keeps caches for the few
+ * pools it used last.
  *
  * This class is thread-safe. Users can obtain an object in one thread and pass
  * it to another.
@@ -173,8 +185,8 @@ public:
      * returning back to the object pool.
      *
      */
-    VehiclePropValuePool(size_t maxRecyclableVectorSize = 4) :
-        mMaxRecyclableVectorSize(maxRecyclableVectorSize) {};
+    VehiclePropValuePool(size_t maxRecyclableVectorSize = 1024);
+    ~VehiclePropValuePool();
 
     RecyclableType obtain(VehiclePropertyType type);
 
@@ -190,50 +202,38 @@ public:
     VehiclePropValuePool(VehiclePropValuePool& ) = delete;
     VehiclePropValuePool& operator=(VehiclePropValuePool&) = delete;
 private:
-    bool isDisposable(VehiclePropertyType type, size_t vecSize) const {
-        return vecSize > mMaxRecyclableVectorSize || VehiclePropertyType::STRING == type ||
-               VehiclePropertyType::MIXED == type;
-    }
-
-    RecyclableType obtainDisposable(VehiclePropertyType valueType,
-                                    size_t vectorSize) const;
-    RecyclableType obtainRecylable(VehiclePropertyType type,
-                                   size_t vecSize);
+    // Size classes are powers of two from 16 bytes to 8 KiB.
+    static constexpr int kMinSizeClassShift = 4;
+    static constexpr int kMaxSizeClassShift = 13;
+    static constexpr int kSizeClassCount = kMaxSizeClassShift - kMinSizeClassShift + 1;
+    static constexpr int kDisposable = -1;
+    // Shared free list capacity per size class.
+    static constexpr size_t kMaxPooledObjectsPerSizeClass = 256;
+
+    struct PooledValue : public VehiclePropValue {
+        std::unique_ptr<uint8_t[]> payload;
+        size_t capacity = 0;  // In bytes.
+        int sizeClass = kDisposable;
+    };
 
-    class InternalPool: public ObjectPool<VehiclePropValue> {
-    public:
-        InternalPool(VehiclePropertyType type, size_t vectorSize)
-            : mPropType(type), mVectorSize(vectorSize) {}
+    struct ThreadCache;
 
-        RecyclableType obtain() {
-            return ObjectPool<VehiclePropValue>::obtain();
-        }
-    protected:
-        VehiclePropValue* createObject() override;
-        void recycle(VehiclePropValue* o) override;
-    private:
-        bool check(VehiclePropValue::RawValue* v);
-
-        template <typename VecType>
-        bool check(hidl_vec<VecType>* vec, bool expected) {
-            return vec->size() == (expected ? mVectorSize : 0);
-        }
-    private:
-        VehiclePropertyType mPropType;
-        size_t mVectorSize;
-    };
+    static ThreadCache* getThreadCaches();
+    static ThreadCache& getThreadCache(uint64_t poolId);
+    static int getSizeClass(size_t payloadSize);
+    static bool getPayloadSize(VehiclePropertyType type, size_t vecSize, size_t* outSize);
+    static void attachPayload(PooledValue* v, VehiclePropertyType type, size_t vecSize);
+    static void copyPayload(PooledValue* dest, const VehiclePropValue::RawValue& src);
+    static void resetValue(PooledValue* v);
 
-private:
-    const Deleter<VehiclePropValue> mDisposableDeleter {
-        [] (VehiclePropValue* v) {
-            delete v;
-        }
-    };
+    PooledValue* obtainPooled(int sizeClass);
+    void recycle(VehiclePropValue* o);
 
 private:
-    mutable std::mutex mLock;
+    const uint64_t mId;
     const size_t mMaxRecyclableVectorSize;
-    std::map<int32_t, std::unique_ptr<InternalPool>> mValueTypePools;
+    std::unique_ptr<BoundedRing<PooledValue*>> mFreeLists[kSizeClassCount];
+    const Deleter<VehiclePropValue> mDeleter;
 };
 
 }  // namespace V2_0
@@ -17,7 +17,9 @@
 #ifndef android_hardware_automotive_vehicle_V2_0_impl_PropertyDb_H_
 #define android_hardware_automotive_vehicle_V2_0_impl_PropertyDb_H_
 
+#include <array>
 #include <cstdint>
+#include <map>
 #include <unordered_map>
 #include <memory>
 #include <mutex>
@@ -37,13 +39,26 @@ namespace V2_0 {
  * VehiclePropertyValues stored in a sorted map thus it makes easier to get range of values, e.g.
  * to get value for all areas for particular property.
  *
- * This class is thread-safe, however it uses blocking synchronization across all methods.
+ * This class is thread-safe. In Mode::SINGLE_LOCK (default) it uses blocking synchronization
+ * across all methods. In Mode::SHARDED values are partitioned by property ID into independent
+ * shards, each of which publishes an immutable snapshot of its values. Readers atomically load
+ * the current snapshot and never contend with writers; writers serialize only with other writers
+ * of the same shard, copy the (small) shard, modify the copy and publish it (read-copy-update).
  */
 class VehiclePropertyStore {
 public:
     /* Function that used to calculate unique token for given VehiclePropValue */
     using TokenFunction = std::function<int64_t(const VehiclePropValue& value)>;
 
+    enum class Mode {
+        /* All operations are serialized behind a single mutex. */
+        SINGLE_LOCK,
+        /* Values are sharded by property ID and reads are served from lock-free snapshots. */
+        SHARDED,
+    };
+
+    explicit VehiclePropertyStore(Mode mode = Mode::SINGLE_LOCK);
+
 private:
     struct RecordConfig {
         VehiclePropConfig propConfig;
@@ -61,6 +76,14 @@ private:
 
     using PropertyMap = std::map<RecordId, VehiclePropValue>;
     using PropertyMapRange = std::pair<PropertyMap::const_iterator, PropertyMap::const_iterator>;
+    using ConfigIndex = std::unordered_map<int32_t /* VehicleProperty */, const RecordConfig*>;
+
+    struct Shard {
+        std::mutex writeLock;  // Serializes writers of this shard, never taken by readers.
+        std::shared_ptr<const PropertyMap> values;  // Accessed with std::atomic_load/store.
+    };
+
+    static constexpr size_t kShardCount = 64;
 
 public:
     void registerProperty(const VehiclePropConfig& config, TokenFunction tokenFunc = nullptr);
@@ -82,17 +105,38 @@ public:
     const VehiclePropConfig* getConfigOrNull(int32_t propId) const;
     const VehiclePropConfig* getConfigOrDie(int32_t propId) const;
 
+    Mode getMode() const { return mMode; }
+
 private:
     RecordId getRecordIdLocked(const VehiclePropValue& valuePrototype) const;
     const VehiclePropValue* getValueOrNullLocked(const RecordId& recId) const;
     PropertyMapRange findRangeLocked(int32_t propId) const;
 
+    // Helpers for Mode::SHARDED, none of them require mLock to be held.
+    static RecordId makeRecordId(const RecordConfig& config, const VehiclePropValue& value);
+    static PropertyMapRange findRange(const PropertyMap& map, int32_t propId);
+    const RecordConfig* findConfig(int32_t propId) const;
+    Shard& shardFor(int32_t propId) const;
+    std::shared_ptr<const PropertyMap> loadSnapshot(int32_t propId) const;
+    bool writeValueSharded(const VehiclePropValue& propValue, bool updateStatus);
+    void removeValueSharded(const VehiclePropValue& propValue);
+    void removeValuesForPropertySharded(int32_t propId);
+    std::vector<VehiclePropValue> readAllValuesSharded() const;
+    std::vector<VehiclePropValue> readValuesForPropertySharded(int32_t propId) const;
+    std::unique_ptr<VehiclePropValue> readValueOrNullSharded(const RecordId& recId) const;
+
 private:
     using MuxGuard = std::lock_guard<std::mutex>;
+    const Mode mMode;
     mutable std::mutex mLock;
+    // Nodes of unordered_map are never relocated, which keeps pointers to RecordConfig stable.
     std::unordered_map<int32_t /* VehicleProperty */, RecordConfig> mConfigs;
 
     PropertyMap mPropertyValues;  // Sorted map of RecordId : VehiclePropValue.
+
+    // Mode::SHARDED only. mConfigIndex is republished by registerProperty and read lock-free.
+    std::shared_ptr<const ConfigIndex> mConfigIndex;
+    mutable std::array<Shard, kShardCount> mShards;
 };
 
 }  // namespace V2_0
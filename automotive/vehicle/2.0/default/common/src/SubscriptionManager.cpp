@@ -18,6 +18,7 @@
 
 #include "SubscriptionManager.h"
 
+#include <algorithm>
 #include <cmath>
 #include <inttypes.h>
 
@@ -83,6 +84,44 @@ std::vector<int32_t> HalClient::getSubscribedProperties() const {
     return props;
 }
 
+SubscriptionIndex::SubscriptionIndex(
+        std::vector<sp<HalClient>> clients,
+        const std::map<int32_t, std::vector<std::pair<size_t, SubscribeFlags>>>& propToClientSlots)
+    : mClients(std::move(clients)),
+      mWordsPerRow((mClients.size() + kBitsPerWord - 1) / kBitsPerWord) {
+    mProps.reserve(propToClientSlots.size());
+    mBits.assign(propToClientSlots.size() * kFlagCount * mWordsPerRow, 0);
+
+    for (const auto& entry : propToClientSlots) {
+        size_t propIndex = mProps.size();
+        mProps.push_back(entry.first);  // std::map is sorted, so is mProps.
+        for (const auto& slotAndFlags : entry.second) {
+            size_t slot = slotAndFlags.first;
+            for (SubscribeFlags flag : { SubscribeFlags::EVENTS_FROM_CAR,
+                                         SubscribeFlags::EVENTS_FROM_ANDROID }) {
+                if (!(slotAndFlags.second & flag)) continue;
+                size_t row = propIndex * kFlagCount + flagToRow(flag);
+                mBits[row * mWordsPerRow + slot / kBitsPerWord] |=
+                        static_cast<Word>(1) << (slot % kBitsPerWord);
+            }
+        }
+    }
+}
+
+int SubscriptionIndex::flagToRow(SubscribeFlags flag) {
+    return flag == SubscribeFlags::EVENTS_FROM_CAR ? 0 : 1;
+}
+
+const SubscriptionIndex::Word* SubscriptionIndex::findClients(int32_t propId,
+                                                              SubscribeFlags flag) const {
+    auto it = std::lower_bound(mProps.begin(), mProps.end(), propId);
+    if (it == mProps.end() || *it != propId) {
+        return nullptr;
+    }
+    size_t row = (it - mProps.begin()) * kFlagCount + flagToRow(flag);
+    return &mBits[row * mWordsPerRow];
+}
+
 StatusCode SubscriptionManager::addOrUpdateSubscription(
         ClientId clientId,
         const sp<IVehicleCallback> &callback,
@@ -113,6 +152,7 @@ StatusCode SubscriptionManager::addOrUpdateSubscription(
             }
         }
     }
+    rebuildIndexLocked();
 
     return StatusCode::OK;
 }
@@ -144,6 +184,54 @@ std::list<HalClientValues> SubscriptionManager::distributeValuesToClients(
     return clientValues;
 }
 
+void SubscriptionManager::distributeValuesToClients(
+        const std::vector<recyclable_ptr<VehiclePropValue>>& propValues,
+        SubscribeFlags flag,
+        std::vector<HalClientHidlValues>* out) const {
+    out->clear();
+    auto index = std::atomic_load(&mIndex);
+    size_t clientCount = index->getClientCount();
+    if (clientCount == 0) return;
+
+    using Word = SubscriptionIndex::Word;
+    constexpr size_t kBitsPerWord = SubscriptionIndex::kBitsPerWord;
+    size_t words = index->getWordsPerRow();
+
+    // First pass: resolve subscribers of every value once and count values per client.
+    std::vector<const Word*> subscribers(propValues.size());
+    std::vector<size_t> counts(clientCount, 0);
+    for (size_t i = 0; i < propValues.size(); i++) {
+        subscribers[i] = index->findClients(propValues[i]->prop, flag);
+        if (subscribers[i] == nullptr) continue;
+        for (size_t w = 0; w < words; w++) {
+            for (Word bits = subscribers[i][w]; bits != 0; bits &= bits - 1) {
+                counts[w * kBitsPerWord + __builtin_ctzll(bits)]++;
+            }
+        }
+    }
+
+    // Allocate each client's hidl_vec once with the exact size.
+    std::vector<size_t> outIndex(clientCount, SIZE_MAX);
+    for (size_t slot = 0; slot < clientCount; slot++) {
+        if (counts[slot] == 0) continue;
+        outIndex[slot] = out->size();
+        out->push_back({ index->getClient(slot), hidl_vec<VehiclePropValue>() });
+        out->back().values.resize(counts[slot]);
+        counts[slot] = 0;  // Reused as a write position below.
+    }
+
+    // Second pass: shallow-copy values in their original order.
+    for (size_t i = 0; i < propValues.size(); i++) {
+        if (subscribers[i] == nullptr) continue;
+        for (size_t w = 0; w < words; w++) {
+            for (Word bits = subscribers[i][w]; bits != 0; bits &= bits - 1) {
+                size_t slot = w * kBitsPerWord + __builtin_ctzll(bits);
+                shallowCopy(&(*out)[outIndex[slot]].values[counts[slot]++], *propValues[i]);
+            }
+        }
+    }
+}
+
 std::list<sp<HalClient>> SubscriptionManager::getSubscribedClients(int32_t propId,
                                                                    SubscribeFlags flags) const {
     MuxGuard g(mLock);
@@ -265,12 +353,47 @@ void SubscriptionManager::unsubscribe(ClientId clientId,
         }
     }
 
+    rebuildIndexLocked();
+
     if (propertyClients == nullptr || propertyClients->isEmpty()) {
         mHalEventSubscribeOptions.erase(propId);
         mOnPropertyUnsubscribed(propId);
     }
 }
 
+void SubscriptionManager::rebuildIndexLocked() {
+    std::vector<sp<HalClient>> clients;
+    std::map<HalClient*, size_t> clientSlots;
+    std::map<int32_t, std::vector<std::pair<size_t, SubscribeFlags>>> propToClientSlots;
+
+    for (const auto& propClients : mPropToClients) {
+        int32_t propId = propClients.first;
+        const sp<HalClientVector>& halClients = propClients.second;
+        for (size_t i = 0; i < halClients->size(); i++) {
+            const sp<HalClient>& client = halClients->itemAt(i);
+            auto slotIt = clientSlots.find(client.get());
+            if (slotIt == clientSlots.end()) {
+                slotIt = clientSlots.emplace(client.get(), clients.size()).first;
+                clients.push_back(client);
+            }
+
+            int flags = 0;
+            for (SubscribeFlags flag : { SubscribeFlags::EVENTS_FROM_CAR,
+                                         SubscribeFlags::EVENTS_FROM_ANDROID }) {
+                if (client->isSubscribed(propId, flag)) {
+                    flags |= toInt(flag);
+                }
+            }
+            if (flags != 0) {
+                propToClientSlots[propId].push_back({ slotIt->second, SubscribeFlags(flags) });
+            }
+        }
+    }
+
+    std::atomic_store(&mIndex, std::shared_ptr<const SubscriptionIndex>(
+            std::make_shared<SubscriptionIndex>(std::move(clients), propToClientSlots)));
+}
+
 void SubscriptionManager::onCallbackDead(uint64_t cookie) {
     ALOGI("%s, cookie: 0x%" PRIx64, __func__, cookie);
     ClientId clientId = cookie;
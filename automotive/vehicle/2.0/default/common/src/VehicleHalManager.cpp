@@ -34,16 +34,15 @@ namespace V2_0 {
 
 using namespace std::placeholders;
 
+// Upper bound for how long an event may be held back to be batched with other events.
 constexpr std::chrono::milliseconds kHalEventBatchingTimeWindow(10);
+// Batch is delivered if no new events arrived within this time.
+constexpr std::chrono::microseconds kHalEventBatchingIdleGap(200);
+// Batch is delivered once it has that many events.
+constexpr size_t kHalEventBatchSizeThreshold = 128;
 
 const VehiclePropValue kEmptyValue{};
 
-/**
- * Indicates what's the maximum size of hidl_vec<VehiclePropValue> we want
- * to store in reusable object pool.
- */
-constexpr auto kMaxHidlVecOfVehiclPropValuePoolSize = 20;
-
 Return<void> VehicleHalManager::getAllPropConfigs(getAllPropConfigs_cb _hidl_cb) {
     ALOGI("getAllPropConfigs called");
     hidl_vec<VehiclePropConfig> hidlConfigs;
@@ -155,6 +154,7 @@ Return<StatusCode> VehicleHalManager::subscribe(const sp<IVehicleCallback> &call
     }
 
     for (auto opt : updatedOptions) {
+        updateMaxBatchingDelay(opt.propId, opt.sampleRate);
         mHal->subscribe(opt.propId, opt.sampleRate);
     }
 
@@ -168,18 +168,19 @@ Return<StatusCode> VehicleHalManager::unsubscribe(const sp<IVehicleCallback>& ca
 }
 
 Return<void> VehicleHalManager::debugDump(IVehicle::debugDump_cb _hidl_cb) {
-    _hidl_cb("");
+    _hidl_cb(PoolStats::instance()->toString());
     return Void();
 }
 
 void VehicleHalManager::init() {
     ALOGI("VehicleHalManager::init");
 
-    mHidlVecOfVehiclePropValuePool.resize(kMaxHidlVecOfVehiclPropValuePoolSize);
-
-
+    std::atomic_store(&mBatchingDelays, std::make_shared<const BatchingDelayMap>());
     mBatchingConsumer.run(&mEventQueue,
-                          kHalEventBatchingTimeWindow,
+                          { .maxBatchSize = kHalEventBatchSizeThreshold,
+                            .maxDelay = kHalEventBatchingTimeWindow,
+                            .idleGap = kHalEventBatchingIdleGap },
+                          std::bind(&VehicleHalManager::getMaxBatchingDelay, this, _1),
                           std::bind(&VehicleHalManager::onBatchHalEvent,
                                     this, _1));
 
@@ -212,6 +213,29 @@ void VehicleHalManager::onHalEvent(VehiclePropValuePtr v) {
     mEventQueue.push(std::move(v));
 }
 
+std::chrono::nanoseconds VehicleHalManager::getMaxBatchingDelay(
+        const VehiclePropValuePtr& value) const {
+    auto delays = std::atomic_load(&mBatchingDelays);
+    auto it = delays->find(value->prop);
+    return it == delays->end() ? std::chrono::nanoseconds(kHalEventBatchingTimeWindow)
+                               : it->second;
+}
+
+void VehicleHalManager::updateMaxBatchingDelay(int32_t propId, float sampleRate) {
+    // Continuous properties must not be delayed for more than a half of their sampling period,
+    // otherwise subscribers would observe two samples arriving together.
+    std::chrono::nanoseconds delay = kHalEventBatchingTimeWindow;
+    if (sampleRate > 0) {
+        delay = std::min(delay, std::chrono::nanoseconds(
+                                        static_cast<int64_t>(1e9 / sampleRate / 2)));
+    }
+
+    std::lock_guard<std::mutex> g(mBatchingDelaysLock);
+    auto delays = std::make_shared<BatchingDelayMap>(*std::atomic_load(&mBatchingDelays));
+    (*delays)[propId] = delay;
+    std::atomic_store(&mBatchingDelays, std::shared_ptr<const BatchingDelayMap>(std::move(delays)));
+}
+
 void VehicleHalManager::onHalPropertySetError(StatusCode errorCode,
                                               int32_t property,
                                               int32_t areaId) {
@@ -224,29 +248,19 @@ void VehicleHalManager::onHalPropertySetError(StatusCode errorCode,
 }
 
 void VehicleHalManager::onBatchHalEvent(const std::vector<VehiclePropValuePtr>& values) {
-    const auto& clientValues =
-        mSubscriptionManager.distributeValuesToClients(values, SubscribeFlags::EVENTS_FROM_CAR);
-
-    for (const HalClientValues& cv : clientValues) {
-        auto vecSize = cv.values.size();
-        hidl_vec<VehiclePropValue> vec;
-        if (vecSize < kMaxHidlVecOfVehiclPropValuePoolSize) {
-            vec.setToExternal(&mHidlVecOfVehiclePropValuePool[0], vecSize);
-        } else {
-            vec.resize(vecSize);
-        }
+    mSubscriptionManager.distributeValuesToClients(values, SubscribeFlags::EVENTS_FROM_CAR,
+                                                   &mClientValues);
 
-        int i = 0;
-        for (VehiclePropValue* pValue : cv.values) {
-            shallowCopy(&(vec)[i++], *pValue);
-        }
-        auto status = cv.client->getCallback()->onPropertyEvent(vec);
+    for (const HalClientHidlValues& cv : mClientValues) {
+        auto status = cv.client->getCallback()->onPropertyEvent(cv.values);
         if (!status.isOk()) {
             ALOGE("Failed to notify client %s, err: %s",
                   toString(cv.client->getCallback()).c_str(),
                   status.description().c_str());
         }
     }
+    // Values are shallow copies of the batch, drop them before the batch is recycled.
+    mClientValues.clear();
 }
 
 bool VehicleHalManager::isSampleRateFixed(VehiclePropertyChangeMode mode) {
@@ -324,6 +338,13 @@ const VehiclePropConfig* VehicleHalManager::getPropConfigOrNull(
 }
 
 void VehicleHalManager::onAllClientsUnsubscribed(int32_t propertyId) {
+    {
+        std::lock_guard<std::mutex> g(mBatchingDelaysLock);
+        auto delays = std::make_shared<BatchingDelayMap>(*std::atomic_load(&mBatchingDelays));
+        delays->erase(propertyId);
+        std::atomic_store(&mBatchingDelays,
+                          std::shared_ptr<const BatchingDelayMap>(std::move(delays)));
+    }
     mHal->unsubscribe(propertyId);
 }
 
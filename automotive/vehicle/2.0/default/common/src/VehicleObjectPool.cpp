@@ -18,6 +18,12 @@
 
 #include "VehicleObjectPool.h"
 
+#include <string.h>
+
+#include <algorithm>
+#include <sstream>
+#include <vector>
+
 #include <log/log.h>
 
 #include "VehicleUtils.h"
@@ -28,11 +34,277 @@ namespace automotive {
 namespace vehicle {
 namespace V2_0 {
 
+namespace {
+
+// Thread caches are small: they only need to absorb bursts of obtain / release on one thread.
+constexpr size_t kThreadCacheSizePerClass = 16;
+// Number of pools a thread keeps caches for. The least recently used one is flushed when the
+// thread starts using yet another pool.
+constexpr size_t kThreadCachesPerThread = 4;
+
+std::atomic<uint64_t> gNextPoolId { 1 };
+
+template<typename T>
+void copyVecInPlace(hidl_vec<T>* dest, const hidl_vec<T>& src) {
+    if (dest->size() == src.size()) {
+        std::copy(src.begin(), src.end(), dest->begin());
+    } else {
+        *dest = src;
+    }
+}
+
+}  // namespace
+
+struct VehiclePropValuePool::ThreadCache {
+    uint64_t poolId = 0;
+    uint64_t lastUse = 0;
+    std::vector<PooledValue*> bins[kSizeClassCount];
+
+    ~ThreadCache() {
+        clear();
+    }
+
+    void clear() {
+        for (auto& bin : bins) {
+            for (PooledValue* v : bin) {
+                delete v;
+            }
+            bin.clear();
+        }
+    }
+};
+
+std::string PoolStats::toString() const {
+    std::stringstream ss;
+    ss << "VehiclePropValuePool: obtained=" << Obtained << " created=" << Created
+       << " recycled=" << Recycled << " hits=" << Hits << " misses=" << Misses
+       << " disposed=" << Disposed;
+    return ss.str();
+}
+
+VehiclePropValuePool::VehiclePropValuePool(size_t maxRecyclableVectorSize)
+    : mId(gNextPoolId++),
+      mMaxRecyclableVectorSize(maxRecyclableVectorSize),
+      mDeleter(std::bind(&VehiclePropValuePool::recycle, this, std::placeholders::_1)) {
+    for (auto& freeList : mFreeLists) {
+        freeList.reset(new BoundedRing<PooledValue*>(kMaxPooledObjectsPerSizeClass));
+    }
+}
+
+VehiclePropValuePool::~VehiclePropValuePool() {
+    for (auto& freeList : mFreeLists) {
+        PooledValue* v;
+        while (freeList->tryPop(&v)) {
+            delete v;
+        }
+    }
+    // Objects cached by other threads are plain heap objects, they are deleted once these
+    // threads exit or evict the cache of this pool.
+    ThreadCache* caches = getThreadCaches();
+    for (size_t i = 0; i < kThreadCachesPerThread; i++) {
+        if (caches[i].poolId == mId) {
+            caches[i].clear();
+            caches[i].poolId = 0;
+            caches[i].lastUse = 0;
+        }
+    }
+}
+
+VehiclePropValuePool::ThreadCache* VehiclePropValuePool::getThreadCaches() {
+    static thread_local ThreadCache caches[kThreadCachesPerThread];
+    return caches;
+}
+
+VehiclePropValuePool::ThreadCache& VehiclePropValuePool::getThreadCache(uint64_t poolId) {
+    static thread_local uint64_t useCount = 0;
+    ThreadCache* caches = getThreadCaches();
+    ThreadCache* victim = &caches[0];
+    for (size_t i = 0; i < kThreadCachesPerThread; i++) {
+        if (caches[i].poolId == poolId) {
+            caches[i].lastUse = ++useCount;
+            return caches[i];
+        }
+        if (caches[i].lastUse < victim->lastUse) {
+            victim = &caches[i];
+        }
+    }
+    victim->clear();
+    victim->poolId = poolId;
+    victim->lastUse = ++useCount;
+    return *victim;
+}
+
+int VehiclePropValuePool::getSizeClass(size_t payloadSize) {
+    int shift = kMinSizeClassShift;
+    while ((static_cast<size_t>(1) << shift) < payloadSize) {
+        if (++shift > kMaxSizeClassShift) return kDisposable;
+    }
+    return shift - kMinSizeClassShift;
+}
+
+bool VehiclePropValuePool::getPayloadSize(VehiclePropertyType type, size_t vecSize,
+                                          size_t* outSize) {
+    switch (type) {
+        case VehiclePropertyType::INT32:      // fall through
+        case VehiclePropertyType::INT32_VEC:  // fall through
+        case VehiclePropertyType::BOOLEAN:
+            *outSize = vecSize * sizeof(int32_t);
+            return true;
+        case VehiclePropertyType::FLOAT:      // fall through
+        case VehiclePropertyType::FLOAT_VEC:
+            *outSize = vecSize * sizeof(float);
+            return true;
+        case VehiclePropertyType::INT64:
+        case VehiclePropertyType::INT64_VEC:
+            *outSize = vecSize * sizeof(int64_t);
+            return true;
+        case VehiclePropertyType::BYTES:
+            *outSize = vecSize;
+            return true;
+        case VehiclePropertyType::STRING:
+            *outSize = vecSize + 1;  // Room for the terminating null.
+            return true;
+        case VehiclePropertyType::MIXED:
+            *outSize = 0;  // MIXED values get their vectors assigned, only the object is pooled.
+            return true;
+        default:
+            return false;
+    }
+}
+
+void VehiclePropValuePool::attachPayload(PooledValue* v, VehiclePropertyType type,
+                                         size_t vecSize) {
+    uint8_t* payload = v->payload.get();
+    size_t payloadSize = 0;
+    getPayloadSize(type, vecSize, &payloadSize);
+    if (type != VehiclePropertyType::STRING && payloadSize > 0) {
+        memset(payload, 0, payloadSize);
+    }
+
+    switch (type) {
+        case VehiclePropertyType::INT32:      // fall through
+        case VehiclePropertyType::INT32_VEC:  // fall through
+        case VehiclePropertyType::BOOLEAN:
+            v->value.int32Values.setToExternal(reinterpret_cast<int32_t*>(payload), vecSize);
+            break;
+        case VehiclePropertyType::FLOAT:      // fall through
+        case VehiclePropertyType::FLOAT_VEC:
+            v->value.floatValues.setToExternal(reinterpret_cast<float*>(payload), vecSize);
+            break;
+        case VehiclePropertyType::INT64:
+        case VehiclePropertyType::INT64_VEC:
+            v->value.int64Values.setToExternal(reinterpret_cast<int64_t*>(payload), vecSize);
+            break;
+        case VehiclePropertyType::BYTES:
+            v->value.bytes.setToExternal(payload, vecSize);
+            break;
+        default:
+            break;  // Strings are attached once their content is known.
+    }
+}
+
+void VehiclePropValuePool::copyPayload(PooledValue* dest, const VehiclePropValue::RawValue& src) {
+    copyVecInPlace(&dest->value.int32Values, src.int32Values);
+    copyVecInPlace(&dest->value.floatValues, src.floatValues);
+    copyVecInPlace(&dest->value.int64Values, src.int64Values);
+    copyVecInPlace(&dest->value.bytes, src.bytes);
+
+    size_t length = src.stringValue.size();
+    if (length == 0) {
+        dest->value.stringValue.clear();
+    } else if (getPropType(dest->prop) == VehiclePropertyType::STRING && length < dest->capacity) {
+        char* payload = reinterpret_cast<char*>(dest->payload.get());
+        memcpy(payload, src.stringValue.c_str(), length);
+        payload[length] = '\0';
+        dest->value.stringValue.setToExternal(payload, length);
+    } else {
+        dest->value.stringValue = src.stringValue;
+    }
+}
+
+void VehiclePropValuePool::resetValue(PooledValue* v) {
+    // Assigning empty hidl_vecs releases buffers that were allocated by users of the value and
+    // detaches the ones that point to the payload.
+    v->prop = 0;
+    v->areaId = 0;
+    v->timestamp = 0;
+    v->status = VehiclePropertyStatus::AVAILABLE;
+    v->value.int32Values = hidl_vec<int32_t>();
+    v->value.floatValues = hidl_vec<float>();
+    v->value.int64Values = hidl_vec<int64_t>();
+    v->value.bytes = hidl_vec<uint8_t>();
+    v->value.stringValue.clear();
+}
+
+VehiclePropValuePool::PooledValue* VehiclePropValuePool::obtainPooled(int sizeClass) {
+    INC_METRIC(Obtained)
+    auto& bin = getThreadCache(mId).bins[sizeClass];
+    PooledValue* v = nullptr;
+    if (!bin.empty()) {
+        v = bin.back();
+        bin.pop_back();
+    } else {
+        mFreeLists[sizeClass]->tryPop(&v);
+    }
+
+    if (v != nullptr) {
+        INC_METRIC(Hits)
+        return v;
+    }
+
+    INC_METRIC(Created)
+    INC_METRIC(Misses)
+    v = new PooledValue;
+    v->capacity = static_cast<size_t>(1) << (sizeClass + kMinSizeClassShift);
+    v->payload.reset(new uint8_t[v->capacity]);
+    v->sizeClass = sizeClass;
+    return v;
+}
+
+void VehiclePropValuePool::recycle(VehiclePropValue* o) {
+    if (o == nullptr) {
+        ALOGE("Attempt to recycle nullptr");
+        return;
+    }
+
+    PooledValue* v = static_cast<PooledValue*>(o);
+    if (v->sizeClass == kDisposable) {
+        delete v;
+        return;
+    }
+
+    INC_METRIC(Recycled)
+    resetValue(v);
+    auto& bin = getThreadCache(mId).bins[v->sizeClass];
+    if (bin.size() < kThreadCacheSizePerClass) {
+        bin.push_back(v);
+    } else if (!mFreeLists[v->sizeClass]->tryPush(v)) {
+        INC_METRIC(Disposed)
+        delete v;
+    }
+}
+
 VehiclePropValuePool::RecyclableType VehiclePropValuePool::obtain(
         VehiclePropertyType type, size_t vecSize) {
-    return isDisposable(type, vecSize)
-           ? obtainDisposable(type, vecSize)
-           : obtainRecylable(type, vecSize);
+    size_t payloadSize = 0;
+    if (!getPayloadSize(type, vecSize, &payloadSize)) {
+        ALOGE("%s: unknown type: %d", __func__, type);
+        return RecyclableType();
+    }
+
+    int sizeClass = vecSize > mMaxRecyclableVectorSize ? kDisposable : getSizeClass(payloadSize);
+    PooledValue* v;
+    if (sizeClass == kDisposable) {
+        INC_METRIC(Misses)
+        v = new PooledValue;
+        v->capacity = payloadSize;
+        v->payload.reset(new uint8_t[payloadSize]);
+    } else {
+        v = obtainPooled(sizeClass);
+    }
+
+    attachPayload(v, type, vecSize);
+    return RecyclableType { v, mDeleter };
 }
 
 VehiclePropValuePool::RecyclableType VehiclePropValuePool::obtain(
@@ -42,14 +314,19 @@ VehiclePropValuePool::RecyclableType VehiclePropValuePool::obtain(
         return RecyclableType();
     }
     VehiclePropertyType type = getPropType(src.prop);
-    size_t vecSize = getVehicleRawValueVectorSize(src.value, type);;
+    size_t vecSize = type == VehiclePropertyType::STRING
+            ? src.value.stringValue.size()
+            : getVehicleRawValueVectorSize(src.value, type);
     auto dest = obtain(type, vecSize);
+    if (!dest) {
+        return dest;
+    }
 
     dest->prop = src.prop;
     dest->areaId = src.areaId;
     dest->status = src.status;
     dest->timestamp = src.timestamp;
-    copyVehicleRawValue(&dest->value, src.value);
+    copyPayload(static_cast<PooledValue*>(dest.get()), src.value);
 
     return dest;
 }
@@ -77,8 +354,12 @@ VehiclePropValuePool::RecyclableType VehiclePropValuePool::obtainFloat(
 
 VehiclePropValuePool::RecyclableType VehiclePropValuePool::obtainString(
         const char* cstr) {
-    auto val = obtain(VehiclePropertyType::STRING);
-    val->value.stringValue = cstr;
+    size_t length = strlen(cstr);
+    auto val = obtain(VehiclePropertyType::STRING, length);
+    PooledValue* v = static_cast<PooledValue*>(val.get());
+    char* payload = reinterpret_cast<char*>(v->payload.get());
+    memcpy(payload, cstr, length + 1);
+    v->value.stringValue.setToExternal(payload, length);
     return val;
 }
 
@@ -86,73 +367,16 @@ VehiclePropValuePool::RecyclableType VehiclePropValuePool::obtainComplex() {
     return obtain(VehiclePropertyType::MIXED);
 }
 
-VehiclePropValuePool::RecyclableType VehiclePropValuePool::obtainRecylable(
-        VehiclePropertyType type, size_t vecSize) {
-    // VehiclePropertyType is not overlapping with vectorSize.
-    int32_t key = static_cast<int32_t>(type)
-                  | static_cast<int32_t>(vecSize);
-
-    std::lock_guard<std::mutex> g(mLock);
-    auto it = mValueTypePools.find(key);
-
-    if (it == mValueTypePools.end()) {
-        auto newPool(std::make_unique<InternalPool>(type, vecSize));
-        it = mValueTypePools.emplace(key, std::move(newPool)).first;
-    }
-    return it->second->obtain();
-}
-
 VehiclePropValuePool::RecyclableType VehiclePropValuePool::obtainBoolean(
         bool value)  {
     return obtainInt32(value);
 }
 
-VehiclePropValuePool::RecyclableType VehiclePropValuePool::obtainDisposable(
-        VehiclePropertyType valueType, size_t vectorSize) const {
-    return RecyclableType {
-        createVehiclePropValue(valueType, vectorSize).release(),
-        mDisposableDeleter
-    };
-}
-
 VehiclePropValuePool::RecyclableType VehiclePropValuePool::obtain(
         VehiclePropertyType type) {
     return obtain(type, 1);
 }
 
-
-void VehiclePropValuePool::InternalPool::recycle(VehiclePropValue* o) {
-    if (o == nullptr) {
-        ALOGE("Attempt to recycle nullptr");
-        return;
-    }
-
-    if (!check(&o->value)) {
-        ALOGE("Discarding value for prop 0x%x because it contains "
-                  "data that is not consistent with this pool. "
-                  "Expected type: %d, vector size: %zu",
-              o->prop, mPropType, mVectorSize);
-        delete o;
-    } else {
-        ObjectPool<VehiclePropValue>::recycle(o);
-    }
-}
-
-bool VehiclePropValuePool::InternalPool::check(VehiclePropValue::RawValue* v) {
-    return check(&v->int32Values, (VehiclePropertyType::INT32 == mPropType ||
-                                   VehiclePropertyType::INT32_VEC == mPropType ||
-                                   VehiclePropertyType::BOOLEAN == mPropType)) &&
-           check(&v->floatValues, (VehiclePropertyType::FLOAT == mPropType ||
-                                   VehiclePropertyType::FLOAT_VEC == mPropType)) &&
-           check(&v->int64Values, (VehiclePropertyType::INT64 == mPropType ||
-                                   VehiclePropertyType::INT64_VEC == mPropType)) &&
-           check(&v->bytes, VehiclePropertyType::BYTES == mPropType) && v->stringValue.size() == 0;
-}
-
-VehiclePropValue* VehiclePropValuePool::InternalPool::createObject() {
-    return createVehiclePropValue(mPropType, mVectorSize).release();
-}
-
 }  // namespace V2_0
 }  // namespace vehicle
 }  // namespace automotive
@@ -35,14 +35,28 @@ bool VehiclePropertyStore::RecordId::operator<(const VehiclePropertyStore::Recor
            || (prop == other.prop && area == other.area && token < other.token);
 }
 
+VehiclePropertyStore::VehiclePropertyStore(Mode mode)
+    : mMode(mode), mConfigIndex(std::make_shared<const ConfigIndex>()) {
+    for (auto& shard : mShards) {
+        shard.values = std::make_shared<const PropertyMap>();
+    }
+}
+
 void VehiclePropertyStore::registerProperty(const VehiclePropConfig& config,
                                             VehiclePropertyStore::TokenFunction tokenFunc) {
     MuxGuard g(mLock);
-    mConfigs.insert({ config.prop, RecordConfig { config, tokenFunc } });
+    auto result = mConfigs.insert({ config.prop, RecordConfig { config, tokenFunc } });
+    if (mMode == Mode::SHARDED && result.second) {
+        auto index = std::make_shared<ConfigIndex>(*std::atomic_load(&mConfigIndex));
+        index->insert({ config.prop, &result.first->second });
+        std::atomic_store(&mConfigIndex, std::shared_ptr<const ConfigIndex>(std::move(index)));
+    }
 }
 
 bool VehiclePropertyStore::writeValue(const VehiclePropValue& propValue,
                                         bool updateStatus) {
+    if (mMode == Mode::SHARDED) return writeValueSharded(propValue, updateStatus);
+
     MuxGuard g(mLock);
     if (!mConfigs.count(propValue.prop)) return false;
 
@@ -61,6 +75,8 @@ bool VehiclePropertyStore::writeValue(const VehiclePropValue& propValue,
 }
 
 void VehiclePropertyStore::removeValue(const VehiclePropValue& propValue) {
+    if (mMode == Mode::SHARDED) return removeValueSharded(propValue);
+
     MuxGuard g(mLock);
     RecordId recId = getRecordIdLocked(propValue);
     auto it = mPropertyValues.find(recId);
@@ -70,12 +86,16 @@ void VehiclePropertyStore::removeValue(const VehiclePropValue& propValue) {
 }
 
 void VehiclePropertyStore::removeValuesForProperty(int32_t propId) {
+    if (mMode == Mode::SHARDED) return removeValuesForPropertySharded(propId);
+
     MuxGuard g(mLock);
     auto range = findRangeLocked(propId);
     mPropertyValues.erase(range.first, range.second);
 }
 
 std::vector<VehiclePropValue> VehiclePropertyStore::readAllValues() const {
+    if (mMode == Mode::SHARDED) return readAllValuesSharded();
+
     MuxGuard g(mLock);
     std::vector<VehiclePropValue> allValues;
     allValues.reserve(mPropertyValues.size());
@@ -86,6 +106,8 @@ std::vector<VehiclePropValue> VehiclePropertyStore::readAllValues() const {
 }
 
 std::vector<VehiclePropValue> VehiclePropertyStore::readValuesForProperty(int32_t propId) const {
+    if (mMode == Mode::SHARDED) return readValuesForPropertySharded(propId);
+
     std::vector<VehiclePropValue> values;
     MuxGuard g(mLock);
     auto range = findRangeLocked(propId);
@@ -98,6 +120,11 @@ std::vector<VehiclePropValue> VehiclePropertyStore::readValuesForProperty(int32_
 
 std::unique_ptr<VehiclePropValue> VehiclePropertyStore::readValueOrNull(
         const VehiclePropValue& request) const {
+    if (mMode == Mode::SHARDED) {
+        const RecordConfig* config = findConfig(request.prop);
+        return config ? readValueOrNullSharded(makeRecordId(*config, request)) : nullptr;
+    }
+
     MuxGuard g(mLock);
     RecordId recId = getRecordIdLocked(request);
     const VehiclePropValue* internalValue = getValueOrNullLocked(recId);
@@ -107,6 +134,8 @@ std::unique_ptr<VehiclePropValue> VehiclePropertyStore::readValueOrNull(
 std::unique_ptr<VehiclePropValue> VehiclePropertyStore::readValueOrNull(
         int32_t prop, int32_t area, int64_t token) const {
     RecordId recId = {prop, isGlobalProp(prop) ? 0 : area, token };
+    if (mMode == Mode::SHARDED) return readValueOrNullSharded(recId);
+
     MuxGuard g(mLock);
     const VehiclePropValue* internalValue = getValueOrNullLocked(recId);
     return internalValue ? std::make_unique<VehiclePropValue>(*internalValue) : nullptr;
@@ -124,6 +153,11 @@ std::vector<VehiclePropConfig> VehiclePropertyStore::getAllConfigs() const {
 }
 
 const VehiclePropConfig* VehiclePropertyStore::getConfigOrNull(int32_t propId) const {
+    if (mMode == Mode::SHARDED) {
+        const RecordConfig* config = findConfig(propId);
+        return config ? &config->propConfig : nullptr;
+    }
+
     MuxGuard g(mLock);
     auto recordConfigIt = mConfigs.find(propId);
     return recordConfigIt != mConfigs.end() ? &recordConfigIt->second.propConfig : nullptr;
@@ -169,6 +203,135 @@ VehiclePropertyStore::PropertyMapRange VehiclePropertyStore::findRangeLocked(int
     return  PropertyMapRange { beginIt, endIt };
 }
 
+VehiclePropertyStore::RecordId VehiclePropertyStore::makeRecordId(
+        const RecordConfig& config, const VehiclePropValue& value) {
+    RecordId recId = {
+        .prop = value.prop,
+        .area = isGlobalProp(value.prop) ? 0 : value.areaId,
+        .token = 0
+    };
+    if (config.tokenFunction != nullptr) {
+        recId.token = config.tokenFunction(value);
+    }
+    return recId;
+}
+
+VehiclePropertyStore::PropertyMapRange VehiclePropertyStore::findRange(const PropertyMap& map,
+                                                                       int32_t propId) {
+    auto beginIt = map.lower_bound(RecordId { propId, INT32_MIN, 0 });
+    auto endIt = map.lower_bound(RecordId { propId + 1, INT32_MIN, 0 });
+    return PropertyMapRange { beginIt, endIt };
+}
+
+const VehiclePropertyStore::RecordConfig* VehiclePropertyStore::findConfig(int32_t propId) const {
+    // RecordConfigs are owned by mConfigs and never removed, so the pointer outlives the snapshot.
+    auto index = std::atomic_load(&mConfigIndex);
+    auto it = index->find(propId);
+    return it == index->end() ? nullptr : it->second;
+}
+
+VehiclePropertyStore::Shard& VehiclePropertyStore::shardFor(int32_t propId) const {
+    // Property IDs of one group differ mostly in the low bits, mix them before picking the shard.
+    uint32_t h = static_cast<uint32_t>(propId);
+    h ^= h >> 16;
+    h *= 0x45d9f3bu;
+    h ^= h >> 16;
+    return mShards[h % kShardCount];
+}
+
+std::shared_ptr<const VehiclePropertyStore::PropertyMap> VehiclePropertyStore::loadSnapshot(
+        int32_t propId) const {
+    return std::atomic_load(&shardFor(propId).values);
+}
+
+bool VehiclePropertyStore::writeValueSharded(const VehiclePropValue& propValue,
+                                             bool updateStatus) {
+    const RecordConfig* config = findConfig(propValue.prop);
+    if (config == nullptr) return false;
+
+    RecordId recId = makeRecordId(*config, propValue);
+    Shard& shard = shardFor(propValue.prop);
+
+    MuxGuard g(shard.writeLock);
+    auto values = std::make_shared<PropertyMap>(*shard.values);
+    auto it = values->find(recId);
+    if (it == values->end()) {
+        values->insert({ recId, propValue });
+    } else {
+        it->second.timestamp = propValue.timestamp;
+        it->second.value = propValue.value;
+        if (updateStatus) {
+            it->second.status = propValue.status;
+        }
+    }
+    std::atomic_store(&shard.values, std::shared_ptr<const PropertyMap>(std::move(values)));
+    return true;
+}
+
+void VehiclePropertyStore::removeValueSharded(const VehiclePropValue& propValue) {
+    const RecordConfig* config = findConfig(propValue.prop);
+    if (config == nullptr) return;
+
+    RecordId recId = makeRecordId(*config, propValue);
+    Shard& shard = shardFor(recId.prop);
+
+    MuxGuard g(shard.writeLock);
+    if (!shard.values->count(recId)) return;
+    auto values = std::make_shared<PropertyMap>(*shard.values);
+    values->erase(recId);
+    std::atomic_store(&shard.values, std::shared_ptr<const PropertyMap>(std::move(values)));
+}
+
+void VehiclePropertyStore::removeValuesForPropertySharded(int32_t propId) {
+    Shard& shard = shardFor(propId);
+
+    MuxGuard g(shard.writeLock);
+    auto range = findRange(*shard.values, propId);
+    if (range.first == range.second) return;
+    auto values = std::make_shared<PropertyMap>(*shard.values);
+    auto mutableRange = findRange(*values, propId);
+    values->erase(mutableRange.first, mutableRange.second);
+    std::atomic_store(&shard.values, std::shared_ptr<const PropertyMap>(std::move(values)));
+}
+
+std::vector<VehiclePropValue> VehiclePropertyStore::readAllValuesSharded() const {
+    std::array<std::shared_ptr<const PropertyMap>, kShardCount> snapshots;
+    size_t total = 0;
+    for (size_t i = 0; i < kShardCount; i++) {
+        snapshots[i] = std::atomic_load(&mShards[i].values);
+        total += snapshots[i]->size();
+    }
+
+    // Values are grouped by shard, order across properties is not defined.
+    std::vector<VehiclePropValue> allValues;
+    allValues.reserve(total);
+    for (auto&& snapshot : snapshots) {
+        for (auto&& it : *snapshot) {
+            allValues.push_back(it.second);
+        }
+    }
+    return allValues;
+}
+
+std::vector<VehiclePropValue> VehiclePropertyStore::readValuesForPropertySharded(
+        int32_t propId) const {
+    auto snapshot = loadSnapshot(propId);
+    auto range = findRange(*snapshot, propId);
+
+    std::vector<VehiclePropValue> values;
+    for (auto it = range.first; it != range.second; ++it) {
+        values.push_back(it->second);
+    }
+    return values;
+}
+
+std::unique_ptr<VehiclePropValue> VehiclePropertyStore::readValueOrNullSharded(
+        const RecordId& recId) const {
+    auto snapshot = loadSnapshot(recId.prop);
+    auto it = snapshot->find(recId);
+    return it == snapshot->end() ? nullptr : std::make_unique<VehiclePropValue>(it->second);
+}
+
 }  // namespace V2_0
 }  // namespace vehicle
 }  // namespace automotive
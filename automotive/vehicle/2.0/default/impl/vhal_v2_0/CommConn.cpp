@@ -42,28 +42,29 @@ void CommConn::stop() {
 }
 
 void CommConn::sendMessage(emulator::EmulatorMessage const& msg) {
+    std::lock_guard<std::mutex> lock(mTxLock);
     int numBytes = msg.ByteSize();
-    std::vector<uint8_t> buffer(static_cast<size_t>(numBytes));
-    if (!msg.SerializeToArray(buffer.data(), numBytes)) {
+    mTxBuffer.resize(static_cast<size_t>(numBytes));
+    if (!msg.SerializeToArray(mTxBuffer.data(), numBytes)) {
         ALOGE("%s: SerializeToString failed!", __func__);
         return;
     }
 
-    write(buffer);
+    write(mTxBuffer);
 }
 
 void CommConn::readThread() {
     std::vector<uint8_t> buffer;
+    emulator::EmulatorMessage rxMsg;
+    emulator::EmulatorMessage respMsg;
     while (isOpen()) {
-        buffer = read();
-        if (buffer.size() == 0) {
+        if (!read(&buffer) || buffer.size() == 0) {
             ALOGI("%s: Read returned empty message, exiting read loop.", __func__);
             break;
         }
 
-        emulator::EmulatorMessage rxMsg;
         if (rxMsg.ParseFromArray(buffer.data(), static_cast<int32_t>(buffer.size()))) {
-            emulator::EmulatorMessage respMsg;
+            respMsg.Clear();
             mMessageProcessor->processMessage(rxMsg, respMsg);
 
             sendMessage(respMsg);
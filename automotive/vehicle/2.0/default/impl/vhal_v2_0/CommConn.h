@@ -18,6 +18,7 @@
 #define android_hardware_automotive_vehicle_V2_0_impl_CommBase_H_
 
 #include <android/hardware/automotive/vehicle/2.0/IVehicle.h>
+#include <mutex>
 #include <string>
 #include <thread>
 #include <vector>
@@ -74,12 +75,14 @@ class CommConn {
     virtual bool isOpen() = 0;
 
     /**
-     * Blocking call to read data from the connection.
+     * Blocking call to read data from the connection. The capacity of msg is reused, so that
+     * reading messages does not allocate once it is large enough.
      *
-     * @return std::vector<uint8_t> Serialized protobuf data received from emulator.  This will be
-     *              an empty vector if the connection was closed or some other error occurred.
+     * @param msg Set to the serialized protobuf data received from emulator.
+     *
+     * @return bool False if the connection was closed or some other error occurred.
      */
-    virtual std::vector<uint8_t> read() = 0;
+    virtual bool read(std::vector<uint8_t>* msg) = 0;
 
     /**
      * Transmits a string of data to the emulator.
@@ -91,7 +94,8 @@ class CommConn {
     virtual int write(const std::vector<uint8_t>& data) = 0;
 
     /**
-     * Serialized and send the given message to the other side.
+     * Serialized and send the given message to the other side. Messages sent from different
+     * threads are not interleaved.
      */
     void sendMessage(emulator::EmulatorMessage const& msg);
 
@@ -99,6 +103,10 @@ class CommConn {
     std::unique_ptr<std::thread> mReadThread;
     MessageProcessor* mMessageProcessor;
 
+    // Guards mTxBuffer, which is reused to serialize each message sent.
+    std::mutex mTxLock;
+    std::vector<uint8_t> mTxBuffer;
+
     /**
      * A thread that reads messages in a loop, and responds. You can stop this thread by calling
      * stop().
@@ -122,7 +122,9 @@ enum class FakeDataCommand : int32_t {
      * Caller must provide additional data:
      *     int32Values[1] - number of iterations. If it is not provided or -1. The iteration will be
      *                      repeated infinite times.
-     *     stringValue    - path to the fake values JSON file
+     *     stringValue    - path to the fake values JSON file, or to a binary replay file converted
+     *                      from it by vhal-fake-value-converter. Events are read from the file as
+     *                      they are injected.
      */
     StartJson = 2,
 
@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "FakeValueReader"
+
+#include <fstream>
+
+#include <log/log.h>
+
+#include "FakeValueReader.h"
+#include "FakeValueReplayFile.h"
+#include "JsonFakeValueReader.h"
+
+namespace android {
+namespace hardware {
+namespace automotive {
+namespace vehicle {
+namespace V2_0 {
+
+namespace impl {
+
+FakeValueReaderPtr openFakeValueFile(const std::string& path) {
+    if (FakeValueReplayReader::isReplayFile(path)) {
+        return FakeValueReplayReader::open(path);
+    }
+    auto ifs = std::make_unique<std::ifstream>(path);
+    if (!*ifs) {
+        ALOGE("%s: couldn't open %s for parsing.", __func__, path.c_str());
+        return nullptr;
+    }
+    return std::make_unique<JsonFakeValueReader>(std::move(ifs));
+}
+
+}  // namespace impl
+
+}  // namespace V2_0
+}  // namespace vehicle
+}  // namespace automotive
+}  // namespace hardware
+}  // namespace android
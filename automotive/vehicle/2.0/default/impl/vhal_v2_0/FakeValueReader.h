@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef android_hardware_automotive_vehicle_V2_0_impl_FakeValueReader_H_
+#define android_hardware_automotive_vehicle_V2_0_impl_FakeValueReader_H_
+
+#include <memory>
+#include <string>
+
+#include <android/hardware/automotive/vehicle/2.0/types.h>
+
+namespace android {
+namespace hardware {
+namespace automotive {
+namespace vehicle {
+namespace V2_0 {
+
+namespace impl {
+
+/**
+ * Reads the events recorded in a fake value file one at a time, so that only the current event
+ * has to be kept in memory whatever the size of the file.
+ */
+class FakeValueReader {
+public:
+    virtual ~FakeValueReader() = default;
+
+    /**
+     * Reads the next event into |event|. Returns false once all the events have been read.
+     */
+    virtual bool next(VehiclePropValue* event) = 0;
+
+    /**
+     * Goes back to the first event. Returns false on failure.
+     */
+    virtual bool rewind() = 0;
+};
+
+using FakeValueReaderPtr = std::unique_ptr<FakeValueReader>;
+
+/**
+ * Opens the fake value file at |path|, which is either a binary replay file written by
+ * writeReplayFile() or a JSON array of events. Returns nullptr if it can't be opened.
+ */
+FakeValueReaderPtr openFakeValueFile(const std::string& path);
+
+}  // namespace impl
+
+}  // namespace V2_0
+}  // namespace vehicle
+}  // namespace automotive
+}  // namespace hardware
+}  // namespace android
+
+#endif  // android_hardware_automotive_vehicle_V2_0_impl_FakeValueReader_H_
@@ -0,0 +1,295 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "FakeValueReplayFile"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <vector>
+
+#include <android-base/unique_fd.h>
+#include <log/log.h>
+
+#include "FakeValueReplayFile.h"
+
+namespace android {
+namespace hardware {
+namespace automotive {
+namespace vehicle {
+namespace V2_0 {
+
+namespace impl {
+
+namespace {
+
+constexpr char kMagic[8] = {'V', 'H', 'A', 'L', 'R', 'P', 'L', 'Y'};
+constexpr uint32_t kVersion = 1;
+constexpr size_t kRecordAlignment = 8;
+// Pages of the events already replayed are dropped in chunks of this size.
+constexpr size_t kReleaseChunkSize = 1024 * 1024;
+
+struct FileHeader {
+    char magic[sizeof(kMagic)];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t numEvents;
+    uint64_t indexOffset;
+};
+
+struct RecordHeader {
+    int64_t timestamp;
+    int32_t prop;
+    int32_t areaId;
+    int32_t status;
+    uint32_t numInt32Values;
+    uint32_t numFloatValues;
+    uint32_t numInt64Values;
+    uint32_t numBytes;
+    uint32_t stringLength;
+};
+
+static_assert(sizeof(FileHeader) % kRecordAlignment == 0, "Records must start aligned");
+
+size_t alignRecord(size_t offset) {
+    return (offset + kRecordAlignment - 1) & ~(kRecordAlignment - 1);
+}
+
+size_t alignDownToPage(size_t offset) {
+    static const size_t kPageSize = sysconf(_SC_PAGESIZE);
+    return offset & ~(kPageSize - 1);
+}
+
+// Copies |count| elements at |offset| of |data| into |dest|, and moves |offset| past them.
+template <typename T>
+bool readArray(const uint8_t* data, size_t size, size_t* offset, uint32_t count,
+               hidl_vec<T>* dest) {
+    const uint64_t length = uint64_t{count} * sizeof(T);
+    if (length > size - *offset) {
+        return false;
+    }
+    dest->resize(count);
+    if (length > 0) {
+        memcpy(dest->data(), data + *offset, length);
+        *offset += length;
+    }
+    return true;
+}
+
+template <typename T>
+size_t writeArray(std::ofstream& os, const hidl_vec<T>& array) {
+    os.write(reinterpret_cast<const char*>(array.data()), array.size() * sizeof(T));
+    return array.size() * sizeof(T);
+}
+
+}  // namespace
+
+std::unique_ptr<FakeValueReplayReader> FakeValueReplayReader::open(const std::string& path) {
+    base::unique_fd fd(TEMP_FAILURE_RETRY(::open(path.c_str(), O_RDONLY | O_CLOEXEC)));
+    if (fd == -1) {
+        ALOGE("%s: couldn't open %s: %s", __func__, path.c_str(), strerror(errno));
+        return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        ALOGE("%s: couldn't stat %s: %s", __func__, path.c_str(), strerror(errno));
+        return nullptr;
+    }
+    const size_t size = st.st_size;
+    if (size < sizeof(FileHeader)) {
+        ALOGE("%s: %s is too small to be a replay file", __func__, path.c_str());
+        return nullptr;
+    }
+    void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+        ALOGE("%s: couldn't map %s: %s", __func__, path.c_str(), strerror(errno));
+        return nullptr;
+    }
+    // Events are replayed in order, pages already read can be dropped.
+    madvise(data, size, MADV_SEQUENTIAL);
+
+    FileHeader header;
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion ||
+        header.indexOffset > size ||
+        header.numEvents > (size - header.indexOffset) / sizeof(uint64_t)) {
+        ALOGE("%s: %s is not a valid replay file", __func__, path.c_str());
+        munmap(data, size);
+        return nullptr;
+    }
+    return std::unique_ptr<FakeValueReplayReader>(new FakeValueReplayReader(
+            static_cast<const uint8_t*>(data), size, header.numEvents, header.indexOffset));
+}
+
+FakeValueReplayReader::FakeValueReplayReader(const uint8_t* data, size_t size, size_t numEvents,
+                                             size_t indexOffset)
+    : mData(data),
+      mSize(size),
+      mNumEvents(numEvents),
+      mIndexOffset(indexOffset),
+      mNextEvent(0),
+      mEventsPagesBegin(0),
+      mIndexPagesBegin(alignDownToPage(indexOffset)) {}
+
+FakeValueReplayReader::~FakeValueReplayReader() {
+    munmap(const_cast<uint8_t*>(mData), mSize);
+}
+
+bool FakeValueReplayReader::next(VehiclePropValue* event) {
+    if (mNextEvent >= mNumEvents) {
+        return false;
+    }
+    const size_t indexEntry = mIndexOffset + mNextEvent * sizeof(uint64_t);
+    uint64_t offset;
+    memcpy(&offset, mData + indexEntry, sizeof(offset));
+    if (!readEvent(offset, event)) {
+        ALOGE("%s: event %zu of the replay file is corrupted", __func__, mNextEvent);
+        mNextEvent = mNumEvents;
+        return false;
+    }
+    mNextEvent++;
+    // Events are not read again until the next iteration, so that resident memory does not grow
+    // with the size of the file.
+    releasePages(&mEventsPagesBegin, offset);
+    releasePages(&mIndexPagesBegin, indexEntry);
+    return true;
+}
+
+bool FakeValueReplayReader::rewind() {
+    return seek(0);
+}
+
+bool FakeValueReplayReader::seek(size_t index) {
+    if (index > mNumEvents) {
+        return false;
+    }
+    mNextEvent = index;
+    uint64_t offset = mIndexOffset;
+    if (index < mNumEvents) {
+        memcpy(&offset, mData + mIndexOffset + index * sizeof(offset), sizeof(offset));
+    }
+    mEventsPagesBegin = alignDownToPage(std::min<uint64_t>(offset, mIndexOffset));
+    mIndexPagesBegin = alignDownToPage(mIndexOffset + index * sizeof(uint64_t));
+    return true;
+}
+
+bool FakeValueReplayReader::isReplayFile(const std::string& path) {
+    std::ifstream ifs(path, std::ios::binary);
+    char magic[sizeof(kMagic)];
+    return ifs.read(magic, sizeof(magic)) && memcmp(magic, kMagic, sizeof(kMagic)) == 0;
+}
+
+bool FakeValueReplayReader::readEvent(size_t offset, VehiclePropValue* event) const {
+    // Records are all before the index.
+    if (offset > mIndexOffset || mIndexOffset - offset < sizeof(RecordHeader)) {
+        return false;
+    }
+    RecordHeader record;
+    memcpy(&record, mData + offset, sizeof(record));
+    offset += sizeof(record);
+
+    event->timestamp = record.timestamp;
+    event->prop = record.prop;
+    event->areaId = record.areaId;
+    event->status = static_cast<VehiclePropertyStatus>(record.status);
+    auto& value = event->value;
+    if (!readArray(mData, mIndexOffset, &offset, record.numInt32Values, &value.int32Values) ||
+        !readArray(mData, mIndexOffset, &offset, record.numFloatValues, &value.floatValues) ||
+        !readArray(mData, mIndexOffset, &offset, record.numInt64Values, &value.int64Values) ||
+        !readArray(mData, mIndexOffset, &offset, record.numBytes, &value.bytes) ||
+        record.stringLength > mIndexOffset - offset) {
+        return false;
+    }
+    value.stringValue.setTo(reinterpret_cast<const char*>(mData + offset), record.stringLength);
+    return true;
+}
+
+void FakeValueReplayReader::releasePages(size_t* begin, size_t end) {
+    end = alignDownToPage(end);
+    if (end < *begin + kReleaseChunkSize) {
+        return;
+    }
+    madvise(const_cast<uint8_t*>(mData) + *begin, end - *begin, MADV_DONTNEED);
+    *begin = end;
+}
+
+ssize_t writeReplayFile(FakeValueReader* reader, const std::string& path) {
+    std::ofstream os(path, std::ios::binary | std::ios::trunc);
+    if (!os) {
+        ALOGE("%s: couldn't open %s for writing.", __func__, path.c_str());
+        return -1;
+    }
+    FileHeader header = {};
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    const char padding[kRecordAlignment] = {};
+    std::vector<uint64_t> index;
+    size_t offset = sizeof(header);
+    VehiclePropValue event;
+    while (reader->next(&event)) {
+        index.push_back(offset);
+        const auto& value = event.value;
+        const RecordHeader record = {
+                .timestamp = event.timestamp,
+                .prop = event.prop,
+                .areaId = event.areaId,
+                .status = static_cast<int32_t>(event.status),
+                .numInt32Values = static_cast<uint32_t>(value.int32Values.size()),
+                .numFloatValues = static_cast<uint32_t>(value.floatValues.size()),
+                .numInt64Values = static_cast<uint32_t>(value.int64Values.size()),
+                .numBytes = static_cast<uint32_t>(value.bytes.size()),
+                .stringLength = static_cast<uint32_t>(value.stringValue.size()),
+        };
+        os.write(reinterpret_cast<const char*>(&record), sizeof(record));
+        offset += sizeof(record);
+        offset += writeArray(os, value.int32Values);
+        offset += writeArray(os, value.floatValues);
+        offset += writeArray(os, value.int64Values);
+        offset += writeArray(os, value.bytes);
+        os.write(value.stringValue.c_str(), value.stringValue.size());
+        offset += value.stringValue.size();
+        os.write(padding, alignRecord(offset) - offset);
+        offset = alignRecord(offset);
+    }
+
+    header.numEvents = index.size();
+    header.indexOffset = offset;
+    os.write(reinterpret_cast<const char*>(index.data()), index.size() * sizeof(uint64_t));
+    os.seekp(0);
+    os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    os.flush();
+    if (!os) {
+        ALOGE("%s: failed to write %s.", __func__, path.c_str());
+        return -1;
+    }
+    return index.size();
+}
+
+}  // namespace impl
+
+}  // namespace V2_0
+}  // namespace vehicle
+}  // namespace automotive
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef android_hardware_automotive_vehicle_V2_0_impl_FakeValueReplayFile_H_
+#define android_hardware_automotive_vehicle_V2_0_impl_FakeValueReplayFile_H_
+
+#include <sys/types.h>
+
+#include <memory>
+#include <string>
+
+#include "FakeValueReader.h"
+
+namespace android {
+namespace hardware {
+namespace automotive {
+namespace vehicle {
+namespace V2_0 {
+
+namespace impl {
+
+/**
+ * Binary replay files hold the same events as fake value JSON files, in a form which can be read
+ * in place. All values are in the host byte order:
+ *
+ *     header  - magic "VHALRPLY", uint32 version, uint32 reserved, uint64 number of events,
+ *               uint64 offset of the index
+ *     events  - one record per event, each starting on an 8 bytes boundary: int64 timestamp,
+ *               int32 prop, int32 areaId, int32 status, then uint32 element counts of
+ *               int32Values, floatValues, int64Values, bytes and stringValue, followed by the
+ *               elements of each of them in that order
+ *     index   - uint64 offset of each event record
+ */
+class FakeValueReplayReader : public FakeValueReader {
+public:
+    /**
+     * Maps the replay file at |path|. Returns nullptr if it is not a valid replay file.
+     */
+    static std::unique_ptr<FakeValueReplayReader> open(const std::string& path);
+
+    ~FakeValueReplayReader();
+
+    bool next(VehiclePropValue* event) override;
+
+    bool rewind() override;
+
+    size_t size() const { return mNumEvents; }
+
+    /**
+     * Makes |index| the next event returned by next(). Returns false if it is out of range.
+     */
+    bool seek(size_t index);
+
+    /**
+     * Returns true if the file at |path| starts like a replay file.
+     */
+    static bool isReplayFile(const std::string& path);
+
+private:
+    FakeValueReplayReader(const uint8_t* data, size_t size, size_t numEvents, size_t indexOffset);
+
+    bool readEvent(size_t offset, VehiclePropValue* event) const;
+
+    /**
+     * Drops the pages from |*begin| up to |end| once they add up to enough memory, and moves
+     * |*begin| past them.
+     */
+    void releasePages(size_t* begin, size_t end);
+
+    const uint8_t* mData;
+    const size_t mSize;
+    const size_t mNumEvents;
+    const size_t mIndexOffset;
+    size_t mNextEvent;
+    // Start of the pages which may be resident, in the events and in the index.
+    size_t mEventsPagesBegin;
+    size_t mIndexPagesBegin;
+};
+
+/**
+ * Writes all the events of |reader| to |path| as a replay file. Returns the number of events
+ * written, or -1 on error.
+ */
+ssize_t writeReplayFile(FakeValueReader* reader, const std::string& path);
+
+}  // namespace impl
+
+}  // namespace V2_0
+}  // namespace vehicle
+}  // namespace automotive
+}  // namespace hardware
+}  // namespace android
+
+#endif  // android_hardware_automotive_vehicle_V2_0_impl_FakeValueReplayFile_H_
@@ -18,11 +18,9 @@
 #define android_hardware_automotive_vehicle_V2_0_impl_JsonFakeValueGenerator_H_
 
 #include <chrono>
-#include <iostream>
-
-#include <json/json.h>
 
 #include "FakeValueGenerator.h"
+#include "FakeValueReader.h"
 
 namespace android {
 namespace hardware {
@@ -32,13 +30,12 @@ namespace V2_0 {
 
 namespace impl {
 
+/**
+ * Replays the events of a fake value file, either JSON or binary replay file. Events are read from
+ * the file as they are generated, so that replay starts right away and memory use does not depend
+ * on the size of the file.
+ */
 class JsonFakeValueGenerator : public FakeValueGenerator {
-private:
-    struct GeneratorCfg {
-        size_t index;
-        std::vector<VehiclePropValue> events;
-    };
-
 public:
     JsonFakeValueGenerator(const VehiclePropValue& request);
     ~JsonFakeValueGenerator() = default;
@@ -48,18 +45,18 @@ public:
     bool hasNext();
 
 private:
-    std::vector<VehiclePropValue> parseFakeValueJson(std::istream& is);
-    void copyMixedValueJson(VehiclePropValue::RawValue& dest, const Json::Value& jsonValue);
-
-    template <typename T>
-    void copyJsonArray(hidl_vec<T>& dest, const Json::Value& jsonArray);
-
-    bool isDiagnosticProperty(int32_t prop);
-    hidl_vec<uint8_t> generateDiagnosticBytes(const VehiclePropValue::RawValue& diagnosticValue);
-    void setBit(hidl_vec<uint8_t>& bytes, size_t idx);
+    /**
+     * Reads the event following mNextEvent, starting a new iteration at the end of the file.
+     */
+    void readNextEvent();
 
 private:
-    GeneratorCfg mGenCfg;
+    FakeValueReaderPtr mReader;
+    VehiclePropValue mNextEvent;
+    bool mHasNextEvent;
+    // Whether mNextEvent is the first event of an iteration.
+    bool mIsFirstEvent;
+    int64_t mLastEventTimestamp;
     int32_t mNumOfIterations;
 };
 
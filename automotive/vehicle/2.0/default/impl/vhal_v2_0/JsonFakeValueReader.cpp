@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "JsonFakeValueReader"
+
+#include <ctype.h>
+#include <type_traits>
+
+#include <log/log.h>
+#include <vhal_v2_0/VehicleUtils.h>
+
+#include "JsonFakeValueReader.h"
+
+namespace android {
+namespace hardware {
+namespace automotive {
+namespace vehicle {
+namespace V2_0 {
+
+namespace impl {
+
+JsonFakeValueReader::JsonFakeValueReader(std::unique_ptr<std::istream> is)
+    : mStream(std::move(is)), mInArray(false) {}
+
+bool JsonFakeValueReader::next(VehiclePropValue* event) {
+    Json::Reader reader;
+    Json::Value rawEvent;
+    while (readElement(&mElement)) {
+        if (!reader.parse(mElement, rawEvent)) {
+            ALOGE("%s: Failed to parse VHAL JSON event. Error: %s", __func__,
+                  reader.getFormattedErrorMessages().c_str());
+            continue;
+        }
+        if (parseEvent(rawEvent, event)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool JsonFakeValueReader::rewind() {
+    mStream->clear();
+    mStream->seekg(0);
+    mInArray = false;
+    return mStream->good();
+}
+
+bool JsonFakeValueReader::readElement(std::string* text) {
+    text->clear();
+    int c;
+    // Skip to the start of the next element.
+    while ((c = mStream->get()) != EOF) {
+        if (isspace(c) || (mInArray && c == ',')) {
+            continue;
+        }
+        if (!mInArray) {
+            if (c != '[') {
+                ALOGE("%s: Fake data JSON file should be an array of events", __func__);
+                return false;
+            }
+            mInArray = true;
+            continue;
+        }
+        break;
+    }
+    if (c == EOF || c == ']') {
+        return false;
+    }
+
+    int depth = 0;
+    bool inString = false;
+    bool escaped = false;
+    for (; c != EOF; c = mStream->get()) {
+        if (!inString && depth == 0 && (c == ',' || c == ']')) {
+            // End of an element which is not an object, leave the separator for the next call.
+            mStream->unget();
+            return true;
+        }
+        text->push_back(c);
+        if (inString) {
+            if (escaped) {
+                escaped = false;
+            } else if (c == '\\') {
+                escaped = true;
+            } else if (c == '"') {
+                inString = false;
+            }
+        } else if (c == '"') {
+            inString = true;
+        } else if (c == '{' || c == '[') {
+            depth++;
+        } else if ((c == '}' || c == ']') && --depth == 0) {
+            return true;
+        }
+    }
+    ALOGE("%s: Unexpected end of fake data JSON file", __func__);
+    return false;
+}
+
+bool JsonFakeValueReader::parseEvent(const Json::Value& rawEvent, VehiclePropValue* event) {
+    if (!rawEvent.isObject()) {
+        ALOGE("%s: VHAL JSON event should be an object, %s", __func__,
+              rawEvent.toStyledString().c_str());
+        return false;
+    }
+    if (rawEvent["prop"].empty() || rawEvent["areaId"].empty() || rawEvent["value"].empty() ||
+        rawEvent["timestamp"].empty()) {
+        ALOGE("%s: VHAL JSON event has missing fields, skip it, %s", __func__,
+              rawEvent.toStyledString().c_str());
+        return false;
+    }
+    *event = {
+            .timestamp = rawEvent["timestamp"].asInt64(),
+            .areaId = rawEvent["areaId"].asInt(),
+            .prop = rawEvent["prop"].asInt(),
+    };
+
+    const Json::Value& rawEventValue = rawEvent["value"];
+    auto& value = event->value;
+    switch (getPropType(event->prop)) {
+        case VehiclePropertyType::BOOLEAN:
+        case VehiclePropertyType::INT32:
+            value.int32Values.resize(1);
+            value.int32Values[0] = rawEventValue.asInt();
+            break;
+        case VehiclePropertyType::INT64:
+            value.int64Values.resize(1);
+            value.int64Values[0] = rawEventValue.asInt64();
+            break;
+        case VehiclePropertyType::FLOAT:
+            value.floatValues.resize(1);
+            value.floatValues[0] = rawEventValue.asFloat();
+            break;
+        case VehiclePropertyType::STRING:
+            value.stringValue = rawEventValue.asString();
+            break;
+        case VehiclePropertyType::MIXED:
+            copyMixedValueJson(value, rawEventValue);
+            if (isDiagnosticProperty(event->prop)) {
+                value.bytes = generateDiagnosticBytes(value);
+            }
+            break;
+        default:
+            ALOGE("%s: unsupported type for property: 0x%x", __func__, event->prop);
+            return false;
+    }
+    return true;
+}
+
+void JsonFakeValueReader::copyMixedValueJson(VehiclePropValue::RawValue& dest,
+                                                const Json::Value& jsonValue) {
+    copyJsonArray(dest.int32Values, jsonValue["int32Values"]);
+    copyJsonArray(dest.int64Values, jsonValue["int64Values"]);
+    copyJsonArray(dest.floatValues, jsonValue["floatValues"]);
+    dest.stringValue = jsonValue["stringValue"].asString();
+}
+
+template <typename T>
+void JsonFakeValueReader::copyJsonArray(hidl_vec<T>& dest, const Json::Value& jsonArray) {
+    dest.resize(jsonArray.size());
+    for (Json::Value::ArrayIndex i = 0; i < jsonArray.size(); i++) {
+        if (std::is_same<T, int32_t>::value) {
+            dest[i] = jsonArray[i].asInt();
+        } else if (std::is_same<T, int64_t>::value) {
+            dest[i] = jsonArray[i].asInt64();
+        } else if (std::is_same<T, float>::value) {
+            dest[i] = jsonArray[i].asFloat();
+        }
+    }
+}
+
+bool JsonFakeValueReader::isDiagnosticProperty(int32_t prop) {
+    return prop == (int32_t)VehicleProperty::OBD2_LIVE_FRAME ||
+           prop == (int32_t)VehicleProperty::OBD2_FREEZE_FRAME;
+}
+
+hidl_vec<uint8_t> JsonFakeValueReader::generateDiagnosticBytes(
+    const VehiclePropValue::RawValue& diagnosticValue) {
+    size_t byteSize = ((size_t)DiagnosticIntegerSensorIndex::LAST_SYSTEM_INDEX +
+                       (size_t)DiagnosticFloatSensorIndex::LAST_SYSTEM_INDEX + 2);
+    hidl_vec<uint8_t> bytes(byteSize % 8 == 0 ? byteSize / 8 : byteSize / 8 + 1);
+
+    auto& int32Values = diagnosticValue.int32Values;
+    for (size_t i = 0; i < int32Values.size(); i++) {
+        if (int32Values[i] != 0) {
+            setBit(bytes, i);
+        }
+    }
+
+    auto& floatValues = diagnosticValue.floatValues;
+    for (size_t i = 0; i < floatValues.size(); i++) {
+        if (floatValues[i] != 0.0) {
+            setBit(bytes, i + (size_t)DiagnosticIntegerSensorIndex::LAST_SYSTEM_INDEX + 1);
+        }
+    }
+    return bytes;
+}
+
+void JsonFakeValueReader::setBit(hidl_vec<uint8_t>& bytes, size_t idx) {
+    uint8_t mask = 1 << (idx % 8);
+    bytes[idx / 8] |= mask;
+}
+
+}  // namespace impl
+
+}  // namespace V2_0
+}  // namespace vehicle
+}  // namespace automotive
+}  // namespace hardware
+}  // namespace android
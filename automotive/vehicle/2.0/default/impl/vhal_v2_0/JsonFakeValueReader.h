@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef android_hardware_automotive_vehicle_V2_0_impl_JsonFakeValueReader_H_
+#define android_hardware_automotive_vehicle_V2_0_impl_JsonFakeValueReader_H_
+
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include <json/json.h>
+
+#include "FakeValueReader.h"
+
+namespace android {
+namespace hardware {
+namespace automotive {
+namespace vehicle {
+namespace V2_0 {
+
+namespace impl {
+
+/**
+ * Reads events from a JSON array of VHAL events. The array is scanned incrementally, and each
+ * event is parsed only when it is read.
+ */
+class JsonFakeValueReader : public FakeValueReader {
+public:
+    JsonFakeValueReader(std::unique_ptr<std::istream> is);
+    ~JsonFakeValueReader() = default;
+
+    bool next(VehiclePropValue* event) override;
+
+    bool rewind() override;
+
+private:
+    /**
+     * Reads the text of the next element of the top level array into |text|. Returns false at the
+     * end of the array.
+     */
+    bool readElement(std::string* text);
+
+    bool parseEvent(const Json::Value& rawEvent, VehiclePropValue* event);
+    void copyMixedValueJson(VehiclePropValue::RawValue& dest, const Json::Value& jsonValue);
+
+    template <typename T>
+    void copyJsonArray(hidl_vec<T>& dest, const Json::Value& jsonArray);
+
+    bool isDiagnosticProperty(int32_t prop);
+    hidl_vec<uint8_t> generateDiagnosticBytes(const VehiclePropValue::RawValue& diagnosticValue);
+    void setBit(hidl_vec<uint8_t>& bytes, size_t idx);
+
+private:
+    std::unique_ptr<std::istream> mStream;
+    bool mInArray;
+    std::string mElement;
+};
+
+}  // namespace impl
+
+}  // namespace V2_0
+}  // namespace vehicle
+}  // namespace automotive
+}  // namespace hardware
+}  // namespace android
+
+#endif  // android_hardware_automotive_vehicle_V2_0_impl_JsonFakeValueReader_H_
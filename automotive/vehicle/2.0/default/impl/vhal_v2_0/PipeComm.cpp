@@ -57,24 +57,26 @@ void PipeComm::stop() {
     CommConn::stop();
 }
 
-std::vector<uint8_t> PipeComm::read() {
+bool PipeComm::read(std::vector<uint8_t>* msg) {
     static constexpr int MAX_RX_MSG_SZ = 2048;
-    std::vector<uint8_t> msg = std::vector<uint8_t>(MAX_RX_MSG_SZ);
+    // Shrinking the vector keeps its capacity, this only allocates for the first message.
+    msg->resize(MAX_RX_MSG_SZ);
     int numBytes;
 
-    numBytes = qemu_pipe_frame_recv(mPipeFd, msg.data(), msg.size());
+    numBytes = qemu_pipe_frame_recv(mPipeFd, msg->data(), msg->size());
 
     if (numBytes == MAX_RX_MSG_SZ) {
         ALOGE("%s: Received max size = %d", __FUNCTION__, MAX_RX_MSG_SZ);
     } else if (numBytes > 0) {
-        msg.resize(numBytes);
-        return msg;
+        msg->resize(numBytes);
+        return true;
     } else {
         ALOGD("%s: Connection terminated on pipe %d, numBytes=%d", __FUNCTION__, mPipeFd, numBytes);
         mPipeFd = -1;
     }
 
-    return std::vector<uint8_t>();
+    msg->clear();
+    return false;
 }
 
 int PipeComm::write(const std::vector<uint8_t>& data) {
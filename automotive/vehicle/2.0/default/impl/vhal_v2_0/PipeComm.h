@@ -43,7 +43,7 @@ class PipeComm : public CommConn {
     void start() override;
     void stop() override;
 
-    std::vector<uint8_t> read() override;
+    bool read(std::vector<uint8_t>* msg) override;
     int write(const std::vector<uint8_t>& data) override;
 
     inline bool isOpen() override { return mPipeFd > 0; }
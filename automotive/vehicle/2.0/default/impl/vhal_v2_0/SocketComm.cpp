@@ -21,7 +21,10 @@
 #include <arpa/inet.h>
 #include <log/log.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
 
 #include "SocketComm.h"
 
@@ -106,6 +109,10 @@ SocketConn* SocketComm::accept() {
         inet_ntop(AF_INET, &cliAddr.sin_addr, addr, INET_ADDRSTRLEN);
 
         ALOGD("%s: Incoming connection received from %s:%d", __FUNCTION__, addr, cliAddr.sin_port);
+        // Messages are already coalesced and sent with a single write, so do not let Nagle's
+        // algorithm hold them back waiting for the client to acknowledge the previous one.
+        int noDelay = 1;
+        setsockopt(sfd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
         return new SocketConn(mMessageProcessor, sfd);
     }
 
@@ -140,47 +147,41 @@ SocketConn::SocketConn(MessageProcessor* messageProcessor, int sfd)
     : CommConn(messageProcessor), mSockFd(sfd) {}
 
 /**
- * Reads, in a loop, exactly numBytes from the given fd. If the connection is closed, returns
- * an empty buffer, otherwise will return exactly the given number of bytes.
+ * Reads, in a loop, exactly numBytes from the given fd into buffer. Returns false if the connection
+ * is closed or fails before all the bytes are read.
  */
-std::vector<uint8_t> readExactly(int fd, int numBytes) {
-    std::vector<uint8_t> buffer(numBytes);
-    int totalRead = 0;
-    int offset = 0;
-    while (totalRead < numBytes) {
-        int numRead = ::read(fd, &buffer.data()[offset], numBytes - offset);
-        if (numRead == 0) {
-            buffer.resize(0);
-            return buffer;
+static bool readExactly(int fd, void* buffer, size_t numBytes) {
+    uint8_t* data = static_cast<uint8_t*>(buffer);
+    size_t offset = 0;
+    while (offset < numBytes) {
+        ssize_t numRead = TEMP_FAILURE_RETRY(::read(fd, data + offset, numBytes - offset));
+        if (numRead <= 0) {
+            return false;
         }
-
-        totalRead += numRead;
+        offset += numRead;
     }
-    return buffer;
+    return true;
 }
 
-/**
- * Reads an int, guaranteed to be non-zero, from the given fd. If the connection is closed, returns
- * -1.
- */
-int32_t readInt(int fd) {
-    std::vector<uint8_t> buffer = readExactly(fd, sizeof(int32_t));
-    if (buffer.size() == 0) {
-        return -1;
+bool SocketConn::read(std::vector<uint8_t>* msg) {
+    uint32_t msgLen;
+    int32_t msgSize = -1;
+    if (readExactly(mSockFd, &msgLen, sizeof(msgLen))) {
+        msgSize = static_cast<int32_t>(ntohl(msgLen));
     }
-
-    int32_t value = *reinterpret_cast<int32_t*>(buffer.data());
-    return ntohl(value);
-}
-
-std::vector<uint8_t> SocketConn::read() {
-    int32_t msgSize = readInt(mSockFd);
     if (msgSize <= 0) {
         ALOGD("%s: Connection terminated on socket %d", __FUNCTION__, mSockFd);
-        return std::vector<uint8_t>();
+        msg->clear();
+        return false;
     }
 
-    return readExactly(mSockFd, msgSize);
+    // Shrinking the vector keeps its capacity, this only allocates for larger messages.
+    msg->resize(msgSize);
+    if (!readExactly(mSockFd, msg->data(), msgSize)) {
+        msg->clear();
+        return false;
+    }
+    return true;
 }
 
 void SocketConn::stop() {
@@ -192,25 +193,39 @@ void SocketConn::stop() {
 
 int SocketConn::write(const std::vector<uint8_t>& data) {
     static constexpr int MSG_HEADER_LEN = 4;
-    int retVal = 0;
-    union {
-        uint32_t msgLen;
-        uint8_t msgLenBytes[MSG_HEADER_LEN];
-    };
+    if (mSockFd <= 0) {
+        return 0;
+    }
 
     // Prepare header for the message
-    msgLen = static_cast<uint32_t>(data.size());
-    msgLen = htonl(msgLen);
-
-    if (mSockFd > 0) {
-        retVal = ::write(mSockFd, msgLenBytes, MSG_HEADER_LEN);
-
-        if (retVal == MSG_HEADER_LEN) {
-            retVal = ::write(mSockFd, data.data(), data.size());
+    uint32_t msgLen = htonl(static_cast<uint32_t>(data.size()));
+    struct iovec iov[] = {
+            {.iov_base = &msgLen, .iov_len = MSG_HEADER_LEN},
+            {.iov_base = const_cast<uint8_t*>(data.data()), .iov_len = data.size()},
+    };
+    struct msghdr msg = {};
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+    while (msg.msg_iovlen > 0) {
+        // Same as writev(), without raising SIGPIPE if the client went away.
+        ssize_t numWritten = TEMP_FAILURE_RETRY(::sendmsg(mSockFd, &msg, MSG_NOSIGNAL));
+        if (numWritten < 0) {
+            ALOGE("%s: sendmsg failed on socket %d, errno=%d", __FUNCTION__, mSockFd, errno);
+            return -1;
+        }
+        // Skip what was written, in case of a partial write.
+        while (msg.msg_iovlen > 0 && static_cast<size_t>(numWritten) >= msg.msg_iov->iov_len) {
+            numWritten -= msg.msg_iov->iov_len;
+            msg.msg_iov++;
+            msg.msg_iovlen--;
+        }
+        if (msg.msg_iovlen > 0) {
+            msg.msg_iov->iov_base = static_cast<uint8_t*>(msg.msg_iov->iov_base) + numWritten;
+            msg.msg_iov->iov_len -= numWritten;
         }
     }
 
-    return retVal;
+    return data.size();
 }
 
 }  // impl
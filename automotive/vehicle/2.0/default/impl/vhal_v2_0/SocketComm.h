@@ -86,12 +86,13 @@ class SocketConn : public CommConn {
     virtual ~SocketConn() = default;
 
     /**
-     * Blocking call to read data from the connection.
+     * Blocking call to read data from the connection. The capacity of msg is reused.
      *
-     * @return std::vector<uint8_t> Serialized protobuf data received from emulator.  This will be
-     *              an empty vector if the connection was closed or some other error occurred.
+     * @param msg Set to the serialized protobuf data received from emulator.
+     *
+     * @return bool False if the connection was closed or some other error occurred.
      */
-    std::vector<uint8_t> read() override;
+    bool read(std::vector<uint8_t>* msg) override;
 
     /**
      * Closes a connection if it is open.
@@ -99,7 +100,8 @@ class SocketConn : public CommConn {
     void stop() override;
 
     /**
-     * Transmits a string of data to the emulator.
+     * Transmits a string of data to the emulator. The length header and the data are sent with a
+     * single gathered write.
      *
      * @param data Serialized protobuf data to transmit.
      *
@@ -20,6 +20,7 @@
 #include <log/log.h>
 #include <utils/SystemClock.h>
 #include <algorithm>
+#include <utility>
 
 #include <vhal_v2_0/VehicleUtils.h>
 
@@ -36,6 +37,8 @@ namespace V2_0 {
 
 namespace impl {
 
+constexpr std::chrono::milliseconds VehicleEmulator::kBatchWindow;
+
 VehicleEmulator::VehicleEmulator(EmulatedVehicleHalIface* hal) : mHal{hal} {
     mHal->registerEmulator(this);
 
@@ -48,9 +51,19 @@ VehicleEmulator::VehicleEmulator(EmulatedVehicleHalIface* hal) : mHal{hal} {
         mPipeComm = std::make_unique<PipeComm>(this);
         mPipeComm->start();
     }
+
+    mBatchFlushThread = std::thread(&VehicleEmulator::batchFlushThread, this);
 }
 
 VehicleEmulator::~VehicleEmulator() {
+    {
+        std::lock_guard<std::mutex> g(mBatchLock);
+        mExit = true;
+    }
+    mBatchCond.notify_one();
+    // Sends the pending updates before the connections are closed.
+    mBatchFlushThread.join();
+
     mSocketComm->stop();
     if (mPipeComm) {
         mPipeComm->stop();
@@ -62,15 +75,43 @@ VehicleEmulator::~VehicleEmulator() {
  * changed.
  */
 void VehicleEmulator::doSetValueFromClient(const VehiclePropValue& propValue) {
-    emulator::EmulatorMessage msg;
-    emulator::VehiclePropValue *val = msg.add_value();
-    populateProtoVehiclePropValue(val, &propValue);
-    msg.set_status(emulator::RESULT_OK);
-    msg.set_msg_type(emulator::SET_PROPERTY_ASYNC);
+    int batchSize;
+    {
+        std::lock_guard<std::mutex> g(mBatchLock);
+        if (mBatch.value_size() == 0) {
+            mBatch.set_status(emulator::RESULT_OK);
+            mBatch.set_msg_type(emulator::SET_PROPERTY_ASYNC);
+            mBatchDeadline = std::chrono::steady_clock::now() + kBatchWindow;
+        }
+        emulator::VehiclePropValue* val = mBatch.add_value();
+        populateProtoVehiclePropValue(val, &propValue);
+        batchSize = mBatch.value_size();
+    }
+    // The flush thread only waits for a batch to start, then for its deadline or for it to fill.
+    if (batchSize == 1 || batchSize == kMaxBatchSize) {
+        mBatchCond.notify_one();
+    }
+}
 
-    mSocketComm->sendMessage(msg);
-    if (mPipeComm) {
-        mPipeComm->sendMessage(msg);
+void VehicleEmulator::batchFlushThread() {
+    EmulatorMessage msg;
+    std::unique_lock<std::mutex> g(mBatchLock);
+    while (true) {
+        mBatchCond.wait(g, [this] { return mExit || mBatch.value_size() > 0; });
+        if (mBatch.value_size() == 0) {
+            return;
+        }
+        mBatchCond.wait_until(g, mBatchDeadline,
+                              [this] { return mExit || mBatch.value_size() >= kMaxBatchSize; });
+
+        msg.Clear();
+        std::swap(msg, mBatch);
+        g.unlock();
+        mSocketComm->sendMessage(msg);
+        if (mPipeComm) {
+            mPipeComm->sendMessage(msg);
+        }
+        g.lock();
     }
 }
 
@@ -151,7 +192,17 @@ void VehicleEmulator::doGetPropertyAll(VehicleEmulator::EmulatorMessage const& /
 
 void VehicleEmulator::doSetProperty(VehicleEmulator::EmulatorMessage const& rxMsg,
                                     VehicleEmulator::EmulatorMessage& respMsg) {
-    emulator::VehiclePropValue protoVal = rxMsg.value(0);
+    respMsg.set_msg_type(emulator::SET_PROPERTY_RESP);
+
+    // A batch of values succeeds only if every value is set.
+    bool halRes = rxMsg.value_size() > 0;
+    for (const emulator::VehiclePropValue& protoVal : rxMsg.value()) {
+        halRes &= doSetPropertyValue(protoVal);
+    }
+    respMsg.set_status(halRes ? emulator::RESULT_OK : emulator::ERROR_INVALID_PROPERTY);
+}
+
+bool VehicleEmulator::doSetPropertyValue(const emulator::VehiclePropValue& protoVal) {
     VehiclePropValue val = {
             .timestamp = elapsedRealtimeNano(),
             .areaId = protoVal.area_id(),
@@ -159,8 +210,6 @@ void VehicleEmulator::doSetProperty(VehicleEmulator::EmulatorMessage const& rxMs
             .status = (VehiclePropertyStatus)protoVal.status(),
     };
 
-    respMsg.set_msg_type(emulator::SET_PROPERTY_RESP);
-
     // Copy value data if it is set.  This automatically handles complex data types if needed.
     if (protoVal.has_string_value()) {
         val.value.stringValue = protoVal.string_value().c_str();
@@ -186,8 +235,7 @@ void VehicleEmulator::doSetProperty(VehicleEmulator::EmulatorMessage const& rxMs
                                                      protoVal.float_values().end() };
     }
 
-    bool halRes = mHal->setPropertyFromVehicle(val);
-    respMsg.set_status(halRes ? emulator::RESULT_OK : emulator::ERROR_INVALID_PROPERTY);
+    return mHal->setPropertyFromVehicle(val);
 }
 
 void VehicleEmulator::processMessage(emulator::EmulatorMessage const& rxMsg,
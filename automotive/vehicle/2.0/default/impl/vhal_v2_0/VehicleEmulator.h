@@ -18,7 +18,10 @@
 #define android_hardware_automotive_vehicle_V2_0_impl_VehicleHalEmulator_H_
 
 #include <log/log.h>
+#include <chrono>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
 #include <thread>
 #include <vector>
 
@@ -71,6 +74,10 @@ class VehicleEmulator : public MessageProcessor {
     VehicleEmulator(EmulatedVehicleHalIface* hal);
     virtual ~VehicleEmulator();
 
+    /**
+     * Sends propValue to the clients. Updates made within kBatchWindow of each other are sent
+     * together in one SET_PROPERTY_ASYNC message.
+     */
     void doSetValueFromClient(const VehiclePropValue& propValue);
     void processMessage(emulator::EmulatorMessage const& rxMsg,
                         emulator::EmulatorMessage& respMsg) override;
@@ -79,11 +86,18 @@ class VehicleEmulator : public MessageProcessor {
     friend class ConnectionThread;
     using EmulatorMessage = emulator::EmulatorMessage;
 
+    static constexpr std::chrono::milliseconds kBatchWindow{2};
+    // Pending updates are sent before the end of kBatchWindow once there are this many.
+    static constexpr int kMaxBatchSize = 32;
+
+    void batchFlushThread();
+
     void doGetConfig(EmulatorMessage const& rxMsg, EmulatorMessage& respMsg);
     void doGetConfigAll(EmulatorMessage const& rxMsg, EmulatorMessage& respMsg);
     void doGetProperty(EmulatorMessage const& rxMsg, EmulatorMessage& respMsg);
     void doGetPropertyAll(EmulatorMessage const& rxMsg, EmulatorMessage& respMsg);
     void doSetProperty(EmulatorMessage const& rxMsg, EmulatorMessage& respMsg);
+    bool doSetPropertyValue(const emulator::VehiclePropValue& protoVal);
     void populateProtoVehicleConfig(emulator::VehiclePropConfig* protoCfg,
                                     const VehiclePropConfig& cfg);
     void populateProtoVehiclePropValue(emulator::VehiclePropValue* protoVal,
@@ -93,6 +107,14 @@ private:
     EmulatedVehicleHalIface* mHal;
     std::unique_ptr<SocketComm> mSocketComm;
     std::unique_ptr<PipeComm> mPipeComm;
+
+    std::mutex mBatchLock;
+    std::condition_variable mBatchCond;
+    // Updates not sent yet, and when they must be sent. Guarded by mBatchLock.
+    EmulatorMessage mBatch;
+    std::chrono::steady_clock::time_point mBatchDeadline;
+    bool mExit = false;
+    std::thread mBatchFlushThread;
 };
 
 }  // impl
@@ -0,0 +1,178 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "vhal_v2_0/ConcurrentQueue.h"
+
+namespace android {
+
+namespace {
+
+using std::chrono::milliseconds;
+using std::chrono::microseconds;
+using std::chrono::steady_clock;
+
+class DeadlineBatchingConsumerTest : public ::testing::Test {
+protected:
+    void TearDown() override {
+        consumer.requestStop();
+        queue.deactivate();
+        consumer.waitStopped();
+    }
+
+    void start(size_t maxBatchSize, milliseconds maxDelay, microseconds idleGap) {
+        consumer.run(&queue,
+                     { .maxBatchSize = maxBatchSize, .maxDelay = maxDelay, .idleGap = idleGap },
+                     nullptr,
+                     [this](const std::vector<int>& items) {
+                         std::lock_guard<std::mutex> g(mLock);
+                         batches.push_back(items);
+                         lastDelivery = steady_clock::now();
+                         mCond.notify_all();
+                     });
+    }
+
+    bool waitForItems(size_t count) {
+        std::unique_lock<std::mutex> g(mLock);
+        return mCond.wait_for(g, milliseconds(1000), [this, count] {
+            size_t total = 0;
+            for (const auto& b : batches) total += b.size();
+            return total >= count;
+        });
+    }
+
+public:
+    MpscRingQueue<int> queue { 16 };
+    DeadlineBatchingConsumer<int> consumer;
+    std::vector<std::vector<int>> batches;
+    steady_clock::time_point lastDelivery;
+
+private:
+    std::mutex mLock;
+    std::condition_variable mCond;
+};
+
+TEST(MpscRingQueueTest, pushPopInOrder) {
+    MpscRingQueue<int> queue(4);
+    for (int i = 0; i < 4; i++) {
+        ASSERT_TRUE(queue.push(int(i)));
+    }
+    int item;
+    for (int i = 0; i < 4; i++) {
+        ASSERT_TRUE(queue.pop(&item));
+        ASSERT_EQ(i, item);
+    }
+    ASSERT_FALSE(queue.pop(&item));
+
+    queue.deactivate();
+    ASSERT_FALSE(queue.push(42));
+}
+
+TEST(MpscRingQueueTest, pushBlocksWhileFull) {
+    MpscRingQueue<int> queue(2);
+    ASSERT_TRUE(queue.push(0));
+    ASSERT_TRUE(queue.push(1));
+
+    std::atomic<bool> pushed { false };
+    std::thread producer([&queue, &pushed] {
+        pushed = queue.push(2);
+    });
+    std::this_thread::sleep_for(milliseconds(50));
+    ASSERT_FALSE(pushed);
+
+    int item;
+    ASSERT_TRUE(queue.pop(&item));
+    producer.join();
+    ASSERT_TRUE(pushed);
+    ASSERT_TRUE(queue.pop(&item));
+    ASSERT_EQ(1, item);
+    ASSERT_TRUE(queue.pop(&item));
+    ASSERT_EQ(2, item);
+}
+
+TEST(MpscRingQueueTest, deactivateUnblocksProducers) {
+    MpscRingQueue<int> queue(2);
+    ASSERT_TRUE(queue.push(0));
+    ASSERT_TRUE(queue.push(1));
+
+    std::atomic<bool> pushed { true };
+    std::thread producer([&queue, &pushed] {
+        pushed = queue.push(2);
+    });
+    std::this_thread::sleep_for(milliseconds(50));
+    queue.deactivate();
+    producer.join();
+    ASSERT_FALSE(pushed);
+}
+
+TEST(MpscRingQueueTest, multipleProducers) {
+    constexpr int kProducers = 4;
+    constexpr int kItemsPerProducer = 10000;
+    MpscRingQueue<int> queue(64);  // Much smaller than the number of items, producers must wait.
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducers; p++) {
+        producers.emplace_back([&queue, p] {
+            for (int i = 0; i < kItemsPerProducer; i++) {
+                queue.push(p * kItemsPerProducer + i);
+            }
+        });
+    }
+
+    std::vector<int> lastSeen(kProducers, -1);
+    int item;
+    for (int received = 0; received < kProducers * kItemsPerProducer;) {
+        if (!queue.pop(&item)) {
+            queue.waitForItems();
+            continue;
+        }
+        int producer = item / kItemsPerProducer;
+        ASSERT_LT(lastSeen[producer], item);  // Per-producer FIFO order.
+        lastSeen[producer] = item;
+        received++;
+    }
+
+    for (auto& t : producers) t.join();
+}
+
+TEST_F(DeadlineBatchingConsumerTest, singleEventIsNotDelayed) {
+    start(64, milliseconds(100), microseconds(200));
+
+    auto pushed = steady_clock::now();
+    queue.push(1);
+    ASSERT_TRUE(waitForItems(1));
+    // Much less than maxDelay, the event must be flushed once the queue is idle.
+    ASSERT_LT(lastDelivery - pushed, milliseconds(50));
+}
+
+TEST_F(DeadlineBatchingConsumerTest, batchSizeThreshold) {
+    start(4, milliseconds(1000), microseconds(100000));
+
+    for (int i = 0; i < 8; i++) {
+        queue.push(int(i));
+    }
+    ASSERT_TRUE(waitForItems(8));
+    for (const auto& b : batches) {
+        ASSERT_LE(b.size(), 4u);
+    }
+}
+
+}  // namespace anonymous
+
+}  // namespace android
@@ -0,0 +1,181 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <android-base/file.h>
+#include <gtest/gtest.h>
+
+#include "vhal_v2_0/DefaultConfig.h"
+#include "vhal_v2_0/FakeValueReplayFile.h"
+#include "vhal_v2_0/JsonFakeValueGenerator.h"
+#include "vhal_v2_0/JsonFakeValueReader.h"
+#include "vhal_v2_0/VehicleUtils.h"
+
+namespace android {
+namespace hardware {
+namespace automotive {
+namespace vehicle {
+namespace V2_0 {
+
+namespace impl {
+
+namespace {
+
+using android::base::TemporaryFile;
+using android::base::WriteStringToFile;
+
+constexpr int32_t kMixedProperty = 0x0101 | VehiclePropertyGroup::VENDOR | VehicleArea::GLOBAL |
+                                   VehiclePropertyType::MIXED;
+constexpr size_t kNumValidEvents = 4;
+
+std::string getFakeValueJson() {
+    return "[\n"
+           "  {\"timestamp\": 1000000, \"areaId\": 0, \"prop\": " +
+           std::to_string(toInt(VehicleProperty::GEAR_SELECTION)) +
+           ", \"value\": 8},\n"
+           "  42,\n"
+           "  {\"timestamp\": 3000000, \"areaId\": 0, \"prop\": " +
+           std::to_string(toInt(VehicleProperty::PERF_VEHICLE_SPEED)) +
+           ", \"value\": 1.5},\n"
+           "  {\"timestamp\": 4000000, \"areaId\": 0, \"prop\": " +
+           std::to_string(toInt(VehicleProperty::INFO_MAKE)) +
+           ", \"value\": \"a \\\"quoted\\\" ]} string\"},\n"
+           "  {\"timestamp\": 5000000, \"areaId\": 1},\n"
+           "  {\"timestamp\": 6000000, \"areaId\": 0, \"prop\": " +
+           std::to_string(kMixedProperty) +
+           ", \"value\": {\"int32Values\": [1, 2], \"int64Values\": [3],"
+           " \"floatValues\": [4.5], \"stringValue\": \"x\"}}\n"
+           "]\n";
+}
+
+std::unique_ptr<JsonFakeValueReader> openJson(const std::string& path) {
+    return std::make_unique<JsonFakeValueReader>(std::make_unique<std::ifstream>(path));
+}
+
+std::vector<VehiclePropValue> readAll(FakeValueReader* reader) {
+    std::vector<VehiclePropValue> events;
+    VehiclePropValue event;
+    while (reader->next(&event)) {
+        events.push_back(event);
+    }
+    return events;
+}
+
+class FakeValueReplayTest : public ::testing::Test {
+protected:
+    void SetUp() override { ASSERT_TRUE(WriteStringToFile(getFakeValueJson(), mJsonFile.path)); }
+
+    void convert() {
+        auto reader = openJson(mJsonFile.path);
+        ASSERT_EQ(static_cast<ssize_t>(kNumValidEvents),
+                  writeReplayFile(reader.get(), mReplayFile.path));
+    }
+
+    TemporaryFile mJsonFile;
+    TemporaryFile mReplayFile;
+};
+
+}  // namespace
+
+TEST_F(FakeValueReplayTest, JsonReaderSkipsInvalidEvents) {
+    auto reader = openJson(mJsonFile.path);
+    const auto events = readAll(reader.get());
+    ASSERT_EQ(kNumValidEvents, events.size());
+
+    EXPECT_EQ(toInt(VehicleProperty::GEAR_SELECTION), events[0].prop);
+    EXPECT_EQ(1000000, events[0].timestamp);
+    ASSERT_EQ(1u, events[0].value.int32Values.size());
+    EXPECT_EQ(8, events[0].value.int32Values[0]);
+
+    EXPECT_EQ(toInt(VehicleProperty::PERF_VEHICLE_SPEED), events[1].prop);
+    ASSERT_EQ(1u, events[1].value.floatValues.size());
+    EXPECT_EQ(1.5f, events[1].value.floatValues[0]);
+
+    EXPECT_EQ(toInt(VehicleProperty::INFO_MAKE), events[2].prop);
+    EXPECT_EQ("a \"quoted\" ]} string", std::string(events[2].value.stringValue));
+
+    EXPECT_EQ(kMixedProperty, events[3].prop);
+    EXPECT_EQ(2u, events[3].value.int32Values.size());
+    EXPECT_EQ(1u, events[3].value.int64Values.size());
+    EXPECT_EQ(1u, events[3].value.floatValues.size());
+    EXPECT_EQ("x", std::string(events[3].value.stringValue));
+
+    ASSERT_TRUE(reader->rewind());
+    EXPECT_EQ(events, readAll(reader.get()));
+}
+
+TEST_F(FakeValueReplayTest, ReplayFileMatchesJson) {
+    convert();
+    auto replay = FakeValueReplayReader::open(mReplayFile.path);
+    ASSERT_NE(nullptr, replay);
+    ASSERT_EQ(kNumValidEvents, replay->size());
+
+    const auto events = readAll(openJson(mJsonFile.path).get());
+    EXPECT_EQ(events, readAll(replay.get()));
+
+    ASSERT_TRUE(replay->seek(3));
+    VehiclePropValue event;
+    ASSERT_TRUE(replay->next(&event));
+    EXPECT_EQ(events[3], event);
+    EXPECT_FALSE(replay->next(&event));
+    EXPECT_FALSE(replay->seek(kNumValidEvents + 1));
+}
+
+TEST_F(FakeValueReplayTest, ReplayReaderRejectsOtherFiles) {
+    EXPECT_FALSE(FakeValueReplayReader::isReplayFile(mJsonFile.path));
+    EXPECT_EQ(nullptr, FakeValueReplayReader::open(mJsonFile.path));
+}
+
+TEST_F(FakeValueReplayTest, GeneratorReplaysFileForEachIteration) {
+    convert();
+    for (const char* path : {mJsonFile.path, mReplayFile.path}) {
+        VehiclePropValue request = {.prop = kGenerateFakeDataControllingProperty};
+        request.value.int32Values = {toInt(FakeDataCommand::StartJson), 2};
+        request.value.stringValue = path;
+        JsonFakeValueGenerator generator(request);
+
+        std::vector<VehiclePropValue> events;
+        while (generator.hasNext()) {
+            events.push_back(generator.nextEvent());
+        }
+        ASSERT_EQ(2 * kNumValidEvents, events.size()) << path;
+        for (size_t i = 0; i < events.size(); i++) {
+            EXPECT_EQ(events[i % kNumValidEvents].prop, events[i].prop);
+        }
+        // Events are delayed by the time between them in the file.
+        EXPECT_GE(events[1].timestamp - events[0].timestamp, 2000000);
+    }
+}
+
+TEST_F(FakeValueReplayTest, GeneratorWithMissingFileHasNoEvents) {
+    VehiclePropValue request = {.prop = kGenerateFakeDataControllingProperty};
+    request.value.int32Values = {toInt(FakeDataCommand::StartJson)};
+    request.value.stringValue = std::string(mJsonFile.path) + ".missing";
+    JsonFakeValueGenerator generator(request);
+    EXPECT_FALSE(generator.hasNext());
+}
+
+}  // namespace impl
+
+}  // namespace V2_0
+}  // namespace vehicle
+}  // namespace automotive
+}  // namespace hardware
+}  // namespace android
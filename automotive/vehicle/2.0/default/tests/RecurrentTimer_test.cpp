@@ -70,4 +70,51 @@ TEST(RecurrentTimerTest, multipleIntervals) {
     ASSERT_EQ_WITH_TOLERANCE(20, counter5ms.load(), 5);
 }
 
+TEST(RecurrentEventQueueTest, alignedIntervals) {
+    using TimePoint = RecurrentEventQueue::TimePoint;
+    RecurrentEventQueue queue;
+    TimePoint start(milliseconds(1200));
+    queue.add(milliseconds(1), 1, start);
+    queue.add(milliseconds(2), 2, start);
+    queue.add(milliseconds(3), 3, start);
+    queue.add(milliseconds(5), 4, start);
+    queue.remove(4);
+    ASSERT_EQ(3u, queue.size());
+
+    std::vector<int32_t> cookies;
+    int counters[4] = {};
+    TimePoint next = start;
+    for (int tick = 0; tick < 12; tick++) {
+        cookies.clear();
+        next = queue.takeDueEvents(next, &cookies);
+        for (int32_t cookie : cookies) {
+            counters[cookie]++;
+        }
+    }
+    // Every tick is 1ms, events are aligned so all of them fire at the start time.
+    ASSERT_EQ(12, counters[1]);
+    ASSERT_EQ(6, counters[2]);
+    ASSERT_EQ(4, counters[3]);
+    ASSERT_EQ(0, counters[0]);
+}
+
+TEST(RecurrentEventQueueTest, reportsLateEventOnce) {
+    using TimePoint = RecurrentEventQueue::TimePoint;
+    RecurrentEventQueue queue;
+    queue.add(milliseconds(1), 0xdead, TimePoint(milliseconds(0)));
+
+    std::vector<int32_t> cookies;
+    // Wake up very late, event must be reported only once.
+    queue.takeDueEvents(TimePoint(milliseconds(10) + nanoseconds(500)), &cookies);
+    ASSERT_EQ(1u, cookies.size());
+
+    // Re-registering the cookie replaces the previous interval.
+    queue.add(milliseconds(4), 0xdead, TimePoint(milliseconds(12)));
+    ASSERT_EQ(1u, queue.size());
+    cookies.clear();
+    auto next = queue.takeDueEvents(TimePoint(milliseconds(13)), &cookies);
+    ASSERT_EQ(1u, cookies.size());
+    ASSERT_EQ(TimePoint(milliseconds(16)), next);
+}
+
 }  // anonymous namespace
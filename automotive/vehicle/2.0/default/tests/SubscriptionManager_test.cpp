@@ -188,6 +188,47 @@ TEST_F(SubscriptionManagerTest, unsubscribe) {
     assertLastUnsubscribedProperty(PROP1);
 }
 
+TEST_F(SubscriptionManagerTest, distributeValuesToClients) {
+    std::list<SubscribeOptions> updatedOptions;
+    ASSERT_EQ(StatusCode::OK,
+              manager.addOrUpdateSubscription(1, cb1, subscrToProp1, &updatedOptions));
+    ASSERT_EQ(StatusCode::OK,
+              manager.addOrUpdateSubscription(2, cb2, subscrToProp1and2, &updatedOptions));
+
+    VehiclePropValuePool pool;
+    std::vector<recyclable_ptr<VehiclePropValue>> values;
+    for (int32_t prop : { PROP1, PROP2, PROP1, toInt(VehicleProperty::INFO_MAKE) }) {
+        values.push_back(pool.obtainInt32(static_cast<int32_t>(values.size())));
+        values.back()->prop = prop;
+    }
+
+    std::vector<HalClientHidlValues> clientValues;
+    manager.distributeValuesToClients(values, SubscribeFlags::EVENTS_FROM_CAR, &clientValues);
+    ASSERT_EQ(2u, clientValues.size());
+    for (const auto& cv : clientValues) {
+        if (cv.client->getCallback() == cb1) {
+            ASSERT_EQ(2u, cv.values.size());
+            ASSERT_EQ(0, cv.values[0].value.int32Values[0]);
+            ASSERT_EQ(2, cv.values[1].value.int32Values[0]);
+        } else {
+            ASSERT_EQ(cb2, cv.client->getCallback());
+            ASSERT_EQ(3u, cv.values.size());
+            ASSERT_EQ(PROP2, cv.values[1].prop);
+        }
+    }
+
+    manager.distributeValuesToClients(values, SubscribeFlags::EVENTS_FROM_ANDROID, &clientValues);
+    ASSERT_TRUE(clientValues.empty());
+
+    // Index must follow unsubscriptions.
+    manager.unsubscribe(2, PROP1);
+    manager.distributeValuesToClients(values, SubscribeFlags::EVENTS_FROM_CAR, &clientValues);
+    ASSERT_EQ(2u, clientValues.size());
+    for (const auto& cv : clientValues) {
+        ASSERT_EQ(cv.client->getCallback() == cb1 ? 2u : 1u, cv.values.size());
+    }
+}
+
 }  // namespace anonymous
 
 }  // namespace V2_0
@@ -21,6 +21,7 @@
 #include <utils/SystemClock.h>
 
 #include "vhal_v2_0/VehicleObjectPool.h"
+#include "vhal_v2_0/VehicleUtils.h"
 
 namespace android {
 namespace hardware {
@@ -49,6 +50,9 @@ private:
         stats->Obtained = 0;
         stats->Created = 0;
         stats->Recycled = 0;
+        stats->Hits = 0;
+        stats->Misses = 0;
+        stats->Disposed = 0;
     }
 
 public:
@@ -74,11 +78,69 @@ TEST_F(VehicleObjectPoolTest, valuePoolStrings) {
     void* raw = vs.get();
     vs.reset();  // delete the pointer
 
+    // Strings are recycled, but their content is not.
     auto vs2 = valuePool->obtain(VehiclePropertyType::STRING);
     ASSERT_EQ(0u, vs2->value.stringValue.size());
-    ASSERT_NE(raw, valuePool->obtain(VehiclePropertyType::STRING).get());
+    ASSERT_EQ(raw, vs2.get());
 
-    ASSERT_EQ(0u, stats->Obtained);
+    auto vs3 = valuePool->obtainString("Hello, world");
+    ASSERT_EQ(std::string("Hello, world"), vs3->value.stringValue.c_str());
+
+    ASSERT_EQ(4u, stats->Obtained);
+    ASSERT_EQ(2u, stats->Hits);
+}
+
+TEST_F(VehicleObjectPoolTest, valuePoolSizeClasses) {
+    // Both payloads fit into the smallest (16 bytes) size class.
+    void* raw = valuePool->obtain(VehiclePropertyType::INT32_VEC, 3).get();
+    auto v = valuePool->obtain(VehiclePropertyType::FLOAT_VEC, 4);
+    ASSERT_EQ(raw, v.get());
+    ASSERT_EQ(4u, v->value.floatValues.size());
+    ASSERT_EQ(0u, v->value.int32Values.size());
+    ASSERT_EQ(0.0f, v->value.floatValues[3]);
+
+    // Long vectors are recycled too.
+    raw = valuePool->obtain(VehiclePropertyType::BYTES, 1000).get();
+    auto bytes = valuePool->obtain(VehiclePropertyType::BYTES, 600);
+    ASSERT_EQ(raw, bytes.get());
+    ASSERT_EQ(600u, bytes->value.bytes.size());
+
+    // Values the user assigned new vectors to are still safe to recycle.
+    bytes->value.bytes = std::vector<uint8_t>(2000, 0xff);
+    bytes.reset();
+
+    ASSERT_EQ(2u, stats->Hits);
+    ASSERT_EQ(2u, stats->Misses);
+}
+
+TEST_F(VehicleObjectPoolTest, valuePoolAlternatingPools) {
+    // A thread switching between pools keeps the objects cached for each of them.
+    VehiclePropValuePool otherPool;
+    void* raw = valuePool->obtain(VehiclePropertyType::INT32).get();
+    void* otherRaw = otherPool.obtain(VehiclePropertyType::INT32).get();
+    for (int i = 0; i < 10; i++) {
+        ASSERT_EQ(raw, valuePool->obtain(VehiclePropertyType::INT32).get());
+        ASSERT_EQ(otherRaw, otherPool.obtain(VehiclePropertyType::INT32).get());
+    }
+
+    ASSERT_EQ(2u, stats->Created);
+    ASSERT_EQ(20u, stats->Hits);
+}
+
+TEST_F(VehicleObjectPoolTest, valuePoolCopy) {
+    VehiclePropValue src;
+    src.prop = toInt(VehicleProperty::INFO_MAKE);
+    src.value.stringValue = "Sample make";
+    auto dest = valuePool->obtain(src);
+    ASSERT_EQ(src.prop, dest->prop);
+    ASSERT_EQ(src.value.stringValue, dest->value.stringValue);
+
+    src.prop = toInt(VehicleProperty::INFO_FUEL_TYPE);
+    src.value.stringValue = "";
+    src.value.int32Values = { 1, 2, 3 };
+    dest = valuePool->obtain(src);
+    ASSERT_EQ(src.value.int32Values, dest->value.int32Values);
+    ASSERT_EQ(0u, dest->value.stringValue.size());
 }
 
 TEST_F(VehicleObjectPoolTest, valuePoolMultithreadedBenchmark) {
@@ -114,8 +176,9 @@ TEST_F(VehicleObjectPoolTest, valuePoolMultithreadedBenchmark) {
 
     ASSERT_EQ(static_cast<uint32_t>(T * C * O), stats->Obtained);
     ASSERT_EQ(static_cast<uint32_t>(T * C * O), stats->Recycled);
-    // Created less than obtained.
-    ASSERT_GE(static_cast<uint32_t>(T * O), stats->Created);
+    // Created less than obtained. Objects that sit in a cache of another thread can't be
+    // reused, so each thread may create up to its cache size (16) more.
+    ASSERT_GE(static_cast<uint32_t>(T * (O + 16)), stats->Created);
 
     auto elapsedMs = (finish - start) / 1000000;
     ASSERT_GE(1000, elapsedMs);  // Less a second to access 100K objects.
@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <atomic>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "vhal_v2_0/VehiclePropertyStore.h"
+#include "vhal_v2_0/VehicleUtils.h"
+
+namespace android {
+namespace hardware {
+namespace automotive {
+namespace vehicle {
+namespace V2_0 {
+
+namespace {
+
+constexpr int32_t kGlobalProp = toInt(VehicleProperty::PERF_VEHICLE_SPEED);
+constexpr int32_t kSeatProp = toInt(VehicleProperty::HVAC_SEAT_TEMPERATURE);
+
+class VehiclePropertyStoreTest : public ::testing::TestWithParam<VehiclePropertyStore::Mode> {
+protected:
+    void SetUp() override {
+        store.reset(new VehiclePropertyStore(GetParam()));
+        store->registerProperty(VehiclePropConfig { .prop = kGlobalProp });
+        store->registerProperty(VehiclePropConfig { .prop = kSeatProp });
+    }
+
+    static VehiclePropValue makeValue(int32_t prop, int32_t area, float value) {
+        VehiclePropValue v;
+        v.prop = prop;
+        v.areaId = area;
+        v.value.floatValues = { value };
+        return v;
+    }
+
+public:
+    std::unique_ptr<VehiclePropertyStore> store;
+};
+
+TEST_P(VehiclePropertyStoreTest, readWrite) {
+    ASSERT_EQ(nullptr, store->readValueOrNull(kGlobalProp));
+    ASSERT_TRUE(store->writeValue(makeValue(kGlobalProp, 0, 1.0f), true));
+    ASSERT_TRUE(store->writeValue(makeValue(kGlobalProp, 0, 2.0f), true));
+
+    auto value = store->readValueOrNull(kGlobalProp);
+    ASSERT_NE(nullptr, value);
+    ASSERT_EQ(2.0f, value->value.floatValues[0]);
+
+    // Not registered.
+    ASSERT_FALSE(store->writeValue(makeValue(kGlobalProp + 1, 0, 1.0f), true));
+    ASSERT_EQ(nullptr, store->getConfigOrNull(kGlobalProp + 1));
+    ASSERT_NE(nullptr, store->getConfigOrNull(kGlobalProp));
+}
+
+TEST_P(VehiclePropertyStoreTest, areasAndRemoval) {
+    store->writeValue(makeValue(kSeatProp, 1, 10.0f), true);
+    store->writeValue(makeValue(kSeatProp, 2, 20.0f), true);
+    store->writeValue(makeValue(kGlobalProp, 0, 1.0f), true);
+
+    ASSERT_EQ(2u, store->readValuesForProperty(kSeatProp).size());
+    ASSERT_EQ(3u, store->readAllValues().size());
+
+    auto value = store->readValueOrNull(kSeatProp, 2);
+    ASSERT_NE(nullptr, value);
+    ASSERT_EQ(20.0f, value->value.floatValues[0]);
+
+    store->removeValue(makeValue(kSeatProp, 1, 0.0f));
+    ASSERT_EQ(nullptr, store->readValueOrNull(kSeatProp, 1));
+    ASSERT_EQ(1u, store->readValuesForProperty(kSeatProp).size());
+
+    store->removeValuesForProperty(kSeatProp);
+    ASSERT_EQ(0u, store->readValuesForProperty(kSeatProp).size());
+    ASSERT_EQ(1u, store->readAllValues().size());
+}
+
+TEST_P(VehiclePropertyStoreTest, concurrentReadWrite) {
+    std::atomic<bool> done { false };
+    std::thread writer([this, &done] {
+        for (int i = 0; i < 10000; i++) {
+            store->writeValue(makeValue(kGlobalProp, 0, static_cast<float>(i)), true);
+        }
+        done = true;
+    });
+
+    float last = -1.0f;
+    while (!done) {
+        auto value = store->readValueOrNull(kGlobalProp);
+        if (value == nullptr) continue;
+        // Readers must always observe a complete value and values never go back in time.
+        ASSERT_EQ(1u, value->value.floatValues.size());
+        ASSERT_LE(last, value->value.floatValues[0]);
+        last = value->value.floatValues[0];
+    }
+    writer.join();
+    ASSERT_EQ(9999.0f, store->readValueOrNull(kGlobalProp)->value.floatValues[0]);
+}
+
+INSTANTIATE_TEST_CASE_P(Modes, VehiclePropertyStoreTest,
+                        ::testing::Values(VehiclePropertyStore::Mode::SINGLE_LOCK,
+                                          VehiclePropertyStore::Mode::SHARDED));
+
+}  // namespace anonymous
+
+}  // namespace V2_0
+}  // namespace vehicle
+}  // namespace automotive
+}  // namespace hardware
+}  // namespace android
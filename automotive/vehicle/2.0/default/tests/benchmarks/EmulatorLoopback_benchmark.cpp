@@ -0,0 +1,221 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <android-base/unique_fd.h>
+#include <benchmark/benchmark.h>
+#include <utils/SystemClock.h>
+
+#include "vhal_v2_0/EmulatedVehicleHal.h"
+#include "vhal_v2_0/VehicleEmulator.h"
+#include "vhal_v2_0/VehicleHalProto.pb.h"
+
+namespace android {
+namespace hardware {
+namespace automotive {
+namespace vehicle {
+namespace V2_0 {
+
+namespace {
+
+using android::base::unique_fd;
+
+// Port SocketComm listens on. The vehicle HAL service must be stopped while this benchmark runs.
+constexpr int kEmulatorPort = 33452;
+
+/**
+ * A fake emulator connected over TCP to a VehicleEmulator driving an EmulatedVehicleHal, the way
+ * the host side of the emulator talks to the default HAL.
+ */
+class Loopback {
+  public:
+    Loopback() : mStore(VehiclePropertyStore::Mode::SHARDED), mHal(&mStore), mEmulator(&mHal) {
+        mHal.init(&mPool, [this](VehicleHal::VehiclePropValuePtr) { mHalEvents++; },
+                  [](StatusCode, int32_t, int32_t) {});
+        connectToEmulator();
+    }
+
+    impl::EmulatedVehicleHal* hal() { return &mHal; }
+    int64_t halEvents() const { return mHalEvents; }
+
+    bool send(const emulator::EmulatorMessage& msg) {
+        mTxBuffer.resize(msg.ByteSize() + sizeof(uint32_t));
+        uint32_t msgLen = htonl(msg.ByteSize());
+        memcpy(mTxBuffer.data(), &msgLen, sizeof(msgLen));
+        msg.SerializeToArray(mTxBuffer.data() + sizeof(msgLen), msg.ByteSize());
+        return ::send(mFd.get(), mTxBuffer.data(), mTxBuffer.size(), MSG_NOSIGNAL) ==
+               static_cast<ssize_t>(mTxBuffer.size());
+    }
+
+    bool receive(emulator::EmulatorMessage* msg) {
+        uint32_t msgLen;
+        if (!readExactly(&msgLen, sizeof(msgLen))) {
+            return false;
+        }
+        mRxBuffer.resize(ntohl(msgLen));
+        return readExactly(mRxBuffer.data(), mRxBuffer.size()) &&
+               msg->ParseFromArray(mRxBuffer.data(), mRxBuffer.size());
+    }
+
+  private:
+    void connectToEmulator() {
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(kEmulatorPort);
+        for (int attempt = 0; attempt < 100; attempt++) {
+            mFd.reset(socket(AF_INET, SOCK_STREAM, 0));
+            if (connect(mFd.get(), reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0) {
+                int noDelay = 1;
+                setsockopt(mFd.get(), IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+                // Wait until SocketComm has registered the connection, or the first updates are
+                // not sent to it.
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                return;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        abort();
+    }
+
+    bool readExactly(void* buffer, size_t numBytes) {
+        uint8_t* data = static_cast<uint8_t*>(buffer);
+        while (numBytes > 0) {
+            ssize_t numRead = TEMP_FAILURE_RETRY(::read(mFd.get(), data, numBytes));
+            if (numRead <= 0) {
+                return false;
+            }
+            data += numRead;
+            numBytes -= numRead;
+        }
+        return true;
+    }
+
+    VehiclePropValuePool mPool;
+    VehiclePropertyStore mStore;
+    impl::EmulatedVehicleHal mHal;
+    impl::VehicleEmulator mEmulator;
+    std::atomic<int64_t> mHalEvents{0};
+    unique_fd mFd;
+    std::vector<uint8_t> mTxBuffer;
+    std::vector<uint8_t> mRxBuffer;
+};
+
+// Never destroyed: SocketComm cannot be stopped while a client is connected.
+Loopback* getLoopback() {
+    static Loopback* loopback = new Loopback();
+    return loopback;
+}
+
+/* Emulator -> HAL: SET_PROPERTY_CMD messages carrying state.range(0) updates each. */
+void BM_EmulatorToHal(benchmark::State& state) {
+    Loopback* loopback = getLoopback();
+    emulator::EmulatorMessage cmd;
+    cmd.set_msg_type(emulator::SET_PROPERTY_CMD);
+    for (int64_t i = 0; i < state.range(0); i++) {
+        emulator::VehiclePropValue* value = cmd.add_value();
+        value->set_prop(toInt(VehicleProperty::PERF_VEHICLE_SPEED));
+        value->set_value_type(toInt(VehiclePropertyType::FLOAT));
+        value->add_float_values(0.0f);
+    }
+    emulator::EmulatorMessage resp;
+    int64_t eventsBefore = loopback->halEvents();
+
+    float speed = 0.0f;
+    for (auto _ : state) {
+        for (auto& value : *cmd.mutable_value()) {
+            value.set_float_values(0, speed++);
+        }
+        if (!loopback->send(cmd)) {
+            state.SkipWithError("send failed");
+            break;
+        }
+        // Skips the updates sent by other benchmarks still in flight.
+        do {
+            if (!loopback->receive(&resp)) {
+                state.SkipWithError("receive failed");
+                return;
+            }
+        } while (resp.msg_type() != emulator::SET_PROPERTY_RESP);
+        if (resp.status() != emulator::RESULT_OK) {
+            state.SkipWithError("set failed");
+            break;
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.counters["hal_events"] = loopback->halEvents() - eventsBefore;
+}
+
+/*
+ * HAL -> emulator: state.range(0) VehicleHal::set() calls, until all of them reached the emulator.
+ * Includes the time updates wait in VehicleEmulator for more updates to send along.
+ */
+void BM_HalToEmulator(benchmark::State& state) {
+    Loopback* loopback = getLoopback();
+    VehiclePropValue value = {.prop = toInt(VehicleProperty::VEHICLE_SPEED_DISPLAY_UNITS)};
+    value.value.int32Values = {0};
+    emulator::EmulatorMessage msg;
+    int64_t messages = 0;
+
+    for (auto _ : state) {
+        for (int64_t i = 0; i < state.range(0); i++) {
+            value.timestamp = elapsedRealtimeNano();
+            value.value.int32Values[0]++;
+            if (loopback->hal()->set(value) != StatusCode::OK) {
+                state.SkipWithError("set failed");
+                return;
+            }
+        }
+        int64_t received = 0;
+        while (received < state.range(0)) {
+            if (!loopback->receive(&msg)) {
+                state.SkipWithError("receive failed");
+                return;
+            }
+            if (msg.msg_type() == emulator::SET_PROPERTY_ASYNC) {
+                received += msg.value_size();
+                messages++;
+            }
+        }
+    }
+    int64_t updates = state.iterations() * state.range(0);
+    state.SetItemsProcessed(updates);
+    state.counters["updates_per_message"] =
+            static_cast<double>(updates) / std::max<int64_t>(messages, 1);
+}
+
+BENCHMARK(BM_EmulatorToHal)->Arg(1)->Arg(8)->Arg(32)->UseRealTime();
+BENCHMARK(BM_HalToEmulator)->Arg(1)->Arg(32)->Arg(256)->UseRealTime();
+
+}  // anonymous namespace
+
+}  // namespace V2_0
+}  // namespace vehicle
+}  // namespace automotive
+}  // namespace hardware
+}  // namespace android
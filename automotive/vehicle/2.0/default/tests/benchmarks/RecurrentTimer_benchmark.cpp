@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <iterator>
+
+#include <benchmark/benchmark.h>
+
+#include "vhal_v2_0/RecurrentTimer.h"
+
+namespace {
+
+using std::chrono::milliseconds;
+using TimePoint = RecurrentEventQueue::TimePoint;
+
+// Intervals typical for CONTINUOUS properties: 1, 5, 10 Hz ... 100 Hz.
+const milliseconds kIntervals[] = { milliseconds(10), milliseconds(20), milliseconds(50),
+                                    milliseconds(100), milliseconds(200), milliseconds(1000) };
+
+void fillQueue(RecurrentEventQueue* queue, int32_t cookieCount, TimePoint now) {
+    for (int32_t cookie = 0; cookie < cookieCount; cookie++) {
+        queue->add(kIntervals[cookie % std::size(kIntervals)], cookie, now);
+    }
+}
+
+/* Cost of a single wake-up of the timer thread, reported per tick. */
+void BM_TakeDueEvents(benchmark::State& state) {
+    RecurrentEventQueue queue;
+    TimePoint now(milliseconds(100000));
+    fillQueue(&queue, state.range(0), now);
+
+    std::vector<int32_t> cookies;
+    for (auto _ : state) {
+        cookies.clear();
+        now = queue.takeDueEvents(now, &cookies);
+        benchmark::DoNotOptimize(cookies.data());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+/* Cost of (re)registering an event when many other events are registered. */
+void BM_Register(benchmark::State& state) {
+    RecurrentEventQueue queue;
+    TimePoint now(milliseconds(100000));
+    int32_t cookieCount = state.range(0);
+    fillQueue(&queue, cookieCount, now);
+
+    int32_t cookie = 0;
+    for (auto _ : state) {
+        queue.add(milliseconds(10), cookie, now);
+        cookie = (cookie + 1) % cookieCount;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_TakeDueEvents)->RangeMultiplier(10)->Range(10, 10000);
+BENCHMARK(BM_Register)->RangeMultiplier(10)->Range(10, 10000);
+
+}  // anonymous namespace
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include "vhal_v2_0/SubscriptionManager.h"
+#include "vhal_v2_0/VehicleUtils.h"
+
+#include "../VehicleHalTestUtils.h"
+
+namespace android {
+namespace hardware {
+namespace automotive {
+namespace vehicle {
+namespace V2_0 {
+
+namespace {
+
+constexpr int kClientCount = 32;
+constexpr int32_t kPropertyCount = 100;
+// 1000 props/s delivered in 10 ms batching windows.
+constexpr size_t kValuesPerBatch = 10;
+constexpr int32_t kBaseProp = 0x1000 | toInt(VehiclePropertyGroup::VENDOR) |
+                              toInt(VehicleArea::GLOBAL) | toInt(VehiclePropertyType::INT32);
+
+class SubscriptionFixture : public benchmark::Fixture {
+public:
+    void SetUp(const benchmark::State&) override {
+        manager.reset(new SubscriptionManager([](int32_t) {}));
+        for (int c = 0; c < kClientCount; c++) {
+            callbacks.push_back(new MockedVehicleCallback());
+            // Every client is subscribed to a half of the properties.
+            std::vector<SubscribeOptions> options;
+            for (int32_t p = c % 2; p < kPropertyCount; p += 2) {
+                options.push_back({ .propId = kBaseProp + p,
+                                    .flags = SubscribeFlags::EVENTS_FROM_CAR });
+            }
+            std::list<SubscribeOptions> updated;
+            manager->addOrUpdateSubscription(c + 1, callbacks.back(), options, &updated);
+        }
+        for (size_t i = 0; i < kValuesPerBatch; i++) {
+            values.push_back(pool.obtainInt32(i));
+            values.back()->prop = kBaseProp + (i * 7) % kPropertyCount;
+        }
+    }
+
+    void TearDown(const benchmark::State&) override {
+        values.clear();
+        manager.reset();
+        callbacks.clear();
+    }
+
+    VehiclePropValuePool pool;
+    std::unique_ptr<SubscriptionManager> manager;
+    std::vector<sp<IVehicleCallback>> callbacks;
+    std::vector<recyclable_ptr<VehiclePropValue>> values;
+};
+
+/* The list based fan-out, including copying into hidl_vecs as VehicleHalManager used to do. */
+BENCHMARK_F(SubscriptionFixture, BM_DistributeToLists)(benchmark::State& state) {
+    for (auto _ : state) {
+        auto clientValues = manager->distributeValuesToClients(values,
+                                                               SubscribeFlags::EVENTS_FROM_CAR);
+        for (const HalClientValues& cv : clientValues) {
+            hidl_vec<VehiclePropValue> vec;
+            vec.resize(cv.values.size());
+            int i = 0;
+            for (VehiclePropValue* pValue : cv.values) {
+                shallowCopy(&vec[i++], *pValue);
+            }
+            benchmark::DoNotOptimize(vec.data());
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * kValuesPerBatch);
+}
+
+/* The indexed fan-out that builds every client's hidl_vec once. */
+BENCHMARK_F(SubscriptionFixture, BM_DistributeIndexed)(benchmark::State& state) {
+    std::vector<HalClientHidlValues> clientValues;
+    for (auto _ : state) {
+        manager->distributeValuesToClients(values, SubscribeFlags::EVENTS_FROM_CAR,
+                                           &clientValues);
+        benchmark::DoNotOptimize(clientValues.data());
+    }
+    state.SetItemsProcessed(state.iterations() * kValuesPerBatch);
+}
+
+}  // namespace anonymous
+
+}  // namespace V2_0
+}  // namespace vehicle
+}  // namespace automotive
+}  // namespace hardware
+}  // namespace android
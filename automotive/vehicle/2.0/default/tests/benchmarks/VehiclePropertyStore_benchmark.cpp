@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include "vhal_v2_0/VehiclePropertyStore.h"
+#include "vhal_v2_0/VehicleUtils.h"
+
+namespace android {
+namespace hardware {
+namespace automotive {
+namespace vehicle {
+namespace V2_0 {
+
+namespace {
+
+// Number of distinct properties stored, roughly what the emulated HAL registers.
+constexpr int32_t kPropertyCount = 256;
+constexpr int32_t kBaseProp = 0x1000 | toInt(VehiclePropertyGroup::VENDOR) |
+                              toInt(VehicleArea::GLOBAL) | toInt(VehiclePropertyType::FLOAT);
+
+VehiclePropertyStore* gStore = nullptr;
+
+void setUpStore(VehiclePropertyStore::Mode mode) {
+    gStore = new VehiclePropertyStore(mode);
+    for (int32_t i = 0; i < kPropertyCount; i++) {
+        gStore->registerProperty(VehiclePropConfig { .prop = kBaseProp + i });
+        VehiclePropValue value;
+        value.prop = kBaseProp + i;
+        value.value.floatValues = { 0.0f };
+        gStore->writeValue(value, true);
+    }
+}
+
+/**
+ * Thread 0 writes values the way the emulator / generators do, all other threads read them the
+ * way HIDL clients polling CONTINUOUS properties do. Throughput is reported per thread.
+ */
+void BM_MixedReadWrite(benchmark::State& state, VehiclePropertyStore::Mode mode) {
+    if (state.thread_index == 0) {
+        setUpStore(mode);
+    }
+
+    VehiclePropValue value;
+    value.value.floatValues = { 0.0f };
+    int32_t i = state.thread_index;
+    for (auto _ : state) {
+        int32_t prop = kBaseProp + (i++ % kPropertyCount);
+        if (state.thread_index == 0) {
+            value.prop = prop;
+            value.value.floatValues[0] += 1.0f;
+            benchmark::DoNotOptimize(gStore->writeValue(value, true));
+        } else {
+            benchmark::DoNotOptimize(gStore->readValueOrNull(prop));
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+
+    if (state.thread_index == 0) {
+        delete gStore;
+        gStore = nullptr;
+    }
+}
+
+void BM_ReadAllValues(benchmark::State& state, VehiclePropertyStore::Mode mode) {
+    setUpStore(mode);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(gStore->readAllValues());
+    }
+    state.SetItemsProcessed(state.iterations() * kPropertyCount);
+    delete gStore;
+    gStore = nullptr;
+}
+
+BENCHMARK_CAPTURE(BM_MixedReadWrite, SingleLock, VehiclePropertyStore::Mode::SINGLE_LOCK)
+        ->ThreadRange(1, 8)
+        ->UseRealTime();
+BENCHMARK_CAPTURE(BM_MixedReadWrite, Sharded, VehiclePropertyStore::Mode::SHARDED)
+        ->ThreadRange(1, 8)
+        ->UseRealTime();
+BENCHMARK_CAPTURE(BM_ReadAllValues, SingleLock, VehiclePropertyStore::Mode::SINGLE_LOCK);
+BENCHMARK_CAPTURE(BM_ReadAllValues, Sharded, VehiclePropertyStore::Mode::SHARDED);
+
+}  // namespace anonymous
+
+}  // namespace V2_0
+}  // namespace vehicle
+}  // namespace automotive
+}  // namespace hardware
+}  // namespace android
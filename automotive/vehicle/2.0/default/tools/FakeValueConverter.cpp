@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Converts a fake value JSON file into a binary replay file, which FakeDataCommand::StartJson
+// replays without parsing.
+//
+// Usage: vhal-fake-value-converter <input.json> <output.replay>
+
+#include <fstream>
+#include <iostream>
+
+#include <vhal_v2_0/FakeValueReplayFile.h>
+#include <vhal_v2_0/JsonFakeValueReader.h>
+
+using android::hardware::automotive::vehicle::V2_0::impl::JsonFakeValueReader;
+using android::hardware::automotive::vehicle::V2_0::impl::writeReplayFile;
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        std::cerr << "Usage: " << argv[0] << " <input.json> <output.replay>" << std::endl;
+        return 1;
+    }
+    auto ifs = std::make_unique<std::ifstream>(argv[1]);
+    if (!*ifs) {
+        std::cerr << "Couldn't open " << argv[1] << std::endl;
+        return 1;
+    }
+    JsonFakeValueReader reader(std::move(ifs));
+    const ssize_t numEvents = writeReplayFile(&reader, argv[2]);
+    if (numEvents < 0) {
+        std::cerr << "Couldn't write " << argv[2] << std::endl;
+        return 1;
+    }
+    std::cout << "Converted " << numEvents << " events" << std::endl;
+    return 0;
+}
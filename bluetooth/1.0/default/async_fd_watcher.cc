@@ -27,11 +27,14 @@
 #include <thread>
 #include <vector>
 #include "fcntl.h"
-#include "sys/select.h"
+#include "sys/epoll.h"
 #include "unistd.h"
 
 static const int INVALID_FD = -1;
 
+// The number of ready file descriptors handled per epoll_wait()
+static const int MAX_EPOLL_EVENTS = 8;
+
 static const int BT_RT_PRIORITY = 1;
 
 namespace android {
@@ -48,7 +51,9 @@ int AsyncFdWatcher::WatchFdForNonBlockingReads(
   }
 
   // Start the thread if not started yet
-  return tryStartThread();
+  if (tryStartThread()) return -1;
+
+  return addFdToEpoll(file_descriptor);
 }
 
 int AsyncFdWatcher::ConfigureTimeout(
@@ -81,12 +86,29 @@ int AsyncFdWatcher::tryStartThread() {
   notification_listen_fd_ = pipe_fds[0];
   notification_write_fd_ = pipe_fds[1];
 
+  epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd_ == INVALID_FD) return -1;
+  if (addFdToEpoll(notification_listen_fd_)) return -1;
+
   thread_ = std::thread([this]() { ThreadRoutine(); });
   if (!thread_.joinable()) return -1;
 
   return 0;
 }
 
+int AsyncFdWatcher::addFdToEpoll(int file_descriptor) {
+  struct epoll_event event;
+  event.events = EPOLLIN;
+  event.data.fd = file_descriptor;
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, file_descriptor, &event) &&
+      errno != EEXIST) {
+    ALOGE("%s unable to watch fd %d: %s", __func__, file_descriptor,
+          strerror(errno));
+    return -1;
+  }
+  return 0;
+}
+
 int AsyncFdWatcher::stopThread() {
   if (!std::atomic_exchange(&running_, false)) return 0;
 
@@ -105,6 +127,7 @@ int AsyncFdWatcher::stopThread() {
     timeout_cb_ = nullptr;
   }
 
+  close(epoll_fd_);
   close(notification_listen_fd_);
   close(notification_write_fd_);
 
@@ -129,26 +152,14 @@ void AsyncFdWatcher::ThreadRoutine() {
   }
 
   while (running_) {
-    fd_set read_fds;
-    FD_ZERO(&read_fds);
-    FD_SET(notification_listen_fd_, &read_fds);
-    int max_read_fd = INVALID_FD;
-    for (auto& it : watched_fds_) {
-      FD_SET(it.first, &read_fds);
-      max_read_fd = std::max(max_read_fd, it.first);
-    }
-
-    struct timeval timeout;
-    struct timeval* timeout_ptr = NULL;
+    int timeout = -1;
     if (timeout_ms_ > std::chrono::milliseconds(0)) {
-      timeout.tv_sec = timeout_ms_.count() / 1000;
-      timeout.tv_usec = (timeout_ms_.count() % 1000) * 1000;
-      timeout_ptr = &timeout;
+      timeout = timeout_ms_.count();
     }
 
     // Wait until there is data available to read on some FD.
-    int nfds = std::max(notification_listen_fd_, max_read_fd);
-    int retval = select(nfds + 1, &read_fds, NULL, NULL, timeout_ptr);
+    struct epoll_event events[MAX_EPOLL_EVENTS];
+    int retval = epoll_wait(epoll_fd_, events, MAX_EPOLL_EVENTS, timeout);
 
     // There was some error.
     if (retval < 0) continue;
@@ -166,19 +177,25 @@ void AsyncFdWatcher::ThreadRoutine() {
     }
 
     // Read data from the notification FD.
-    if (FD_ISSET(notification_listen_fd_, &read_fds)) {
+    bool notified = false;
+    for (int i = 0; i < retval; i++) {
+      if (events[i].data.fd == notification_listen_fd_) notified = true;
+    }
+    if (notified) {
       char buffer[] = {0};
       TEMP_FAILURE_RETRY(read(notification_listen_fd_, buffer, 1));
       continue;
     }
 
-    // Invoke the data ready callbacks if appropriate.
+    // Invoke the data ready callbacks if appropriate. The watched FDs are
+    // level-triggered, so data left unread is reported again.
     {
       // Hold the mutex to make sure that the callbacks are still valid.
       std::unique_lock<std::mutex> guard(internal_mutex_);
-      for (auto& it : watched_fds_) {
-        if (FD_ISSET(it.first, &read_fds)) {
-          it.second(it.first);
+      for (int i = 0; i < retval; i++) {
+        auto it = watched_fds_.find(events[i].data.fd);
+        if (it != watched_fds_.end()) {
+          it->second(it->first);
         }
       }
     }
@@ -44,6 +44,7 @@ class AsyncFdWatcher {
   AsyncFdWatcher& operator=(const AsyncFdWatcher&) = delete;
 
   int tryStartThread();
+  int addFdToEpoll(int file_descriptor);
   int stopThread();
   int notifyThread();
   void ThreadRoutine();
@@ -54,6 +55,7 @@ class AsyncFdWatcher {
   std::mutex timeout_mutex_;
 
   std::map<int, ReadCallback> watched_fds_;
+  int epoll_fd_;
   int notification_listen_fd_;
   int notification_write_fd_;
   TimeoutCallback timeout_cb_;
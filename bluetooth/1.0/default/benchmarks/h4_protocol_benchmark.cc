@@ -0,0 +1,98 @@
+//
+// Copyright 2019 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include <benchmark/benchmark.h>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "h4_protocol.h"
+
+namespace android {
+namespace hardware {
+namespace bluetooth {
+namespace hci {
+
+// Packets written to the fake UART at once, small enough to fit in the socket
+// buffer.
+static const size_t kPacketsPerBurst = 32;
+
+// Builds |kPacketsPerBurst| H4 framed ACL packets with |payload_size| bytes.
+static std::vector<uint8_t> BuildAclBurst(size_t payload_size) {
+  std::vector<uint8_t> burst;
+  for (size_t i = 0; i < kPacketsPerBurst; i++) {
+    // h4 type[1] + handle[2] + size[2]
+    const uint8_t preamble[] = {HCI_PACKET_TYPE_ACL_DATA, 0x01, 0x20,
+                                static_cast<uint8_t>(payload_size & 0xff),
+                                static_cast<uint8_t>(payload_size >> 8)};
+    burst.insert(burst.end(), preamble, preamble + sizeof(preamble));
+    burst.insert(burst.end(), payload_size, static_cast<uint8_t>(i));
+  }
+  return burst;
+}
+
+// Measures how fast inbound ACL packets are parsed from a socketpair standing
+// in for the UART.
+static void BM_H4ReadAclPackets(benchmark::State& state) {
+  int sockfd[2];
+  if (socketpair(AF_LOCAL, SOCK_STREAM, 0, sockfd)) {
+    state.SkipWithError("socketpair failed");
+    return;
+  }
+  const std::vector<uint8_t> burst = BuildAclBurst(state.range(0));
+  int buffer_size = burst.size() * 2;
+  setsockopt(sockfd[1], SOL_SOCKET, SO_SNDBUF, &buffer_size,
+             sizeof(buffer_size));
+  setsockopt(sockfd[0], SOL_SOCKET, SO_RCVBUF, &buffer_size,
+             sizeof(buffer_size));
+
+  size_t packets_received = 0;
+  PacketReadCallback count_packet = [&packets_received](
+                                        const hidl_vec<uint8_t>& packet) {
+    benchmark::DoNotOptimize(packet.data());
+    packets_received++;
+  };
+  H4Protocol protocol(sockfd[0], count_packet, count_packet, count_packet,
+                      count_packet);
+
+  for (auto _ : state) {
+    if (TEMP_FAILURE_RETRY(write(sockfd[1], burst.data(), burst.size())) !=
+        static_cast<ssize_t>(burst.size())) {
+      state.SkipWithError("write failed");
+      break;
+    }
+    packets_received = 0;
+    while (packets_received < kPacketsPerBurst) {
+      protocol.OnDataReady(sockfd[0]);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kPacketsPerBurst);
+  state.SetBytesProcessed(state.iterations() * burst.size());
+
+  close(sockfd[0]);
+  close(sockfd[1]);
+}
+// LE default and maximum, 2-DH5 and 3-DH5 sized ACL payloads
+BENCHMARK(BM_H4ReadAclPackets)->Arg(27)->Arg(251)->Arg(679)->Arg(1021);
+
+}  // namespace hci
+}  // namespace bluetooth
+}  // namespace hardware
+}  // namespace android
+
+BENCHMARK_MAIN();
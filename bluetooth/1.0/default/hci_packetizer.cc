@@ -21,6 +21,7 @@
 #include <dlfcn.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <string.h>
 #include <unistd.h>
 #include <utils/Log.h>
 
@@ -28,17 +29,30 @@ namespace {
 
 const size_t preamble_size_for_type[] = {
     0, HCI_COMMAND_PREAMBLE_SIZE, HCI_ACL_PREAMBLE_SIZE, HCI_SCO_PREAMBLE_SIZE,
-    HCI_EVENT_PREAMBLE_SIZE};
+    HCI_EVENT_PREAMBLE_SIZE, HCI_ISO_PREAMBLE_SIZE};
 const size_t packet_length_offset_for_type[] = {
-    0, HCI_LENGTH_OFFSET_CMD, HCI_LENGTH_OFFSET_ACL, HCI_LENGTH_OFFSET_SCO,
-    HCI_LENGTH_OFFSET_EVT};
+    0, HCI_LENGTH_OFFSET_CMD, HCI_LENGTH_OFFSET_ACL,
+    HCI_LENGTH_OFFSET_SCO, HCI_LENGTH_OFFSET_EVT, HCI_LENGTH_OFFSET_ISO};
+
+// Enough for several maximum sized BR/EDR ACL packets per read. The buffer
+// grows if a larger packet arrives.
+const size_t kReadBufferSize = 16 * 1024;
 
 size_t HciGetPacketLengthForType(HciPacketType type, const uint8_t* preamble) {
   size_t offset = packet_length_offset_for_type[type];
+  if (type == HCI_PACKET_TYPE_ISO_DATA) {
+    // The upper two bits are reserved.
+    return (((preamble[offset + 1] & 0x3f) << 8) | preamble[offset]);
+  }
   if (type != HCI_PACKET_TYPE_ACL_DATA) return preamble[offset];
   return (((preamble[offset + 1]) << 8) | preamble[offset]);
 }
 
+bool HciIsInboundPacketType(HciPacketType type) {
+  return type == HCI_PACKET_TYPE_ACL_DATA || type == HCI_PACKET_TYPE_SCO_DATA ||
+         type == HCI_PACKET_TYPE_EVENT || type == HCI_PACKET_TYPE_ISO_DATA;
+}
+
 }  // namespace
 
 namespace android {
@@ -46,61 +60,87 @@ namespace hardware {
 namespace bluetooth {
 namespace hci {
 
+HciPacketizer::HciPacketizer(HciPacketReadyCallback packet_cb)
+    : buffer_(kReadBufferSize), packet_ready_cb_(packet_cb) {}
+
 const hidl_vec<uint8_t>& HciPacketizer::GetPacket() const { return packet_; }
 
+HciPacketType HciPacketizer::GetPacketType() const { return packet_type_; }
+
+void HciPacketizer::OnDataReady(int fd) {
+  OnDataReady(fd, HCI_PACKET_TYPE_UNKNOWN);
+}
+
 void HciPacketizer::OnDataReady(int fd, HciPacketType packet_type) {
-  switch (state_) {
-    case HCI_PREAMBLE: {
-      ssize_t bytes_read = TEMP_FAILURE_RETRY(
-          read(fd, preamble_ + bytes_read_,
-               preamble_size_for_type[packet_type] - bytes_read_));
-      if (bytes_read == 0) {
-        // This is only expected if the UART got closed when shutting down.
-        ALOGE("%s: Unexpected EOF reading the header!", __func__);
-        sleep(5);  // Expect to be shut down within 5 seconds.
-        return;
-      }
-      if (bytes_read < 0) {
-        LOG_ALWAYS_FATAL("%s: Read header error: %s", __func__,
-                         strerror(errno));
-      }
-      bytes_read_ += bytes_read;
-      if (bytes_read_ == preamble_size_for_type[packet_type]) {
-        size_t packet_length =
-            HciGetPacketLengthForType(packet_type, preamble_);
-        packet_.resize(preamble_size_for_type[packet_type] + packet_length);
-        memcpy(packet_.data(), preamble_, preamble_size_for_type[packet_type]);
-        bytes_remaining_ = packet_length;
-        state_ = HCI_PAYLOAD;
-        bytes_read_ = 0;
-      }
-      break;
-    }
+  if (!ReadAvailable(fd)) return;
+  CompactBuffer(ParsePackets(packet_type));
+}
 
-    case HCI_PAYLOAD: {
-      ssize_t bytes_read = TEMP_FAILURE_RETRY(read(
-          fd,
-          packet_.data() + preamble_size_for_type[packet_type] + bytes_read_,
-          bytes_remaining_));
-      if (bytes_read == 0) {
-        // This is only expected if the UART got closed when shutting down.
-        ALOGE("%s: Unexpected EOF reading the payload!", __func__);
-        sleep(5);  // Expect to be shut down within 5 seconds.
-        return;
-      }
-      if (bytes_read < 0) {
-        LOG_ALWAYS_FATAL("%s: Read payload error: %s", __func__,
-                         strerror(errno));
-      }
-      bytes_remaining_ -= bytes_read;
-      bytes_read_ += bytes_read;
-      if (bytes_remaining_ == 0) {
-        packet_ready_cb_();
-        state_ = HCI_PREAMBLE;
-        bytes_read_ = 0;
+bool HciPacketizer::ReadAvailable(int fd) {
+  ssize_t bytes_read = TEMP_FAILURE_RETRY(read(
+      fd, buffer_.data() + buffer_end_, buffer_.size() - buffer_end_));
+  if (bytes_read == 0) {
+    // This is only expected if the UART got closed when shutting down.
+    ALOGE("%s: Unexpected EOF reading the UART!", __func__);
+    sleep(5);  // Expect to be shut down within 5 seconds.
+    return false;
+  }
+  if (bytes_read < 0) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK) return false;
+    LOG_ALWAYS_FATAL("%s: Read error: %s", __func__, strerror(errno));
+  }
+  buffer_end_ += bytes_read;
+  return true;
+}
+
+size_t HciPacketizer::ParsePackets(HciPacketType channel_type) {
+  while (true) {
+    uint8_t* data = buffer_.data() + buffer_begin_;
+    size_t available = buffer_end_ - buffer_begin_;
+    HciPacketType packet_type = channel_type;
+    size_t type_size = 0;
+    if (channel_type == HCI_PACKET_TYPE_UNKNOWN) {
+      if (available < 1) return 1;
+      packet_type = static_cast<HciPacketType>(data[0]);
+      if (!HciIsInboundPacketType(packet_type)) {
+        LOG_ALWAYS_FATAL("%s: Unimplemented packet type %d", __func__,
+                         static_cast<int>(packet_type));
       }
-      break;
+      type_size = 1;
+    }
+    size_t preamble_size = preamble_size_for_type[packet_type];
+    if (available < type_size + preamble_size) {
+      return type_size + preamble_size;
     }
+    size_t packet_size =
+        preamble_size +
+        HciGetPacketLengthForType(packet_type, data + type_size);
+    if (available < type_size + packet_size) {
+      return type_size + packet_size;
+    }
+    packet_.setToExternal(data + type_size, packet_size);
+    packet_type_ = packet_type;
+    buffer_begin_ += type_size + packet_size;
+    packet_ready_cb_();
+  }
+}
+
+void HciPacketizer::CompactBuffer(size_t bytes_needed) {
+  packet_ = hidl_vec<uint8_t>();
+  size_t available = buffer_end_ - buffer_begin_;
+  if (available == 0) {
+    buffer_begin_ = buffer_end_ = 0;
+    return;
+  }
+  // Move the start of the incomplete packet to the front, so that the rest
+  // of it can be read behind it.
+  if (buffer_begin_ + bytes_needed > buffer_.size()) {
+    memmove(buffer_.data(), buffer_.data() + buffer_begin_, available);
+    buffer_begin_ = 0;
+    buffer_end_ = available;
+  }
+  if (bytes_needed > buffer_.size()) {
+    buffer_.resize(bytes_needed);
   }
 }
 
@@ -17,6 +17,7 @@
 #pragma once
 
 #include <functional>
+#include <vector>
 
 #include <hidl/HidlSupport.h>
 
@@ -30,20 +31,36 @@ namespace hci {
 using ::android::hardware::hidl_vec;
 using HciPacketReadyCallback = std::function<void(void)>;
 
+// Reads as much as is available from the transport at once, and reports every
+// complete packet in the read buffer. A packet split across reads is kept in
+// the buffer until the rest of it arrives.
 class HciPacketizer {
  public:
-  HciPacketizer(HciPacketReadyCallback packet_cb)
-      : packet_ready_cb_(packet_cb){};
+  HciPacketizer(HciPacketReadyCallback packet_cb);
+
+  // For a channel carrying H4 framed packets, each preceded by its type.
+  void OnDataReady(int fd);
+  // For a channel carrying only packets of |packet_type|.
   void OnDataReady(int fd, HciPacketType packet_type);
+
+  // The packet being reported, valid only until the callback returns. It
+  // refers to the read buffer, so the packet is not copied.
   const hidl_vec<uint8_t>& GetPacket() const;
+  HciPacketType GetPacketType() const;
 
  protected:
-  enum State { HCI_PREAMBLE, HCI_PAYLOAD };
-  State state_{HCI_PREAMBLE};
-  uint8_t preamble_[HCI_PREAMBLE_SIZE_MAX];
+  bool ReadAvailable(int fd);
+  // Reports the complete packets in the read buffer, and returns the number
+  // of bytes needed to complete the next one.
+  size_t ParsePackets(HciPacketType channel_type);
+  void CompactBuffer(size_t bytes_needed);
+
+  std::vector<uint8_t> buffer_;
+  // The bytes read but not reported yet are [buffer_begin_, buffer_end_).
+  size_t buffer_begin_{0};
+  size_t buffer_end_{0};
+  HciPacketType packet_type_{HCI_PACKET_TYPE_UNKNOWN};
   hidl_vec<uint8_t> packet_;
-  size_t bytes_remaining_{0};
-  size_t bytes_read_{0};
   HciPacketReadyCallback packet_ready_cb_;
 };
 
@@ -23,6 +23,7 @@
 #include <cstdint>
 #include <cstring>
 #include <mutex>
+#include <thread>
 #include <vector>
 
 #include <log/log.h>
@@ -122,24 +123,23 @@ class H4ProtocolTest : public ::testing::Test {
     preamble[3] = length & 0xFF;
     preamble[4] = (length >> 8) & 0xFF;
 
-    ALOGD("%s writing", __func__);
-    TEMP_FAILURE_RETRY(write(fake_uart_, preamble, sizeof(preamble)));
-    TEMP_FAILURE_RETRY(write(fake_uart_, payload, strlen(payload)));
-
-    ALOGD("%s waiting", __func__);
     std::mutex mutex;
     std::condition_variable done;
     EXPECT_CALL(acl_cb_, Call(HidlVecMatches(preamble + 1, sizeof(preamble) - 1,
                                              payload)))
         .WillOnce(Notify(&mutex, &done));
+    // Hold the lock while writing, so the notification can't be missed.
+    std::unique_lock<std::mutex> lock(mutex);
+
+    ALOGD("%s writing", __func__);
+    TEMP_FAILURE_RETRY(write(fake_uart_, preamble, sizeof(preamble)));
+    TEMP_FAILURE_RETRY(write(fake_uart_, payload, strlen(payload)));
 
+    ALOGD("%s waiting", __func__);
     // Fail if it takes longer than 100 ms.
     auto timeout_time =
         std::chrono::steady_clock::now() + std::chrono::milliseconds(100);
-    {
-      std::unique_lock<std::mutex> lock(mutex);
-      done.wait_until(lock, timeout_time);
-    }
+    done.wait_until(lock, timeout_time);
   }
 
   void WriteAndExpectInboundScoData(char* payload) {
@@ -147,70 +147,69 @@ class H4ProtocolTest : public ::testing::Test {
     char preamble[4] = {HCI_PACKET_TYPE_SCO_DATA, 20, 17, 0};
     preamble[3] = strlen(payload) & 0xFF;
 
-    ALOGD("%s writing", __func__);
-    TEMP_FAILURE_RETRY(write(fake_uart_, preamble, sizeof(preamble)));
-    TEMP_FAILURE_RETRY(write(fake_uart_, payload, strlen(payload)));
-
-    ALOGD("%s waiting", __func__);
     std::mutex mutex;
     std::condition_variable done;
     EXPECT_CALL(sco_cb_, Call(HidlVecMatches(preamble + 1, sizeof(preamble) - 1,
                                              payload)))
         .WillOnce(Notify(&mutex, &done));
+    // Hold the lock while writing, so the notification can't be missed.
+    std::unique_lock<std::mutex> lock(mutex);
 
+    ALOGD("%s writing", __func__);
+    TEMP_FAILURE_RETRY(write(fake_uart_, preamble, sizeof(preamble)));
+    TEMP_FAILURE_RETRY(write(fake_uart_, payload, strlen(payload)));
+
+    ALOGD("%s waiting", __func__);
     // Fail if it takes longer than 100 ms.
     auto timeout_time =
         std::chrono::steady_clock::now() + std::chrono::milliseconds(100);
-    {
-      std::unique_lock<std::mutex> lock(mutex);
-      done.wait_until(lock, timeout_time);
-    }
+    done.wait_until(lock, timeout_time);
   }
 
   void WriteAndExpectInboundEvent(char* payload) {
     // h4 type[1] + event_code[1] + size[1]
     char preamble[3] = {HCI_PACKET_TYPE_EVENT, 9, 0};
     preamble[2] = strlen(payload) & 0xFF;
-    ALOGD("%s writing", __func__);
-    TEMP_FAILURE_RETRY(write(fake_uart_, preamble, sizeof(preamble)));
-    TEMP_FAILURE_RETRY(write(fake_uart_, payload, strlen(payload)));
-
-    ALOGD("%s waiting", __func__);
     std::mutex mutex;
     std::condition_variable done;
     EXPECT_CALL(event_cb_, Call(HidlVecMatches(preamble + 1,
                                                sizeof(preamble) - 1, payload)))
         .WillOnce(Notify(&mutex, &done));
-
-    {
-      std::unique_lock<std::mutex> lock(mutex);
-      done.wait(lock);
-    }
-  }
-
-  void WriteAndExpectInboundIsoData(char* payload) {
-    // h4 type[1] + handle[2] + size[1]
-    char preamble[4] = {HCI_PACKET_TYPE_ISO_DATA, 20, 17, 0};
-    preamble[3] = strlen(payload) & 0xFF;
+    // Hold the lock while writing, so the notification can't be missed.
+    std::unique_lock<std::mutex> lock(mutex);
 
     ALOGD("%s writing", __func__);
     TEMP_FAILURE_RETRY(write(fake_uart_, preamble, sizeof(preamble)));
     TEMP_FAILURE_RETRY(write(fake_uart_, payload, strlen(payload)));
 
     ALOGD("%s waiting", __func__);
+    done.wait(lock);
+  }
+
+  void WriteAndExpectInboundIsoData(char* payload) {
+    // h4 type[1] + handle[2] + size[2]
+    char preamble[5] = {HCI_PACKET_TYPE_ISO_DATA, 20, 17, 0, 0};
+    int length = strlen(payload);
+    preamble[3] = length & 0xFF;
+    preamble[4] = (length >> 8) & 0x3F;
+
     std::mutex mutex;
     std::condition_variable done;
     EXPECT_CALL(iso_cb_, Call(HidlVecMatches(preamble + 1, sizeof(preamble) - 1,
                                              payload)))
         .WillOnce(Notify(&mutex, &done));
+    // Hold the lock while writing, so the notification can't be missed.
+    std::unique_lock<std::mutex> lock(mutex);
 
+    ALOGD("%s writing", __func__);
+    TEMP_FAILURE_RETRY(write(fake_uart_, preamble, sizeof(preamble)));
+    TEMP_FAILURE_RETRY(write(fake_uart_, payload, strlen(payload)));
+
+    ALOGD("%s waiting", __func__);
     // Fail if it takes longer than 100 ms.
     auto timeout_time =
         std::chrono::steady_clock::now() + std::chrono::milliseconds(100);
-    {
-      std::unique_lock<std::mutex> lock(mutex);
-      done.wait_until(lock, timeout_time);
-    }
+    done.wait_until(lock, timeout_time);
   }
 
   testing::MockFunction<void(const hidl_vec<uint8_t>&)> event_cb_;
@@ -238,6 +237,69 @@ TEST_F(H4ProtocolTest, TestReads) {
   WriteAndExpectInboundIsoData(iso_data);
 }
 
+// Ensure all the packets are parsed when several arrive in a single read
+TEST_F(H4ProtocolTest, TestReadsBatchedPackets) {
+  // h4 type[1] + event_code[1] + size[1], and h4 type[1] + handle[2] + size[2]
+  char event_preamble[3] = {HCI_PACKET_TYPE_EVENT, 9,
+                            static_cast<char>(strlen(event_data))};
+  char acl_preamble[5] = {HCI_PACKET_TYPE_ACL_DATA, 19, 92,
+                          static_cast<char>(strlen(acl_data)), 0};
+  std::vector<char> uart_data;
+  const int kNumPackets = 10;
+  for (int i = 0; i < kNumPackets; i++) {
+    uart_data.insert(uart_data.end(), event_preamble,
+                     event_preamble + sizeof(event_preamble));
+    uart_data.insert(uart_data.end(), event_data,
+                     event_data + strlen(event_data));
+    uart_data.insert(uart_data.end(), acl_preamble,
+                     acl_preamble + sizeof(acl_preamble));
+    uart_data.insert(uart_data.end(), acl_data, acl_data + strlen(acl_data));
+  }
+
+  std::mutex mutex;
+  std::condition_variable done;
+  int acl_packets = 0;
+  EXPECT_CALL(event_cb_, Call(HidlVecMatches(event_preamble + 1,
+                                             sizeof(event_preamble) - 1,
+                                             event_data)))
+      .Times(kNumPackets);
+  EXPECT_CALL(acl_cb_, Call(HidlVecMatches(acl_preamble + 1,
+                                           sizeof(acl_preamble) - 1, acl_data)))
+      .Times(kNumPackets)
+      .WillRepeatedly([&](const hidl_vec<uint8_t>&) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (++acl_packets == kNumPackets) done.notify_one();
+      });
+  TEMP_FAILURE_RETRY(write(fake_uart_, uart_data.data(), uart_data.size()));
+
+  std::unique_lock<std::mutex> lock(mutex);
+  done.wait_for(lock, std::chrono::milliseconds(100),
+                [&] { return acl_packets == kNumPackets; });
+}
+
+// Ensure a packet is reassembled when it arrives one byte at a time
+TEST_F(H4ProtocolTest, TestReadsSplitPacket) {
+  // h4 type[1] + handle[2] + size[2]
+  char preamble[5] = {HCI_PACKET_TYPE_ACL_DATA, 19, 92,
+                      static_cast<char>(strlen(acl_data)), 0};
+  std::vector<char> uart_data(preamble, preamble + sizeof(preamble));
+  uart_data.insert(uart_data.end(), acl_data, acl_data + strlen(acl_data));
+
+  std::mutex mutex;
+  std::condition_variable done;
+  EXPECT_CALL(acl_cb_, Call(HidlVecMatches(preamble + 1, sizeof(preamble) - 1,
+                                           acl_data)))
+      .WillOnce(Notify(&mutex, &done));
+  // Hold the lock while writing, so the notification can't be missed.
+  std::unique_lock<std::mutex> lock(mutex);
+  for (char byte : uart_data) {
+    TEMP_FAILURE_RETRY(write(fake_uart_, &byte, 1));
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+
+  done.wait_for(lock, std::chrono::milliseconds(100));
+}
+
 }  // namespace implementation
 }  // namespace V1_0
 }  // namespace bluetooth
@@ -18,6 +18,10 @@
 
 #include "BluetoothAudioSession.h"
 
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
 #include <android-base/logging.h>
 #include <android-base/stringprintf.h>
 
@@ -45,15 +49,39 @@ AudioConfiguration BluetoothAudioSession::invalidOffloadAudioConfiguration = {};
 static constexpr int kFmqSendTimeoutMs = 1000;  // 1000 ms timeout for sending
 static constexpr int kWritePollMs = 1;          // polled non-blocking interval
 
+static inline uint64_t elapsed_ns(
+    std::chrono::steady_clock::time_point start_time) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - start_time)
+      .count();
+}
+
 static inline timespec timespec_convert_from_hal(const TimeSpec& TS) {
   return {.tv_sec = static_cast<long>(TS.tvSec),
           .tv_nsec = static_cast<long>(TS.tvNSec)};
 }
 
 BluetoothAudioSession::BluetoothAudioSession(const SessionType& session_type)
-    : session_type_(session_type), stack_iface_(nullptr), mDataMQ(nullptr) {
+    : session_type_(session_type), stack_iface_(nullptr), data_path_(nullptr) {
   invalidSoftwareAudioConfiguration.pcmConfig(kInvalidPcmParameters);
   invalidOffloadAudioConfiguration.codecConfig(kInvalidCodecConfiguration);
+  ResetDataPathStatistics();
+}
+
+BluetoothAudioSession::DataPath::DataPath(const DataMQ::Descriptor& descriptor)
+    : data_mq(descriptor), event_flag(nullptr) {
+  if (!data_mq.isValid() || data_mq.getEventFlagWord() == nullptr) return;
+  if (EventFlag::createEventFlag(data_mq.getEventFlagWord(), &event_flag) !=
+      ::android::OK) {
+    LOG(WARNING) << __func__ << " - failed to create EventFlag, polling FMQ";
+    event_flag = nullptr;
+  }
+}
+
+BluetoothAudioSession::DataPath::~DataPath() {
+  if (event_flag != nullptr) {
+    EventFlag::deleteEventFlag(&event_flag);
+  }
 }
 
 // The report function is used to report that the Bluetooth stack has started
@@ -79,6 +107,7 @@ void BluetoothAudioSession::OnSessionStarted(
              : kInvalidSoftwareAudioConfiguration);
   } else {
     stack_iface_ = stack_iface;
+    ResetDataPathStatistics();
     LOG(INFO) << __func__ << " - SessionType=" << toString(session_type_)
               << ", AudioConfiguration=" << toString(audio_config);
     ReportSessionStatus();
@@ -147,24 +176,26 @@ bool BluetoothAudioSession::IsSessionReady() {
   std::lock_guard<std::recursive_mutex> guard(mutex_);
   bool dataMQ_valid =
       (session_type_ == SessionType::A2DP_HARDWARE_OFFLOAD_DATAPATH ||
-       (mDataMQ != nullptr && mDataMQ->isValid()));
+       std::atomic_load(&data_path_) != nullptr);
   return stack_iface_ != nullptr && dataMQ_valid;
 }
 
 bool BluetoothAudioSession::UpdateDataPath(const DataMQ::Descriptor* dataMQ) {
-  if (dataMQ == nullptr) {
-    // usecase of reset by nullptr
-    mDataMQ = nullptr;
-    return true;
+  std::shared_ptr<DataPath> tempDataPath;
+  if (dataMQ != nullptr) {
+    tempDataPath = std::make_shared<DataPath>(*dataMQ);
+    if (!tempDataPath->data_mq.isValid()) {
+      tempDataPath = nullptr;
+    }
   }
-  std::unique_ptr<DataMQ> tempDataMQ;
-  tempDataMQ.reset(new DataMQ(*dataMQ));
-  if (!tempDataMQ || !tempDataMQ->isValid()) {
-    mDataMQ = nullptr;
-    return false;
+  // usecase of reset by nullptr
+  std::shared_ptr<DataPath> oldDataPath =
+      std::atomic_exchange(&data_path_, tempDataPath);
+  if (oldDataPath != nullptr && oldDataPath->event_flag != nullptr) {
+    // let a writer blocked on the old FMQ see that it is gone
+    oldDataPath->event_flag->wake(kDataMqNotFull);
   }
-  mDataMQ = std::move(tempDataMQ);
-  return true;
+  return dataMQ == nullptr || tempDataPath != nullptr;
 }
 
 bool BluetoothAudioSession::UpdateAudioConfig(
@@ -370,36 +401,95 @@ void BluetoothAudioSession::UpdateTracksMetadata(
 size_t BluetoothAudioSession::OutWritePcmData(const void* buffer,
                                               size_t bytes) {
   if (buffer == nullptr || !bytes) return 0;
+  const auto start_time = std::chrono::steady_clock::now();
+  const auto deadline =
+      start_time + std::chrono::milliseconds(kFmqSendTimeoutMs);
+  // The session lock only guards the control state, so it is not held while
+  // waiting for the Bluetooth stack to drain the FMQ.
+  std::shared_ptr<DataPath> data_path = std::atomic_load(&data_path_);
+  if (data_path == nullptr) return 0;
+  DataMQ& data_mq = data_path->data_mq;
+  if (data_mq.availableToRead() == 0 && total_bytes_written_ > 0) {
+    ++underrun_count_;
+  }
   size_t totalWritten = 0;
-  int ms_timeout = kFmqSendTimeoutMs;
   do {
-    std::unique_lock<std::recursive_mutex> lock(mutex_);
-    if (!IsSessionReady()) break;
-    size_t availableToWrite = mDataMQ->availableToWrite();
+    size_t availableToWrite = data_mq.availableToWrite();
     if (availableToWrite) {
       if (availableToWrite > (bytes - totalWritten)) {
         availableToWrite = bytes - totalWritten;
       }
 
-      if (!mDataMQ->write(static_cast<const uint8_t*>(buffer) + totalWritten,
-                          availableToWrite)) {
+      if (!data_mq.write(static_cast<const uint8_t*>(buffer) + totalWritten,
+                         availableToWrite)) {
         ALOGE("FMQ datapath writting %zu/%zu failed", totalWritten, bytes);
-        return totalWritten;
+        break;
       }
       totalWritten += availableToWrite;
-    } else if (ms_timeout >= kWritePollMs) {
-      lock.unlock();
-      usleep(kWritePollMs * 1000);
-      ms_timeout -= kWritePollMs;
-    } else {
+      if (data_path->event_flag != nullptr) {
+        data_path->event_flag->wake(kDataMqNotEmpty);
+      }
+      continue;
+    }
+    const auto now = std::chrono::steady_clock::now();
+    if (now >= deadline) {
       ALOGD("data %zu/%zu overflow %d ms", totalWritten, bytes,
-            (kFmqSendTimeoutMs - ms_timeout));
-      return totalWritten;
+            kFmqSendTimeoutMs);
+      ++overrun_count_;
+      break;
     }
+    // A Bluetooth stack which does not wake kDataMqNotFull is still polled
+    // every kWritePollMs.
+    const auto wait_time =
+        std::min<std::chrono::steady_clock::duration>(
+            deadline - now, std::chrono::milliseconds(kWritePollMs));
+    if (data_path->event_flag != nullptr) {
+      uint32_t efState = 0;
+      data_path->event_flag->wait(
+          kDataMqNotFull, &efState,
+          std::chrono::duration_cast<std::chrono::nanoseconds>(wait_time)
+              .count(),
+          true /* retry */);
+    } else {
+      std::this_thread::sleep_for(wait_time);
+    }
+    // the session has ended or restarted with another FMQ
+    if (std::atomic_load(&data_path_) != data_path) break;
   } while (totalWritten < bytes);
+  UpdateWriteStatistics(totalWritten, elapsed_ns(start_time));
   return totalWritten;
 }
 
+void BluetoothAudioSession::ResetDataPathStatistics() {
+  underrun_count_ = 0;
+  overrun_count_ = 0;
+  write_count_ = 0;
+  total_bytes_written_ = 0;
+  total_write_latency_ns_ = 0;
+  max_write_latency_ns_ = 0;
+}
+
+void BluetoothAudioSession::UpdateWriteStatistics(size_t bytes_written,
+                                                  uint64_t latency_ns) {
+  ++write_count_;
+  total_bytes_written_ += bytes_written;
+  total_write_latency_ns_ += latency_ns;
+  uint64_t max_latency_ns = max_write_latency_ns_;
+  while (latency_ns > max_latency_ns &&
+         !max_write_latency_ns_.compare_exchange_weak(max_latency_ns,
+                                                      latency_ns)) {
+  }
+}
+
+DataPathStatistics BluetoothAudioSession::GetDataPathStatistics() {
+  return {.underrun_count = underrun_count_,
+          .overrun_count = overrun_count_,
+          .write_count = write_count_,
+          .total_bytes_written = total_bytes_written_,
+          .total_write_latency_ns = total_write_latency_ns_,
+          .max_write_latency_ns = max_write_latency_ns_};
+}
+
 std::unique_ptr<BluetoothAudioSessionInstance>
     BluetoothAudioSessionInstance::instance_ptr =
         std::unique_ptr<BluetoothAudioSessionInstance>(
@@ -16,10 +16,13 @@
 
 #pragma once
 
+#include <atomic>
+#include <memory>
 #include <mutex>
 #include <unordered_map>
 
 #include <android/hardware/bluetooth/audio/2.0/IBluetoothAudioPort.h>
+#include <fmq/EventFlag.h>
 #include <fmq/MessageQueue.h>
 #include <hardware/audio.h>
 #include <hidl/MQDescriptor.h>
@@ -29,6 +32,7 @@ namespace bluetooth {
 namespace audio {
 
 using ::android::sp;
+using ::android::hardware::EventFlag;
 using ::android::hardware::kSynchronizedReadWrite;
 using ::android::hardware::MessageQueue;
 using ::android::hardware::bluetooth::audio::V2_0::AudioConfiguration;
@@ -45,6 +49,13 @@ using BluetoothAudioStatus =
 
 using DataMQ = MessageQueue<uint8_t, kSynchronizedReadWrite>;
 
+// Bits of the DataMQ event flag word. The bluetooth_audio module wakes
+// kDataMqNotEmpty after writing; a Bluetooth stack which wakes kDataMqNotFull
+// after reading lets a blocked writer resume without waiting for its poll
+// interval.
+static constexpr uint32_t kDataMqNotEmpty = 1 << 0;
+static constexpr uint32_t kDataMqNotFull = 1 << 1;
+
 static constexpr uint16_t kObserversCookieSize = 0x0010;  // 0x0000 ~ 0x000f
 constexpr uint16_t kObserversCookieUndefined =
     (static_cast<uint16_t>(SessionType::UNKNOWN) << 8 & 0xff00);
@@ -78,16 +89,44 @@ struct PortStatusCallbacks {
   std::function<void(uint16_t cookie)> session_changed_cb_;
 };
 
+// The counters of the software encoding data path since the session started
+struct DataPathStatistics {
+  // writes which found the FMQ drained, so the Bluetooth stack may have run
+  // out of audio to encode
+  uint64_t underrun_count;
+  // writes which timed out on a full FMQ and dropped audio
+  uint64_t overrun_count;
+  uint64_t write_count;
+  uint64_t total_bytes_written;
+  // time spent in OutWritePcmData, including waiting for the FMQ to drain
+  uint64_t total_write_latency_ns;
+  uint64_t max_write_latency_ns;
+};
+
 class BluetoothAudioSession {
  private:
+  // audio data path (FMQ) for software encoding, and the EventFlag of its
+  // event flag word if it has one
+  struct DataPath {
+    explicit DataPath(const DataMQ::Descriptor& descriptor);
+    ~DataPath();
+    DataPath(const DataPath&) = delete;
+    DataPath& operator=(const DataPath&) = delete;
+
+    DataMQ data_mq;
+    EventFlag* event_flag;
+  };
+
   // using recursive_mutex to allow hwbinder to re-enter agian.
   std::recursive_mutex mutex_;
   SessionType session_type_;
 
   // audio control path to use for both software and offloading
   sp<IBluetoothAudioPort> stack_iface_;
-  // audio data path (FMQ) for software encoding
-  std::unique_ptr<DataMQ> mDataMQ;
+  // audio data path for software encoding. It is swapped atomically under
+  // mutex_, and OutWritePcmData only takes a reference to it, so writing never
+  // waits for the control path.
+  std::shared_ptr<DataPath> data_path_;
   // audio data configuration for both software and offloading
   AudioConfiguration audio_config_;
 
@@ -98,10 +137,20 @@ class BluetoothAudioSession {
   std::unordered_map<uint16_t, std::shared_ptr<struct PortStatusCallbacks>>
       observers_;
 
+  // counters of the software encoding data path
+  std::atomic<uint64_t> underrun_count_;
+  std::atomic<uint64_t> overrun_count_;
+  std::atomic<uint64_t> write_count_;
+  std::atomic<uint64_t> total_bytes_written_;
+  std::atomic<uint64_t> total_write_latency_ns_;
+  std::atomic<uint64_t> max_write_latency_ns_;
+
   bool UpdateDataPath(const DataMQ::Descriptor* dataMQ);
   bool UpdateAudioConfig(const AudioConfiguration& audio_config);
   // invoking the registered session_changed_cb_
   void ReportSessionStatus();
+  void ResetDataPathStatistics();
+  void UpdateWriteStatistics(size_t bytes_written, uint64_t latency_ns);
 
  public:
   BluetoothAudioSession(const SessionType& session_type);
@@ -151,9 +200,14 @@ class BluetoothAudioSession {
                                timespec* data_position);
   void UpdateTracksMetadata(const struct source_metadata* source_metadata);
 
-  // The control function writes stream to FMQ
+  // The control function writes stream to FMQ. It blocks on the FMQ event
+  // flag while the FMQ is full, and gives up after kFmqSendTimeoutMs.
   size_t OutWritePcmData(const void* buffer, size_t bytes);
 
+  // The report function is used to fetch the counters of the software encoding
+  // data path since this session started
+  DataPathStatistics GetDataPathStatistics();
+
   static constexpr PcmParameters kInvalidPcmParameters = {
       .sampleRate = SampleRate::RATE_UNKNOWN,
       .channelMode = ChannelMode::UNKNOWN,
@@ -56,6 +56,19 @@ class BluetoothAudioSessionReport {
       session_ptr->ReportControlStatus(start_resp, status);
     }
   }
+  // The API reports the underrun, overrun and write latency counters of the
+  // software encoding data path since the session started
+  // @return: true if the session exists
+  static bool GetDataPathStatistics(const SessionType& session_type,
+                                    DataPathStatistics* statistics) {
+    std::shared_ptr<BluetoothAudioSession> session_ptr =
+        BluetoothAudioSessionInstance::GetSessionInstance(session_type);
+    if (session_ptr != nullptr && statistics != nullptr) {
+      *statistics = session_ptr->GetDataPathStatistics();
+      return true;
+    }
+    return false;
+  }
 };
 
 }  // namespace audio
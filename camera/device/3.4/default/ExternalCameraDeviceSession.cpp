@@ -18,10 +18,12 @@
 #define ATRACE_TAG ATRACE_TAG_CAMERA
 #include <log/log.h>
 
+#include <algorithm>
 #include <inttypes.h>
 #include "ExternalCameraDeviceSession.h"
 
 #include "android-base/macros.h"
+#include <utils/AndroidThreads.h>
 #include <utils/Timers.h>
 #include <utils/Trace.h>
 #include <linux/videodev2.h>
@@ -947,7 +949,20 @@ ExternalCameraDeviceSession::OutputThread::OutputThread(
         wp<ExternalCameraDeviceSession> parent,
         CroppingType ct) : mParent(parent), mCroppingType(ct) {}
 
-ExternalCameraDeviceSession::OutputThread::~OutputThread() {}
+ExternalCameraDeviceSession::OutputThread::~OutputThread() {
+    std::unique_lock<std::mutex> lk(mProcessLock);
+    mProcessExit = true;
+    lk.unlock();
+    mProcessCond.notify_one();
+    if (mProcessThread.joinable()) {
+        if (mProcessThread.get_id() == std::this_thread::get_id()) {
+            // Last reference dropped by the process thread, it exits on its own
+            mProcessThread.detach();
+        } else {
+            mProcessThread.join();
+        }
+    }
+}
 
 void ExternalCameraDeviceSession::OutputThread::setExifMakeModel(
         const std::string& make, const std::string& model) {
@@ -1075,19 +1090,15 @@ int ExternalCameraDeviceSession::OutputThread::cropAndScaleLocked(
         return 0;
     }
 
-    auto it = mScaledYu12Frames.find(outSz);
-    sp<AllocatedFrame> scaledYu12Buf;
-    if (it != mScaledYu12Frames.end()) {
-        scaledYu12Buf = it->second;
-    } else {
-        it = mIntermediateBuffers.find(outSz);
-        if (it == mIntermediateBuffers.end()) {
-            ALOGE("%s: failed to find intermediate buffer size %dx%d",
-                    __FUNCTION__, outSz.width, outSz.height);
-            return -1;
-        }
-        scaledYu12Buf = it->second;
+    // Each output size has its own intermediate buffer, so different sizes can be scaled in
+    // parallel
+    auto it = mIntermediateBuffers.find(outSz);
+    if (it == mIntermediateBuffers.end()) {
+        ALOGE("%s: failed to find intermediate buffer size %dx%d",
+                __FUNCTION__, outSz.width, outSz.height);
+        return -1;
     }
+    sp<AllocatedFrame> scaledYu12Buf = it->second;
     // Scale
     YCbCrLayout outLayout;
     ret = scaledYu12Buf->getLayout(&outLayout);
@@ -1124,7 +1135,6 @@ int ExternalCameraDeviceSession::OutputThread::cropAndScaleLocked(
     }
 
     *out = outLayout;
-    mScaledYu12Frames.insert({outSz, scaledYu12Buf});
     return 0;
 }
 
@@ -1616,7 +1626,8 @@ ssize_t ExternalCameraDeviceSession::getJpegBufferSize(
 
 int ExternalCameraDeviceSession::OutputThread::createJpegLocked(
         HalStreamBuffer &halBuf,
-        const std::shared_ptr<HalRequest>& req)
+        const std::shared_ptr<HalRequest>& req,
+        sp<AllocatedFrame>& yu12Frame)
 {
     ATRACE_CALL();
     int ret;
@@ -1639,7 +1650,7 @@ int ExternalCameraDeviceSession::OutputThread::createJpegLocked(
           halBuf.bufPtr);
     ALOGV("%s: YV12 buffer %d x %d",
           __FUNCTION__,
-          mYu12Frame->mWidth, mYu12Frame->mHeight);
+          yu12Frame->mWidth, yu12Frame->mHeight);
 
     int jpegQuality, thumbQuality;
     Size thumbSize;
@@ -1704,7 +1715,7 @@ int ExternalCameraDeviceSession::OutputThread::createJpegLocked(
 
     YCbCrLayout yu12Thumb;
     if (outputThumbnail) {
-        ret = cropAndScaleThumbLocked(mYu12Frame, thumbSize, &yu12Thumb);
+        ret = cropAndScaleThumbLocked(yu12Frame, thumbSize, &yu12Thumb);
 
         if (ret != 0) {
             return lfail(
@@ -1712,12 +1723,12 @@ int ExternalCameraDeviceSession::OutputThread::createJpegLocked(
         }
     }
 
-    /* Scale and crop main jpeg */
-    ret = cropAndScaleLocked(mYu12Frame, jpegSize, &yu12Main);
-
-    if (ret != 0) {
+    /* Main jpeg was cropped and scaled by the scale stage */
+    auto scaled = mScaledYu12Layouts.find(jpegSize);
+    if (scaled == mScaledYu12Layouts.end()) {
         return lfail("%s: crop and scale main failed!", __FUNCTION__);
     }
+    yu12Main = scaled->second;
 
     /* Encode the thumbnail image */
     if (outputThumbnail) {
@@ -1794,7 +1805,35 @@ int ExternalCameraDeviceSession::OutputThread::createJpegLocked(
     return 0;
 }
 
+void ExternalCameraDeviceSession::OutputThread::StageTiming::record(nsecs_t ns) {
+    count++;
+    totalNs += ns;
+    maxNs = std::max(maxNs, ns);
+}
+
+void ExternalCameraDeviceSession::OutputThread::recordStageTime(
+        StageTiming* timing, nsecs_t startNs) {
+    nsecs_t ns = systemTime(SYSTEM_TIME_MONOTONIC) - startNs;
+    std::lock_guard<std::mutex> lk(mStatsLock);
+    timing->record(ns);
+}
+
+status_t ExternalCameraDeviceSession::OutputThread::readyToRun() {
+    mWorkerPool = std::make_unique<WorkerPool>(kNumWorkerThreads, PRIORITY_DISPLAY);
+    mProcessThread = std::thread(&OutputThread::processLoop, wp<OutputThread>(this));
+    return OK;
+}
+
 bool ExternalCameraDeviceSession::OutputThread::threadLoop() {
+    bool keepRunning = decodeNextRequest();
+    if (!keepRunning || exitPending()) {
+        // Let the process stage return the requests it already has before this thread is joined
+        drainProcessStage();
+    }
+    return keepRunning;
+}
+
+bool ExternalCameraDeviceSession::OutputThread::decodeNextRequest() {
     std::shared_ptr<HalRequest> req;
     auto parent = mParent.promote();
     if (parent == nullptr) {
@@ -1815,7 +1854,7 @@ bool ExternalCameraDeviceSession::OutputThread::threadLoop() {
         ALOGE(args...);
         parent->notifyError(
                 req->frameNumber, /*stream*/-1, ErrorCode::ERROR_DEVICE);
-        signalRequestDone();
+        signalRequestDone(req->frameNumber);
         return false;
     };
 
@@ -1833,35 +1872,48 @@ bool ExternalCameraDeviceSession::OutputThread::threadLoop() {
         return onDeviceError("%s: failed to send buffer request!", __FUNCTION__);
     }
 
-    std::unique_lock<std::mutex> lk(mBufferLock);
+    // Waiting for a free YU12 frame bounds the number of requests in flight
+    size_t yu12FrameIdx;
+    sp<AllocatedFrame> yu12Frame;
+    nsecs_t waitStart = systemTime(SYSTEM_TIME_MONOTONIC);
+    if (!acquireYu12Frame(&yu12FrameIdx, &yu12Frame)) {
+        return onDeviceError("%s: no YU12 frame available", __FUNCTION__);
+    }
+    recordStageTime(&mFrameWaitTiming, waitStart);
+
     // Convert input V4L2 frame to YU12 of the same size
     // TODO: see if we can save some computation by converting to YV12 here
     uint8_t* inData;
     size_t inDataSize;
     if (req->frameIn->map(&inData, &inDataSize) != 0) {
-        lk.unlock();
+        releaseYu12Frame(yu12FrameIdx);
         return onDeviceError("%s: V4L2 buffer map failed", __FUNCTION__);
     }
 
     // TODO: in some special case maybe we can decode jpg directly to gralloc output?
     if (req->frameIn->mFourcc == V4L2_PIX_FMT_MJPEG) {
+        YCbCrLayout yu12Layout;
+        if (yu12Frame->getLayout(&yu12Layout) != 0) {
+            releaseYu12Frame(yu12FrameIdx);
+            return onDeviceError("%s: failed to get YU12 frame layout", __FUNCTION__);
+        }
+
+        nsecs_t decodeStart = systemTime(SYSTEM_TIME_MONOTONIC);
         ATRACE_BEGIN("MJPGtoI420");
         int res = libyuv::MJPGToI420(
-            inData, inDataSize, static_cast<uint8_t*>(mYu12FrameLayout.y), mYu12FrameLayout.yStride,
-            static_cast<uint8_t*>(mYu12FrameLayout.cb), mYu12FrameLayout.cStride,
-            static_cast<uint8_t*>(mYu12FrameLayout.cr), mYu12FrameLayout.cStride,
-            mYu12Frame->mWidth, mYu12Frame->mHeight, mYu12Frame->mWidth, mYu12Frame->mHeight);
+            inData, inDataSize, static_cast<uint8_t*>(yu12Layout.y), yu12Layout.yStride,
+            static_cast<uint8_t*>(yu12Layout.cb), yu12Layout.cStride,
+            static_cast<uint8_t*>(yu12Layout.cr), yu12Layout.cStride,
+            yu12Frame->mWidth, yu12Frame->mHeight, yu12Frame->mWidth, yu12Frame->mHeight);
         ATRACE_END();
+        recordStageTime(&mDecodeTiming, decodeStart);
 
         if (res != 0) {
             // For some webcam, the first few V4L2 frames might be malformed...
             ALOGE("%s: Convert V4L2 frame to YU12 failed! res %d", __FUNCTION__, res);
-            lk.unlock();
-            Status st = parent->processCaptureRequestError(req);
-            if (st != Status::OK) {
-                return onDeviceError("%s: failed to process capture request error!", __FUNCTION__);
-            }
-            signalRequestDone();
+            // The process stage sends the error result, so that its shutter does not overtake
+            // the ones of the frames it is still processing
+            queueDecodedRequest({req, yu12FrameIdx, yu12Frame, /*decodeFailed*/true});
             return true;
         }
     }
@@ -1872,11 +1924,10 @@ bool ExternalCameraDeviceSession::OutputThread::threadLoop() {
 
     if (res != 0) {
         ALOGE("%s: wait for BufferRequest done failed! res %d", __FUNCTION__, res);
-        lk.unlock();
+        releaseYu12Frame(yu12FrameIdx);
         return onDeviceError("%s: failed to process buffer request error!", __FUNCTION__);
     }
 
-    ALOGV("%s processing new request", __FUNCTION__);
     const int kSyncWaitTimeoutMs = 500;
     for (auto& halBuf : req->buffers) {
         if (*(halBuf.bufPtr) == nullptr) {
@@ -1891,91 +1942,288 @@ bool ExternalCameraDeviceSession::OutputThread::threadLoop() {
                 halBuf.acquireFence = -1;
             }
         }
+    }
+
+    // Hand the decoded frame to the process stage and go decode the next request
+    queueDecodedRequest({req, yu12FrameIdx, yu12Frame, /*decodeFailed*/false});
+    return true;
+}
 
+void ExternalCameraDeviceSession::OutputThread::queueDecodedRequest(DecodedRequest&& decoded) {
+    std::unique_lock<std::mutex> lk(mProcessLock);
+    mDecodedRequests.push_back(std::move(decoded));
+    lk.unlock();
+    mProcessCond.notify_one();
+}
+
+bool ExternalCameraDeviceSession::OutputThread::acquireYu12Frame(
+        size_t* idx, sp<AllocatedFrame>* frame) {
+    std::unique_lock<std::mutex> lk(mYu12FramesLock);
+    if (mYu12Frames[0] == nullptr) {
+        ALOGE("%s: YU12 frames are not allocated!", __FUNCTION__);
+        return false;
+    }
+    while (true) {
+        for (size_t i = 0; i < kMaxInflightRequests; i++) {
+            if (!mYu12FrameInUse[i]) {
+                mYu12FrameInUse[i] = true;
+                *idx = i;
+                *frame = mYu12Frames[i];
+                return true;
+            }
+        }
+        if (exitPending()) {
+            return false;
+        }
+        mYu12FrameFreeCond.wait_for(lk, std::chrono::milliseconds(kReqWaitTimeoutMs));
+    }
+}
+
+void ExternalCameraDeviceSession::OutputThread::releaseYu12Frame(size_t idx) {
+    std::unique_lock<std::mutex> lk(mYu12FramesLock);
+    mYu12FrameInUse[idx] = false;
+    lk.unlock();
+    mYu12FrameFreeCond.notify_one();
+}
+
+void ExternalCameraDeviceSession::OutputThread::processLoop(wp<OutputThread> weakThis) {
+    androidSetThreadPriority(0, PRIORITY_DISPLAY);
+    while (true) {
+        sp<OutputThread> thiz = weakThis.promote();
+        if (thiz == nullptr || !thiz->processNextRequest()) {
+            return;
+        }
+    }
+}
+
+bool ExternalCameraDeviceSession::OutputThread::processNextRequest() {
+    std::unique_lock<std::mutex> lk(mProcessLock);
+    // Time out now and then so the strong reference held by processLoop is not kept forever
+    std::chrono::milliseconds timeout =
+            std::chrono::milliseconds(kReqWaitTimeoutMs * kReqWaitTimesMax);
+    if (!mProcessCond.wait_for(lk, timeout,
+            [this] { return !mDecodedRequests.empty() || mProcessExit; })) {
+        return true;
+    }
+    if (mDecodedRequests.empty()) {
+        return false; // Exiting and nothing left to process
+    }
+    DecodedRequest decoded = std::move(mDecodedRequests.front());
+    mDecodedRequests.pop_front();
+    mProcessBusy = true;
+    lk.unlock();
+
+    std::shared_ptr<HalRequest>& req = decoded.req;
+    auto parent = mParent.promote();
+    if (parent == nullptr) {
+        ALOGE("%s: session has been disconnected!", __FUNCTION__);
+        releaseYu12Frame(decoded.yu12FrameIdx);
+    } else if (mProcessFailed) {
+        // The device is in error state after an earlier request failed
+        releaseYu12Frame(decoded.yu12FrameIdx);
+        parent->processCaptureRequestError(req);
+    } else if (decoded.decodeFailed) {
+        releaseYu12Frame(decoded.yu12FrameIdx);
+        if (parent->processCaptureRequestError(req) != Status::OK) {
+            ALOGE("%s: failed to process capture request error!", __FUNCTION__);
+            parent->notifyError(req->frameNumber, /*stream*/-1, ErrorCode::ERROR_DEVICE);
+            mProcessFailed = true;
+            requestExit();
+        }
+    } else {
+        nsecs_t processStart = systemTime(SYSTEM_TIME_MONOTONIC);
+        int ret = processRequest(req, decoded.yu12Frame);
+        recordStageTime(&mProcessTiming, processStart);
+        releaseYu12Frame(decoded.yu12FrameIdx);
+
+        if (ret == 0 && parent->processCaptureResult(req) != Status::OK) {
+            ALOGE("%s: failed to process capture result!", __FUNCTION__);
+            ret = -1;
+        }
+        if (ret != 0) {
+            parent->notifyError(req->frameNumber, /*stream*/-1, ErrorCode::ERROR_DEVICE);
+            mProcessFailed = true;
+            // Stop the decode stage like the OutputThread used to on device errors
+            requestExit();
+        }
+    }
+    signalRequestDone(req->frameNumber);
+
+    lk.lock();
+    mProcessBusy = false;
+    lk.unlock();
+    mProcessIdleCond.notify_all();
+    return true;
+}
+
+int ExternalCameraDeviceSession::OutputThread::processRequest(
+        const std::shared_ptr<HalRequest>& req, sp<AllocatedFrame>& yu12Frame) {
+    std::lock_guard<std::mutex> lk(mBufferLock);
+
+    // Scale stage: one job per output size. Buffers of the same size share the scaled frame.
+    std::vector<Size> sizes;
+    for (const auto& halBuf : req->buffers) {
         if (halBuf.fenceTimeout) {
             continue;
         }
-
-        // Gralloc lockYCbCr the buffer
         switch (halBuf.format) {
-            case PixelFormat::BLOB: {
-                int ret = createJpegLocked(halBuf, req);
-
-                if(ret != 0) {
-                    lk.unlock();
-                    return onDeviceError("%s: createJpegLocked failed with %d",
-                          __FUNCTION__, ret);
+            case PixelFormat::BLOB:
+            case PixelFormat::YCBCR_420_888:
+            case PixelFormat::YV12: {
+                Size sz {halBuf.width, halBuf.height};
+                if (std::find(sizes.begin(), sizes.end(), sz) == sizes.end()) {
+                    sizes.push_back(sz);
                 }
             } break;
-            case PixelFormat::Y16: {
-                void* outLayout = sHandleImporter.lock(*(halBuf.bufPtr), halBuf.usage, inDataSize);
+            case PixelFormat::Y16:
+                break;
+            default:
+                ALOGE("%s: unknown output format %x", __FUNCTION__, halBuf.format);
+                return -1;
+        }
+    }
 
-                std::memcpy(outLayout, inData, inDataSize);
+    std::vector<YCbCrLayout> scaledLayouts(sizes.size());
+    std::vector<int> scaleResults(sizes.size(), 0);
+    std::vector<std::function<void()>> jobs;
+    for (size_t i = 0; i < sizes.size(); i++) {
+        jobs.push_back([&, i] {
+            nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+            ATRACE_BEGIN("cropAndScaleLocked");
+            scaleResults[i] = cropAndScaleLocked(yu12Frame, sizes[i], &scaledLayouts[i]);
+            ATRACE_END();
+            recordStageTime(&mScaleTiming, start);
+        });
+    }
+    mWorkerPool->run(jobs);
 
-                int relFence = sHandleImporter.unlock(*(halBuf.bufPtr));
-                if (relFence >= 0) {
-                    halBuf.acquireFence = relFence;
+    for (size_t i = 0; i < sizes.size(); i++) {
+        if (scaleResults[i] != 0) {
+            ALOGE("%s: crop and scale to %dx%d failed!",
+                    __FUNCTION__, sizes[i].width, sizes[i].height);
+            return -1;
+        }
+        mScaledYu12Layouts[sizes[i]] = scaledLayouts[i];
+    }
+
+    // Convert stage: every output buffer is independent, except that BLOB buffers share the
+    // thumbnail frame, so they are all encoded by one job. It goes first as it takes longest.
+    uint8_t* inData;
+    size_t inDataSize;
+    if (req->frameIn->map(&inData, &inDataSize) != 0) {
+        ALOGE("%s: V4L2 buffer map failed", __FUNCTION__);
+        mScaledYu12Layouts.clear();
+        return -1;
+    }
+
+    std::vector<int> results(req->buffers.size(), 0);
+    std::vector<size_t> blobBufferIndices;
+    for (size_t i = 0; i < req->buffers.size(); i++) {
+        if (!req->buffers[i].fenceTimeout && req->buffers[i].format == PixelFormat::BLOB) {
+            blobBufferIndices.push_back(i);
+        }
+    }
+
+    jobs.clear();
+    if (!blobBufferIndices.empty()) {
+        jobs.push_back([&] {
+            for (size_t i : blobBufferIndices) {
+                nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+                results[i] = createJpegLocked(req->buffers[i], req, yu12Frame);
+                recordStageTime(&mJpegTiming, start);
+                if (results[i] != 0) {
+                    ALOGE("%s: createJpegLocked failed with %d", __FUNCTION__, results[i]);
                 }
+            }
+        });
+    }
+
+    for (size_t i = 0; i < req->buffers.size(); i++) {
+        if (req->buffers[i].fenceTimeout) {
+            continue;
+        }
+
+        // Gralloc lockYCbCr the buffer
+        switch (req->buffers[i].format) {
+            case PixelFormat::Y16: {
+                jobs.push_back([&, i] {
+                    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+                    HalStreamBuffer& halBuf = req->buffers[i];
+                    void* outLayout = sHandleImporter.lock(
+                            *(halBuf.bufPtr), halBuf.usage, inDataSize);
+
+                    std::memcpy(outLayout, inData, inDataSize);
+
+                    int relFence = sHandleImporter.unlock(*(halBuf.bufPtr));
+                    if (relFence >= 0) {
+                        halBuf.acquireFence = relFence;
+                    }
+                    recordStageTime(&mConvertTiming, start);
+                });
             } break;
             case PixelFormat::YCBCR_420_888:
             case PixelFormat::YV12: {
-                IMapper::Rect outRect {0, 0,
-                        static_cast<int32_t>(halBuf.width),
-                        static_cast<int32_t>(halBuf.height)};
-                YCbCrLayout outLayout = sHandleImporter.lockYCbCr(
-                        *(halBuf.bufPtr), halBuf.usage, outRect);
-                ALOGV("%s: outLayout y %p cb %p cr %p y_str %d c_str %d c_step %d",
-                        __FUNCTION__, outLayout.y, outLayout.cb, outLayout.cr,
-                        outLayout.yStride, outLayout.cStride, outLayout.chromaStep);
-
-                // Convert to output buffer size/format
-                uint32_t outputFourcc = getFourCcFromLayout(outLayout);
-                ALOGV("%s: converting to format %c%c%c%c", __FUNCTION__,
-                        outputFourcc & 0xFF,
-                        (outputFourcc >> 8) & 0xFF,
-                        (outputFourcc >> 16) & 0xFF,
-                        (outputFourcc >> 24) & 0xFF);
-
-                YCbCrLayout cropAndScaled;
-                ATRACE_BEGIN("cropAndScaleLocked");
-                int ret = cropAndScaleLocked(
-                        mYu12Frame,
-                        Size { halBuf.width, halBuf.height },
-                        &cropAndScaled);
-                ATRACE_END();
-                if (ret != 0) {
-                    lk.unlock();
-                    return onDeviceError("%s: crop and scale failed!", __FUNCTION__);
-                }
-
-                Size sz {halBuf.width, halBuf.height};
-                ATRACE_BEGIN("formatConvertLocked");
-                ret = formatConvertLocked(cropAndScaled, outLayout, sz, outputFourcc);
-                ATRACE_END();
-                if (ret != 0) {
-                    lk.unlock();
-                    return onDeviceError("%s: format coversion failed!", __FUNCTION__);
-                }
-                int relFence = sHandleImporter.unlock(*(halBuf.bufPtr));
-                if (relFence >= 0) {
-                    halBuf.acquireFence = relFence;
-                }
+                jobs.push_back([&, i] {
+                    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+                    HalStreamBuffer& halBuf = req->buffers[i];
+                    IMapper::Rect outRect {0, 0,
+                            static_cast<int32_t>(halBuf.width),
+                            static_cast<int32_t>(halBuf.height)};
+                    YCbCrLayout outLayout = sHandleImporter.lockYCbCr(
+                            *(halBuf.bufPtr), halBuf.usage, outRect);
+                    ALOGV("%s: outLayout y %p cb %p cr %p y_str %d c_str %d c_step %d",
+                            __FUNCTION__, outLayout.y, outLayout.cb, outLayout.cr,
+                            outLayout.yStride, outLayout.cStride, outLayout.chromaStep);
+
+                    // Convert to output buffer size/format
+                    uint32_t outputFourcc = getFourCcFromLayout(outLayout);
+                    ALOGV("%s: converting to format %c%c%c%c", __FUNCTION__,
+                            outputFourcc & 0xFF,
+                            (outputFourcc >> 8) & 0xFF,
+                            (outputFourcc >> 16) & 0xFF,
+                            (outputFourcc >> 24) & 0xFF);
+
+                    Size sz {halBuf.width, halBuf.height};
+                    ATRACE_BEGIN("formatConvertLocked");
+                    results[i] = formatConvertLocked(
+                            mScaledYu12Layouts.at(sz), outLayout, sz, outputFourcc);
+                    ATRACE_END();
+                    if (results[i] != 0) {
+                        ALOGE("%s: format coversion failed!", __FUNCTION__);
+                    }
+                    int relFence = sHandleImporter.unlock(*(halBuf.bufPtr));
+                    if (relFence >= 0) {
+                        halBuf.acquireFence = relFence;
+                    }
+                    recordStageTime(&mConvertTiming, start);
+                });
             } break;
             default:
-                lk.unlock();
-                return onDeviceError("%s: unknown output format %x", __FUNCTION__, halBuf.format);
+                break; // BLOB buffers are handled above
         }
     } // for each buffer
-    mScaledYu12Frames.clear();
+    mWorkerPool->run(jobs);
+    mScaledYu12Layouts.clear();
 
-    // Don't hold the lock while calling back to parent
-    lk.unlock();
-    Status st = parent->processCaptureResult(req);
-    if (st != Status::OK) {
-        return onDeviceError("%s: failed to process capture result!", __FUNCTION__);
+    for (int result : results) {
+        if (result != 0) {
+            return result;
+        }
+    }
+    return 0;
+}
+
+void ExternalCameraDeviceSession::OutputThread::drainProcessStage() {
+    std::unique_lock<std::mutex> lk(mProcessLock);
+    mProcessExit = true;
+    mProcessCond.notify_one();
+    // Bounded, the process thread may itself be closing the session and waiting for us
+    std::chrono::seconds timeout = std::chrono::seconds(kFlushWaitTimeoutSec);
+    bool idle = mProcessIdleCond.wait_for(lk, timeout,
+            [this] { return mDecodedRequests.empty() && !mProcessBusy; });
+    if (!idle) {
+        ALOGE("%s: wait for process stage to drain timeout!", __FUNCTION__);
     }
-    signalRequestDone();
-    return true;
 }
 
 Status ExternalCameraDeviceSession::OutputThread::allocateIntermediateBuffers(
@@ -1983,22 +2231,30 @@ Status ExternalCameraDeviceSession::OutputThread::allocateIntermediateBuffers(
         const hidl_vec<Stream>& streams,
         uint32_t blobBufferSize) {
     std::lock_guard<std::mutex> lk(mBufferLock);
-    if (mScaledYu12Frames.size() != 0) {
+    if (mScaledYu12Layouts.size() != 0) {
         ALOGE("%s: intermediate buffer pool has %zu inflight buffers! (expect 0)",
-                __FUNCTION__, mScaledYu12Frames.size());
+                __FUNCTION__, mScaledYu12Layouts.size());
         return Status::INTERNAL_ERROR;
     }
 
-    // Allocating intermediate YU12 frame
-    if (mYu12Frame == nullptr || mYu12Frame->mWidth != v4lSize.width ||
-            mYu12Frame->mHeight != v4lSize.height) {
-        mYu12Frame.clear();
-        mYu12Frame = new AllocatedFrame(v4lSize.width, v4lSize.height);
-        int ret = mYu12Frame->allocate(&mYu12FrameLayout);
-        if (ret != 0) {
-            ALOGE("%s: allocating YU12 frame failed!", __FUNCTION__);
+    // Allocating intermediate YU12 frames, one per request in flight
+    std::lock_guard<std::mutex> framesLk(mYu12FramesLock);
+    for (size_t i = 0; i < kMaxInflightRequests; i++) {
+        if (mYu12FrameInUse[i]) {
+            ALOGE("%s: YU12 frame %zu is still in use!", __FUNCTION__, i);
             return Status::INTERNAL_ERROR;
         }
+        sp<AllocatedFrame>& yu12Frame = mYu12Frames[i];
+        if (yu12Frame == nullptr || yu12Frame->mWidth != v4lSize.width ||
+                yu12Frame->mHeight != v4lSize.height) {
+            yu12Frame.clear();
+            yu12Frame = new AllocatedFrame(v4lSize.width, v4lSize.height);
+            int ret = yu12Frame->allocate();
+            if (ret != 0) {
+                ALOGE("%s: allocating YU12 frame failed!", __FUNCTION__);
+                return Status::INTERNAL_ERROR;
+            }
+        }
     }
 
     // Allocating intermediate YU12 thumbnail frame
@@ -2075,10 +2331,11 @@ void ExternalCameraDeviceSession::OutputThread::flush() {
     std::unique_lock<std::mutex> lk(mRequestListLock);
     std::list<std::shared_ptr<HalRequest>> reqs = std::move(mRequestList);
     mRequestList.clear();
-    if (mProcessingRequest) {
+    if (!mProcessingFrameNumbers.empty()) {
         std::chrono::seconds timeout = std::chrono::seconds(kFlushWaitTimeoutSec);
-        auto st = mRequestDoneCond.wait_for(lk, timeout);
-        if (st == std::cv_status::timeout) {
+        bool done = mRequestDoneCond.wait_for(lk, timeout,
+                [this] { return mProcessingFrameNumbers.empty(); });
+        if (!done) {
             ALOGE("%s: wait for inflight request finish timeout!", __FUNCTION__);
         }
     }
@@ -2116,22 +2373,24 @@ void ExternalCameraDeviceSession::OutputThread::waitForNextRequest(
     }
     *out = mRequestList.front();
     mRequestList.pop_front();
-    mProcessingRequest = true;
-    mProcessingFrameNumer = (*out)->frameNumber;
+    mProcessingFrameNumbers.push_back((*out)->frameNumber);
 }
 
-void ExternalCameraDeviceSession::OutputThread::signalRequestDone() {
+void ExternalCameraDeviceSession::OutputThread::signalRequestDone(uint32_t frameNumber) {
     std::unique_lock<std::mutex> lk(mRequestListLock);
-    mProcessingRequest = false;
-    mProcessingFrameNumer = 0;
+    mProcessingFrameNumbers.remove(frameNumber);
     lk.unlock();
-    mRequestDoneCond.notify_one();
+    mRequestDoneCond.notify_all();
 }
 
 void ExternalCameraDeviceSession::OutputThread::dump(int fd) {
-    std::lock_guard<std::mutex> lk(mRequestListLock);
-    if (mProcessingRequest) {
-        dprintf(fd, "OutputThread processing frame %d\n", mProcessingFrameNumer);
+    std::unique_lock<std::mutex> lk(mRequestListLock);
+    if (!mProcessingFrameNumbers.empty()) {
+        dprintf(fd, "OutputThread processing frame: ");
+        for (uint32_t frameNumber : mProcessingFrameNumbers) {
+            dprintf(fd, "%d, ", frameNumber);
+        }
+        dprintf(fd, "\n");
     } else {
         dprintf(fd, "OutputThread not processing any frames\n");
     }
@@ -2140,6 +2399,21 @@ void ExternalCameraDeviceSession::OutputThread::dump(int fd) {
         dprintf(fd, "%d, ", req->frameNumber);
     }
     dprintf(fd, "\n");
+    lk.unlock();
+
+    std::lock_guard<std::mutex> statsLk(mStatsLock);
+    dprintf(fd, "OutputThread stage timings (count, avg us, max us):\n");
+    auto dumpStage = [fd](const char* name, const StageTiming& timing) {
+        nsecs_t avgNs = timing.count == 0 ? 0 : timing.totalNs / timing.count;
+        dprintf(fd, "  %s: %" PRIu64 ", %" PRId64 ", %" PRId64 "\n", name, timing.count,
+                ns2us(avgNs), ns2us(timing.maxNs));
+    };
+    dumpStage("wait for YU12 frame", mFrameWaitTiming);
+    dumpStage("decode", mDecodeTiming);
+    dumpStage("scale", mScaleTiming);
+    dumpStage("convert", mConvertTiming);
+    dumpStage("jpeg", mJpegTiming);
+    dumpStage("process", mProcessTiming);
 }
 
 void ExternalCameraDeviceSession::cleanupBuffersLocked(int id) {
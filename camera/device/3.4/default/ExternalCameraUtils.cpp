@@ -20,6 +20,7 @@
 #include <cmath>
 #include <sys/mman.h>
 #include <linux/videodev2.h>
+#include <utils/AndroidThreads.h>
 #include "ExternalCameraUtils.h"
 
 namespace android {
@@ -150,6 +151,62 @@ double SupportedV4L2Format::FrameRate::getDouble() const {
     return durationDenominator / static_cast<double>(durationNumerator);
 }
 
+WorkerPool::WorkerPool(size_t numThreads, int priority) {
+    for (size_t i = 0; i < numThreads; i++) {
+        mThreads.emplace_back(&WorkerPool::workerLoop, this, priority);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lk(mLock);
+        mExit = true;
+    }
+    mJobCond.notify_all();
+    for (auto& thread : mThreads) {
+        thread.join();
+    }
+}
+
+void WorkerPool::run(const std::vector<std::function<void()>>& jobs) {
+    if (jobs.empty()) {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lk(mLock);
+    mJobs = &jobs;
+    mNextJob = 0;
+    mNumUnfinishedJobs = jobs.size();
+    mJobCond.notify_all();
+    while (runOneJobLocked(lk)) {}
+    mDoneCond.wait(lk, [this] { return mNumUnfinishedJobs == 0; });
+    mJobs = nullptr;
+}
+
+bool WorkerPool::runOneJobLocked(std::unique_lock<std::mutex>& lk) {
+    if (mJobs == nullptr || mNextJob == mJobs->size()) {
+        return false;
+    }
+    const std::function<void()>& job = (*mJobs)[mNextJob++];
+    lk.unlock();
+    job();
+    lk.lock();
+    if (--mNumUnfinishedJobs == 0) {
+        mDoneCond.notify_all();
+    }
+    return true;
+}
+
+void WorkerPool::workerLoop(int priority) {
+    androidSetThreadPriority(0, priority);
+    std::unique_lock<std::mutex> lk(mLock);
+    while (!mExit) {
+        if (!runOneJobLocked(lk)) {
+            mJobCond.wait(lk);
+        }
+    }
+}
+
 }  // namespace implementation
 }  // namespace V3_4
 }  // namespace device
@@ -26,6 +26,8 @@
 #include <chrono>
 #include <condition_variable>
 #include <list>
+#include <memory>
+#include <thread>
 #include <unordered_map>
 #include <unordered_set>
 #include "CameraMetadata.h"
@@ -263,6 +265,7 @@ protected:
         Status submitRequest(const std::shared_ptr<HalRequest>&);
         void flush();
         void dump(int fd);
+        virtual status_t readyToRun() override;
         virtual bool threadLoop() override;
 
         void setExifMakeModel(const std::string& make, const std::string& model);
@@ -285,9 +288,51 @@ protected:
         static const int kFlushWaitTimeoutSec = 3; // 3 sec
         static const int kReqWaitTimeoutMs = 33;   // 33ms
         static const int kReqWaitTimesMax = 90;    // 33ms * 90 ~= 3 sec
+        // Requests decoded or being decoded at once. Each one owns a YU12 frame, so the
+        // next request can be decoded while the previous one is scaled and converted.
+        static const size_t kMaxInflightRequests = 2;
+        // Extra threads converting the output buffers of a request in parallel. Together with
+        // the process thread this covers kMaxProcessedStream + kMaxStallStream buffers.
+        static const size_t kNumWorkerThreads = 2;
+
+        // A decoded request waiting for the process thread
+        struct DecodedRequest {
+            std::shared_ptr<HalRequest> req;
+            size_t yu12FrameIdx;
+            sp<AllocatedFrame> yu12Frame;
+            // MJPG decoding failed, the process thread only sends the error result
+            bool decodeFailed;
+        };
+
+        // Wall time spent in one stage of the output pipeline
+        struct StageTiming {
+            uint64_t count = 0;
+            nsecs_t totalNs = 0;
+            nsecs_t maxNs = 0;
+            void record(nsecs_t ns);
+        };
 
         void waitForNextRequest(std::shared_ptr<HalRequest>* out);
-        void signalRequestDone();
+        void signalRequestDone(uint32_t frameNumber);
+
+        // Decode stage, runs on the OutputThread
+        bool decodeNextRequest();
+        // Returns false if the pipeline is shutting down
+        bool acquireYu12Frame(size_t* idx, sp<AllocatedFrame>* frame);
+        void releaseYu12Frame(size_t idx);
+        void queueDecodedRequest(DecodedRequest&& decoded);
+
+        // Process stage: scale, format convert and JPEG encode on mProcessThread and mWorkerPool.
+        // The process thread only holds a weak reference between requests, as the last strong
+        // reference to the session (and this thread) may be dropped on it.
+        static void processLoop(wp<OutputThread> weakThis);
+        // Returns false once the process stage is exiting
+        bool processNextRequest();
+        int processRequest(const std::shared_ptr<HalRequest>& req, sp<AllocatedFrame>& yu12Frame);
+        // Ask the process stage to exit once the decoded requests are returned and wait for that
+        void drainProcessStage();
+
+        void recordStageTime(StageTiming* timing, nsecs_t startNs);
 
         int cropAndScaleLocked(
                 sp<AllocatedFrame>& in, const Size& outSize,
@@ -306,32 +351,55 @@ protected:
                 void *out, size_t maxOutSize,
                 size_t &actualCodeSize);
 
-        int createJpegLocked(HalStreamBuffer &halBuf, const std::shared_ptr<HalRequest>& req);
+        int createJpegLocked(HalStreamBuffer &halBuf, const std::shared_ptr<HalRequest>& req,
+                sp<AllocatedFrame>& yu12Frame);
 
         const wp<ExternalCameraDeviceSession> mParent;
         const CroppingType mCroppingType;
 
-        mutable std::mutex mRequestListLock;      // Protect acccess to mRequestList,
-                                                  // mProcessingRequest and mProcessingFrameNumer
+        mutable std::mutex mRequestListLock;      // Protect acccess to mRequestList and
+                                                  // mProcessingFrameNumbers
         std::condition_variable mRequestCond;     // signaled when a new request is submitted
         std::condition_variable mRequestDoneCond; // signaled when a request is done processing
         std::list<std::shared_ptr<HalRequest>> mRequestList;
-        bool mProcessingRequest = false;
-        uint32_t mProcessingFrameNumer = 0;
+        // Requests taken off mRequestList whose result has not been returned yet
+        std::list<uint32_t> mProcessingFrameNumbers;
 
         // V4L2 frameIn
-        // (MJPG decode)-> mYu12Frame
-        // (Scale)-> mScaledYu12Frames
-        // (Format convert) -> output gralloc frames
-        mutable std::mutex mBufferLock; // Protect access to intermediate buffers
-        sp<AllocatedFrame> mYu12Frame;
+        // (MJPG decode, OutputThread)-> mYu12Frames
+        // (Scale, mWorkerPool)-> mScaledYu12Layouts
+        // (Format convert/JPEG encode, mWorkerPool) -> output gralloc frames
+        mutable std::mutex mBufferLock; // Protect access to intermediate buffers. Held by the
+                                        // process stage, must not lock it after mYu12FramesLock
         sp<AllocatedFrame> mYu12ThumbFrame;
         std::unordered_map<Size, sp<AllocatedFrame>, SizeHasher> mIntermediateBuffers;
-        std::unordered_map<Size, sp<AllocatedFrame>, SizeHasher> mScaledYu12Frames;
-        YCbCrLayout mYu12FrameLayout;
+        std::unordered_map<Size, YCbCrLayout, SizeHasher> mScaledYu12Layouts;
         YCbCrLayout mYu12ThumbFrameLayout;
         uint32_t mBlobBufferSize = 0; // 0 -> HAL derive buffer size, else: use given size
 
+        std::mutex mYu12FramesLock; // Protect mYu12Frames and mYu12FrameInUse
+        std::condition_variable mYu12FrameFreeCond; // signaled when a YU12 frame is released
+        sp<AllocatedFrame> mYu12Frames[kMaxInflightRequests];
+        bool mYu12FrameInUse[kMaxInflightRequests] = {};
+
+        std::mutex mProcessLock; // Protect mDecodedRequests, mProcessBusy and mProcessExit
+        std::condition_variable mProcessCond; // signaled when a request is decoded or on exit
+        std::condition_variable mProcessIdleCond; // signaled when a request is processed
+        std::list<DecodedRequest> mDecodedRequests;
+        bool mProcessBusy = false;
+        bool mProcessExit = false;
+        bool mProcessFailed = false; // Only accessed by mProcessThread
+        std::thread mProcessThread;
+        std::unique_ptr<WorkerPool> mWorkerPool;
+
+        std::mutex mStatsLock; // Protect the stage timings below
+        StageTiming mFrameWaitTiming; // waiting for a free YU12 frame
+        StageTiming mDecodeTiming;
+        StageTiming mScaleTiming;     // per output size
+        StageTiming mConvertTiming;   // per YUV or Y16 output buffer
+        StageTiming mJpegTiming;      // per BLOB output buffer
+        StageTiming mProcessTiming;   // whole process stage of a request
+
         std::string mExifMake;
         std::string mExifModel;
     };
@@ -19,7 +19,10 @@
 
 #include <android/hardware/graphics/mapper/2.0/IMapper.h>
 #include <inttypes.h>
+#include <condition_variable>
+#include <functional>
 #include <mutex>
+#include <thread>
 #include <unordered_set>
 #include <vector>
 #include "tinyxml2.h"  // XML parsing
@@ -152,6 +155,30 @@ private:
     std::vector<uint8_t> mData;
 };
 
+// A fixed set of threads running batches of independent jobs, e.g. the output buffers of one
+// capture request. The thread calling run() executes jobs too, so N threads plus the caller
+// process up to N + 1 jobs at once. run() must not be called from more than one thread at a time.
+class WorkerPool {
+public:
+    WorkerPool(size_t numThreads, int priority);
+    ~WorkerPool();
+    // Returns after every job has finished
+    void run(const std::vector<std::function<void()>>& jobs);
+private:
+    void workerLoop(int priority);
+    // Returns false if there is no job left to pick up
+    bool runOneJobLocked(std::unique_lock<std::mutex>& lk);
+
+    std::mutex mLock; // Protect all members below except mThreads
+    std::condition_variable mJobCond;  // signaled when a batch is posted or the pool exits
+    std::condition_variable mDoneCond; // signaled when the last job of a batch finishes
+    const std::vector<std::function<void()>>* mJobs = nullptr;
+    size_t mNextJob = 0;
+    size_t mNumUnfinishedJobs = 0;
+    bool mExit = false;
+    std::vector<std::thread> mThreads;
+};
+
 enum CroppingType {
     HORIZONTAL = 0,
     VERTICAL = 1
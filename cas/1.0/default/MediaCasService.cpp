@@ -33,8 +33,8 @@ namespace V1_0 {
 namespace implementation {
 
 MediaCasService::MediaCasService() :
-    mCasLoader("createCasFactory"),
-    mDescramblerLoader("createDescramblerFactory") {
+    mCasLoader("createCasFactory", &mPluginIndex),
+    mDescramblerLoader("createDescramblerFactory", &mPluginIndex) {
 }
 
 MediaCasService::~MediaCasService() {
@@ -0,0 +1,280 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "android.hardware.cas@1.0-PluginIndex"
+
+#include "PluginIndex.h"
+
+#include <android-base/file.h>
+#include <android-base/parseint.h>
+#include <android-base/properties.h>
+#include <android-base/stringprintf.h>
+#include <android-base/strings.h>
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utils/Log.h>
+
+#include <algorithm>
+
+#include "SharedLibrary.h"
+
+namespace android {
+namespace hardware {
+namespace cas {
+namespace V1_0 {
+namespace implementation {
+
+namespace {
+
+constexpr char kManifestHeader[] = "cas-plugin-index 1";
+// The libraries of a build image usually all have the same mtime, so a manifest is only trusted
+// on the build it was written on.
+constexpr char kFingerprintProperty[] = "ro.vendor.build.fingerprint";
+
+typedef CasFactory* (*CreateCasFactoryFunc)();
+
+}  // namespace
+
+PluginIndex::PluginIndex(const char* pluginDir, const char* manifestPath)
+    : mPluginDir(pluginDir), mManifestPath(manifestPath), mLoaded(false) {}
+
+bool PluginIndex::findLibraryForScheme(int32_t CA_system_id, String8* path) {
+    Mutex::Autolock autoLock(mLock);
+
+    if (!loadLocked()) {
+        return false;
+    }
+    ssize_t index = mCASystemIdToLibraryPathMap.indexOfKey(CA_system_id);
+    if (index < 0) {
+        return false;
+    }
+    *path = mCASystemIdToLibraryPathMap.valueAt(index);
+    return true;
+}
+
+bool PluginIndex::enumeratePlugins(std::vector<HidlCasPluginDescriptor>* results) {
+    Mutex::Autolock autoLock(mLock);
+
+    if (!loadLocked()) {
+        results->clear();
+        return false;
+    }
+    *results = mDescriptors;
+    return true;
+}
+
+bool PluginIndex::getLibraryPaths(std::vector<String8>* paths) {
+    Mutex::Autolock autoLock(mLock);
+
+    if (!loadLocked()) {
+        paths->clear();
+        return false;
+    }
+    *paths = mLibraryPaths;
+    return true;
+}
+
+bool PluginIndex::loadLocked() {
+    if (mLoaded) {
+        return true;
+    }
+
+    // Retried on the next use, the directory may become readable later
+    std::vector<Library> libraries;
+    if (!listLibraries(&libraries)) {
+        return false;
+    }
+
+    const std::string fingerprint = base::GetProperty(kFingerprintProperty, "");
+    std::vector<Library> manifest;
+    bool upToDate = readManifest(fingerprint, &manifest) && manifest.size() == libraries.size();
+    size_t queried = 0;
+    for (Library& library : libraries) {
+        mLibraryPaths.push_back(library.path);
+        auto cached = std::find_if(manifest.begin(), manifest.end(), [&](const Library& entry) {
+            return entry.isSameFile(library);
+        });
+        if (cached != manifest.end()) {
+            library.descriptors = cached->descriptors;
+        } else {
+            queryLibrary(&library);
+            queried++;
+            upToDate = false;
+        }
+
+        for (const CasPluginDescriptor& descriptor : library.descriptors) {
+            if (mCASystemIdToLibraryPathMap.indexOfKey(descriptor.CA_system_id) < 0) {
+                mCASystemIdToLibraryPathMap.add(descriptor.CA_system_id, library.path);
+            }
+            mDescriptors.push_back(HidlCasPluginDescriptor{.caSystemId = descriptor.CA_system_id,
+                                                           .name = descriptor.name.c_str()});
+        }
+    }
+    if (!upToDate) {
+        writeManifest(fingerprint, libraries);
+    }
+
+    ALOGI("Indexed %zu plugins in %zu libraries, %zu of them loaded", mDescriptors.size(),
+          libraries.size(), queried);
+    mLoaded = true;
+    return true;
+}
+
+bool PluginIndex::listLibraries(std::vector<Library>* libraries) const {
+    DIR* pDir = opendir(mPluginDir.string());
+
+    if (pDir == NULL) {
+        ALOGE("Failed to open plugin directory %s", mPluginDir.string());
+        return false;
+    }
+
+    struct dirent* pEntry;
+    while ((pEntry = readdir(pDir))) {
+        String8 pluginPath = mPluginDir + "/" + pEntry->d_name;
+        if (pluginPath.getPathExtension() != ".so") {
+            continue;
+        }
+        struct stat st;
+        if (stat(pluginPath.string(), &st) != 0) {
+            ALOGW("Failed to stat %s: %s", pluginPath.string(), strerror(errno));
+            continue;
+        }
+        Library library;
+        library.path = pluginPath;
+        library.inode = st.st_ino;
+        library.size = st.st_size;
+        library.mtimeNs = st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+        libraries->push_back(library);
+    }
+
+    closedir(pDir);
+
+    // Plugins claiming the same CA system id are resolved in the same order on every start.
+    std::sort(libraries->begin(), libraries->end(),
+              [](const Library& a, const Library& b) { return a.path < b.path; });
+    return true;
+}
+
+bool PluginIndex::readManifest(const std::string& fingerprint,
+                               std::vector<Library>* libraries) const {
+    std::string content;
+    if (!base::ReadFileToString(mManifestPath.string(), &content)) {
+        ALOGV("No plugin index at %s", mManifestPath.string());
+        return false;
+    }
+
+    std::vector<std::string> lines = base::Split(content, "\n");
+    if (lines.size() < 2 || lines[0] != kManifestHeader ||
+        lines[1] != "fingerprint\t" + fingerprint) {
+        ALOGV("Plugin index %s is from another build", mManifestPath.string());
+        return false;
+    }
+
+    for (size_t i = 2; i < lines.size(); i++) {
+        if (lines[i].empty()) {
+            continue;
+        }
+        std::vector<std::string> fields = base::Split(lines[i], "\t");
+        bool valid = false;
+        if (fields[0] == "library" && fields.size() == 5) {
+            Library library;
+            uint64_t inode;
+            int64_t size;
+            library.path = fields[1].c_str();
+            valid = base::ParseUint(fields[2], &inode) && base::ParseInt(fields[3], &size) &&
+                    base::ParseInt(fields[4], &library.mtimeNs);
+            library.inode = inode;
+            library.size = size;
+            libraries->push_back(library);
+        } else if (fields[0] == "plugin" && fields.size() == 3 && !libraries->empty()) {
+            CasPluginDescriptor descriptor;
+            valid = base::ParseInt(fields[1], &descriptor.CA_system_id);
+            descriptor.name = fields[2].c_str();
+            libraries->back().descriptors.push_back(descriptor);
+        }
+        if (!valid) {
+            ALOGW("Ignoring malformed plugin index %s", mManifestPath.string());
+            libraries->clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool PluginIndex::writeManifest(const std::string& fingerprint,
+                                const std::vector<Library>& libraries) const {
+    std::string content = base::StringPrintf("%s\nfingerprint\t%s\n", kManifestHeader,
+                                             fingerprint.c_str());
+    for (const Library& library : libraries) {
+        base::StringAppendF(&content, "library\t%s\t%llu\t%lld\t%lld\n", library.path.string(),
+                            static_cast<unsigned long long>(library.inode),
+                            static_cast<long long>(library.size),
+                            static_cast<long long>(library.mtimeNs));
+        for (const CasPluginDescriptor& descriptor : library.descriptors) {
+            if (strpbrk(descriptor.name.string(), "\t\n") != NULL) {
+                ALOGW("Not saving plugin index: %s has an unsupported plugin name",
+                      library.path.string());
+                return false;
+            }
+            base::StringAppendF(&content, "plugin\t%d\t%s\n", descriptor.CA_system_id,
+                                descriptor.name.string());
+        }
+    }
+
+    // Written aside and renamed, so that a service killed meanwhile does not leave half of it.
+    std::string tmpPath = std::string(mManifestPath.string()) + ".tmp";
+    if (!base::WriteStringToFile(content, tmpPath) ||
+        rename(tmpPath.c_str(), mManifestPath.string()) != 0) {
+        ALOGW("Failed to save plugin index to %s: %s", mManifestPath.string(), strerror(errno));
+        unlink(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+void PluginIndex::queryLibrary(Library* library) {
+    ALOGV("Querying plugins of %s", library->path.string());
+
+    sp<SharedLibrary> sharedLibrary = new SharedLibrary(library->path);
+    if (!*sharedLibrary) {
+        ALOGW("Failed to load %s: %s", library->path.string(), sharedLibrary->lastError());
+        return;
+    }
+
+    CreateCasFactoryFunc createFactory =
+            (CreateCasFactoryFunc)sharedLibrary->lookup("createCasFactory");
+    CasFactory* factory;
+    if (createFactory == NULL || (factory = createFactory()) == NULL) {
+        ALOGW("%s has no CasFactory", library->path.string());
+        return;
+    }
+    if (factory->queryPlugins(&library->descriptors) != OK) {
+        ALOGW("Failed to query the plugins of %s", library->path.string());
+        library->descriptors.clear();
+    }
+    delete factory;
+}
+
+}  // namespace implementation
+}  // namespace V1_0
+}  // namespace cas
+}  // namespace hardware
+}  // namespace android
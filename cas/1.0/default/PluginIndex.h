@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HARDWARE_CAS_V1_0_PLUGIN_INDEX_H_
+#define ANDROID_HARDWARE_CAS_V1_0_PLUGIN_INDEX_H_
+
+#include <android/hardware/cas/1.0/types.h>
+#include <media/cas/CasAPI.h>
+#include <sys/types.h>
+#include <utils/KeyedVector.h>
+#include <utils/Mutex.h>
+#include <utils/String8.h>
+
+#include <string>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace cas {
+namespace V1_0 {
+namespace implementation {
+
+/**
+ * Index of the CAS plugin libraries and of the CA system ids each of them supports, as reported
+ * by their CasFactory::queryPlugins(). The libraries are queried the first time the index is
+ * used, and the result is saved to a manifest. Later instances of the service take the
+ * descriptors of unchanged libraries from the manifest, and only load the new or updated ones.
+ */
+class PluginIndex {
+  public:
+    static constexpr const char* kPluginDir = "/vendor/lib/mediacas";
+    static constexpr const char* kManifestPath = "/data/vendor/mediacas/plugin_index";
+
+    explicit PluginIndex(const char* pluginDir = kPluginDir,
+                         const char* manifestPath = kManifestPath);
+
+    // Sets |path| to the library supporting CA_system_id. Does not load any library once the
+    // index is built.
+    bool findLibraryForScheme(int32_t CA_system_id, String8* path);
+
+    // Returns false if the plugin directory cannot be read.
+    bool enumeratePlugins(std::vector<HidlCasPluginDescriptor>* results);
+
+    // Sets |paths| to all the plugin libraries, e.g. to probe them for a scheme none of the
+    // plugins reported. Returns false if the plugin directory cannot be read.
+    bool getLibraryPaths(std::vector<String8>* paths);
+
+  private:
+    struct Library {
+        String8 path;
+        // Identify the version of the library the descriptors were queried from.
+        ino_t inode;
+        off_t size;
+        int64_t mtimeNs;
+        std::vector<CasPluginDescriptor> descriptors;
+
+        bool isSameFile(const Library& other) const {
+            return path == other.path && inode == other.inode && size == other.size &&
+                   mtimeNs == other.mtimeNs;
+        }
+    };
+
+    Mutex mLock;
+    const String8 mPluginDir;
+    const String8 mManifestPath;
+    bool mLoaded;
+    KeyedVector<int32_t, String8> mCASystemIdToLibraryPathMap;
+    std::vector<HidlCasPluginDescriptor> mDescriptors;
+    std::vector<String8> mLibraryPaths;
+
+    bool loadLocked();
+    bool listLibraries(std::vector<Library>* libraries) const;
+    bool readManifest(const std::string& fingerprint, std::vector<Library>* libraries) const;
+    bool writeManifest(const std::string& fingerprint, const std::vector<Library>& libraries) const;
+
+    static void queryLibrary(Library* library);
+};
+
+}  // namespace implementation
+}  // namespace V1_0
+}  // namespace cas
+}  // namespace hardware
+}  // namespace android
+
+#endif  // ANDROID_HARDWARE_CAS_V1_0_PLUGIN_INDEX_H_
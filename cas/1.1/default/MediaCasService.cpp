@@ -61,7 +61,8 @@ class Wrapper : public V1_1::ICasListener {
 };
 
 MediaCasService::MediaCasService()
-    : mCasLoader("createCasFactory"), mDescramblerLoader("createDescramblerFactory") {}
+    : mCasLoader("createCasFactory", &mPluginIndex),
+      mDescramblerLoader("createDescramblerFactory", &mPluginIndex) {}
 
 MediaCasService::~MediaCasService() {}
 
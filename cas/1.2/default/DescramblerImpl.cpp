@@ -17,8 +17,13 @@
 //#define LOG_NDEBUG 0
 #define LOG_TAG "android.hardware.cas@1.1-DescramblerImpl"
 
+#include <fcntl.h>
 #include <hidlmemory/mapping.h>
 #include <inttypes.h>
+#include <linux/kcmp.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
 #include <media/cas/DescramblerAPI.h>
 #include <media/hardware/CryptoAPI.h>
 #include <media/stagefright/foundation/AUtils.h>
@@ -29,7 +34,6 @@
 #include "TypeConvert.h"
 
 namespace android {
-using hidl::memory::V1_0::IMemory;
 
 namespace hardware {
 namespace cas {
@@ -78,6 +82,48 @@ Return<bool> DescramblerImpl::requiresSecureDecoderComponent(const hidl_string&
     return holder->requiresSecureDecoderComponent(String8(mime.c_str()));
 }
 
+// Returns 0 if fd1 and fd2 refer to the same open file, as the fds binder passes for the
+// same heap do, a positive value if they don't, or -1 if the kernel can't tell.
+static int compareFiles(int fd1, int fd2) {
+    pid_t pid = getpid();
+    return syscall(SYS_kcmp, pid, pid, KCMP_FILE, fd1, fd2);
+}
+
+sp<IMemory> DescramblerImpl::mapHeap(const hidl_memory& heap) {
+    const native_handle_t* handle = heap.handle();
+    if (handle == NULL || handle->numFds < 1) {
+        return mapMemory(heap);
+    }
+    int fd = handle->data[0];
+
+    std::lock_guard<std::mutex> lock(mMappedHeapsLock);
+    for (auto it = mMappedHeaps.begin(); it != mMappedHeaps.end(); ++it) {
+        if (it->size == heap.size() && it->name == heap.name() &&
+            compareFiles(it->fd.get(), fd) == 0) {
+            std::rotate(mMappedHeaps.begin(), it, it + 1);
+            return mMappedHeaps.front().memory;
+        }
+    }
+
+    sp<IMemory> memory = mapMemory(heap);
+    base::unique_fd heapFd(fcntl(fd, F_DUPFD_CLOEXEC, 0));
+    // Only keep the mapping if the heap can be recognized in the next calls.
+    if (memory == NULL || heapFd.get() < 0 || compareFiles(heapFd.get(), fd) != 0) {
+        return memory;
+    }
+    if (mMappedHeaps.size() == kMaxMappedHeaps) {
+        mMappedHeaps.pop_back();
+    }
+    mMappedHeaps.insert(mMappedHeaps.begin(),
+                        {std::move(heapFd), heap.name(), heap.size(), memory});
+    return memory;
+}
+
+void DescramblerImpl::clearMappedHeaps() {
+    std::lock_guard<std::mutex> lock(mMappedHeapsLock);
+    mMappedHeaps.clear();
+}
+
 static inline bool validateRangeForSize(uint64_t offset, uint64_t length, uint64_t size) {
     return isInRange<uint64_t, uint64_t>(0, size, offset, length);
 }
@@ -99,7 +145,7 @@ Return<void> DescramblerImpl::descramble(ScramblingControl scramblingControl,
         return Void();
     }
 
-    sp<IMemory> srcMem = mapMemory(srcBuffer.heapBase);
+    sp<IMemory> srcMem = mapHeap(srcBuffer.heapBase);
 
     // Validate if the offset and size in the SharedBuffer is consistent with the
     // mapped ashmem, since the offset and size is controlled by client.
@@ -185,6 +231,7 @@ Return<Status> DescramblerImpl::release() {
 
     std::shared_ptr<DescramblerPlugin> holder(nullptr);
     std::atomic_store(&mPluginHolder, holder);
+    clearMappedHeaps();
 
     return Status::OK;
 }
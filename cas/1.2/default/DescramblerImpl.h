@@ -17,7 +17,12 @@
 #ifndef ANDROID_HARDWARE_CAS_V1_1_DESCRAMBLER_IMPL_H_
 #define ANDROID_HARDWARE_CAS_V1_1_DESCRAMBLER_IMPL_H_
 
+#include <mutex>
+#include <vector>
+
+#include <android-base/unique_fd.h>
 #include <android/hardware/cas/native/1.0/IDescrambler.h>
+#include <android/hidl/memory/1.0/IMemory.h>
 #include <media/stagefright/foundation/ABase.h>
 
 namespace android {
@@ -31,6 +36,7 @@ namespace implementation {
 
 using ::android::hardware::cas::V1_0::HidlCasSessionId;
 using ::android::hardware::cas::V1_0::Status;
+using ::android::hidl::memory::V1_0::IMemory;
 
 class SharedLibrary;
 
@@ -52,9 +58,31 @@ class DescramblerImpl : public IDescrambler {
     virtual Return<Status> release() override;
 
   private:
+    // A source heap mapped by an earlier descramble() call.
+    struct MappedHeap {
+        // Duplicate of the heap fd. Binder passes a new fd for the heap on every call, which is
+        // compared to this one to tell whether it is the same heap.
+        base::unique_fd fd;
+        hidl_string name;
+        uint64_t size;
+        sp<IMemory> memory;
+    };
+
+    // Clients normally send all the data through one heap, a few more are kept in case the
+    // heap is reallocated.
+    static constexpr size_t kMaxMappedHeaps = 4;
+
+    // Returns the mapping of |heap|, reusing the one of an earlier call for the same heap.
+    sp<IMemory> mapHeap(const hidl_memory& heap);
+    void clearMappedHeaps();
+
     sp<SharedLibrary> mLibrary;
     std::shared_ptr<DescramblerPlugin> mPluginHolder;
 
+    std::mutex mMappedHeapsLock;
+    // Most recently used first.
+    std::vector<MappedHeap> mMappedHeaps;
+
     DISALLOW_EVIL_CONSTRUCTORS(DescramblerImpl);
 };
 
@@ -17,11 +17,11 @@
 #ifndef ANDROID_HARDWARE_CAS_V1_1_FACTORY_LOADER_H_
 #define ANDROID_HARDWARE_CAS_V1_1_FACTORY_LOADER_H_
 
-#include <dirent.h>
 #include <dlfcn.h>
 #include <media/cas/CasAPI.h>
 #include <utils/KeyedVector.h>
 #include <utils/Mutex.h>
+#include "PluginIndex.h"
 #include "SharedLibrary.h"
 
 using namespace std;
@@ -37,7 +37,9 @@ using ::android::hardware::cas::V1_0::HidlCasPluginDescriptor;
 template <class T>
 class FactoryLoader {
   public:
-    FactoryLoader(const char* name) : mFactory(NULL), mCreateFactoryFuncName(name) {}
+    // Looks up the factories with |name| in the libraries |pluginIndex| lists.
+    FactoryLoader(const char* name, PluginIndex* pluginIndex)
+        : mFactory(NULL), mCreateFactoryFuncName(name), mPluginIndex(pluginIndex) {}
 
     virtual ~FactoryLoader() { closeFactory(); }
 
@@ -52,15 +54,18 @@ class FactoryLoader {
     Mutex mMapLock;
     T* mFactory;
     const char* mCreateFactoryFuncName;
+    PluginIndex* mPluginIndex;
     sp<SharedLibrary> mLibrary;
+    // Libraries found by probing for the schemes missing from the index, an empty path if none
+    // supports the scheme.
     KeyedVector<int32_t, String8> mCASystemIdToLibraryPathMap;
     KeyedVector<String8, wp<SharedLibrary>> mLibraryPathToOpenLibraryMap;
 
+    bool probeFactoryForScheme(int32_t CA_system_id, sp<SharedLibrary>* library, T** factory);
+
     bool loadFactoryForSchemeFromPath(const String8& path, int32_t CA_system_id,
                                       sp<SharedLibrary>* library, T** factory);
 
-    bool queryPluginsFromPath(const String8& path, vector<HidlCasPluginDescriptor>* results);
-
     bool openFactory(const String8& path);
     void closeFactory();
 };
@@ -77,36 +82,39 @@ bool FactoryLoader<T>::findFactoryForScheme(int32_t CA_system_id, sp<SharedLibra
 
     Mutex::Autolock autoLock(mMapLock);
 
-    // first check cache
+    String8 pluginPath;
+    if (mPluginIndex->findLibraryForScheme(CA_system_id, &pluginPath)) {
+        return loadFactoryForSchemeFromPath(pluginPath, CA_system_id, library, factory);
+    }
+    return probeFactoryForScheme(CA_system_id, library, factory);
+}
+
+template <class T>
+bool FactoryLoader<T>::probeFactoryForScheme(int32_t CA_system_id, sp<SharedLibrary>* library,
+                                             T** factory) {
+    // A factory may support more schemes than its plugins report, ask each library once
     ssize_t index = mCASystemIdToLibraryPathMap.indexOfKey(CA_system_id);
     if (index >= 0) {
-        return loadFactoryForSchemeFromPath(mCASystemIdToLibraryPathMap[index], CA_system_id,
-                                            library, factory);
+        const String8& pluginPath = mCASystemIdToLibraryPathMap.valueAt(index);
+        if (pluginPath.isEmpty()) {
+            ALOGE("Failed to find plugin");
+            return false;
+        }
+        return loadFactoryForSchemeFromPath(pluginPath, CA_system_id, library, factory);
     }
 
-    // no luck, have to search
-    String8 dirPath("/vendor/lib/mediacas");
-    DIR* pDir = opendir(dirPath.string());
-
-    if (pDir == NULL) {
-        ALOGE("Failed to open plugin directory %s", dirPath.string());
+    vector<String8> pluginPaths;
+    if (!mPluginIndex->getLibraryPaths(&pluginPaths)) {
+        ALOGE("Failed to find plugin");
         return false;
     }
-
-    struct dirent* pEntry;
-    while ((pEntry = readdir(pDir))) {
-        String8 pluginPath = dirPath + "/" + pEntry->d_name;
-        if (pluginPath.getPathExtension() == ".so") {
-            if (loadFactoryForSchemeFromPath(pluginPath, CA_system_id, library, factory)) {
-                mCASystemIdToLibraryPathMap.add(CA_system_id, pluginPath);
-                closedir(pDir);
-
-                return true;
-            }
+    for (const String8& pluginPath : pluginPaths) {
+        if (loadFactoryForSchemeFromPath(pluginPath, CA_system_id, library, factory)) {
+            mCASystemIdToLibraryPathMap.add(CA_system_id, pluginPath);
+            return true;
         }
     }
-
-    closedir(pDir);
+    mCASystemIdToLibraryPathMap.add(CA_system_id, String8());
 
     ALOGE("Failed to find plugin");
     return false;
@@ -116,26 +124,7 @@ template <class T>
 bool FactoryLoader<T>::enumeratePlugins(vector<HidlCasPluginDescriptor>* results) {
     ALOGI("enumeratePlugins");
 
-    results->clear();
-
-    String8 dirPath("/vendor/lib/mediacas");
-    DIR* pDir = opendir(dirPath.string());
-
-    if (pDir == NULL) {
-        ALOGE("Failed to open plugin directory %s", dirPath.string());
-        return false;
-    }
-
-    Mutex::Autolock autoLock(mMapLock);
-
-    struct dirent* pEntry;
-    while ((pEntry = readdir(pDir))) {
-        String8 pluginPath = dirPath + "/" + pEntry->d_name;
-        if (pluginPath.getPathExtension() == ".so") {
-            queryPluginsFromPath(pluginPath, results);
-        }
-    }
-    return true;
+    return mPluginIndex->enumeratePlugins(results);
 }
 
 template <class T>
@@ -157,24 +146,6 @@ bool FactoryLoader<T>::loadFactoryForSchemeFromPath(const String8& path, int32_t
     return true;
 }
 
-template <class T>
-bool FactoryLoader<T>::queryPluginsFromPath(const String8& path,
-                                            vector<HidlCasPluginDescriptor>* results) {
-    closeFactory();
-
-    vector<CasPluginDescriptor> descriptors;
-    if (!openFactory(path) || mFactory->queryPlugins(&descriptors) != OK) {
-        closeFactory();
-        return false;
-    }
-
-    for (auto it = descriptors.begin(); it != descriptors.end(); it++) {
-        results->push_back(
-                HidlCasPluginDescriptor{.caSystemId = it->CA_system_id, .name = it->name.c_str()});
-    }
-    return true;
-}
-
 template <class T>
 bool FactoryLoader<T>::openFactory(const String8& path) {
     // get strong pointer to open shared library
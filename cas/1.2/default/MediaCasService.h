@@ -52,6 +52,8 @@ class MediaCasService : public V1_2::IMediaCasService {
     virtual Return<sp<IDescramblerBase>> createDescrambler(int32_t CA_system_id) override;
 
   private:
+    // Shared by the loaders, as the CAS and descrambler factories of a scheme are in one library.
+    PluginIndex mPluginIndex;
     FactoryLoader<CasFactory> mCasLoader;
     FactoryLoader<DescramblerFactory> mDescramblerLoader;
 
@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "DescramblerImplBenchmark"
+
+#include <benchmark/benchmark.h>
+
+#include <cutils/ashmem.h>
+#include <cutils/native_handle.h>
+#include <hidlmemory/mapping.h>
+#include <media/cas/DescramblerAPI.h>
+#include <unistd.h>
+
+#include "../DescramblerImpl.h"
+
+namespace android {
+namespace hardware {
+namespace cas {
+namespace V1_1 {
+namespace implementation {
+namespace {
+
+constexpr size_t kTsPacketSize = 188;
+// Size of the input buffers MediaCodec allocates for a TS stream.
+constexpr size_t kHeapSize = 1024 * 1024;
+
+// Descrambles in place by inverting the encrypted bytes.
+struct MockDescramblerPlugin : public DescramblerPlugin {
+    bool requiresSecureDecoderComponent(const char*) const override { return false; }
+
+    status_t setMediaCasSession(const CasSessionId&) override { return OK; }
+
+    ssize_t descramble(bool, ScramblingControl, size_t numSubSamples,
+                       const SubSample* subSamples, const void* srcPtr, int32_t srcOffset,
+                       void* dstPtr, int32_t dstOffset, AString*) override {
+        const uint8_t* src = static_cast<const uint8_t*>(srcPtr) + srcOffset;
+        uint8_t* dst = static_cast<uint8_t*>(dstPtr) + dstOffset;
+        size_t offset = 0;
+        for (size_t i = 0; i < numSubSamples; i++) {
+            offset += subSamples[i].mNumBytesOfClearData;
+            for (size_t j = 0; j < subSamples[i].mNumBytesOfEncryptedData; j++, offset++) {
+                dst[offset] = ~src[offset];
+            }
+        }
+        return offset;
+    }
+};
+
+// An ashmem heap, sent to the descrambler as binder does: with a new fd on every call.
+class Heap {
+  public:
+    Heap() : mFd(ashmem_create_region("DescramblerImplBenchmark", kHeapSize)) {}
+    ~Heap() { close(mFd); }
+
+    bool valid() const { return mFd >= 0; }
+
+    template <typename F>
+    void send(F func) {
+        native_handle_t* handle = native_handle_create(1 /* numFds */, 0 /* numInts */);
+        handle->data[0] = dup(mFd);
+        func(hidl_memory("ashmem", handle, kHeapSize));
+        native_handle_close(handle);
+        native_handle_delete(handle);
+    }
+
+  private:
+    int mFd;
+};
+
+// One TS packet per subsample: a 4 byte clear header followed by the encrypted payload.
+hidl_vec<SubSample> makeSubSamples(size_t numPackets) {
+    hidl_vec<SubSample> subSamples;
+    subSamples.resize(numPackets);
+    for (auto& subSample : subSamples) {
+        subSample.numBytesOfClearData = 4;
+        subSample.numBytesOfEncryptedData = kTsPacketSize - 4;
+    }
+    return subSamples;
+}
+
+/* DescramblerImpl::descramble() of a stream of 188 x state.range(0) byte chunks. */
+void BM_Descramble(benchmark::State& state) {
+    Heap heap;
+    if (!heap.valid()) {
+        state.SkipWithError("Cannot create heap");
+        return;
+    }
+    sp<DescramblerImpl> descrambler = new DescramblerImpl(nullptr, new MockDescramblerPlugin());
+    const size_t chunkSize = kTsPacketSize * state.range(0);
+    const hidl_vec<SubSample> subSamples = makeSubSamples(state.range(0));
+    DestinationBuffer dstBuffer;
+    dstBuffer.type = BufferType::SHARED_MEMORY;
+
+    size_t offset = 0;
+    for (auto _ : state) {
+        heap.send([&](const hidl_memory& memory) {
+            SharedBuffer srcBuffer = {.heapBase = memory, .offset = offset, .size = chunkSize};
+            descrambler->descramble(ScramblingControl::EVENKEY, subSamples, srcBuffer, 0,
+                                    dstBuffer, 0, [&](Status status, uint32_t, const auto&) {
+                                        if (status != Status::OK) {
+                                            state.SkipWithError("descramble failed");
+                                        }
+                                    });
+        });
+        offset = (offset + chunkSize) % (kHeapSize - kHeapSize % chunkSize);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetBytesProcessed(state.iterations() * chunkSize);
+}
+
+/* The same, mapping the heap on every call as DescramblerImpl used to, for comparison. */
+void BM_DescrambleMappingEveryCall(benchmark::State& state) {
+    Heap heap;
+    if (!heap.valid()) {
+        state.SkipWithError("Cannot create heap");
+        return;
+    }
+    MockDescramblerPlugin plugin;
+    const size_t chunkSize = kTsPacketSize * state.range(0);
+    const hidl_vec<SubSample> subSamples = makeSubSamples(state.range(0));
+
+    size_t offset = 0;
+    for (auto _ : state) {
+        heap.send([&](const hidl_memory& memory) {
+            sp<IMemory> mem = mapMemory(memory);
+            if (mem == nullptr) {
+                state.SkipWithError("mapMemory failed");
+                return;
+            }
+            uint8_t* ptr = static_cast<uint8_t*>(static_cast<void*>(mem->getPointer())) + offset;
+            plugin.descramble(false, DescramblerPlugin::kScrambling_EvenKey, subSamples.size(),
+                              reinterpret_cast<const DescramblerPlugin::SubSample*>(
+                                      subSamples.data()),
+                              ptr, 0, ptr, 0, nullptr);
+        });
+        offset = (offset + chunkSize) % (kHeapSize - kHeapSize % chunkSize);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetBytesProcessed(state.iterations() * chunkSize);
+}
+
+BENCHMARK(BM_Descramble)->Arg(1)->Arg(7)->Arg(64)->Arg(348);
+BENCHMARK(BM_DescrambleMappingEveryCall)->Arg(1)->Arg(7)->Arg(64)->Arg(348);
+
+}  // namespace
+}  // namespace implementation
+}  // namespace V1_1
+}  // namespace cas
+}  // namespace hardware
+}  // namespace android
+
+BENCHMARK_MAIN();
@@ -56,6 +56,7 @@ LOCAL_SRC_FILES := \
 LOCAL_SHARED_LIBRARIES := \
     android.hardware.drm@1.0 \
     android.hidl.memory@1.0 \
+    libbase \
     libcutils \
     libhidlbase \
     libhidlmemory \
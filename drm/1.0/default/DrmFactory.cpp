@@ -28,18 +28,13 @@ namespace V1_0 {
 namespace implementation {
 
     DrmFactory::DrmFactory() :
-        loader(getDrmPluginPath(), "createDrmFactory") {
+        loader(getDrmPluginPath(), "createDrmFactory", getDrmPluginIndexPath()) {
     }
 
     // Methods from ::android::hardware::drm::V1_0::IDrmFactory follow.
     Return<bool> DrmFactory::isCryptoSchemeSupported (
             const hidl_array<uint8_t, 16>& uuid) {
-        for (size_t i = 0; i < loader.factoryCount(); i++) {
-            if (loader.getFactory(i)->isCryptoSchemeSupported(uuid.data())) {
-                return true;
-            }
-        }
-        return false;
+        return loader.getFactoryForScheme(uuid.data()) != NULL;
     }
 
     Return<bool> DrmFactory::isContentTypeSupported (
@@ -55,20 +50,18 @@ namespace implementation {
     Return<void> DrmFactory::createPlugin(const hidl_array<uint8_t, 16>& uuid,
             const hidl_string& /* appPackageName */, createPlugin_cb _hidl_cb) {
 
-        for (size_t i = 0; i < loader.factoryCount(); i++) {
-            if (loader.getFactory(i)->isCryptoSchemeSupported(uuid.data())) {
-                android::DrmPlugin *legacyPlugin = NULL;
-                status_t status = loader.getFactory(i)->createDrmPlugin(
-                        uuid.data(), &legacyPlugin);
-                DrmPlugin *newPlugin = NULL;
-                if (legacyPlugin == NULL) {
-                    ALOGE("Drm legacy HAL: failed to create drm plugin");
-                } else {
-                    newPlugin = new DrmPlugin(legacyPlugin);
-                }
-                _hidl_cb(toStatus(status), newPlugin);
-                return Void();
+        android::DrmFactory *factory = loader.getFactoryForScheme(uuid.data());
+        if (factory) {
+            android::DrmPlugin *legacyPlugin = NULL;
+            status_t status = factory->createDrmPlugin(uuid.data(), &legacyPlugin);
+            DrmPlugin *newPlugin = NULL;
+            if (legacyPlugin == NULL) {
+                ALOGE("Drm legacy HAL: failed to create drm plugin");
+            } else {
+                newPlugin = new DrmPlugin(legacyPlugin);
             }
+            _hidl_cb(toStatus(status), newPlugin);
+            return Void();
         }
         _hidl_cb(Status::ERROR_DRM_CANNOT_HANDLE, NULL);
         return Void();
@@ -38,6 +38,24 @@ const char* getDrmPluginPath() {
 #endif
 }
 
+// Where the schemes supported by each plugin library are saved, see
+// helper::PluginIndex. Both ABIs can run, so each has its own index.
+const char* getDrmPluginIndexPath() {
+#if defined(__LP64__)
+    return "/data/vendor/mediadrm/drm_plugin_index64";
+#else
+    return "/data/vendor/mediadrm/drm_plugin_index";
+#endif
+}
+
+const char* getCryptoPluginIndexPath() {
+#if defined(__LP64__)
+    return "/data/vendor/mediadrm/crypto_plugin_index64";
+#else
+    return "/data/vendor/mediadrm/crypto_plugin_index";
+#endif
+}
+
 }  // namespace implementation
 }  // namespace V1_0
 }  // namespace drm
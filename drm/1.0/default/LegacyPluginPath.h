@@ -25,6 +25,8 @@ namespace V1_0 {
 namespace implementation {
 
 const char* getDrmPluginPath();
+const char* getDrmPluginIndexPath();
+const char* getCryptoPluginIndexPath();
 
 }  // namespace implementation
 }  // namespace V1_0
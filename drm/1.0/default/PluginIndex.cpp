@@ -0,0 +1,235 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "android.hardware.drm@1.0-PluginIndex"
+
+#include "PluginIndex.h"
+
+#include <android-base/file.h>
+#include <android-base/parseint.h>
+#include <android-base/properties.h>
+#include <android-base/stringprintf.h>
+#include <android-base/strings.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utils/Log.h>
+
+#include <algorithm>
+
+namespace android {
+namespace hardware {
+namespace drm {
+namespace V1_0 {
+namespace helper {
+
+namespace {
+
+constexpr char kManifestHeader[] = "drm-plugin-index 1";
+// The libraries of a build image usually all have the same mtime, so a manifest is only trusted
+// on the build it was written on.
+constexpr char kFingerprintProperty[] = "ro.vendor.build.fingerprint";
+
+std::string formatUuid(const PluginIndex::Uuid& uuid) {
+    std::string result;
+    for (uint8_t byte : uuid) {
+        base::StringAppendF(&result, "%02x", byte);
+    }
+    return result;
+}
+
+bool parseUuid(const std::string& hex, PluginIndex::Uuid* uuid) {
+    if (hex.size() != 2 * uuid->size()) {
+        return false;
+    }
+    for (size_t i = 0; i < uuid->size(); i++) {
+        char byte[3] = {hex[2 * i], hex[2 * i + 1], '\0'};
+        if (!isxdigit(byte[0]) || !isxdigit(byte[1])) {
+            return false;
+        }
+        (*uuid)[i] = strtoul(byte, NULL, 16);
+    }
+    return true;
+}
+
+}  // namespace
+
+PluginIndex::PluginIndex(const char* pluginDir, const char* manifestPath)
+    : mPluginDir(pluginDir), mManifestPath(manifestPath != NULL ? manifestPath : "") {}
+
+bool PluginIndex::load() {
+    mLibraries.clear();
+    if (!listLibraries()) {
+        return false;
+    }
+
+    mFingerprint = base::GetProperty(kFingerprintProperty, "");
+    std::vector<Library> manifest;
+    if (readManifest(&manifest)) {
+        for (Library& library : mLibraries) {
+            auto cached = std::find_if(manifest.begin(), manifest.end(), [&](const Library& entry) {
+                return entry.isSameFile(library);
+            });
+            if (cached != manifest.end()) {
+                library.schemes = cached->schemes;
+            }
+        }
+    }
+    return true;
+}
+
+ssize_t PluginIndex::findLibraryForScheme(const Uuid& uuid) const {
+    for (size_t i = 0; i < mLibraries.size(); i++) {
+        const std::vector<Uuid>& schemes = mLibraries[i].schemes;
+        if (std::find(schemes.begin(), schemes.end(), uuid) != schemes.end()) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void PluginIndex::addScheme(size_t index, const Uuid& uuid) {
+    // A library the scheme was recorded for may no longer support it
+    for (Library& library : mLibraries) {
+        library.schemes.erase(std::remove(library.schemes.begin(), library.schemes.end(), uuid),
+                              library.schemes.end());
+    }
+    mLibraries[index].schemes.push_back(uuid);
+    writeManifest();
+}
+
+bool PluginIndex::listLibraries() {
+    DIR* pDir = opendir(mPluginDir.string());
+
+    if (pDir == NULL) {
+        return false;
+    }
+
+    struct dirent* pEntry;
+    while ((pEntry = readdir(pDir))) {
+        String8 file(pEntry->d_name);
+        if (file.getPathExtension() != ".so") {
+            continue;
+        }
+        String8 pluginPath = mPluginDir + "/" + pEntry->d_name;
+        struct stat st;
+        if (stat(pluginPath.string(), &st) != 0) {
+            ALOGW("Failed to stat %s: %s", pluginPath.string(), strerror(errno));
+            continue;
+        }
+        Library library;
+        library.path = pluginPath;
+        library.inode = st.st_ino;
+        library.size = st.st_size;
+        library.mtimeNs = st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+        mLibraries.push_back(library);
+    }
+
+    closedir(pDir);
+
+    // Libraries supporting the same scheme are probed in the same order on every start.
+    std::sort(mLibraries.begin(), mLibraries.end(),
+              [](const Library& a, const Library& b) { return a.path < b.path; });
+    return true;
+}
+
+bool PluginIndex::readManifest(std::vector<Library>* libraries) const {
+    std::string content;
+    if (mManifestPath.empty() || !base::ReadFileToString(mManifestPath, &content)) {
+        ALOGV("No plugin index at %s", mManifestPath.c_str());
+        return false;
+    }
+
+    std::vector<std::string> lines = base::Split(content, "\n");
+    if (lines.size() < 2 || lines[0] != kManifestHeader ||
+        lines[1] != "fingerprint\t" + mFingerprint) {
+        ALOGV("Plugin index %s is from another build", mManifestPath.c_str());
+        return false;
+    }
+
+    for (size_t i = 2; i < lines.size(); i++) {
+        if (lines[i].empty()) {
+            continue;
+        }
+        std::vector<std::string> fields = base::Split(lines[i], "\t");
+        bool valid = false;
+        if (fields[0] == "library" && fields.size() == 5) {
+            Library library;
+            uint64_t inode;
+            int64_t size;
+            library.path = fields[1].c_str();
+            valid = base::ParseUint(fields[2], &inode) && base::ParseInt(fields[3], &size) &&
+                    base::ParseInt(fields[4], &library.mtimeNs);
+            library.inode = inode;
+            library.size = size;
+            libraries->push_back(library);
+        } else if (fields[0] == "scheme" && fields.size() == 2 && !libraries->empty()) {
+            Uuid uuid;
+            valid = parseUuid(fields[1], &uuid);
+            libraries->back().schemes.push_back(uuid);
+        }
+        if (!valid) {
+            ALOGW("Ignoring malformed plugin index %s", mManifestPath.c_str());
+            libraries->clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool PluginIndex::writeManifest() const {
+    if (mManifestPath.empty()) {
+        return false;
+    }
+
+    std::string content = base::StringPrintf("%s\nfingerprint\t%s\n", kManifestHeader,
+                                             mFingerprint.c_str());
+    for (const Library& library : mLibraries) {
+        if (strpbrk(library.path.string(), "\t\n") != NULL) {
+            ALOGW("Not saving plugin index: unsupported library path %s", library.path.string());
+            return false;
+        }
+        base::StringAppendF(&content, "library\t%s\t%llu\t%lld\t%lld\n", library.path.string(),
+                            static_cast<unsigned long long>(library.inode),
+                            static_cast<long long>(library.size),
+                            static_cast<long long>(library.mtimeNs));
+        for (const Uuid& uuid : library.schemes) {
+            base::StringAppendF(&content, "scheme\t%s\n", formatUuid(uuid).c_str());
+        }
+    }
+
+    // Written aside and renamed, so that a service killed meanwhile does not leave half of it.
+    std::string tmpPath = mManifestPath + ".tmp";
+    if (!base::WriteStringToFile(content, tmpPath) ||
+        rename(tmpPath.c_str(), mManifestPath.c_str()) != 0) {
+        ALOGW("Failed to save plugin index to %s: %s", mManifestPath.c_str(), strerror(errno));
+        unlink(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+}
+}
+}
+}
+} // namespace android
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PLUGIN_INDEX_H_
+#define PLUGIN_INDEX_H_
+
+#include <sys/types.h>
+#include <utils/String8.h>
+
+#include <array>
+#include <string>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace drm {
+namespace V1_0 {
+namespace helper {
+
+/**
+ * Index of the DRM plugin libraries and of the crypto schemes each of them supports.
+ *
+ * The plugin factories can't list their schemes, so a library is recorded as supporting a scheme
+ * once its factory answered isCryptoSchemeSupported() for it. The index is saved to a manifest,
+ * and later instances of the service take the schemes of unchanged libraries from it, so that
+ * they only load the library supporting the scheme they are asked for.
+ *
+ * Not thread safe.
+ */
+class PluginIndex {
+  public:
+    typedef std::array<uint8_t, 16> Uuid;
+
+    // |manifestPath| may be NULL to keep the index in memory only.
+    PluginIndex(const char* pluginDir, const char* manifestPath);
+
+    // Lists the libraries of the plugin directory and reads the manifest, without loading any
+    // library. Returns false if the plugin directory cannot be read.
+    bool load();
+
+    size_t libraryCount() const { return mLibraries.size(); }
+    const String8& getLibraryPath(size_t index) const { return mLibraries[index].path; }
+
+    // Returns the index of the library known to support |uuid|, or -1.
+    ssize_t findLibraryForScheme(const Uuid& uuid) const;
+
+    // Records that the library at |index| supports |uuid|, and saves the manifest.
+    void addScheme(size_t index, const Uuid& uuid);
+
+  private:
+    struct Library {
+        String8 path;
+        // Identify the version of the library the schemes were found for.
+        ino_t inode;
+        off_t size;
+        int64_t mtimeNs;
+        std::vector<Uuid> schemes;
+
+        bool isSameFile(const Library& other) const {
+            return path == other.path && inode == other.inode && size == other.size &&
+                   mtimeNs == other.mtimeNs;
+        }
+    };
+
+    const String8 mPluginDir;
+    const std::string mManifestPath;
+    std::string mFingerprint;
+    std::vector<Library> mLibraries;
+
+    bool listLibraries();
+    bool readManifest(std::vector<Library>* libraries) const;
+    bool writeManifest() const;
+};
+
+}
+}
+}
+}
+} // namespace android
+
+#endif // PLUGIN_INDEX_H_
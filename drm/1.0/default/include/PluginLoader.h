@@ -17,11 +17,15 @@
 #ifndef PLUGIN_LOADER_H_
 #define PLUGIN_LOADER_H_
 
+#include "PluginIndex.h"
 #include "SharedLibrary.h"
 #include <utils/Log.h>
+#include <utils/Mutex.h>
 #include <utils/String8.h>
 #include <utils/Vector.h>
 
+#include <algorithm>
+
 namespace android {
 namespace hardware {
 namespace drm {
@@ -32,30 +36,21 @@ template <class T>
 class PluginLoader {
 
   public:
-    PluginLoader(const char *dir, const char *entry) {
+    /**
+     * |indexPath| is where the schemes supported by each library are saved,
+     * NULL to only keep them for the life of the loader.
+     */
+    PluginLoader(const char *dir, const char *entry, const char *indexPath = NULL)
+        : index(dir, indexPath), entry(entry) {
         /**
-         * scan all plugins in the plugin directory and add them to the
-         * factories list.
+         * list all plugins in the plugin directory, they are only loaded
+         * when a factory is needed.
          */
-        String8 pluginDir(dir);
-
-        DIR* pDir = opendir(pluginDir.string());
-        if (pDir == NULL) {
-            ALOGE("Failed to find plugin directory %s", pluginDir.string());
-        } else {
-            struct dirent* pEntry;
-            while ((pEntry = readdir(pDir))) {
-                String8 file(pEntry->d_name);
-                if (file.getPathExtension() == ".so") {
-                    String8 path = pluginDir + "/" + pEntry->d_name;
-                    T *plugin = loadOne(path, entry);
-                    if (plugin) {
-                        factories.push(plugin);
-                    }
-                }
-            }
-            closedir(pDir);
+        if (!index.load()) {
+            ALOGE("Failed to find plugin directory %s", dir);
         }
+        libraryFactories.insertAt(NULL, 0, index.libraryCount());
+        libraryLoaded.insertAt(false, 0, index.libraryCount());
     }
 
     ~PluginLoader() {
@@ -64,16 +59,71 @@ class PluginLoader {
         }
     }
 
+    /**
+     * Returns the factory supporting the crypto scheme |uuid|, or NULL. Only
+     * the library the index has recorded for the scheme is loaded, other
+     * libraries are loaded one by one until one of them supports it.
+     */
+    T *getFactoryForScheme(const uint8_t uuid[16]) {
+        Mutex::Autolock autoLock(lock);
+        PluginIndex::Uuid scheme;
+        std::copy(uuid, uuid + scheme.size(), scheme.begin());
+
+        ssize_t indexed = index.findLibraryForScheme(scheme);
+        if (indexed >= 0) {
+            T *factory = loadLibraryLocked(indexed);
+            if (factory && factory->isCryptoSchemeSupported(uuid)) {
+                return factory;
+            }
+        }
+        for (size_t i = 0; i < index.libraryCount(); i++) {
+            if ((ssize_t)i == indexed) {
+                continue;
+            }
+            T *factory = loadLibraryLocked(i);
+            if (factory && factory->isCryptoSchemeSupported(uuid)) {
+                index.addScheme(i, scheme);
+                return factory;
+            }
+        }
+        return NULL;
+    }
+
+    // Loads all the libraries, to query all the factories.
     T *getFactory(size_t i) const {
+        Mutex::Autolock autoLock(lock);
+        loadAllLocked();
         return factories[i];
     }
 
-    size_t factoryCount() const {return factories.size();}
+    size_t factoryCount() const {
+        Mutex::Autolock autoLock(lock);
+        loadAllLocked();
+        return factories.size();
+    }
 
   private:
-    T* loadOne(const char *path, const char *entry) {
+    void loadAllLocked() const {
+        for (size_t i = 0; i < index.libraryCount(); i++) {
+            loadLibraryLocked(i);
+        }
+    }
+
+    T *loadLibraryLocked(size_t i) const {
+        if (!libraryLoaded[i]) {
+            libraryLoaded.editItemAt(i) = true;
+            T *plugin = loadOne(index.getLibraryPath(i), entry);
+            if (plugin) {
+                factories.push(plugin);
+                libraryFactories.editItemAt(i) = plugin;
+            }
+        }
+        return libraryFactories[i];
+    }
+
+    T* loadOne(const char *path, const char *entry) const {
         sp<SharedLibrary> library = new SharedLibrary(String8(path));
-        if (!library.get()) {
+        if (!*library) {
             ALOGE("Failed to open plugin library %s: %s", path,
                     library->lastError());
         } else {
@@ -93,8 +143,16 @@ class PluginLoader {
         return NULL;
     }
 
-    Vector<T *> factories;
-    Vector<sp<SharedLibrary> > libraries;
+    // Only modified by getFactoryForScheme(), under the lock.
+    PluginIndex index;
+    const String8 entry;
+
+    mutable Mutex lock;
+    // The libraries are loaded lazily, so the const getters load them too.
+    mutable Vector<T *> factories;
+    mutable Vector<T *> libraryFactories;
+    mutable Vector<bool> libraryLoaded;
+    mutable Vector<sp<SharedLibrary> > libraries;
 
     PluginLoader(const PluginLoader &) = delete;
     void operator=(const PluginLoader &) = delete;
@@ -65,7 +65,7 @@ V2_0::GnssLocation getMockLocationV2_0() {
 
 }  // namespace
 
-Gnss::Gnss() : mMinIntervalMs(1000) {}
+Gnss::Gnss() : mMinIntervalMs(1000), mGnssBatching(new GnssBatching(getMockLocationV2_0)) {}
 
 Gnss::~Gnss() {
     stop();
@@ -175,8 +175,7 @@ Return<sp<V1_0::IGnssDebug>> Gnss::getExtensionGnssDebug() {
 }
 
 Return<sp<V1_0::IGnssBatching>> Gnss::getExtensionGnssBatching() {
-    // TODO(b/124012850): Implement function.
-    return sp<V1_0::IGnssBatching>{};
+    return mGnssBatching;
 }
 
 // Methods from V1_1::IGnss follow.
@@ -267,7 +266,7 @@ Return<sp<visibility_control::V1_0::IGnssVisibilityControl>> Gnss::getExtensionV
 }
 
 Return<sp<V2_0::IGnssBatching>> Gnss::getExtensionGnssBatching_2_0() {
-    return new GnssBatching();
+    return mGnssBatching;
 }
 
 Return<bool> Gnss::setCallback_2_0(const sp<V2_0::IGnssCallback>& callback) {
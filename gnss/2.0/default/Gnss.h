@@ -24,6 +24,8 @@
 #include <mutex>
 #include <thread>
 
+#include "GnssBatching.h"
+
 namespace android {
 namespace hardware {
 namespace gnss {
@@ -103,6 +105,8 @@ struct Gnss : public IGnss {
     std::atomic<bool> mIsActive;
     std::thread mThread;
     mutable std::mutex mMutex;
+    // Shared by the 1.0 and 2.0 batching extensions, which batch the same locations.
+    const sp<GnssBatching> mGnssBatching;
 };
 
 }  // namespace implementation
@@ -18,51 +18,194 @@
 
 #include "GnssBatching.h"
 
+#include <inttypes.h>
+#include <log/log.h>
+#include <algorithm>
+#include <chrono>
+
 namespace android {
 namespace hardware {
 namespace gnss {
 namespace V2_0 {
 namespace implementation {
 
+using BatchingFlag = V1_0::IGnssBatching::Flag;
+
+namespace {
+
+constexpr uint16_t kBatchSize = 1024;
+// Shortest interval at which the location source is sampled, whatever the requested period.
+constexpr int64_t kMinSamplingPeriodNanos = 100000000;
+constexpr int64_t kNanosPerMilli = 1000000;
+
+int64_t getLocationNanos(const V2_0::GnssLocation& location) {
+    if (location.elapsedRealtime.flags & ElapsedRealtimeFlags::HAS_TIMESTAMP_NS) {
+        return static_cast<int64_t>(location.elapsedRealtime.timestampNs);
+    }
+    return location.v1_0.timestamp * kNanosPerMilli;
+}
+
+}  // namespace
+
 sp<V2_0::IGnssBatchingCallback> GnssBatching::sCallback = nullptr;
+sp<V1_0::IGnssBatchingCallback> GnssBatching::sCallback_1_0 = nullptr;
+
+GnssBatching::GnssBatching(LocationSource locationSource)
+    : mLocationSource(std::move(locationSource)),
+      mBatch(kBatchSize),
+      mPeriodNanos(0),
+      mWakeupOnFifoFull(false),
+      mIsActive(false),
+      mHasLastLocation(false),
+      mLastLocationNanos(0) {}
+
+GnssBatching::~GnssBatching() {
+    std::unique_lock<std::mutex> lock(mControlMutex);
+    stopThread();
+}
 
 // Methods from ::android::hardware::gnss::V1_0::IGnssBatching follow.
-Return<bool> GnssBatching::init(const sp<V1_0::IGnssBatchingCallback>&) {
-    // TODO implement
-    return bool{};
+Return<bool> GnssBatching::init(const sp<V1_0::IGnssBatchingCallback>& callback) {
+    std::unique_lock<std::mutex> lock(mMutex);
+    sCallback_1_0 = callback;
+    sCallback = nullptr;
+    return true;
 }
 
 Return<uint16_t> GnssBatching::getBatchSize() {
-    // TODO implement
-    return uint16_t{};
+    return static_cast<uint16_t>(mBatch.capacity());
 }
 
-Return<bool> GnssBatching::start(const V1_0::IGnssBatching::Options&) {
-    // TODO implement
-    return bool{};
+Return<bool> GnssBatching::start(const V1_0::IGnssBatching::Options& options) {
+    ALOGD("start");
+    if (options.periodNanos < 0) {
+        ALOGE("%s: Invalid period %" PRId64 "ns", __func__, options.periodNanos);
+        return false;
+    }
+
+    std::unique_lock<std::mutex> controlLock(mControlMutex);
+    stopThread();
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mPeriodNanos = options.periodNanos;
+        mWakeupOnFifoFull = (options.flags & BatchingFlag::WAKEUP_ON_FIFO_FULL) != 0;
+        mHasLastLocation = false;
+        mIsActive = true;
+    }
+
+    const std::chrono::nanoseconds samplingPeriod(
+            std::max(options.periodNanos, kMinSamplingPeriodNanos));
+    mThread = std::thread([this, samplingPeriod]() {
+        std::unique_lock<std::mutex> lock(mMutex);
+        while (!mCondition.wait_for(lock, samplingPeriod, [this]() { return !mIsActive; })) {
+            lock.unlock();
+            reportLocation(mLocationSource());
+            lock.lock();
+        }
+    });
+    return true;
 }
 
 Return<void> GnssBatching::flush() {
-    // TODO implement
+    hidl_vec<V2_0::GnssLocation> locations;
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        locations = mBatch.drain();
+    }
+    // The callback is invoked even if there are no locations.
+    deliverBatch(locations);
     return Void();
 }
 
 Return<bool> GnssBatching::stop() {
-    // TODO implement
-    return bool{};
+    ALOGD("stop");
+    std::unique_lock<std::mutex> controlLock(mControlMutex);
+    stopThread();
+    return true;
 }
 
 Return<void> GnssBatching::cleanup() {
-    // TODO implement
+    ALOGD("cleanup");
+    std::unique_lock<std::mutex> controlLock(mControlMutex);
+    stopThread();
+    std::unique_lock<std::mutex> lock(mMutex);
+    mBatch.clear();
+    sCallback = nullptr;
+    sCallback_1_0 = nullptr;
     return Void();
 }
 
 // Methods from V2_0::IGnssBatching follow.
 Return<bool> GnssBatching::init_2_0(const sp<V2_0::IGnssBatchingCallback>& callback) {
+    std::unique_lock<std::mutex> lock(mMutex);
     sCallback = callback;
+    sCallback_1_0 = nullptr;
     return true;
 }
 
+void GnssBatching::reportLocation(const V2_0::GnssLocation& location) {
+    hidl_vec<V2_0::GnssLocation> locations;
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        if (!mIsActive) {
+            return;
+        }
+        const int64_t locationNanos = getLocationNanos(location);
+        if (mHasLastLocation && locationNanos - mLastLocationNanos < mPeriodNanos) {
+            return;
+        }
+        mHasLastLocation = true;
+        mLastLocationNanos = locationNanos;
+
+        mBatch.push(location);
+        if (!mWakeupOnFifoFull || !mBatch.full()) {
+            return;
+        }
+        locations = mBatch.drain();
+    }
+    deliverBatch(locations);
+}
+
+void GnssBatching::stopThread() {
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mIsActive = false;
+    }
+    mCondition.notify_all();
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+}
+
+void GnssBatching::deliverBatch(const hidl_vec<V2_0::GnssLocation>& locations) {
+    sp<V2_0::IGnssBatchingCallback> callback;
+    sp<V1_0::IGnssBatchingCallback> callback_1_0;
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        callback = sCallback;
+        callback_1_0 = sCallback_1_0;
+    }
+
+    if (callback != nullptr) {
+        auto ret = callback->gnssLocationBatchCb(locations);
+        if (!ret.isOk()) {
+            ALOGE("%s: Unable to invoke callback", __func__);
+        }
+    } else if (callback_1_0 != nullptr) {
+        hidl_vec<V1_0::GnssLocation> locations_1_0;
+        locations_1_0.resize(locations.size());
+        for (size_t i = 0; i < locations.size(); i++) {
+            locations_1_0[i] = locations[i].v1_0;
+        }
+        auto ret = callback_1_0->gnssLocationBatchCb(locations_1_0);
+        if (!ret.isOk()) {
+            ALOGE("%s: Unable to invoke callback", __func__);
+        }
+    } else {
+        ALOGE("%s: sCallback is null.", __func__);
+    }
+}
+
 }  // namespace implementation
 }  // namespace V2_0
 }  // namespace gnss
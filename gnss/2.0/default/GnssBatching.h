@@ -19,6 +19,12 @@
 #include <android/hardware/gnss/2.0/IGnssBatching.h>
 #include <hidl/MQDescriptor.h>
 #include <hidl/Status.h>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "LocationBatch.h"
 
 namespace android {
 namespace hardware {
@@ -35,6 +41,12 @@ using ::android::hardware::Return;
 using ::android::hardware::Void;
 
 struct GnssBatching : public IGnssBatching {
+    using LocationSource = std::function<V2_0::GnssLocation()>;
+
+    // Locations are sampled from |locationSource| while batching is active.
+    explicit GnssBatching(LocationSource locationSource);
+    ~GnssBatching();
+
     // Methods from ::android::hardware::gnss::V1_0::IGnssBatching follow.
     Return<bool> init(const sp<V1_0::IGnssBatchingCallback>& callback) override;
     Return<uint16_t> getBatchSize() override;
@@ -46,8 +58,30 @@ struct GnssBatching : public IGnssBatching {
     // Methods from V2_0::IGnssBatching follow.
     Return<bool> init_2_0(const sp<V2_0::IGnssBatchingCallback>& callback) override;
 
+    // Stores |location| if batching is active and at least Options.periodNanos has passed since
+    // the last stored location. The batch is delivered once full if WAKEUP_ON_FIFO_FULL is set,
+    // otherwise the oldest location is dropped.
+    void reportLocation(const V2_0::GnssLocation& location);
+
   private:
+    void stopThread();
+    void deliverBatch(const hidl_vec<V2_0::GnssLocation>& locations);
+
     static sp<IGnssBatchingCallback> sCallback;
+    static sp<V1_0::IGnssBatchingCallback> sCallback_1_0;
+    const LocationSource mLocationSource;
+    LocationBatch mBatch;
+    int64_t mPeriodNanos;
+    bool mWakeupOnFifoFull;
+    bool mIsActive;
+    bool mHasLastLocation;
+    int64_t mLastLocationNanos;
+    std::thread mThread;
+    std::condition_variable mCondition;
+    // Guards the batch, the options and the callbacks.
+    mutable std::mutex mMutex;
+    // Serializes starting and stopping the sampling thread.
+    std::mutex mControlMutex;
 };
 
 }  // namespace implementation
@@ -0,0 +1,191 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "LocationBatch"
+
+#include "LocationBatch.h"
+
+#include <log/log.h>
+#include <cmath>
+#include <limits>
+
+namespace android {
+namespace hardware {
+namespace gnss {
+namespace V2_0 {
+namespace implementation {
+
+namespace {
+
+constexpr double kDegreesToE7 = 1e7;
+constexpr int64_t kFullCircleE7 = 3600000000;
+constexpr int64_t kHalfCircleE7 = kFullCircleE7 / 2;
+constexpr int64_t kNanosPerMilli = 1000000;
+
+template <typename T>
+T clampToRange(double value) {
+    if (std::isnan(value)) {
+        return 0;
+    }
+    value = std::round(value);
+    if (value <= std::numeric_limits<T>::min()) {
+        return std::numeric_limits<T>::min();
+    }
+    if (value >= std::numeric_limits<T>::max()) {
+        return std::numeric_limits<T>::max();
+    }
+    return static_cast<T>(value);
+}
+
+bool fitsInt32(int64_t value) {
+    return value >= std::numeric_limits<int32_t>::min() &&
+           value <= std::numeric_limits<int32_t>::max();
+}
+
+// Wraps a longitude, or a difference of longitudes, into [-180, 180) degrees.
+int64_t wrapLongitudeE7(int64_t longitudeE7) {
+    longitudeE7 %= kFullCircleE7;
+    if (longitudeE7 >= kHalfCircleE7) {
+        longitudeE7 -= kFullCircleE7;
+    } else if (longitudeE7 < -kHalfCircleE7) {
+        longitudeE7 += kFullCircleE7;
+    }
+    return longitudeE7;
+}
+
+}  // namespace
+
+LocationBatch::LocationBatch(size_t capacity)
+    : mFixes(capacity), mHead(0), mSize(0), mOldest(), mNewest() {}
+
+void LocationBatch::push(const V2_0::GnssLocation& location) {
+    if (mFixes.empty()) {
+        return;
+    }
+    EncodedFix fix;
+    if (mSize > 0 && !encode(location, &fix)) {
+        ALOGW("Dropping %zu batched locations too far apart in time from the new one", mSize);
+        clear();
+    }
+    if (mSize == 0) {
+        mNewest = anchorOf(location);
+        encode(location, &fix);
+    }
+
+    if (full()) {
+        mHead = (mHead + 1) % mFixes.size();
+        mSize--;
+        if (mSize > 0) {
+            mOldest = advance(mOldest, mFixes[mHead]);
+        }
+    }
+    mNewest = advance(mNewest, fix);
+    if (mSize == 0) {
+        mOldest = mNewest;
+    }
+    mFixes[(mHead + mSize) % mFixes.size()] = fix;
+    mSize++;
+}
+
+hidl_vec<V2_0::GnssLocation> LocationBatch::drain() {
+    hidl_vec<V2_0::GnssLocation> locations;
+    locations.resize(mSize);
+    Anchor anchor = mOldest;
+    for (size_t i = 0; i < mSize; i++) {
+        const EncodedFix& fix = mFixes[(mHead + i) % mFixes.size()];
+        if (i > 0) {
+            anchor = advance(anchor, fix);
+        }
+        locations[i] = decode(anchor, fix);
+    }
+    clear();
+    return locations;
+}
+
+void LocationBatch::clear() {
+    mHead = 0;
+    mSize = 0;
+}
+
+LocationBatch::Anchor LocationBatch::anchorOf(const V2_0::GnssLocation& location) {
+    return {.latitudeE7 = std::llround(location.v1_0.latitudeDegrees * kDegreesToE7),
+            .longitudeE7 =
+                    wrapLongitudeE7(std::llround(location.v1_0.longitudeDegrees * kDegreesToE7)),
+            .timestampMs = location.v1_0.timestamp,
+            .elapsedRealtimeMs =
+                    static_cast<int64_t>(location.elapsedRealtime.timestampNs / kNanosPerMilli)};
+}
+
+LocationBatch::Anchor LocationBatch::advance(const Anchor& anchor, const EncodedFix& fix) {
+    return {.latitudeE7 = anchor.latitudeE7 + fix.latitudeE7Delta,
+            .longitudeE7 = wrapLongitudeE7(anchor.longitudeE7 + fix.longitudeE7Delta),
+            .timestampMs = anchor.timestampMs + fix.timestampMsDelta,
+            .elapsedRealtimeMs = anchor.elapsedRealtimeMs + fix.elapsedRealtimeMsDelta};
+}
+
+bool LocationBatch::encode(const V2_0::GnssLocation& location, EncodedFix* fix) const {
+    const Anchor anchor = anchorOf(location);
+    const int64_t timestampMsDelta = anchor.timestampMs - mNewest.timestampMs;
+    const int64_t elapsedRealtimeMsDelta = anchor.elapsedRealtimeMs - mNewest.elapsedRealtimeMs;
+    if (!fitsInt32(timestampMsDelta) || !fitsInt32(elapsedRealtimeMsDelta)) {
+        return false;
+    }
+
+    const V1_0::GnssLocation& v1_0 = location.v1_0;
+    fix->latitudeE7Delta = static_cast<int32_t>(anchor.latitudeE7 - mNewest.latitudeE7);
+    fix->longitudeE7Delta =
+            static_cast<int32_t>(wrapLongitudeE7(anchor.longitudeE7 - mNewest.longitudeE7));
+    fix->altitudeCm = clampToRange<int32_t>(v1_0.altitudeMeters * 100);
+    fix->timestampMsDelta = static_cast<int32_t>(timestampMsDelta);
+    fix->elapsedRealtimeMsDelta = static_cast<int32_t>(elapsedRealtimeMsDelta);
+    fix->timeUncertaintyNs = clampToRange<uint32_t>(location.elapsedRealtime.timeUncertaintyNs);
+    fix->speedCmPerSec = clampToRange<uint16_t>(v1_0.speedMetersPerSec * 100);
+    fix->bearingCentiDegrees = clampToRange<uint16_t>(v1_0.bearingDegrees * 100);
+    fix->horizontalAccuracyCm = clampToRange<uint16_t>(v1_0.horizontalAccuracyMeters * 100);
+    fix->verticalAccuracyCm = clampToRange<uint16_t>(v1_0.verticalAccuracyMeters * 100);
+    fix->speedAccuracyCmPerSec = clampToRange<uint16_t>(v1_0.speedAccuracyMetersPerSecond * 100);
+    fix->bearingAccuracyCentiDegrees = clampToRange<uint16_t>(v1_0.bearingAccuracyDegrees * 100);
+    fix->gnssLocationFlags = v1_0.gnssLocationFlags;
+    fix->elapsedRealtimeFlags = location.elapsedRealtime.flags;
+    return true;
+}
+
+V2_0::GnssLocation LocationBatch::decode(const Anchor& anchor, const EncodedFix& fix) {
+    V2_0::GnssLocation location;
+    V1_0::GnssLocation& v1_0 = location.v1_0;
+    v1_0.gnssLocationFlags = fix.gnssLocationFlags;
+    v1_0.latitudeDegrees = anchor.latitudeE7 / kDegreesToE7;
+    v1_0.longitudeDegrees = anchor.longitudeE7 / kDegreesToE7;
+    v1_0.altitudeMeters = fix.altitudeCm / 100.0;
+    v1_0.speedMetersPerSec = fix.speedCmPerSec / 100.0f;
+    v1_0.bearingDegrees = fix.bearingCentiDegrees / 100.0f;
+    v1_0.horizontalAccuracyMeters = fix.horizontalAccuracyCm / 100.0f;
+    v1_0.verticalAccuracyMeters = fix.verticalAccuracyCm / 100.0f;
+    v1_0.speedAccuracyMetersPerSecond = fix.speedAccuracyCmPerSec / 100.0f;
+    v1_0.bearingAccuracyDegrees = fix.bearingAccuracyCentiDegrees / 100.0f;
+    v1_0.timestamp = anchor.timestampMs;
+    location.elapsedRealtime.flags = fix.elapsedRealtimeFlags;
+    location.elapsedRealtime.timestampNs =
+            static_cast<uint64_t>(anchor.elapsedRealtimeMs) * kNanosPerMilli;
+    location.elapsedRealtime.timeUncertaintyNs = fix.timeUncertaintyNs;
+    return location;
+}
+
+}  // namespace implementation
+}  // namespace V2_0
+}  // namespace gnss
+}  // namespace hardware
+}  // namespace android
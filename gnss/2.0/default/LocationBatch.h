@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android/hardware/gnss/2.0/types.h>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace gnss {
+namespace V2_0 {
+namespace implementation {
+
+using ::android::hardware::hidl_vec;
+
+/**
+ * Fixed-size ring of batched locations. Each location is stored in fixed point relative to the
+ * previous one, using less than half the memory of a V2_0::GnssLocation: latitude and longitude
+ * to 1e-7 degrees, altitude to 1 cm, both timestamps to 1 ms, and the speed, bearing and accuracy
+ * fields to 1 cm, 1 cm/s or 0.01 degrees.
+ */
+class LocationBatch {
+  public:
+    explicit LocationBatch(size_t capacity);
+
+    size_t capacity() const { return mFixes.size(); }
+    size_t size() const { return mSize; }
+    bool full() const { return mSize == mFixes.size(); }
+
+    // Returns the memory used by the stored locations, whether or not the ring is full.
+    size_t memoryUsageBytes() const { return sizeof(*this) + mFixes.size() * sizeof(EncodedFix); }
+
+    // Appends |location|, dropping the oldest location if the ring is full.
+    void push(const V2_0::GnssLocation& location);
+
+    // Returns the stored locations, oldest first, and empties the ring.
+    hidl_vec<V2_0::GnssLocation> drain();
+
+    void clear();
+
+  private:
+    struct EncodedFix {
+        int32_t latitudeE7Delta;
+        int32_t longitudeE7Delta;
+        int32_t altitudeCm;
+        int32_t timestampMsDelta;
+        int32_t elapsedRealtimeMsDelta;
+        uint32_t timeUncertaintyNs;
+        uint16_t speedCmPerSec;
+        uint16_t bearingCentiDegrees;
+        uint16_t horizontalAccuracyCm;
+        uint16_t verticalAccuracyCm;
+        uint16_t speedAccuracyCmPerSec;
+        uint16_t bearingAccuracyCentiDegrees;
+        uint16_t gnssLocationFlags;
+        uint16_t elapsedRealtimeFlags;
+    };
+
+    // Absolute position and timestamps of a stored location.
+    struct Anchor {
+        int64_t latitudeE7;
+        int64_t longitudeE7;
+        int64_t timestampMs;
+        int64_t elapsedRealtimeMs;
+    };
+
+    static Anchor anchorOf(const V2_0::GnssLocation& location);
+    static Anchor advance(const Anchor& anchor, const EncodedFix& fix);
+    // Returns false if the timestamps of |location| are too far from those of mNewest.
+    bool encode(const V2_0::GnssLocation& location, EncodedFix* fix) const;
+    static V2_0::GnssLocation decode(const Anchor& anchor, const EncodedFix& fix);
+
+    std::vector<EncodedFix> mFixes;
+    // Index of the oldest location.
+    size_t mHead;
+    size_t mSize;
+    Anchor mOldest;
+    Anchor mNewest;
+};
+
+}  // namespace implementation
+}  // namespace V2_0
+}  // namespace gnss
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,261 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "GnssBatching.h"
+#include "LocationBatch.h"
+
+namespace android {
+namespace hardware {
+namespace gnss {
+namespace V2_0 {
+namespace implementation {
+
+namespace {
+
+using BatchingFlag = V1_0::IGnssBatching::Flag;
+
+constexpr size_t kNumLocations = 10000;
+// Long enough for the sampling thread never to run during a test.
+constexpr int64_t kPeriodNanos = 3600LL * 1000 * 1000 * 1000;
+
+V2_0::GnssLocation makeLocation(size_t index, int64_t intervalNanos = kPeriodNanos) {
+    V2_0::GnssLocation location;
+    location.v1_0.gnssLocationFlags = 0xFF;
+    location.v1_0.latitudeDegrees = 37.4219999 + index * 1e-5;
+    location.v1_0.longitudeDegrees = -122.0840575 - index * 1e-5;
+    location.v1_0.altitudeMeters = 1.60062531;
+    location.v1_0.speedMetersPerSec = 1.5;
+    location.v1_0.bearingDegrees = 359.99;
+    location.v1_0.horizontalAccuracyMeters = 5;
+    location.v1_0.verticalAccuracyMeters = 5;
+    location.v1_0.speedAccuracyMetersPerSecond = 1;
+    location.v1_0.bearingAccuracyDegrees = 90;
+    location.v1_0.timestamp = 1519930775453 + index * (intervalNanos / 1000000);
+    location.elapsedRealtime.flags =
+            ElapsedRealtimeFlags::HAS_TIMESTAMP_NS | ElapsedRealtimeFlags::HAS_TIME_UNCERTAINTY_NS;
+    location.elapsedRealtime.timestampNs = 1000000000 + index * intervalNanos;
+    location.elapsedRealtime.timeUncertaintyNs = 1000000;
+    return location;
+}
+
+struct BatchingCallback : public V2_0::IGnssBatchingCallback {
+    Return<void> gnssLocationBatchCb(const hidl_vec<V2_0::GnssLocation>& batch) override {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mBatchSizes.push_back(batch.size());
+        mLocations.insert(mLocations.end(), batch.begin(), batch.end());
+        return Void();
+    }
+
+    std::mutex mMutex;
+    std::vector<size_t> mBatchSizes;
+    std::vector<V2_0::GnssLocation> mLocations;
+};
+
+class GnssBatchingTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        mCallback = new BatchingCallback();
+        mBatching = new GnssBatching([]() { return makeLocation(0); });
+        ASSERT_TRUE(mBatching->init_2_0(mCallback));
+        mBatchSize = mBatching->getBatchSize();
+        ASSERT_GT(mBatchSize, 0u);
+    }
+
+    void TearDown() override { mBatching->cleanup(); }
+
+    void start(int64_t periodNanos, bool wakeupOnFifoFull) {
+        V1_0::IGnssBatching::Options options = {
+                .periodNanos = periodNanos,
+                .flags = wakeupOnFifoFull
+                                 ? static_cast<uint8_t>(BatchingFlag::WAKEUP_ON_FIFO_FULL)
+                                 : uint8_t{0}};
+        ASSERT_TRUE(mBatching->start(options));
+    }
+
+    sp<BatchingCallback> mCallback;
+    sp<GnssBatching> mBatching;
+    size_t mBatchSize;
+};
+
+void expectNear(const V2_0::GnssLocation& expected, const V2_0::GnssLocation& actual) {
+    EXPECT_EQ(expected.v1_0.gnssLocationFlags, actual.v1_0.gnssLocationFlags);
+    EXPECT_NEAR(expected.v1_0.latitudeDegrees, actual.v1_0.latitudeDegrees, 1e-7);
+    EXPECT_NEAR(expected.v1_0.longitudeDegrees, actual.v1_0.longitudeDegrees, 1e-7);
+    EXPECT_NEAR(expected.v1_0.altitudeMeters, actual.v1_0.altitudeMeters, 0.01);
+    EXPECT_NEAR(expected.v1_0.speedMetersPerSec, actual.v1_0.speedMetersPerSec, 0.01);
+    EXPECT_NEAR(expected.v1_0.bearingDegrees, actual.v1_0.bearingDegrees, 0.01);
+    EXPECT_NEAR(expected.v1_0.horizontalAccuracyMeters, actual.v1_0.horizontalAccuracyMeters,
+                0.01);
+    EXPECT_NEAR(expected.v1_0.verticalAccuracyMeters, actual.v1_0.verticalAccuracyMeters, 0.01);
+    EXPECT_NEAR(expected.v1_0.speedAccuracyMetersPerSecond,
+                actual.v1_0.speedAccuracyMetersPerSecond, 0.01);
+    EXPECT_NEAR(expected.v1_0.bearingAccuracyDegrees, actual.v1_0.bearingAccuracyDegrees, 0.01);
+    EXPECT_EQ(expected.v1_0.timestamp, actual.v1_0.timestamp);
+    EXPECT_EQ(expected.elapsedRealtime.flags, actual.elapsedRealtime.flags);
+    EXPECT_EQ(expected.elapsedRealtime.timestampNs / 1000000,
+              actual.elapsedRealtime.timestampNs / 1000000);
+    EXPECT_EQ(expected.elapsedRealtime.timeUncertaintyNs,
+              actual.elapsedRealtime.timeUncertaintyNs);
+}
+
+}  // namespace
+
+TEST(LocationBatchTest, StoresLocationsCompactly) {
+    LocationBatch batch(kNumLocations);
+    for (size_t i = 0; i < kNumLocations; i++) {
+        batch.push(makeLocation(i));
+    }
+    ASSERT_TRUE(batch.full());
+
+    const size_t uncompressedBytes = kNumLocations * sizeof(V2_0::GnssLocation);
+    ::testing::Test::RecordProperty("bytes_per_10k_locations", batch.memoryUsageBytes());
+    ::testing::Test::RecordProperty("uncompressed_bytes_per_10k_locations", uncompressedBytes);
+    EXPECT_LT(batch.memoryUsageBytes() * 2, uncompressedBytes);
+
+    const auto locations = batch.drain();
+    ASSERT_EQ(kNumLocations, locations.size());
+    for (size_t i = 0; i < kNumLocations; i++) {
+        expectNear(makeLocation(i), locations[i]);
+    }
+    EXPECT_EQ(0u, batch.size());
+}
+
+TEST(LocationBatchTest, DropsOldestLocationsWhenFull) {
+    LocationBatch batch(10);
+    for (size_t i = 0; i < 25; i++) {
+        batch.push(makeLocation(i));
+    }
+    const auto locations = batch.drain();
+    ASSERT_EQ(10u, locations.size());
+    for (size_t i = 0; i < locations.size(); i++) {
+        expectNear(makeLocation(15 + i), locations[i]);
+    }
+}
+
+TEST(LocationBatchTest, WrapsAroundTheAntimeridian) {
+    LocationBatch batch(2);
+    V2_0::GnssLocation east = makeLocation(0);
+    east.v1_0.longitudeDegrees = 179.9999999;
+    V2_0::GnssLocation west = makeLocation(1);
+    west.v1_0.longitudeDegrees = -179.9999999;
+    batch.push(east);
+    batch.push(west);
+
+    const auto locations = batch.drain();
+    ASSERT_EQ(2u, locations.size());
+    expectNear(east, locations[0]);
+    expectNear(west, locations[1]);
+}
+
+TEST(LocationBatchTest, ClearsBatchOnTimeJump) {
+    LocationBatch batch(4);
+    batch.push(makeLocation(0));
+    batch.push(makeLocation(1));
+    // More than 24 days after the previous location.
+    batch.push(makeLocation(1000));
+
+    const auto locations = batch.drain();
+    ASSERT_EQ(1u, locations.size());
+    expectNear(makeLocation(1000), locations[0]);
+}
+
+TEST_F(GnssBatchingTest, DeliversWholeBatchesWhenFull) {
+    start(kPeriodNanos, true /* wakeupOnFifoFull */);
+    for (size_t i = 0; i < kNumLocations; i++) {
+        mBatching->reportLocation(makeLocation(i));
+    }
+    EXPECT_EQ(kNumLocations / mBatchSize, mCallback->mBatchSizes.size());
+    for (size_t batchSize : mCallback->mBatchSizes) {
+        EXPECT_EQ(mBatchSize, batchSize);
+    }
+
+    mBatching->flush();
+    ::testing::Test::RecordProperty("callbacks_per_10k_locations", mCallback->mBatchSizes.size());
+    EXPECT_EQ((kNumLocations + mBatchSize - 1) / mBatchSize, mCallback->mBatchSizes.size());
+    ASSERT_EQ(kNumLocations, mCallback->mLocations.size());
+    for (size_t i = 0; i < kNumLocations; i++) {
+        expectNear(makeLocation(i), mCallback->mLocations[i]);
+    }
+}
+
+TEST_F(GnssBatchingTest, DropsOldestLocationsWithoutWakeup) {
+    start(kPeriodNanos, false /* wakeupOnFifoFull */);
+    for (size_t i = 0; i < kNumLocations; i++) {
+        mBatching->reportLocation(makeLocation(i));
+    }
+    EXPECT_TRUE(mCallback->mBatchSizes.empty());
+
+    mBatching->flush();
+    ASSERT_EQ(1u, mCallback->mBatchSizes.size());
+    ASSERT_EQ(mBatchSize, mCallback->mLocations.size());
+    for (size_t i = 0; i < mBatchSize; i++) {
+        expectNear(makeLocation(kNumLocations - mBatchSize + i), mCallback->mLocations[i]);
+    }
+}
+
+TEST_F(GnssBatchingTest, HonorsPeriod) {
+    start(kPeriodNanos, false /* wakeupOnFifoFull */);
+    for (size_t i = 0; i < 100; i++) {
+        mBatching->reportLocation(makeLocation(i, kPeriodNanos / 4));
+    }
+    mBatching->flush();
+    ASSERT_EQ(25u, mCallback->mLocations.size());
+    for (size_t i = 0; i < mCallback->mLocations.size(); i++) {
+        expectNear(makeLocation(i * 4, kPeriodNanos / 4), mCallback->mLocations[i]);
+    }
+}
+
+TEST_F(GnssBatchingTest, FlushDeliversEmptyBatch) {
+    start(kPeriodNanos, true /* wakeupOnFifoFull */);
+    mBatching->flush();
+    ASSERT_EQ(1u, mCallback->mBatchSizes.size());
+    EXPECT_EQ(0u, mCallback->mBatchSizes[0]);
+}
+
+TEST_F(GnssBatchingTest, IgnoresLocationsWhenStopped) {
+    start(kPeriodNanos, false /* wakeupOnFifoFull */);
+    mBatching->reportLocation(makeLocation(0));
+    ASSERT_TRUE(mBatching->stop());
+    mBatching->reportLocation(makeLocation(1));
+
+    // Locations batched before stop() are still delivered.
+    mBatching->flush();
+    ASSERT_EQ(1u, mCallback->mLocations.size());
+    expectNear(makeLocation(0), mCallback->mLocations[0]);
+}
+
+TEST_F(GnssBatchingTest, SamplesLocationSource) {
+    start(0, false /* wakeupOnFifoFull */);
+    // The source is sampled every 100ms at most, whatever the period.
+    std::this_thread::sleep_for(std::chrono::milliseconds(350));
+    ASSERT_TRUE(mBatching->stop());
+    mBatching->flush();
+    ASSERT_EQ(1u, mCallback->mBatchSizes.size());
+    EXPECT_GE(mCallback->mLocations.size(), 1u);
+    EXPECT_LE(mCallback->mLocations.size(), 4u);
+}
+
+}  // namespace implementation
+}  // namespace V2_0
+}  // namespace gnss
+}  // namespace hardware
+}  // namespace android
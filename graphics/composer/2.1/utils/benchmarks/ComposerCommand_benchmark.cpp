@@ -0,0 +1,326 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "ComposerCommandBenchmark"
+
+#include <benchmark/benchmark.h>
+
+#include <composer-command-buffer/2.1/ComposerCommandBuffer.h>
+#include <composer-hal/2.1/ComposerCommandEngine.h>
+#include <composer-hal/2.1/ComposerHal.h>
+#include <composer-hal/2.1/ComposerResources.h>
+
+namespace android {
+namespace hardware {
+namespace graphics {
+namespace composer {
+namespace V2_1 {
+namespace hal {
+namespace {
+
+constexpr Display kDisplay = 1;
+constexpr size_t kNumLayers = 60;
+constexpr uint32_t kBufferCacheSize = 4;
+
+// A composer that accepts everything, so that only the command stream is measured.
+class NoopComposerHal : public ComposerHal {
+   public:
+    bool hasCapability(hwc2_capability_t) override { return false; }
+    std::string dumpDebugInfo() override { return ""; }
+    void registerEventCallback(EventCallback*) override {}
+    void unregisterEventCallback() override {}
+
+    uint32_t getMaxVirtualDisplayCount() override { return 0; }
+    Error createVirtualDisplay(uint32_t, uint32_t, PixelFormat*, Display*) override {
+        return Error::UNSUPPORTED;
+    }
+    Error destroyVirtualDisplay(Display) override { return Error::UNSUPPORTED; }
+    Error createLayer(Display, Layer*) override { return Error::UNSUPPORTED; }
+    Error destroyLayer(Display, Layer) override { return Error::UNSUPPORTED; }
+
+    Error getActiveConfig(Display, Config*) override { return Error::UNSUPPORTED; }
+    Error getClientTargetSupport(Display, uint32_t, uint32_t, PixelFormat, Dataspace) override {
+        return Error::UNSUPPORTED;
+    }
+    Error getColorModes(Display, hidl_vec<ColorMode>*) override { return Error::UNSUPPORTED; }
+    Error getDisplayAttribute(Display, Config, IComposerClient::Attribute, int32_t*) override {
+        return Error::UNSUPPORTED;
+    }
+    Error getDisplayConfigs(Display, hidl_vec<Config>*) override { return Error::UNSUPPORTED; }
+    Error getDisplayName(Display, hidl_string*) override { return Error::UNSUPPORTED; }
+    Error getDisplayType(Display, IComposerClient::DisplayType*) override {
+        return Error::UNSUPPORTED;
+    }
+    Error getDozeSupport(Display, bool*) override { return Error::UNSUPPORTED; }
+    Error getHdrCapabilities(Display, hidl_vec<Hdr>*, float*, float*, float*) override {
+        return Error::UNSUPPORTED;
+    }
+
+    Error setActiveConfig(Display, Config) override { return Error::UNSUPPORTED; }
+    Error setColorMode(Display, ColorMode) override { return Error::UNSUPPORTED; }
+    Error setPowerMode(Display, IComposerClient::PowerMode) override { return Error::UNSUPPORTED; }
+    Error setVsyncEnabled(Display, IComposerClient::Vsync) override { return Error::UNSUPPORTED; }
+
+    Error setColorTransform(Display, const float*, int32_t) override { return Error::NONE; }
+    Error setClientTarget(Display, buffer_handle_t, int32_t, int32_t,
+                          const std::vector<hwc_rect_t>&) override {
+        return Error::NONE;
+    }
+    Error setOutputBuffer(Display, buffer_handle_t, int32_t) override { return Error::NONE; }
+    Error validateDisplay(Display, std::vector<Layer>*, std::vector<IComposerClient::Composition>*,
+                          uint32_t*, std::vector<Layer>*, std::vector<uint32_t>*) override {
+        return Error::NONE;
+    }
+    Error acceptDisplayChanges(Display) override { return Error::NONE; }
+    Error presentDisplay(Display, int32_t* outPresentFence, std::vector<Layer>*,
+                         std::vector<int32_t>*) override {
+        *outPresentFence = -1;
+        return Error::NONE;
+    }
+
+    Error setLayerCursorPosition(Display, Layer, int32_t, int32_t) override { return Error::NONE; }
+    Error setLayerBuffer(Display, Layer, buffer_handle_t, int32_t) override { return Error::NONE; }
+    Error setLayerSurfaceDamage(Display, Layer, const std::vector<hwc_rect_t>&) override {
+        return Error::NONE;
+    }
+    Error setLayerBlendMode(Display, Layer, int32_t) override { return Error::NONE; }
+    Error setLayerColor(Display, Layer, IComposerClient::Color) override { return Error::NONE; }
+    Error setLayerCompositionType(Display, Layer, int32_t) override { return Error::NONE; }
+    Error setLayerDataspace(Display, Layer, int32_t) override { return Error::NONE; }
+    Error setLayerDisplayFrame(Display, Layer, const hwc_rect_t&) override { return Error::NONE; }
+    Error setLayerPlaneAlpha(Display, Layer, float) override { return Error::NONE; }
+    Error setLayerSidebandStream(Display, Layer, buffer_handle_t) override { return Error::NONE; }
+    Error setLayerSourceCrop(Display, Layer, const hwc_frect_t&) override { return Error::NONE; }
+    Error setLayerTransform(Display, Layer, int32_t) override { return Error::NONE; }
+    Error setLayerVisibleRegion(Display, Layer, const std::vector<hwc_rect_t>&) override {
+        return Error::NONE;
+    }
+    Error setLayerZOrder(Display, Layer, uint32_t) override { return Error::NONE; }
+};
+
+// The properties of a layer.  Only the properties whose LayerStateBits are set
+// in mask are written by LayerStateWriter::setLayerState.
+struct LayerState {
+    uint32_t mask = 0;
+    IComposerClient::Composition compositionType = IComposerClient::Composition::INVALID;
+    IComposerClient::BlendMode blendMode = IComposerClient::BlendMode::INVALID;
+    IComposerClient::Color color = {};
+    Dataspace dataspace = Dataspace::UNKNOWN;
+    IComposerClient::Rect displayFrame = {};
+    float planeAlpha = 1.0f;
+    IComposerClient::FRect sourceCrop = {};
+    Transform transform = static_cast<Transform>(0);
+    uint32_t zOrder = 0;
+    uint32_t bufferSlot = 0;
+    const native_handle_t* buffer = nullptr;
+    // ownership of the fence is transferred to the writer
+    int acquireFence = -1;
+    std::vector<IComposerClient::Rect> surfaceDamage;
+    std::vector<IComposerClient::Rect> visibleRegion;
+};
+
+// Writes kSetLayerStateCommand, which only ComposerCommandEngine understands
+// and so is not part of CommandWriterBase.
+class LayerStateWriter : public CommandWriterBase {
+   public:
+    LayerStateWriter(uint32_t initialMaxSize) : CommandWriterBase(initialMaxSize) {}
+
+    void setLayerState(const LayerState& state) {
+        const uint32_t mask = state.mask;
+        // When there are too many rectangles in a region we write no rectangle
+        // at all, which means the entire layer, like the separate commands do.
+        size_t fixedLength = 1 + getLayerStateFixedLength(mask);
+        size_t maxRects = (kMaxLength - fixedLength) / 4;
+        size_t damageRects = (mask & LAYER_STATE_SURFACE_DAMAGE) ? state.surfaceDamage.size() : 0;
+        if (damageRects > maxRects) {
+            damageRects = 0;
+        }
+        size_t visibleRects = (mask & LAYER_STATE_VISIBLE_REGION) ? state.visibleRegion.size() : 0;
+        if (visibleRects > maxRects - damageRects) {
+            visibleRects = 0;
+        }
+
+        beginCommand(kSetLayerStateCommand,
+                     static_cast<uint16_t>(fixedLength + (damageRects + visibleRects) * 4));
+        write(mask);
+        if (mask & LAYER_STATE_COMPOSITION_TYPE) {
+            writeSigned(static_cast<int32_t>(state.compositionType));
+        }
+        if (mask & LAYER_STATE_BLEND_MODE) {
+            writeSigned(static_cast<int32_t>(state.blendMode));
+        }
+        if (mask & LAYER_STATE_COLOR) {
+            writeColor(state.color);
+        }
+        if (mask & LAYER_STATE_DATASPACE) {
+            writeSigned(static_cast<int32_t>(state.dataspace));
+        }
+        if (mask & LAYER_STATE_DISPLAY_FRAME) {
+            writeRect(state.displayFrame);
+        }
+        if (mask & LAYER_STATE_PLANE_ALPHA) {
+            writeFloat(state.planeAlpha);
+        }
+        if (mask & LAYER_STATE_SOURCE_CROP) {
+            writeFRect(state.sourceCrop);
+        }
+        if (mask & LAYER_STATE_TRANSFORM) {
+            writeSigned(static_cast<int32_t>(state.transform));
+        }
+        if (mask & LAYER_STATE_Z_ORDER) {
+            write(state.zOrder);
+        }
+        if (mask & LAYER_STATE_BUFFER) {
+            write(state.bufferSlot);
+            writeHandle(state.buffer, true);
+            writeFence(state.acquireFence);
+        }
+        if (mask & LAYER_STATE_SURFACE_DAMAGE) {
+            write(damageRects);
+            writeRects(state.surfaceDamage.data(), damageRects);
+        }
+        if (mask & LAYER_STATE_VISIBLE_REGION) {
+            write(visibleRects);
+            writeRects(state.visibleRegion.data(), visibleRects);
+        }
+        endCommand();
+    }
+};
+
+LayerState makeLayerState(uint32_t z) {
+    LayerState state;
+    state.mask = LAYER_STATE_COMPOSITION_TYPE | LAYER_STATE_BLEND_MODE | LAYER_STATE_DATASPACE |
+                 LAYER_STATE_DISPLAY_FRAME | LAYER_STATE_PLANE_ALPHA | LAYER_STATE_SOURCE_CROP |
+                 LAYER_STATE_TRANSFORM | LAYER_STATE_Z_ORDER | LAYER_STATE_BUFFER |
+                 LAYER_STATE_SURFACE_DAMAGE | LAYER_STATE_VISIBLE_REGION;
+    state.compositionType = IComposerClient::Composition::DEVICE;
+    state.blendMode = IComposerClient::BlendMode::PREMULTIPLIED;
+    state.dataspace = Dataspace::SRGB;
+    int32_t top = static_cast<int32_t>(z) * 10;
+    state.displayFrame = {0, top, 1080, top + 200};
+    state.planeAlpha = 1.0f;
+    state.sourceCrop = {0.0f, 0.0f, 1080.0f, 200.0f};
+    state.transform = Transform::ROT_90;
+    state.zOrder = z;
+    state.bufferSlot = z % kBufferCacheSize;
+    state.surfaceDamage = {state.displayFrame};
+    state.visibleRegion = {state.displayFrame};
+    return state;
+}
+
+// Encode a frame the way clients do today, one command per layer property.
+void writeFrame(LayerStateWriter* writer, const std::vector<LayerState>& layers) {
+    writer->selectDisplay(kDisplay);
+    for (size_t i = 0; i < layers.size(); i++) {
+        const LayerState& state = layers[i];
+        writer->selectLayer(i + 1);
+        writer->setLayerCompositionType(state.compositionType);
+        writer->setLayerBlendMode(state.blendMode);
+        writer->setLayerDataspace(state.dataspace);
+        writer->setLayerDisplayFrame(state.displayFrame);
+        writer->setLayerPlaneAlpha(state.planeAlpha);
+        writer->setLayerSourceCrop(state.sourceCrop);
+        writer->setLayerTransform(state.transform);
+        writer->setLayerZOrder(state.zOrder);
+        writer->setLayerBuffer(state.bufferSlot, state.buffer, state.acquireFence);
+        writer->setLayerSurfaceDamage(state.surfaceDamage);
+        writer->setLayerVisibleRegion(state.visibleRegion);
+    }
+    writer->validateDisplay();
+}
+
+// Encode the same frame with one SET_LAYER_STATE per layer.
+void writeBatchedFrame(LayerStateWriter* writer, const std::vector<LayerState>& layers) {
+    writer->selectDisplay(kDisplay);
+    for (size_t i = 0; i < layers.size(); i++) {
+        writer->selectLayer(i + 1);
+        writer->setLayerState(layers[i]);
+    }
+    writer->validateDisplay();
+}
+
+using WriteFrameFunc = void (*)(LayerStateWriter*, const std::vector<LayerState>&);
+
+std::vector<LayerState> makeFrame() {
+    std::vector<LayerState> layers;
+    for (size_t i = 0; i < kNumLayers; i++) {
+        layers.push_back(makeLayerState(i));
+    }
+    return layers;
+}
+
+void BM_EncodeFrame(benchmark::State& state, WriteFrameFunc writeFrameFunc) {
+    auto layers = makeFrame();
+    LayerStateWriter writer(64 * 1024 / sizeof(uint32_t) - 16);
+    for (auto _ : state) {
+        writer.reset();
+        writeFrameFunc(&writer, layers);
+        benchmark::DoNotOptimize(writer.getCommand(0));
+    }
+    state.SetItemsProcessed(state.iterations() * kNumLayers);
+}
+BENCHMARK_CAPTURE(BM_EncodeFrame, PerProperty, writeFrame);
+BENCHMARK_CAPTURE(BM_EncodeFrame, Batched, writeBatchedFrame);
+
+void BM_ExecuteFrame(benchmark::State& state, WriteFrameFunc writeFrameFunc) {
+    auto layers = makeFrame();
+    NoopComposerHal hal;
+    ComposerResources resources;
+    resources.addPhysicalDisplay(kDisplay);
+    for (size_t i = 0; i < kNumLayers; i++) {
+        resources.addLayer(kDisplay, i + 1, kBufferCacheSize);
+    }
+    ComposerCommandEngine engine(&hal, &resources);
+
+    LayerStateWriter writer(64 * 1024 / sizeof(uint32_t) - 16);
+    for (auto _ : state) {
+        state.PauseTiming();
+        writer.reset();
+        writeFrameFunc(&writer, layers);
+        bool queueChanged = false;
+        uint32_t commandLength = 0;
+        hidl_vec<hidl_handle> commandHandles;
+        if (!writer.writeQueue(&queueChanged, &commandLength, &commandHandles) ||
+            (queueChanged && !engine.setInputMQDescriptor(*writer.getMQDescriptor()))) {
+            state.SkipWithError("failed to write the command queue");
+            break;
+        }
+        state.ResumeTiming();
+
+        bool outQueueChanged = false;
+        uint32_t outCommandLength = 0;
+        hidl_vec<hidl_handle> outCommandHandles;
+        if (engine.execute(commandLength, commandHandles, &outQueueChanged, &outCommandLength,
+                           &outCommandHandles) != Error::NONE) {
+            state.SkipWithError("failed to execute commands");
+            break;
+        }
+        engine.reset();
+    }
+    state.SetItemsProcessed(state.iterations() * kNumLayers);
+}
+BENCHMARK_CAPTURE(BM_ExecuteFrame, PerProperty, writeFrame);
+BENCHMARK_CAPTURE(BM_ExecuteFrame, Batched, writeBatchedFrame);
+
+}  // namespace
+}  // namespace hal
+}  // namespace V2_1
+}  // namespace composer
+}  // namespace graphics
+}  // namespace hardware
+}  // namespace android
+
+BENCHMARK_MAIN();
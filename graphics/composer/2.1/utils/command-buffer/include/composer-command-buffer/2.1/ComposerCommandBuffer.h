@@ -138,6 +138,14 @@ class CommandWriterBase {
         return (mQueue) ? mQueue->getDesc() : nullptr;
     }
 
+    // Make sure at least size words can be written without growing the
+    // buffer, e.g. to size the writer for a whole frame up front.
+    void reserve(uint32_t size) {
+        if (size > mDataMaxSize) {
+            resizeData(size);
+        }
+    }
+
     static constexpr uint16_t kSelectDisplayLength = 2;
     void selectDisplay(Display display) {
         beginCommand(IComposerClient::Command::SELECT_DISPLAY, kSelectDisplayLength);
@@ -477,8 +485,15 @@ class CommandWriterBase {
     }
 
     void writeRegion(const std::vector<IComposerClient::Rect>& region) {
-        for (const auto& rect : region) {
-            writeRect(rect);
+        writeRects(region.data(), region.size());
+    }
+
+    void writeRects(const IComposerClient::Rect* rects, size_t count) {
+        static_assert(sizeof(IComposerClient::Rect) == 4 * sizeof(uint32_t),
+                      "Rect must be four packed int32_t");
+        if (count > 0) {
+            memcpy(&mData[mDataWritten], rects, count * sizeof(IComposerClient::Rect));
+            mDataWritten += count * 4;
         }
     }
 
@@ -538,22 +553,27 @@ class CommandWriterBase {
     uint32_t mDataWritten;
 
    private:
+    // called by every beginCommand, so keep the common case of enough room
+    // inline and cheap
     void growData(uint32_t grow) {
         uint32_t newWritten = mDataWritten + grow;
+        if (__builtin_expect(newWritten >= mDataWritten && newWritten <= mDataMaxSize, 1)) {
+            return;
+        }
+
         if (newWritten < mDataWritten) {
             LOG_ALWAYS_FATAL("buffer overflowed; data written %" PRIu32 ", growing by %" PRIu32,
                              mDataWritten, grow);
         }
 
-        if (newWritten <= mDataMaxSize) {
-            return;
-        }
-
         uint32_t newMaxSize = mDataMaxSize << 1;
         if (newMaxSize < newWritten) {
             newMaxSize = newWritten;
         }
+        resizeData(newMaxSize);
+    }
 
+    void resizeData(uint32_t newMaxSize) {
         auto newData = std::make_unique<uint32_t[]>(newMaxSize);
         std::copy_n(mData.get(), mDataWritten, newData.get());
         mDataMaxSize = newMaxSize;
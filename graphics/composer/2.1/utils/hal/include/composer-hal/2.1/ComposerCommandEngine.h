@@ -36,6 +36,48 @@ namespace composer {
 namespace V2_1 {
 namespace hal {
 
+// SET_LAYER_STATE is not part of IComposerClient::Command and no client can
+// tell whether a composer understands it, so CommandWriterBase does not write
+// it.  It is decoded here, with an opcode from the reserved range, so that the
+// batched encoding can be measured against the per-property commands.
+//
+// The command sets all the changed properties of the selected layer at once.
+// Its first word is a mask of LayerStateBits telling which properties follow,
+// in the order of the bits.  Regions are written as a rectangle count followed
+// by the rectangles.
+constexpr IComposerClient::Command kSetLayerStateCommand = static_cast<IComposerClient::Command>(
+    0x1000 << static_cast<uint32_t>(IComposerClient::Command::OPCODE_SHIFT));
+
+enum LayerStateBits : uint32_t {
+    LAYER_STATE_COMPOSITION_TYPE = 1 << 0,  // 1 word
+    LAYER_STATE_BLEND_MODE = 1 << 1,        // 1 word
+    LAYER_STATE_COLOR = 1 << 2,             // 1 word
+    LAYER_STATE_DATASPACE = 1 << 3,         // 1 word
+    LAYER_STATE_DISPLAY_FRAME = 1 << 4,     // 4 words
+    LAYER_STATE_PLANE_ALPHA = 1 << 5,       // 1 word
+    LAYER_STATE_SOURCE_CROP = 1 << 6,       // 4 words
+    LAYER_STATE_TRANSFORM = 1 << 7,         // 1 word
+    LAYER_STATE_Z_ORDER = 1 << 8,           // 1 word
+    LAYER_STATE_BUFFER = 1 << 9,            // 3 words: slot, buffer, acquire fence
+    LAYER_STATE_SURFACE_DAMAGE = 1 << 10,   // 1 + 4 * N words
+    LAYER_STATE_VISIBLE_REGION = 1 << 11,   // 1 + 4 * N words
+};
+
+// A command with any other bit set is rejected rather than partly applied.
+constexpr uint32_t kKnownLayerStateBits = (LAYER_STATE_VISIBLE_REGION << 1) - 1;
+
+// The length of the kSetLayerStateCommand properties in mask, not counting
+// the mask itself and the rectangles of the regions.
+constexpr size_t getLayerStateFixedLength(uint32_t mask) {
+    return ((mask & LAYER_STATE_COMPOSITION_TYPE) ? 1 : 0) +
+           ((mask & LAYER_STATE_BLEND_MODE) ? 1 : 0) + ((mask & LAYER_STATE_COLOR) ? 1 : 0) +
+           ((mask & LAYER_STATE_DATASPACE) ? 1 : 0) + ((mask & LAYER_STATE_DISPLAY_FRAME) ? 4 : 0) +
+           ((mask & LAYER_STATE_PLANE_ALPHA) ? 1 : 0) + ((mask & LAYER_STATE_SOURCE_CROP) ? 4 : 0) +
+           ((mask & LAYER_STATE_TRANSFORM) ? 1 : 0) + ((mask & LAYER_STATE_Z_ORDER) ? 1 : 0) +
+           ((mask & LAYER_STATE_BUFFER) ? 3 : 0) + ((mask & LAYER_STATE_SURFACE_DAMAGE) ? 1 : 0) +
+           ((mask & LAYER_STATE_VISIBLE_REGION) ? 1 : 0);
+}
+
 // TODO own a CommandReaderBase rather than subclassing
 class ComposerCommandEngine : protected CommandReaderBase {
    public:
@@ -88,6 +130,11 @@ class ComposerCommandEngine : protected CommandReaderBase {
 
    protected:
     virtual bool executeCommand(IComposerClient::Command command, uint16_t length) {
+        // not an IComposerClient::Command, so it cannot be a case below
+        if (command == kSetLayerStateCommand) {
+            return executeSetLayerState(length);
+        }
+
         switch (command) {
             case IComposerClient::Command::SELECT_DISPLAY:
                 return executeSelectDisplay(length);
@@ -362,6 +409,16 @@ class ComposerCommandEngine : protected CommandReaderBase {
             return false;
         }
 
+        auto err = readAndSetLayerBuffer();
+        if (err != Error::NONE) {
+            mWriter.setError(getCommandLoc(), err);
+        }
+
+        return true;
+    }
+
+    // reads the slot, buffer and acquire fence of SET_LAYER_BUFFER
+    Error readAndSetLayerBuffer() {
         bool useCache = false;
         auto slot = read();
         auto rawHandle = readHandle(&useCache);
@@ -381,11 +438,8 @@ class ComposerCommandEngine : protected CommandReaderBase {
         if (closeFence) {
             close(fence);
         }
-        if (err != Error::NONE) {
-            mWriter.setError(getCommandLoc(), err);
-        }
 
-        return true;
+        return err;
     }
 
     bool executeSetLayerSurfaceDamage(uint16_t length) {
@@ -556,6 +610,91 @@ class ComposerCommandEngine : protected CommandReaderBase {
         return true;
     }
 
+    bool executeSetLayerState(uint16_t length) {
+        if (!isLayerStateValid(length)) {
+            return false;
+        }
+
+        const uint32_t mask = read();
+        auto setError = [this](Error err) {
+            if (err != Error::NONE) {
+                mWriter.setError(getCommandLoc(), err);
+            }
+        };
+
+        // the properties are applied in the same order as they are written
+        if (mask & LAYER_STATE_COMPOSITION_TYPE) {
+            setError(mHal->setLayerCompositionType(mCurrentDisplay, mCurrentLayer, readSigned()));
+        }
+        if (mask & LAYER_STATE_BLEND_MODE) {
+            setError(mHal->setLayerBlendMode(mCurrentDisplay, mCurrentLayer, readSigned()));
+        }
+        if (mask & LAYER_STATE_COLOR) {
+            setError(mHal->setLayerColor(mCurrentDisplay, mCurrentLayer, readColor()));
+        }
+        if (mask & LAYER_STATE_DATASPACE) {
+            setError(mHal->setLayerDataspace(mCurrentDisplay, mCurrentLayer, readSigned()));
+        }
+        if (mask & LAYER_STATE_DISPLAY_FRAME) {
+            setError(mHal->setLayerDisplayFrame(mCurrentDisplay, mCurrentLayer, readRect()));
+        }
+        if (mask & LAYER_STATE_PLANE_ALPHA) {
+            setError(mHal->setLayerPlaneAlpha(mCurrentDisplay, mCurrentLayer, readFloat()));
+        }
+        if (mask & LAYER_STATE_SOURCE_CROP) {
+            setError(mHal->setLayerSourceCrop(mCurrentDisplay, mCurrentLayer, readFRect()));
+        }
+        if (mask & LAYER_STATE_TRANSFORM) {
+            setError(mHal->setLayerTransform(mCurrentDisplay, mCurrentLayer, readSigned()));
+        }
+        if (mask & LAYER_STATE_Z_ORDER) {
+            setError(mHal->setLayerZOrder(mCurrentDisplay, mCurrentLayer, read()));
+        }
+        if (mask & LAYER_STATE_BUFFER) {
+            setError(readAndSetLayerBuffer());
+        }
+        if (mask & LAYER_STATE_SURFACE_DAMAGE) {
+            auto damage = readRegion(read());
+            setError(mHal->setLayerSurfaceDamage(mCurrentDisplay, mCurrentLayer, damage));
+        }
+        if (mask & LAYER_STATE_VISIBLE_REGION) {
+            auto region = readRegion(read());
+            setError(mHal->setLayerVisibleRegion(mCurrentDisplay, mCurrentLayer, region));
+        }
+
+        return true;
+    }
+
+    // Check that a kSetLayerStateCommand only has known properties and that
+    // they add up to its length without reading anything, so that a malformed
+    // command is rejected before any of it is applied.
+    bool isLayerStateValid(uint16_t length) const {
+        if (length < 1) {
+            return false;
+        }
+
+        const uint32_t mask = mData[mDataRead];
+        if (mask & ~kKnownLayerStateBits) {
+            return false;
+        }
+
+        const bool hasDamage = mask & LAYER_STATE_SURFACE_DAMAGE;
+        const bool hasVisibleRegion = mask & LAYER_STATE_VISIBLE_REGION;
+        // the offset of the first region rectangle count
+        uint64_t pos = uint64_t(1) + getLayerStateFixedLength(mask) -
+                       (hasDamage ? 1 : 0) - (hasVisibleRegion ? 1 : 0);
+        for (bool hasRegion : {hasDamage, hasVisibleRegion}) {
+            if (hasRegion) {
+                if (pos >= length) {
+                    return false;
+                }
+                pos += 1 + uint64_t(mData[mDataRead + pos]) * 4;
+            }
+        }
+
+        return pos == length;
+    }
+
     hwc_rect_t readRect() {
         return hwc_rect_t{
             readSigned(), readSigned(), readSigned(), readSigned(),
@@ -563,11 +702,12 @@ class ComposerCommandEngine : protected CommandReaderBase {
     }
 
     std::vector<hwc_rect_t> readRegion(size_t count) {
-        std::vector<hwc_rect_t> region;
-        region.reserve(count);
-        while (count > 0) {
-            region.emplace_back(readRect());
-            count--;
+        static_assert(sizeof(hwc_rect_t) == 4 * sizeof(uint32_t),
+                      "hwc_rect_t must be four packed int");
+        std::vector<hwc_rect_t> region(count);
+        if (count > 0) {
+            memcpy(region.data(), &mData[mDataRead], count * sizeof(hwc_rect_t));
+            mDataRead += count * 4;
         }
 
         return region;
@@ -47,7 +47,8 @@ extern "C" IHealth* HIDL_FETCH_IHealth(const char* instance) {
     InitHealthdConfig(config.get());
 
     // This implementation uses default config. If you want to customize it
-    // (e.g. with healthd_board_init), do it here.
+    // (e.g. with healthd_board_init), do it here. How long values read from
+    // sysfs are reused by getHealthInfo* can be passed as a second argument.
 
     return new Health(std::move(config));
 }
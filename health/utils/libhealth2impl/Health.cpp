@@ -21,6 +21,7 @@
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
+#include <android-base/stringprintf.h>
 #include <android/hardware/health/1.0/types.h>
 #include <android/hardware/health/2.0/IHealthInfoCallback.h>
 #include <android/hardware/health/2.0/types.h>
@@ -33,6 +34,7 @@
 #include <health2impl/Callback.h>
 #include <health2impl/HalHealthLoop.h>
 
+using android::base::boot_clock;
 using android::hardware::health::V1_0::BatteryStatus;
 using android::hardware::health::V1_0::toString;
 using android::hardware::health::V1_0::hal_conversion::convertFromHealthInfo;
@@ -62,7 +64,11 @@ class MyHealth : public Health {
 };
 */
 
-Health::Health(std::unique_ptr<healthd_config>&& config) : healthd_config_(std::move(config)) {
+constexpr std::chrono::milliseconds Health::kDefaultMaxSnapshotAge;
+
+Health::Health(std::unique_ptr<healthd_config>&& config,
+               std::chrono::milliseconds max_snapshot_age)
+    : healthd_config_(std::move(config)), max_snapshot_age_(max_snapshot_age) {
     battery_monitor_.init(healthd_config_.get());
 }
 
@@ -79,6 +85,12 @@ Return<Result> Health::unregisterCallback(const sp<V2_0::IHealthInfoCallback>&)
 }
 
 Return<Result> Health::update() {
+    // Something changed (uevent, wake alarm or explicit request), re-read all values.
+    {
+        std::lock_guard<decltype(snapshot_lock_)> lock(snapshot_lock_);
+        snapshot_time_.reset();
+    }
+
     Result result = Result::UNKNOWN;
     getHealthInfo_2_1([&](auto res, const auto& /* health_info */) {
         result = res;
@@ -176,10 +188,21 @@ Return<void> Health::getHealthInfo(getHealthInfo_cb _hidl_cb) {
             [&](auto res, const auto& health_info) { _hidl_cb(res, health_info.legacy); });
 }
 
-Return<void> Health::getHealthInfo_2_1(getHealthInfo_2_1_cb _hidl_cb) {
-    battery_monitor_.updateValues();
+HealthInfo Health::GetBatteryHealthInfo() {
+    std::lock_guard<decltype(snapshot_lock_)> lock(snapshot_lock_);
+    auto now = boot_clock::now();
+    if (snapshot_time_.has_value() && now - *snapshot_time_ <= max_snapshot_age_) {
+        snapshot_hits_++;
+    } else {
+        battery_monitor_.updateValues();
+        snapshot_time_ = now;
+        snapshot_reads_++;
+    }
+    return battery_monitor_.getHealthInfo_2_1();
+}
 
-    HealthInfo health_info = battery_monitor_.getHealthInfo_2_1();
+Return<void> Health::getHealthInfo_2_1(getHealthInfo_2_1_cb _hidl_cb) {
+    HealthInfo health_info = GetBatteryHealthInfo();
 
     // Fill in storage infos; these aren't retrieved by BatteryMonitor.
     GetHealthInfoField(this, &Health::getStorageInfo, &health_info.legacy.storageInfos);
@@ -199,6 +222,17 @@ Return<void> Health::debug(const hidl_handle& handle, const hidl_vec<hidl_string
 
     int fd = handle->data[0];
     battery_monitor_.dumpState(fd);
+    {
+        std::lock_guard<decltype(snapshot_lock_)> lock(snapshot_lock_);
+        android::base::WriteStringToFd(
+                android::base::StringPrintf(
+                        "HealthInfo snapshots (max age %lldms): %llu sysfs reads, %llu reads "
+                        "saved\n",
+                        static_cast<long long>(max_snapshot_age_.count()),
+                        static_cast<unsigned long long>(snapshot_reads_),
+                        static_cast<unsigned long long>(snapshot_hits_)),
+                fd);
+    }
     getHealthInfo_2_1([fd](auto res, const auto& info) {
         android::base::WriteStringToFd("\ngetHealthInfo -> ", fd);
         if (res == Result::SUCCESS) {
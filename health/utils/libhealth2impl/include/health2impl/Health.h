@@ -15,10 +15,13 @@
  */
 #pragma once
 
+#include <chrono>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <vector>
 
+#include <android-base/chrono_utils.h>
 #include <android-base/unique_fd.h>
 #include <android/hardware/health/2.1/IHealth.h>
 #include <healthd/BatteryMonitor.h>
@@ -41,7 +44,12 @@ namespace implementation {
 
 class Health : public IHealth {
   public:
-    Health(std::unique_ptr<healthd_config>&& config);
+    // Values read by BatteryMonitor are reused for this long by getHealthInfo*, unless update()
+    // is called in between. update() is called by HealthLoop on uevents and wake alarms.
+    static constexpr std::chrono::milliseconds kDefaultMaxSnapshotAge{1000};
+
+    Health(std::unique_ptr<healthd_config>&& config,
+           std::chrono::milliseconds max_snapshot_age = kDefaultMaxSnapshotAge);
 
     // Methods from ::android::hardware::health::V2_0::IHealth follow.
     Return<::android::hardware::health::V2_0::Result> registerCallback(
@@ -76,9 +84,20 @@ class Health : public IHealth {
   private:
     bool unregisterCallbackInternal(const sp<IBase>& callback);
 
+    // Returns the values of battery_monitor_, reading them again from sysfs if they are older
+    // than max_snapshot_age_ or update() has been called since.
+    HealthInfo GetBatteryHealthInfo();
+
     BatteryMonitor battery_monitor_;
     std::unique_ptr<healthd_config> healthd_config_;
 
+    const std::chrono::milliseconds max_snapshot_age_;
+    std::mutex snapshot_lock_;
+    // Time battery_monitor_ last read sysfs, or nullopt if update() has been called since.
+    std::optional<android::base::boot_clock::time_point> snapshot_time_;
+    uint64_t snapshot_reads_ = 0;
+    uint64_t snapshot_hits_ = 0;
+
     std::mutex callbacks_lock_;
     std::vector<std::unique_ptr<Callback>> callbacks_;
 };
@@ -17,6 +17,11 @@
 #include <keymasterV4_0/authorization_set.h>
 
 #include <assert.h>
+#include <string.h>
+
+#include <algorithm>
+#include <array>
+#include <limits>
 
 #include <android-base/logging.h>
 
@@ -83,8 +88,19 @@ bool keyParamEqual(const KeyParameter& a, const KeyParameter& b) {
     return false;
 }
 
+namespace {
+
+// Orders KeyParameters by tag only, consistent with keyParamLess
+struct TagLess {
+    bool operator()(const KeyParameter& param, Tag tag) const { return param.tag < tag; }
+    bool operator()(Tag tag, const KeyParameter& param) const { return tag < param.tag; }
+};
+
+}  // namespace
+
 void AuthorizationSet::Sort() {
     std::sort(data_.begin(), data_.end(), keyParamLess);
+    sorted_ = true;
 }
 
 void AuthorizationSet::Deduplicate() {
@@ -105,6 +121,8 @@ void AuthorizationSet::Deduplicate() {
     result.push_back(std::move(*prev));
 
     std::swap(data_, result);
+    // The result is still ordered by keyParamLess
+    sorted_ = true;
 }
 
 void AuthorizationSet::Union(const AuthorizationSet& other) {
@@ -140,6 +158,8 @@ void AuthorizationSet::Filter(std::function<bool(const KeyParameter&)> doKeep) {
 }
 
 KeyParameter& AuthorizationSet::operator[](int at) {
+    // The caller may change the tag
+    sorted_ = false;
     return data_[at];
 }
 
@@ -149,9 +169,14 @@ const KeyParameter& AuthorizationSet::operator[](int at) const {
 
 void AuthorizationSet::Clear() {
     data_.clear();
+    sorted_ = false;
 }
 
 size_t AuthorizationSet::GetTagCount(Tag tag) const {
+    if (sorted_) {
+        auto range = std::equal_range(data_.begin(), data_.end(), tag, TagLess());
+        return range.second - range.first;
+    }
     size_t count = 0;
     for (int pos = -1; (pos = find(tag, pos)) != -1;) ++count;
     return count;
@@ -160,6 +185,16 @@ size_t AuthorizationSet::GetTagCount(Tag tag) const {
 int AuthorizationSet::find(Tag tag, int begin) const {
     auto iter = data_.begin() + (1 + begin);
 
+    if (sorted_) {
+        // keyParamLess orders by tag first, so all the entries of tag are adjacent and the next
+        // one, if any, directly follows begin once the first one was found.
+        if (iter != data_.end() && iter->tag != tag) {
+            iter = std::lower_bound(iter, data_.end(), tag, TagLess());
+        }
+        if (iter != data_.end() && iter->tag == tag) return iter - data_.begin();
+        return -1;
+    }
+
     while (iter != data_.end() && iter->tag != tag) ++iter;
 
     if (iter != data_.end()) return iter - data_.begin();
@@ -450,6 +485,260 @@ void AuthorizationSet::Serialize(std::ostream* out) const {
 
 void AuthorizationSet::Deserialize(std::istream* in) {
     deserialize(*in, &data_);
+    sorted_ = false;
+}
+
+/**
+ * The flat serializer below writes the persistent format straight into a byte buffer. Instead of
+ * walking all_tags_t for every KeyParameter, it looks the tag up in a table indexed by the tag id
+ * (the tag without its TagType bits), generated from all_tags_t at compile time.
+ */
+
+namespace {
+
+constexpr uint32_t kTagIdMask = 0x0FFFFFFF;
+
+constexpr uint32_t tagId(Tag tag) {
+    return static_cast<uint32_t>(tag) & kTagIdMask;
+}
+
+template <typename TagList>
+struct KnownTagTable;
+
+template <TagType... tag_types, Tag... tags>
+struct KnownTagTable<MetaList<TypedTag<tag_types, tags>...>> {
+    static constexpr uint32_t maxTagId() {
+        uint32_t result = 0;
+        ((result = std::max(result, tagId(tags))), ...);
+        return result;
+    }
+
+    static constexpr std::array<Tag, maxTagId() + 1> make() {
+        // Unused ids map to Tag::INVALID, which is id 0 and never matches another tag
+        std::array<Tag, maxTagId() + 1> table{};
+        ((table[tagId(tags)] = tags), ...);
+        return table;
+    }
+
+    static constexpr bool idsAreUnique() {
+        auto table = make();
+        bool result = true;
+        ((result = result && table[tagId(tags)] == tags), ...);
+        return result;
+    }
+};
+
+static_assert(KnownTagTable<all_tags_t>::idsAreUnique(), "two tags in all_tags_t share an id");
+constexpr auto kKnownTags = KnownTagTable<all_tags_t>::make();
+
+bool isKnownTag(Tag tag) {
+    uint32_t id = tagId(tag);
+    return id < kKnownTags.size() && kKnownTags[id] == tag;
+}
+
+/**
+ * Size of the value following the tag in the elements section, matching what
+ * serializeParamValue() writes for the value type of each TagType. Blobs are written as their
+ * length and offset in the indirect section.
+ */
+constexpr size_t valueSize(TagType type) {
+    switch (type) {
+        case TagType::ENUM:
+        case TagType::ENUM_REP:
+        case TagType::UINT:
+        case TagType::UINT_REP:
+            return sizeof(uint32_t);
+        case TagType::ULONG:
+        case TagType::ULONG_REP:
+        case TagType::DATE:
+            return sizeof(uint64_t);
+        case TagType::BOOL:
+            return sizeof(bool);
+        case TagType::BIGNUM:
+        case TagType::BYTES:
+            return 2 * sizeof(uint32_t);
+        case TagType::INVALID:
+            break;
+    }
+    return 0;
+}
+
+bool isBlobType(TagType type) {
+    return type == TagType::BIGNUM || type == TagType::BYTES;
+}
+
+// Entries that Serialize(std::ostream*) skips as well: invalid and unknown tags.
+bool isSerializedParam(const KeyParameter& param) {
+    if (param.tag == Tag::INVALID) return false;
+    if (!isKnownTag(param.tag)) {
+        LOG(WARNING) << "Trying to serialize unknown tag " << unsigned(param.tag)
+                     << ". Did you forget to add it to all_tags_t?";
+        return false;
+    }
+    return true;
+}
+
+template <typename T>
+uint8_t* appendValue(uint8_t* buf, const T& value) {
+    memcpy(buf, &value, sizeof(T));
+    return buf + sizeof(T);
+}
+
+template <typename T>
+const uint8_t* copyValue(const uint8_t* buf, T* value) {
+    memcpy(value, buf, sizeof(T));
+    return buf + sizeof(T);
+}
+
+struct SerializedSizes {
+    size_t indirect = 0;
+    size_t elements = 0;
+    uint32_t count = 0;
+};
+
+bool computeSerializedSizes(const std::vector<KeyParameter>& params, SerializedSizes* sizes) {
+    for (const auto& param : params) {
+        if (!isSerializedParam(param)) continue;
+        TagType type = typeFromTag(param.tag);
+        if (isBlobType(type)) sizes->indirect += param.blob.size();
+        sizes->elements += sizeof(uint32_t) + valueSize(type);
+        ++sizes->count;
+    }
+    return sizes->indirect <= std::numeric_limits<uint32_t>::max() &&
+           sizes->elements <= std::numeric_limits<uint32_t>::max();
+}
+
+}  // namespace
+
+size_t AuthorizationSet::SerializedSize() const {
+    SerializedSizes sizes;
+    if (!computeSerializedSizes(data_, &sizes)) return 0;
+    return 3 * sizeof(uint32_t) + sizes.indirect + sizes.elements;
+}
+
+uint8_t* AuthorizationSet::Serialize(uint8_t* buf, const uint8_t* end) const {
+    SerializedSizes sizes;
+    if (!computeSerializedSizes(data_, &sizes)) return nullptr;
+    if (end < buf ||
+        size_t(end - buf) < 3 * sizeof(uint32_t) + sizes.indirect + sizes.elements) {
+        return nullptr;
+    }
+
+    uint8_t* indirect = appendValue(buf, static_cast<uint32_t>(sizes.indirect));
+    uint8_t* elements = indirect + sizes.indirect;
+    elements = appendValue(elements, sizes.count);
+    elements = appendValue(elements, static_cast<uint32_t>(sizes.elements));
+
+    uint32_t indirect_offset = 0;
+    for (const auto& param : data_) {
+        if (!isSerializedParam(param)) continue;
+        elements = appendValue(elements, param.tag);
+        switch (typeFromTag(param.tag)) {
+            case TagType::ENUM:
+            case TagType::ENUM_REP:
+            case TagType::UINT:
+            case TagType::UINT_REP:
+                // All the enum values share the storage of f.integer
+                elements = appendValue(elements, param.f.integer);
+                break;
+            case TagType::ULONG:
+            case TagType::ULONG_REP:
+                elements = appendValue(elements, param.f.longInteger);
+                break;
+            case TagType::DATE:
+                elements = appendValue(elements, param.f.dateTime);
+                break;
+            case TagType::BOOL:
+                elements = appendValue(elements, param.f.boolValue);
+                break;
+            case TagType::BIGNUM:
+            case TagType::BYTES: {
+                uint32_t blob_length = param.blob.size();
+                elements = appendValue(elements, blob_length);
+                elements = appendValue(elements, indirect_offset);
+                if (blob_length) memcpy(indirect + indirect_offset, &param.blob[0], blob_length);
+                indirect_offset += blob_length;
+                break;
+            }
+            case TagType::INVALID:
+                break;
+        }
+    }
+    return elements;
+}
+
+bool AuthorizationSet::Deserialize(const uint8_t** buf_ptr, const uint8_t* end) {
+    data_.clear();
+    sorted_ = false;
+
+    const uint8_t* buf = *buf_ptr;
+    auto remaining = [&buf, end]() -> size_t { return end > buf ? end - buf : 0; };
+
+    uint32_t indirect_size = 0;
+    if (remaining() < sizeof(uint32_t)) return false;
+    buf = copyValue(buf, &indirect_size);
+    if (remaining() < indirect_size) return false;
+    const uint8_t* indirect = buf;
+    buf += indirect_size;
+
+    uint32_t element_count = 0;
+    uint32_t elements_size = 0;
+    if (remaining() < 2 * sizeof(uint32_t)) return false;
+    buf = copyValue(buf, &element_count);
+    buf = copyValue(buf, &elements_size);
+    if (remaining() < elements_size) return false;
+    const uint8_t* elements_end = buf + elements_size;
+
+    // Every element takes at least its tag, don't let a corrupt count reserve a huge vector
+    if (element_count > elements_size / sizeof(uint32_t)) return false;
+    std::vector<KeyParameter> params;
+    params.reserve(element_count);
+    for (uint32_t i = 0; i < element_count; ++i) {
+        if (size_t(elements_end - buf) < sizeof(uint32_t)) return false;
+        KeyParameter param;
+        param.f.longInteger = 0;
+        buf = copyValue(buf, &param.tag);
+        if (!isKnownTag(param.tag)) return false;
+        TagType type = typeFromTag(param.tag);
+        if (size_t(elements_end - buf) < valueSize(type)) return false;
+        switch (type) {
+            case TagType::ENUM:
+            case TagType::ENUM_REP:
+            case TagType::UINT:
+            case TagType::UINT_REP:
+                buf = copyValue(buf, &param.f.integer);
+                break;
+            case TagType::ULONG:
+            case TagType::ULONG_REP:
+                buf = copyValue(buf, &param.f.longInteger);
+                break;
+            case TagType::DATE:
+                buf = copyValue(buf, &param.f.dateTime);
+                break;
+            case TagType::BOOL:
+                buf = copyValue(buf, &param.f.boolValue);
+                break;
+            case TagType::BIGNUM:
+            case TagType::BYTES: {
+                uint32_t blob_length = 0;
+                uint32_t offset = 0;
+                buf = copyValue(buf, &blob_length);
+                buf = copyValue(buf, &offset);
+                if (offset > indirect_size || blob_length > indirect_size - offset) return false;
+                param.blob.resize(blob_length);
+                if (blob_length) memcpy(&param.blob[0], indirect + offset, blob_length);
+                break;
+            }
+            case TagType::INVALID:
+                // Legacy blobs may contain invalid tags, which carry no value and are dropped.
+                continue;
+        }
+        params.push_back(std::move(param));
+    }
+
+    data_ = std::move(params);
+    *buf_ptr = elements_end;
+    return true;
 }
 
 AuthorizationSetBuilder& AuthorizationSetBuilder::RsaKey(uint32_t key_size,
@@ -0,0 +1,144 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <keymasterV4_0/authorization_set.h>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+namespace android {
+namespace hardware {
+namespace keymaster {
+namespace V4_0 {
+namespace {
+
+// Roughly the characteristics keystore stores for an RSA signing key.
+AuthorizationSet makeKeyCharacteristics() {
+    const uint8_t appId[] = "com.example.app";
+    const uint8_t appData[32] = {};
+    return AuthorizationSetBuilder()
+            .RsaSigningKey(2048, 65537)
+            .Digest({Digest::NONE, Digest::SHA_2_256, Digest::SHA_2_512})
+            .Padding({PaddingMode::RSA_PSS, PaddingMode::RSA_PKCS1_1_5_SIGN})
+            .Authorization(TAG_APPLICATION_ID, appId, sizeof(appId))
+            .Authorization(TAG_APPLICATION_DATA, appData, sizeof(appData))
+            .Authorization(TAG_USER_SECURE_ID, 0x1234567890abcdefULL)
+            .Authorization(TAG_USER_AUTH_TYPE, HardwareAuthenticatorType::PASSWORD)
+            .Authorization(TAG_AUTH_TIMEOUT, 300)
+            .Authorization(TAG_ORIGIN, KeyOrigin::GENERATED)
+            .Authorization(TAG_CREATION_DATETIME, 1570000000000ULL)
+            .Authorization(TAG_OS_VERSION, 100000)
+            .Authorization(TAG_OS_PATCHLEVEL, 201910)
+            .Authorization(TAG_VENDOR_PATCHLEVEL, 20191005)
+            .Authorization(TAG_BOOT_PATCHLEVEL, 20191005)
+            .Authorization(TAG_ROLLBACK_RESISTANCE)
+            .Authorization(TAG_NO_AUTH_REQUIRED);
+}
+
+std::string serializeToString(const AuthorizationSet& set) {
+    std::stringstream stream;
+    set.Serialize(&stream);
+    return stream.str();
+}
+
+void BM_SerializeStream(benchmark::State& state) {
+    AuthorizationSet set = makeKeyCharacteristics();
+    for (auto _ : state) {
+        std::stringstream stream;
+        set.Serialize(&stream);
+        benchmark::DoNotOptimize(stream);
+    }
+    state.SetItemsProcessed(state.iterations() * set.size());
+}
+BENCHMARK(BM_SerializeStream);
+
+void BM_SerializeFlat(benchmark::State& state) {
+    AuthorizationSet set = makeKeyCharacteristics();
+    std::vector<uint8_t> buffer(set.SerializedSize());
+    uint8_t* end = set.Serialize(buffer.data(), buffer.data() + buffer.size());
+    std::string expected = serializeToString(set);
+    if (end != buffer.data() + buffer.size() ||
+        std::string(buffer.begin(), buffer.end()) != expected) {
+        state.SkipWithError("flat and stream serialization differ");
+        return;
+    }
+    for (auto _ : state) {
+        std::vector<uint8_t> out(set.SerializedSize());
+        benchmark::DoNotOptimize(set.Serialize(out.data(), out.data() + out.size()));
+    }
+    state.SetItemsProcessed(state.iterations() * set.size());
+}
+BENCHMARK(BM_SerializeFlat);
+
+void BM_DeserializeStream(benchmark::State& state) {
+    AuthorizationSet set = makeKeyCharacteristics();
+    std::string serialized = serializeToString(set);
+    for (auto _ : state) {
+        std::stringstream stream(serialized);
+        AuthorizationSet result;
+        result.Deserialize(&stream);
+        benchmark::DoNotOptimize(result);
+    }
+    state.SetItemsProcessed(state.iterations() * set.size());
+}
+BENCHMARK(BM_DeserializeStream);
+
+void BM_DeserializeFlat(benchmark::State& state) {
+    AuthorizationSet set = makeKeyCharacteristics();
+    std::string serialized = serializeToString(set);
+    const uint8_t* begin = reinterpret_cast<const uint8_t*>(serialized.data());
+    const uint8_t* end = begin + serialized.size();
+    for (auto _ : state) {
+        AuthorizationSet result;
+        const uint8_t* pos = begin;
+        if (!result.Deserialize(&pos, end) || result.size() != set.size()) {
+            state.SkipWithError("failed to deserialize");
+            break;
+        }
+        benchmark::DoNotOptimize(result);
+    }
+    state.SetItemsProcessed(state.iterations() * set.size());
+}
+BENCHMARK(BM_DeserializeFlat);
+
+// GetTagCount() on every tag of a set with state.range(0) entries.
+void BM_GetTagCount(benchmark::State& state, bool sorted) {
+    AuthorizationSet set;
+    for (int64_t i = 0; i < state.range(0); ++i) {
+        set.push_back(TAG_USER_SECURE_ID, static_cast<uint64_t>(i));
+    }
+    set.push_back(makeKeyCharacteristics());
+    if (sorted) set.Sort();
+    for (auto _ : state) {
+        for (const auto& param : set) {
+            benchmark::DoNotOptimize(set.GetTagCount(param.tag));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * set.size());
+}
+BENCHMARK_CAPTURE(BM_GetTagCount, Unsorted, false)->Arg(0)->Arg(64)->Arg(512);
+BENCHMARK_CAPTURE(BM_GetTagCount, Sorted, true)->Arg(0)->Arg(64)->Arg(512);
+
+}  // namespace
+}  // namespace V4_0
+}  // namespace keymaster
+}  // namespace hardware
+}  // namespace android
+
+BENCHMARK_MAIN();
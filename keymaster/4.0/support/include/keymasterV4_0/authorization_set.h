@@ -43,10 +43,12 @@ class AuthorizationSet {
     AuthorizationSet(){};
 
     // Copy constructor.
-    AuthorizationSet(const AuthorizationSet& other) : data_(other.data_) {}
+    AuthorizationSet(const AuthorizationSet& other)
+        : data_(other.data_), sorted_(other.sorted_) {}
 
     // Move constructor.
-    AuthorizationSet(AuthorizationSet&& other) noexcept : data_(std::move(other.data_)) {}
+    AuthorizationSet(AuthorizationSet&& other) noexcept
+        : data_(std::move(other.data_)), sorted_(other.sorted_) {}
 
     // Constructor from hidl_vec<KeyParameter>
     AuthorizationSet(const hidl_vec<KeyParameter>& other) { *this = other; }
@@ -54,17 +56,20 @@ class AuthorizationSet {
     // Copy assignment.
     AuthorizationSet& operator=(const AuthorizationSet& other) {
         data_ = other.data_;
+        sorted_ = other.sorted_;
         return *this;
     }
 
     // Move assignment.
     AuthorizationSet& operator=(AuthorizationSet&& other) noexcept {
         data_ = std::move(other.data_);
+        sorted_ = other.sorted_;
         return *this;
     }
 
     AuthorizationSet& operator=(const hidl_vec<KeyParameter>& other) {
         if (other.size() > 0) {
+            sorted_ = false;
             data_.resize(other.size());
             for (size_t i = 0; i < data_.size(); ++i) {
                 /* This makes a deep copy even of embedded blobs.
@@ -98,7 +103,9 @@ class AuthorizationSet {
     const KeyParameter* data() const { return data_.data(); }
 
     /**
-     * Sorts the set
+     * Sorts the set. Until the set is modified again, find() and the lookups built on it do a
+     * binary search instead of a linear scan, which pays off for large sets that are queried
+     * often.
      */
     void Sort();
 
@@ -185,8 +192,14 @@ class AuthorizationSet {
         return {};
     }
 
-    void push_back(const KeyParameter& param) { data_.push_back(param); }
-    void push_back(KeyParameter&& param) { data_.push_back(std::move(param)); }
+    void push_back(const KeyParameter& param) {
+        data_.push_back(param);
+        sorted_ = false;
+    }
+    void push_back(KeyParameter&& param) {
+        data_.push_back(std::move(param));
+        sorted_ = false;
+    }
     void push_back(const AuthorizationSet& set) {
         for (auto& entry : set) {
             push_back(entry);
@@ -222,10 +235,32 @@ class AuthorizationSet {
     void Serialize(std::ostream* out) const;
     void Deserialize(std::istream* in);
 
+    /**
+     * Returns the number of bytes Serialize(uint8_t*, const uint8_t*) writes, or 0 if the set
+     * is too large to be serialized.
+     */
+    size_t SerializedSize() const;
+
+    /**
+     * Serializes the set into [buf, end) in the same format as Serialize(std::ostream*), without
+     * going through streams. Returns the end of the written data, or nullptr if the buffer is
+     * too small or the set can't be serialized.
+     */
+    uint8_t* Serialize(uint8_t* buf, const uint8_t* end) const;
+
+    /**
+     * Replaces the content of the set with the set serialized at *buf_ptr, reading no further
+     * than end. On success *buf_ptr is advanced past the serialized set. On failure the set is
+     * left empty and false is returned.
+     */
+    bool Deserialize(const uint8_t** buf_ptr, const uint8_t* end);
+
    private:
     NullOr<const KeyParameter&> GetEntry(Tag tag) const;
 
     std::vector<KeyParameter> data_;
+    // True while data_ is in the order established by Sort()
+    bool sorted_ = false;
 };
 
 class AuthorizationSetBuilder : public AuthorizationSet {
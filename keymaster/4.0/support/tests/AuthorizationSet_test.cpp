@@ -0,0 +1,271 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <keymasterV4_0/authorization_set.h>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace android {
+namespace hardware {
+namespace keymaster {
+namespace V4_0 {
+namespace {
+
+AuthorizationSet makeKeyCharacteristics() {
+    const uint8_t appId[] = "com.example.app";
+    const uint8_t appData[32] = {1, 2, 3};
+    return AuthorizationSetBuilder()
+            .RsaSigningKey(2048, 65537)
+            .Digest({Digest::NONE, Digest::SHA_2_256})
+            .Padding(PaddingMode::RSA_PSS)
+            .Authorization(TAG_APPLICATION_ID, appId, sizeof(appId))
+            .Authorization(TAG_APPLICATION_DATA, appData, sizeof(appData))
+            .Authorization(TAG_CREATION_DATETIME, 1546300800000)
+            .Authorization(TAG_NO_AUTH_REQUIRED);
+}
+
+std::vector<uint8_t> serialize(const AuthorizationSet& set) {
+    std::vector<uint8_t> buf(set.SerializedSize());
+    EXPECT_EQ(buf.data() + buf.size(), set.Serialize(buf.data(), buf.data() + buf.size()));
+    return buf;
+}
+
+void expectSameParams(const AuthorizationSet& expected, const AuthorizationSet& actual) {
+    ASSERT_EQ(expected.size(), actual.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        EXPECT_TRUE(expected[i] == actual[i]) << "param " << i;
+    }
+}
+
+/**
+ * Builds a serialized set by hand: the indirect data, the element count and the elements, each
+ * a tag followed by its value.
+ */
+class SerializedSetBuilder {
+  public:
+    SerializedSetBuilder& Indirect(const std::vector<uint8_t>& data) {
+        indirect_ = data;
+        return *this;
+    }
+    SerializedSetBuilder& Count(uint32_t count) {
+        count_ = count;
+        return *this;
+    }
+    SerializedSetBuilder& Uint(Tag tag, uint32_t value) {
+        Append(&elements_, tag);
+        Append(&elements_, value);
+        return *this;
+    }
+    SerializedSetBuilder& Blob(Tag tag, uint32_t length, uint32_t offset) {
+        Append(&elements_, tag);
+        Append(&elements_, length);
+        Append(&elements_, offset);
+        return *this;
+    }
+
+    std::vector<uint8_t> Build() const {
+        std::vector<uint8_t> buf;
+        Append(&buf, static_cast<uint32_t>(indirect_.size()));
+        buf.insert(buf.end(), indirect_.begin(), indirect_.end());
+        Append(&buf, count_);
+        Append(&buf, static_cast<uint32_t>(elements_.size()));
+        buf.insert(buf.end(), elements_.begin(), elements_.end());
+        return buf;
+    }
+
+  private:
+    template <typename T>
+    static void Append(std::vector<uint8_t>* buf, const T& value) {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+        buf->insert(buf->end(), bytes, bytes + sizeof(T));
+    }
+
+    std::vector<uint8_t> indirect_;
+    uint32_t count_ = 0;
+    std::vector<uint8_t> elements_;
+};
+
+// Deserializes buf and checks that it is rejected without moving the read pointer
+void expectRejected(const std::vector<uint8_t>& buf) {
+    AuthorizationSet set = AuthorizationSetBuilder().Authorization(TAG_KEY_SIZE, 256);
+    const uint8_t* p = buf.data();
+    EXPECT_FALSE(set.Deserialize(&p, buf.data() + buf.size()));
+    EXPECT_EQ(buf.data(), p);
+    EXPECT_TRUE(set.empty());
+}
+
+TEST(AuthorizationSetTest, FlatRoundTrip) {
+    AuthorizationSet set = makeKeyCharacteristics();
+    std::vector<uint8_t> buf = serialize(set);
+
+    AuthorizationSet deserialized;
+    const uint8_t* p = buf.data();
+    ASSERT_TRUE(deserialized.Deserialize(&p, buf.data() + buf.size()));
+    EXPECT_EQ(buf.data() + buf.size(), p);
+    expectSameParams(set, deserialized);
+}
+
+TEST(AuthorizationSetTest, FlatMatchesStreamFormat) {
+    AuthorizationSet set = makeKeyCharacteristics();
+    std::vector<uint8_t> buf = serialize(set);
+    std::stringstream stream;
+    set.Serialize(&stream);
+    EXPECT_EQ(stream.str(), std::string(buf.begin(), buf.end()));
+
+    // Blobs written by either path are read back the same by the other one
+    AuthorizationSet fromStream;
+    std::stringstream in(stream.str());
+    fromStream.Deserialize(&in);
+    expectSameParams(set, fromStream);
+}
+
+TEST(AuthorizationSetTest, FlatEmptySet) {
+    AuthorizationSet set;
+    std::vector<uint8_t> buf = serialize(set);
+    EXPECT_EQ(3 * sizeof(uint32_t), buf.size());
+
+    AuthorizationSet deserialized = AuthorizationSetBuilder().Authorization(TAG_KEY_SIZE, 256);
+    const uint8_t* p = buf.data();
+    ASSERT_TRUE(deserialized.Deserialize(&p, buf.data() + buf.size()));
+    EXPECT_TRUE(deserialized.empty());
+}
+
+TEST(AuthorizationSetTest, FlatSerializeBufferTooSmall) {
+    AuthorizationSet set = makeKeyCharacteristics();
+    std::vector<uint8_t> buf(set.SerializedSize());
+    EXPECT_EQ(nullptr, set.Serialize(buf.data(), buf.data() + buf.size() - 1));
+}
+
+TEST(AuthorizationSetTest, FlatDeserializeStopsAtEnd) {
+    AuthorizationSet set = makeKeyCharacteristics();
+    std::vector<uint8_t> buf = serialize(set);
+    size_t size = buf.size();
+    buf.push_back(0x77);
+
+    AuthorizationSet deserialized;
+    const uint8_t* p = buf.data();
+    ASSERT_TRUE(deserialized.Deserialize(&p, buf.data() + buf.size()));
+    EXPECT_EQ(buf.data() + size, p);
+    expectSameParams(set, deserialized);
+}
+
+TEST(AuthorizationSetTest, FlatDeserializeTruncated) {
+    std::vector<uint8_t> buf = serialize(makeKeyCharacteristics());
+    for (size_t size = 0; size < buf.size(); ++size) {
+        SCOPED_TRACE(size);
+        expectRejected(std::vector<uint8_t>(buf.begin(), buf.begin() + size));
+    }
+}
+
+TEST(AuthorizationSetTest, FlatDeserializeBadIndirectSize) {
+    std::vector<uint8_t> buf = SerializedSetBuilder()
+                                       .Indirect({1, 2, 3})
+                                       .Count(1)
+                                       .Blob(Tag::APPLICATION_ID, 3, 0)
+                                       .Build();
+    // An indirect section running past the end of the data
+    buf[0] = 0xff;
+    expectRejected(buf);
+    buf[0] = 0;
+    buf[3] = 0x80;
+    expectRejected(buf);
+}
+
+TEST(AuthorizationSetTest, FlatDeserializeElementCountLargerThanData) {
+    SerializedSetBuilder builder;
+    builder.Uint(Tag::KEY_SIZE, 256).Uint(Tag::PURPOSE, 2);
+    expectRejected(builder.Count(3).Build());
+    // More elements than there is room for tags, checked before reserving anything
+    expectRejected(builder.Count(0xffffffff).Build());
+
+    AuthorizationSet set;
+    std::vector<uint8_t> buf = builder.Count(2).Build();
+    const uint8_t* p = buf.data();
+    ASSERT_TRUE(set.Deserialize(&p, buf.data() + buf.size()));
+    EXPECT_EQ(2u, set.size());
+}
+
+TEST(AuthorizationSetTest, FlatDeserializeElementsSizeLargerThanData) {
+    std::vector<uint8_t> buf = SerializedSetBuilder().Count(1).Uint(Tag::KEY_SIZE, 256).Build();
+    // elements_size follows the empty indirect section and the count
+    buf[8] += 1;
+    expectRejected(buf);
+}
+
+TEST(AuthorizationSetTest, FlatDeserializeValueTruncatedByElementsSize) {
+    std::vector<uint8_t> buf = SerializedSetBuilder().Count(1).Uint(Tag::KEY_SIZE, 256).Build();
+    // The value of the element is cut by elements_size, even though the data goes on
+    buf[8] -= 1;
+    expectRejected(buf);
+}
+
+TEST(AuthorizationSetTest, FlatDeserializeBlobOutOfRange) {
+    const std::vector<uint8_t> indirect = {1, 2, 3, 4};
+    auto build = [&](uint32_t length, uint32_t offset) {
+        return SerializedSetBuilder()
+                .Indirect(indirect)
+                .Count(1)
+                .Blob(Tag::APPLICATION_ID, length, offset)
+                .Build();
+    };
+    expectRejected(build(5, 0));
+    expectRejected(build(2, 3));
+    expectRejected(build(0, 5));
+    // An offset large enough for offset + length to wrap around
+    expectRejected(build(2, 0xffffffff));
+    expectRejected(build(0xffffffff, 1));
+
+    AuthorizationSet set;
+    std::vector<uint8_t> buf = build(2, 2);
+    const uint8_t* p = buf.data();
+    ASSERT_TRUE(set.Deserialize(&p, buf.data() + buf.size()));
+    ASSERT_EQ(1u, set.size());
+    EXPECT_EQ(Tag::APPLICATION_ID, set[0].tag);
+    ASSERT_EQ(2u, set[0].blob.size());
+    EXPECT_EQ(3, set[0].blob[0]);
+    EXPECT_EQ(4, set[0].blob[1]);
+}
+
+TEST(AuthorizationSetTest, FlatDeserializeUnknownTag) {
+    expectRejected(SerializedSetBuilder().Count(1).Uint(static_cast<Tag>(0x3000ffff), 1).Build());
+}
+
+TEST(AuthorizationSetTest, FlatDeserializeDropsLegacyInvalidTags) {
+    std::vector<uint8_t> buf = SerializedSetBuilder()
+                                       .Count(2)
+                                       .Uint(Tag::KEY_SIZE, 256)
+                                       .Build();
+    // An INVALID tag carries no value
+    std::vector<uint8_t> invalid(sizeof(uint32_t), 0);
+    buf.insert(buf.end(), invalid.begin(), invalid.end());
+    buf[8] += invalid.size();
+
+    AuthorizationSet set;
+    const uint8_t* p = buf.data();
+    ASSERT_TRUE(set.Deserialize(&p, buf.data() + buf.size()));
+    ASSERT_EQ(1u, set.size());
+    EXPECT_EQ(Tag::KEY_SIZE, set[0].tag);
+}
+
+}  // namespace
+}  // namespace V4_0
+}  // namespace keymaster
+}  // namespace hardware
+}  // namespace android
@@ -21,14 +21,17 @@
 #include <android/hardware/sensors/2.0/types.h>
 
 #include <android-base/file.h>
+#include <utils/SystemClock.h>
 #include "hardware_legacy/power.h"
 
 #include <dlfcn.h>
 
+#include <algorithm>
 #include <cinttypes>
 #include <cmath>
 #include <fstream>
 #include <functional>
+#include <iomanip>
 #include <thread>
 
 namespace android {
@@ -69,6 +72,21 @@ size_t extractSubHalIndex(int32_t sensorHandle) {
     return static_cast<size_t>(sensorHandle >> kBitsAfterSubHalIndex);
 }
 
+/**
+ * Copy events to dst, setting the subhal index on the sensor handle of each copied event.
+ *
+ * @param src The events to copy.
+ * @param n The number of events to copy.
+ * @param subHalIndex The index in the hal proxy of the sub hal the events came from.
+ * @param dst The location to copy the events to.
+ */
+void copyEventsWithSubHalIndex(const Event* src, size_t n, size_t subHalIndex, Event* dst) {
+    for (size_t i = 0; i < n; i++) {
+        dst[i] = src[i];
+        dst[i].sensorHandle = setSubHalIndex(src[i].sensorHandle, subHalIndex);
+    }
+}
+
 /**
  * Convert nanoseconds to milliseconds.
  *
@@ -149,8 +167,12 @@ Return<Result> HalProxy::initialize(
     disableAllSensors();
 
     // Clears the queue if any events were pending write before.
-    mPendingWriteEventsQueue = std::queue<std::pair<std::vector<Event>, size_t>>();
-    mSizePendingWriteEventsQueue = 0;
+    {
+        std::lock_guard<std::mutex> lock(mEventQueueWriteMutex);
+        mPendingWriteEventsQueueHead = 0;
+        mSizePendingWriteEventsQueue = 0;
+        resetEventStatsLocked();
+    }
 
     // Clears previously connected dynamic sensors
     mDynamicSensors.clear();
@@ -269,7 +291,7 @@ Return<void> HalProxy::configDirectReport(int32_t sensorHandle, int32_t channelH
     return Return<void>();
 }
 
-Return<void> HalProxy::debug(const hidl_handle& fd, const hidl_vec<hidl_string>& /*args*/) {
+Return<void> HalProxy::debug(const hidl_handle& fd, const hidl_vec<hidl_string>& args) {
     if (fd.getNativeHandle() == nullptr || fd->numFds < 1) {
         ALOGE("%s: missing fd for writing", __FUNCTION__);
         return Void();
@@ -278,6 +300,11 @@ Return<void> HalProxy::debug(const hidl_handle& fd, const hidl_vec<hidl_string>&
     android::base::borrowed_fd writeFd = dup(fd->data[0]);
 
     std::ostringstream stream;
+    if (args.size() == 1 && args[0] == "--stats") {
+        dumpStatsMachineReadable(stream);
+        android::base::WriteStringToFd(stream.str(), writeFd);
+        return Return<void>();
+    }
     stream << "===HalProxy===" << std::endl;
     stream << "Internal values:" << std::endl;
     stream << "  Threads are running: " << (mThreadsRun.load() ? "true" : "false") << std::endl;
@@ -292,12 +319,11 @@ Return<void> HalProxy::debug(const hidl_handle& fd, const hidl_vec<hidl_string>&
            << std::endl;
     stream << " Most events seen on pending write events queue: "
            << mMostEventsObservedPendingWriteEventsQueue << std::endl;
-    if (!mPendingWriteEventsQueue.empty()) {
-        stream << "  Size of events list on front of pending writes queue: "
-               << mPendingWriteEventsQueue.front().first.size() << std::endl;
-    }
+    stream << "  Capacity of pending write events queue: " << kMaxSizePendingWriteEventsQueue
+           << std::endl;
     stream << "  # of non-dynamic sensors across all subhals: " << mSensors.size() << std::endl;
     stream << "  # of dynamic sensors across all subhals: " << mDynamicSensors.size() << std::endl;
+    dumpStats(stream);
     stream << "SubHals (" << mSubHalList.size() << "):" << std::endl;
     for (ISensorsSubHal* subHal : mSubHalList) {
         stream << "  Name: " << subHal->getName() << std::endl;
@@ -435,8 +461,12 @@ void* HalProxy::getHandleForSubHalSharedObject(const std::string& filename) {
 }
 
 void HalProxy::init() {
+    // Left uninitialized so that the pages are only touched once events actually overflow the fmq.
+    mPendingWriteEventsQueue.reset(new Event[kMaxSizePendingWriteEventsQueue]);
     initializeSubHalCallbacks();
     initializeSensorList();
+    std::lock_guard<std::mutex> lock(mEventQueueWriteMutex);
+    resetEventStatsLocked();
 }
 
 void HalProxy::stopThreads() {
@@ -484,38 +514,37 @@ void HalProxy::handlePendingWrites() {
     std::unique_lock<std::mutex> lock(mEventQueueWriteMutex);
     while (mThreadsRun.load()) {
         mEventQueueWriteCV.wait(
-                lock, [&] { return !mPendingWriteEventsQueue.empty() || !mThreadsRun.load(); });
+                lock, [&] { return mSizePendingWriteEventsQueue > 0 || !mThreadsRun.load(); });
         if (mThreadsRun.load()) {
-            std::vector<Event>& pendingWriteEvents = mPendingWriteEventsQueue.front().first;
-            size_t numWakeupEvents = mPendingWriteEventsQueue.front().second;
-            size_t eventQueueSize = mEventQueue->getQuantumCount();
-            size_t numToWrite = std::min(pendingWriteEvents.size(), eventQueueSize);
+            // Only write up to the end of the ring so that the events are contiguous. Posting
+            // threads only append past the tail, so the head events stay put while unlocked.
+            size_t head = mPendingWriteEventsQueueHead;
+            size_t numToWrite = std::min({mSizePendingWriteEventsQueue,
+                                          kMaxSizePendingWriteEventsQueue - head,
+                                          mEventQueue->getQuantumCount()});
+            const Event* pendingWriteEvents = &mPendingWriteEventsQueue[head];
             lock.unlock();
-            if (!mEventQueue->writeBlocking(
-                        pendingWriteEvents.data(), numToWrite,
-                        static_cast<uint32_t>(EventQueueFlagBits::EVENTS_READ),
-                        static_cast<uint32_t>(EventQueueFlagBits::READ_AND_PROCESS),
-                        kPendingWriteTimeoutNs, mEventQueueFlag)) {
+            bool success = mEventQueue->writeBlocking(
+                    pendingWriteEvents, numToWrite,
+                    static_cast<uint32_t>(EventQueueFlagBits::EVENTS_READ),
+                    static_cast<uint32_t>(EventQueueFlagBits::READ_AND_PROCESS),
+                    kPendingWriteTimeoutNs, mEventQueueFlag);
+            if (!success) {
                 ALOGE("Dropping %zu events after blockingWrite failed.", numToWrite);
+                size_t numWakeupEvents = countNumWakeupEvents(pendingWriteEvents, numToWrite);
                 if (numWakeupEvents > 0) {
-                    if (pendingWriteEvents.size() > eventQueueSize) {
-                        decrementRefCountAndMaybeReleaseWakelock(
-                                countNumWakeupEvents(pendingWriteEvents, eventQueueSize));
-                    } else {
-                        decrementRefCountAndMaybeReleaseWakelock(numWakeupEvents);
-                    }
+                    decrementRefCountAndMaybeReleaseWakelock(numWakeupEvents);
                 }
             }
             lock.lock();
-            mSizePendingWriteEventsQueue -= numToWrite;
-            if (pendingWriteEvents.size() > eventQueueSize) {
-                // TODO(b/143302327): Check if this erase operation is too inefficient. It will copy
-                // all the events ahead of it down to fill gap off array at front after the erase.
-                pendingWriteEvents.erase(pendingWriteEvents.begin(),
-                                         pendingWriteEvents.begin() + eventQueueSize);
+            if (success) {
+                recordEventsWrittenLocked(pendingWriteEvents, numToWrite, true /* queued */);
             } else {
-                mPendingWriteEventsQueue.pop();
+                recordPendingWriteEventsDroppedLocked(pendingWriteEvents, numToWrite);
             }
+            mPendingWriteEventsQueueHead = (head + numToWrite) % kMaxSizePendingWriteEventsQueue;
+            mSizePendingWriteEventsQueue -= numToWrite;
+            recordPendingWriteEventsQueueDepthLocked();
         }
     }
 }
@@ -567,35 +596,69 @@ void HalProxy::resetSharedWakelock() {
     mWakelockTimeoutResetTime = getTimeNow();
 }
 
-void HalProxy::postEventsToMessageQueue(const std::vector<Event>& events, size_t numWakeupEvents,
-                                        ScopedWakelock wakelock) {
+void HalProxy::postEventsToMessageQueue(const std::vector<Event>& events, size_t subHalIndex,
+                                        size_t numWakeupEvents, ScopedWakelock wakelock) {
     size_t numToWrite = 0;
     std::lock_guard<std::mutex> lock(mEventQueueWriteMutex);
     if (wakelock.isLocked()) {
         incrementRefCountAndMaybeAcquireWakelock(numWakeupEvents);
     }
-    if (mPendingWriteEventsQueue.empty()) {
-        numToWrite = std::min(events.size(), mEventQueue->availableToWrite());
-        if (numToWrite > 0) {
-            if (mEventQueue->write(events.data(), numToWrite)) {
-                // TODO(b/143302327): While loop if mEventQueue->avaiableToWrite > 0 to possibly fit
-                // in more writes immediately
-                mEventQueueFlag->wake(static_cast<uint32_t>(EventQueueFlagBits::READ_AND_PROCESS));
-            } else {
-                numToWrite = 0;
-            }
-        }
+    if (mSizePendingWriteEventsQueue == 0) {
+        numToWrite = writeEventsToMessageQueueLocked(events.data(), events.size(), subHalIndex);
     }
     size_t numLeft = events.size() - numToWrite;
-    if (numToWrite < events.size() &&
-        mSizePendingWriteEventsQueue + numLeft <= kMaxSizePendingWriteEventsQueue) {
-        std::vector<Event> eventsLeft(events.begin() + numToWrite, events.end());
-        mPendingWriteEventsQueue.push({eventsLeft, numWakeupEvents});
-        mSizePendingWriteEventsQueue += numLeft;
+    if (numLeft == 0) {
+        return;
+    }
+    if (mSizePendingWriteEventsQueue + numLeft <= kMaxSizePendingWriteEventsQueue) {
+        appendPendingWriteEventsLocked(events.data() + numToWrite, numLeft, subHalIndex);
         mMostEventsObservedPendingWriteEventsQueue =
                 std::max(mMostEventsObservedPendingWriteEventsQueue, mSizePendingWriteEventsQueue);
         mEventQueueWriteCV.notify_one();
+    } else {
+        recordEventsDroppedLocked(events.data() + numToWrite, numLeft, subHalIndex);
+    }
+    recordPendingWriteEventsQueueDepthLocked();
+}
+
+size_t HalProxy::writeEventsToMessageQueueLocked(const Event* events, size_t numEvents,
+                                                 size_t subHalIndex) {
+    size_t numWritten = 0;
+    // The framework may drain the fmq while we write, so keep going until it is really full.
+    while (numWritten < numEvents) {
+        size_t numToWrite = std::min(numEvents - numWritten, mEventQueue->availableToWrite());
+        EventMemTransaction tx;
+        if (numToWrite == 0 || !mEventQueue->beginWrite(numToWrite, &tx)) {
+            break;
+        }
+        // The transaction may wrap around the end of the fmq ring buffer.
+        const Event* src = events + numWritten;
+        size_t firstLength = std::min(tx.getFirstRegion().getLength(), numToWrite);
+        copyEventsWithSubHalIndex(src, firstLength, subHalIndex, tx.getFirstRegion().getAddress());
+        copyEventsWithSubHalIndex(src + firstLength, numToWrite - firstLength, subHalIndex,
+                                  tx.getSecondRegion().getAddress());
+        if (!mEventQueue->commitWrite(numToWrite)) {
+            break;
+        }
+        recordEventsWrittenLocked(tx.getFirstRegion().getAddress(), firstLength,
+                                  false /* queued */);
+        recordEventsWrittenLocked(tx.getSecondRegion().getAddress(), numToWrite - firstLength,
+                                  false /* queued */);
+        numWritten += numToWrite;
+        mEventQueueFlag->wake(static_cast<uint32_t>(EventQueueFlagBits::READ_AND_PROCESS));
     }
+    return numWritten;
+}
+
+void HalProxy::appendPendingWriteEventsLocked(const Event* events, size_t numEvents,
+                                              size_t subHalIndex) {
+    size_t tail = (mPendingWriteEventsQueueHead + mSizePendingWriteEventsQueue) %
+                  kMaxSizePendingWriteEventsQueue;
+    size_t firstLength = std::min(numEvents, kMaxSizePendingWriteEventsQueue - tail);
+    copyEventsWithSubHalIndex(events, firstLength, subHalIndex, &mPendingWriteEventsQueue[tail]);
+    copyEventsWithSubHalIndex(events + firstLength, numEvents - firstLength, subHalIndex,
+                              &mPendingWriteEventsQueue[0]);
+    mSizePendingWriteEventsQueue += numEvents;
 }
 
 bool HalProxy::incrementRefCountAndMaybeAcquireWakelock(size_t delta,
@@ -604,6 +667,7 @@ bool HalProxy::incrementRefCountAndMaybeAcquireWakelock(size_t delta,
     std::lock_guard<std::recursive_mutex> lockGuard(mWakelockMutex);
     if (mWakelockRefCount == 0) {
         acquire_wake_lock(PARTIAL_WAKE_LOCK, kWakelockName);
+        mWakelockAcquiredTime = getTimeNow();
         mWakelockCV.notify_one();
     }
     mWakelockTimeoutStartTime = getTimeNow();
@@ -623,6 +687,8 @@ void HalProxy::decrementRefCountAndMaybeReleaseWakelock(size_t delta,
     mWakelockRefCount -= std::min(mWakelockRefCount, delta);
     if (mWakelockRefCount == 0) {
         release_wake_lock(kWakelockName);
+        int64_t holdTimeNs = std::max<int64_t>(getTimeNow() - mWakelockAcquiredTime, 0);
+        mWakelockHoldTimeMs.record(msFromNs(holdTimeNs));
     }
 }
 
@@ -648,11 +714,162 @@ bool HalProxy::isSubHalIndexValid(int32_t sensorHandle) {
     return extractSubHalIndex(sensorHandle) < mSubHalList.size();
 }
 
-size_t HalProxy::countNumWakeupEvents(const std::vector<Event>& events, size_t n) {
+void HalProxy::recordEventsWrittenLocked(const Event* events, size_t n, bool queued) {
+    int64_t nowNs = elapsedRealtimeNano();
+    // Events from a subhal usually come in runs from the same sensor, so only look up the stats
+    // when the sensor handle changes.
+    int32_t lastSensorHandle = 0;
+    EventStats* sensorStats = nullptr;
+    EventStats* subHalStats = nullptr;
+    for (size_t i = 0; i < n; i++) {
+        const Event& event = events[i];
+        if (sensorStats == nullptr || event.sensorHandle != lastSensorHandle) {
+            lastSensorHandle = event.sensorHandle;
+            sensorStats = &mSensorEventStats[lastSensorHandle];
+            size_t subHalIndex = extractSubHalIndex(lastSensorHandle);
+            subHalStats = subHalIndex < mSubHalEventStats.size() ? &mSubHalEventStats[subHalIndex]
+                                                                 : nullptr;
+        }
+        uint64_t latencyUs = static_cast<uint64_t>(std::max<int64_t>(nowNs - event.timestamp, 0)) /
+                             UINT64_C(1000);
+        for (EventStats* stats : {sensorStats, subHalStats}) {
+            if (stats != nullptr) {
+                stats->numEventsWritten++;
+                stats->numEventsQueued += queued ? 1 : 0;
+                stats->writeLatencyUs.record(latencyUs);
+            }
+        }
+    }
+}
+
+void HalProxy::recordEventsDroppedLocked(const Event* events, size_t n, size_t subHalIndex) {
+    for (size_t i = 0; i < n; i++) {
+        recordEventDroppedLocked(setSubHalIndex(events[i].sensorHandle, subHalIndex));
+    }
+}
+
+void HalProxy::recordPendingWriteEventsDroppedLocked(const Event* events, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        recordEventDroppedLocked(events[i].sensorHandle);
+    }
+}
+
+void HalProxy::recordEventDroppedLocked(int32_t sensorHandle) {
+    mSensorEventStats[sensorHandle].numEventsDropped++;
+    size_t subHalIndex = extractSubHalIndex(sensorHandle);
+    if (subHalIndex < mSubHalEventStats.size()) {
+        mSubHalEventStats[subHalIndex].numEventsDropped++;
+    }
+}
+
+void HalProxy::recordPendingWriteEventsQueueDepthLocked() {
+    mPendingWriteEventsQueueDepth.record(mSizePendingWriteEventsQueue);
+    mPendingWriteEventsQueueDepthHistory.record(mSizePendingWriteEventsQueue,
+                                                elapsedRealtimeNano());
+}
+
+void HalProxy::resetEventStatsLocked() {
+    mEventStatsStartTimeNs = elapsedRealtimeNano();
+    mSubHalEventStats.assign(mSubHalList.size(), EventStats());
+    mSensorEventStats.clear();
+    mPendingWriteEventsQueueDepth = Log2Histogram();
+    mPendingWriteEventsQueueDepthHistory = PerSecondMax();
+}
+
+void HalProxy::dumpStats(std::ostream& stream) {
+    constexpr size_t kNumHistorySeconds = 10;
+    std::lock_guard<std::mutex> lock(mEventQueueWriteMutex);
+    int64_t nowNs = elapsedRealtimeNano();
+    int64_t elapsedNs = nowNs - mEventStatsStartTimeNs;
+    auto dumpEventStats = [&](const EventStats& stats) {
+        stream << std::fixed << std::setprecision(1)
+               << "events/s: " << stats.eventsPerSecond(elapsedNs)
+               << ", written: " << stats.numEventsWritten
+               << ", queued: " << stats.numEventsQueued
+               << ", dropped: " << stats.numEventsDropped
+               << ", write latency p50/p99/max: " << stats.writeLatencyUs.percentile(50) << "/"
+               << stats.writeLatencyUs.percentile(99) << "/" << stats.writeLatencyUs.max()
+               << " us" << std::endl;
+    };
+    stream << "Event stats over the last " << msFromNs(elapsedNs) << " ms:" << std::endl;
+    stream << "  Pending write events queue depth mean/p99/max: "
+           << mPendingWriteEventsQueueDepth.mean() << "/"
+           << mPendingWriteEventsQueueDepth.percentile(99) << "/"
+           << mPendingWriteEventsQueueDepth.max() << std::endl;
+    stream << "  Max pending write events queue depth over the last " << kNumHistorySeconds
+           << " s (newest first):";
+    for (size_t i = 0; i < kNumHistorySeconds; i++) {
+        stream << " " << mPendingWriteEventsQueueDepthHistory.maxSecondsAgo(nowNs, i);
+    }
+    stream << std::endl;
+    for (size_t i = 0; i < mSubHalEventStats.size(); i++) {
+        stream << "  SubHal " << mSubHalList[i]->getName() << ": ";
+        dumpEventStats(mSubHalEventStats[i]);
+    }
+    for (const auto& entry : mSensorEventStats) {
+        auto sensor = mSensors.find(entry.first);
+        stream << "  Sensor 0x" << std::hex << entry.first << std::dec << " ("
+               << (sensor != mSensors.end() ? sensor->second.name.c_str() : "dynamic")
+               << "): ";
+        dumpEventStats(entry.second);
+    }
+    std::lock_guard<std::recursive_mutex> wakelockLock(mWakelockMutex);
+    stream << "  Wakelock acquisitions: " << mWakelockHoldTimeMs.count()
+           << ", hold time mean/p99/max: " << mWakelockHoldTimeMs.mean() << "/"
+           << mWakelockHoldTimeMs.percentile(99) << "/" << mWakelockHoldTimeMs.max() << " ms"
+           << std::endl;
+}
+
+void HalProxy::dumpStatsMachineReadable(std::ostream& stream) {
+    std::lock_guard<std::mutex> lock(mEventQueueWriteMutex);
+    int64_t nowNs = elapsedRealtimeNano();
+    int64_t elapsedNs = nowNs - mEventStatsStartTimeNs;
+    auto dumpEventStats = [&](const EventStats& stats) {
+        stream << std::fixed << std::setprecision(3)
+               << " events_per_sec=" << stats.eventsPerSecond(elapsedNs)
+               << " written=" << stats.numEventsWritten << " queued=" << stats.numEventsQueued
+               << " dropped=" << stats.numEventsDropped
+               << " latency_us_p50=" << stats.writeLatencyUs.percentile(50)
+               << " latency_us_p90=" << stats.writeLatencyUs.percentile(90)
+               << " latency_us_p99=" << stats.writeLatencyUs.percentile(99)
+               << " latency_us_max=" << stats.writeLatencyUs.max()
+               << " latency_us_mean=" << stats.writeLatencyUs.mean() << std::endl;
+    };
+    stream << "halproxy elapsed_ms=" << msFromNs(elapsedNs)
+           << " pending_depth=" << mSizePendingWriteEventsQueue
+           << " pending_depth_max=" << mMostEventsObservedPendingWriteEventsQueue
+           << " pending_depth_mean=" << mPendingWriteEventsQueueDepth.mean()
+           << " pending_depth_p99=" << mPendingWriteEventsQueueDepth.percentile(99)
+           << " pending_capacity=" << kMaxSizePendingWriteEventsQueue << std::endl;
+    stream << "pending_depth_history";
+    for (size_t i = 0; i < PerSecondMax::kNumSeconds; i++) {
+        stream << " s" << i << "=" << mPendingWriteEventsQueueDepthHistory.maxSecondsAgo(nowNs, i);
+    }
+    stream << std::endl;
+    for (size_t i = 0; i < mSubHalEventStats.size(); i++) {
+        stream << "subhal index=" << i << " name=\"" << mSubHalList[i]->getName() << "\"";
+        dumpEventStats(mSubHalEventStats[i]);
+    }
+    for (const auto& entry : mSensorEventStats) {
+        stream << "sensor handle=" << entry.first
+               << " subhal=" << extractSubHalIndex(entry.first);
+        dumpEventStats(entry.second);
+    }
+    std::lock_guard<std::recursive_mutex> wakelockLock(mWakelockMutex);
+    stream << "wakelock acquisitions=" << mWakelockHoldTimeMs.count()
+           << " ref_count=" << mWakelockRefCount
+           << " hold_ms_mean=" << mWakelockHoldTimeMs.mean()
+           << " hold_ms_p50=" << mWakelockHoldTimeMs.percentile(50)
+           << " hold_ms_p99=" << mWakelockHoldTimeMs.percentile(99)
+           << " hold_ms_max=" << mWakelockHoldTimeMs.max() << std::endl;
+}
+
+size_t HalProxy::countNumWakeupEvents(const Event* events, size_t n) {
     size_t numWakeupEvents = 0;
     for (size_t i = 0; i < n; i++) {
-        int32_t sensorHandle = events[i].sensorHandle;
-        if (mSensors[sensorHandle].flags & static_cast<uint32_t>(V1_0::SensorFlagBits::WAKE_UP)) {
+        auto sensor = mSensors.find(events[i].sensorHandle);
+        if (sensor != mSensors.end() &&
+            (sensor->second.flags & static_cast<uint32_t>(V1_0::SensorFlagBits::WAKE_UP))) {
             numWakeupEvents++;
         }
     }
@@ -669,8 +886,7 @@ bool HalProxy::subHalIndexIsClear(int32_t sensorHandle) {
 
 void HalProxyCallback::postEvents(const std::vector<Event>& events, ScopedWakelock wakelock) {
     if (events.empty() || !mHalProxy->areThreadsRunning()) return;
-    size_t numWakeupEvents;
-    std::vector<Event> processedEvents = processEvents(events, &numWakeupEvents);
+    size_t numWakeupEvents = countNumWakeupEvents(events);
     if (numWakeupEvents > 0) {
         ALOG_ASSERT(wakelock.isLocked(),
                     "Wakeup events posted while wakelock unlocked for subhal"
@@ -682,7 +898,7 @@ void HalProxyCallback::postEvents(const std::vector<Event>& events, ScopedWakelo
                     " w/ index %" PRId32 ".",
                     mSubHalIndex);
     }
-    mHalProxy->postEventsToMessageQueue(processedEvents, numWakeupEvents, std::move(wakelock));
+    mHalProxy->postEventsToMessageQueue(events, mSubHalIndex, numWakeupEvents, std::move(wakelock));
 }
 
 ScopedWakelock HalProxyCallback::createScopedWakelock(bool lock) {
@@ -690,19 +906,16 @@ ScopedWakelock HalProxyCallback::createScopedWakelock(bool lock) {
     return wakelock;
 }
 
-std::vector<Event> HalProxyCallback::processEvents(const std::vector<Event>& events,
-                                                   size_t* numWakeupEvents) const {
-    *numWakeupEvents = 0;
-    std::vector<Event> eventsOut;
-    for (Event event : events) {
-        event.sensorHandle = setSubHalIndex(event.sensorHandle, mSubHalIndex);
-        eventsOut.push_back(event);
-        const SensorInfo& sensor = mHalProxy->getSensorInfo(event.sensorHandle);
+size_t HalProxyCallback::countNumWakeupEvents(const std::vector<Event>& events) const {
+    size_t numWakeupEvents = 0;
+    for (const Event& event : events) {
+        const SensorInfo& sensor =
+                mHalProxy->getSensorInfo(setSubHalIndex(event.sensorHandle, mSubHalIndex));
         if ((sensor.flags & V1_0::SensorFlagBits::WAKE_UP) != 0) {
-            (*numWakeupEvents)++;
+            numWakeupEvents++;
         }
     }
-    return eventsOut;
+    return numWakeupEvents;
 }
 
 }  // namespace implementation
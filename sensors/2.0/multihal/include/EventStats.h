@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_0 {
+namespace implementation {
+
+/**
+ * A histogram with power of two sized buckets. Recording a value is a couple of integer
+ * operations so it can be updated for every sensor event. Not thread safe, the owner must
+ * synchronize access.
+ */
+class Log2Histogram {
+  public:
+    //! Bucket 0 holds the value 0, bucket i > 0 holds values in [2^(i-1), 2^i).
+    static constexpr size_t kNumBuckets = 40;
+
+    void record(uint64_t value) {
+        size_t bucket = value == 0 ? 0 : 64 - __builtin_clzll(value);
+        mBuckets[std::min(bucket, kNumBuckets - 1)]++;
+        mCount++;
+        mSum += value;
+        mMax = std::max(mMax, value);
+    }
+
+    uint64_t count() const { return mCount; }
+
+    uint64_t max() const { return mMax; }
+
+    uint64_t mean() const { return mCount == 0 ? 0 : mSum / mCount; }
+
+    /**
+     * @param percent The percentile to look up, between 0 and 100.
+     *
+     * @return The upper bound of the bucket the percentile falls in, capped at the max value seen.
+     */
+    uint64_t percentile(double percent) const {
+        uint64_t target = static_cast<uint64_t>(mCount * percent / 100.0);
+        uint64_t seen = 0;
+        for (size_t bucket = 0; bucket < kNumBuckets; bucket++) {
+            seen += mBuckets[bucket];
+            if (seen > target) {
+                return std::min(bucket == 0 ? 0 : (UINT64_C(1) << bucket) - 1, mMax);
+            }
+        }
+        return mMax;
+    }
+
+  private:
+    std::array<uint64_t, kNumBuckets> mBuckets{};
+    uint64_t mCount = 0;
+    uint64_t mSum = 0;
+    uint64_t mMax = 0;
+};
+
+/**
+ * Keeps the largest value seen during each of the last kNumSeconds seconds, e.g. to see how deep
+ * a queue got over time. Not thread safe, the owner must synchronize access.
+ */
+class PerSecondMax {
+  public:
+    static constexpr size_t kNumSeconds = 60;
+
+    void record(size_t value, int64_t nowNs) {
+        int64_t second = nowNs / INT64_C(1000000000);
+        advanceTo(second);
+        size_t& slot = mMaxPerSecond[second % kNumSeconds];
+        slot = std::max(slot, value);
+    }
+
+    /**
+     * @param nowNs The current time.
+     * @param secondsAgo How many seconds before the current one to look up.
+     *
+     * @return The largest value recorded during that second, or 0 if nothing was recorded.
+     */
+    size_t maxSecondsAgo(int64_t nowNs, size_t secondsAgo) const {
+        int64_t second = nowNs / INT64_C(1000000000) - static_cast<int64_t>(secondsAgo);
+        if (secondsAgo >= kNumSeconds || second > mCurrentSecond ||
+            second <= mCurrentSecond - static_cast<int64_t>(kNumSeconds)) {
+            return 0;
+        }
+        return mMaxPerSecond[second % kNumSeconds];
+    }
+
+  private:
+    void advanceTo(int64_t second) {
+        if (second <= mCurrentSecond) {
+            return;
+        }
+        int64_t numToClear = std::min(second - mCurrentSecond, static_cast<int64_t>(kNumSeconds));
+        for (int64_t i = 1; i <= numToClear; i++) {
+            mMaxPerSecond[(mCurrentSecond + i) % kNumSeconds] = 0;
+        }
+        mCurrentSecond = second;
+    }
+
+    std::array<size_t, kNumSeconds> mMaxPerSecond{};
+    int64_t mCurrentSecond = 0;
+};
+
+/**
+ * Event counters kept by the HalProxy for each subhal and for each sensor.
+ */
+struct EventStats {
+    //! The number of events written to the event fmq.
+    uint64_t numEventsWritten = 0;
+
+    //! The number of events that had to go through the pending write events queue.
+    uint64_t numEventsQueued = 0;
+
+    //! The number of events dropped because the pending write events queue was full or the
+    //! blocking write to the event fmq timed out.
+    uint64_t numEventsDropped = 0;
+
+    //! Microseconds from the event timestamp to the event being written to the event fmq.
+    Log2Histogram writeLatencyUs;
+
+    /**
+     * @param elapsedNs The time the events were counted over.
+     *
+     * @return The average number of events written per second.
+     */
+    double eventsPerSecond(int64_t elapsedNs) const {
+        return elapsedNs <= 0 ? 0.0 : numEventsWritten * 1e9 / elapsedNs;
+    }
+};
+
+}  // namespace implementation
+}  // namespace V2_0
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include "EventStats.h"
 #include "ScopedWakelock.h"
 #include "SubHal.h"
 
@@ -29,8 +30,8 @@
 #include <atomic>
 #include <condition_variable>
 #include <map>
+#include <memory>
 #include <mutex>
-#include <queue>
 #include <thread>
 #include <utility>
 
@@ -59,6 +60,9 @@ class HalProxy : public ISensors, public IScopedWakelockRefCounter {
     using SharedMemInfo = ::android::hardware::sensors::V1_0::SharedMemInfo;
     using ISensorsSubHal = ::android::hardware::sensors::V2_0::implementation::ISensorsSubHal;
 
+    //! The max number of events allowed in the pending write events queue
+    static constexpr size_t kMaxSizePendingWriteEventsQueue = 100000;
+
     explicit HalProxy();
     // Test only constructor.
     explicit HalProxy(std::vector<ISensorsSubHal*>& subHalList);
@@ -110,12 +114,17 @@ class HalProxy : public ISensors, public IScopedWakelockRefCounter {
      * remaining events to a background thread for a blocking write with a kPendingWriteTimeoutNs
      * timeout.
      *
-     * @param events The list of events to post to the message queue.
+     * The events are copied straight into the message queue slots, or the pending write ring,
+     * and have the subhal index set on their sensor handle there, so no intermediate copy of the
+     * events is made.
+     *
+     * @param events The list of events, as posted by the subhal, to post to the message queue.
+     * @param subHalIndex The index of the subhal that posted the events.
      * @param numWakeupEvents The number of wakeup events in events.
      * @param wakelock The wakelock associated with this post of events.
      */
-    void postEventsToMessageQueue(const std::vector<Event>& events, size_t numWakeupEvents,
-                                  ScopedWakelock wakelock);
+    void postEventsToMessageQueue(const std::vector<Event>& events, size_t subHalIndex,
+                                  size_t numWakeupEvents, ScopedWakelock wakelock);
 
     /**
      * Get the sensor info associated with that sensorHandle.
@@ -136,6 +145,7 @@ class HalProxy : public ISensors, public IScopedWakelockRefCounter {
 
   private:
     using EventMessageQueue = MessageQueue<Event, kSynchronizedReadWrite>;
+    using EventMemTransaction = EventMessageQueue::MemTransaction;
     using WakeLockMessageQueue = MessageQueue<uint32_t, kSynchronizedReadWrite>;
 
     /**
@@ -195,20 +205,38 @@ class HalProxy : public ISensors, public IScopedWakelockRefCounter {
     static constexpr int32_t kSensorHandleSubHalIndexMask = 0xFF000000;
 
     /**
-     * A FIFO queue of pairs of vector of events and the number of wakeup events in that vector
-     * which are waiting to be written to the events fmq in the background thread.
+     * A FIFO ring of kMaxSizePendingWriteEventsQueue events, with the subhal index already set on
+     * their sensor handles, which are waiting to be written to the events fmq in the background
+     * thread. It is allocated once so that overflowing the fmq does not allocate per batch.
      */
-    std::queue<std::pair<std::vector<Event>, size_t>> mPendingWriteEventsQueue;
+    std::unique_ptr<Event[]> mPendingWriteEventsQueue;
+
+    //! The index in mPendingWriteEventsQueue of the oldest pending write event.
+    size_t mPendingWriteEventsQueueHead = 0;
 
     //! The most events observed on the pending write events queue for debug purposes.
     size_t mMostEventsObservedPendingWriteEventsQueue = 0;
 
-    //! The max number of events allowed in the pending write events queue
-    static constexpr size_t kMaxSizePendingWriteEventsQueue = 100000;
-
     //! The number of events in the pending write events queue
     size_t mSizePendingWriteEventsQueue = 0;
 
+    // Event stats below, all guarded by mEventQueueWriteMutex and reset on initialize.
+
+    //! The elapsed realtime the event stats started being collected at.
+    int64_t mEventStatsStartTimeNs = 0;
+
+    //! The event stats for each subhal where the indices correlate with mSubHalList.
+    std::vector<EventStats> mSubHalEventStats;
+
+    //! The event stats for each sensor handle that has posted events.
+    std::map<int32_t, EventStats> mSensorEventStats;
+
+    //! The number of events on the pending write events queue, sampled whenever it changes.
+    Log2Histogram mPendingWriteEventsQueueDepth;
+
+    //! The deepest the pending write events queue got during each of the last seconds.
+    PerSecondMax mPendingWriteEventsQueueDepthHistory;
+
     //! The mutex protecting writing to the fmq and the pending events queue
     std::mutex mEventQueueWriteMutex;
 
@@ -242,6 +270,12 @@ class HalProxy : public ISensors, public IScopedWakelockRefCounter {
 
     int64_t mWakelockTimeoutResetTime = getTimeNow();
 
+    //! The time the shared wakelock was last acquired, used to measure how long it was held.
+    int64_t mWakelockAcquiredTime = 0;
+
+    //! How long in milliseconds the shared wakelock was held for each time it was released.
+    Log2Histogram mWakelockHoldTimeMs;
+
     const char* kWakelockName = "SensorsHAL_WAKEUP";
 
     /**
@@ -350,14 +384,91 @@ class HalProxy : public ISensors, public IScopedWakelockRefCounter {
     bool isSubHalIndexValid(int32_t sensorHandle);
 
     /**
-     * Count the number of wakeup events in the first n events of the vector.
+     * Write as many events as currently fit to the event fmq, setting the subhal index on their
+     * sensor handles in place, and keep writing while the reader frees up more room.
+     *
+     * Must be called with mEventQueueWriteMutex held.
+     *
+     * @param events The events to write.
+     * @param numEvents The number of events to write.
+     * @param subHalIndex The index of the subhal that posted the events.
+     *
+     * @return The number of events written to the event fmq.
+     */
+    size_t writeEventsToMessageQueueLocked(const Event* events, size_t numEvents,
+                                           size_t subHalIndex);
+
+    /**
+     * Append events to the tail of the pending write events ring, setting the subhal index on
+     * their sensor handles. The caller must have checked that there is room for them.
+     *
+     * Must be called with mEventQueueWriteMutex held.
+     *
+     * @param events The events to append.
+     * @param numEvents The number of events to append.
+     * @param subHalIndex The index of the subhal that posted the events.
+     */
+    void appendPendingWriteEventsLocked(const Event* events, size_t numEvents, size_t subHalIndex);
+
+    /**
+     * Update the event stats of the subhals and sensors of events that were just written to the
+     * event fmq. Must be called with mEventQueueWriteMutex held.
+     *
+     * @param events The events written, with the subhal index set on their handles.
+     * @param n The number of events written.
+     * @param queued Whether the events were written from the pending write events queue.
+     */
+    void recordEventsWrittenLocked(const Event* events, size_t n, bool queued);
+
+    /**
+     * Update the event stats of the subhals and sensors of events that were dropped. Must be
+     * called with mEventQueueWriteMutex held.
+     *
+     * @param events The events dropped, as posted by the subhal, without the subhal index set.
+     * @param n The number of events dropped.
+     * @param subHalIndex The index of the subhal the events came from.
+     */
+    void recordEventsDroppedLocked(const Event* events, size_t n, size_t subHalIndex);
+
+    /**
+     * Same as above for events from the pending write events queue, which may come from several
+     * subhals and already have the subhal index set on their handles.
+     */
+    void recordPendingWriteEventsDroppedLocked(const Event* events, size_t n);
+
+    //! Update the stats of the sensor with the given proxy handle and of its subhal.
+    void recordEventDroppedLocked(int32_t sensorHandle);
+
+    //! Record the current depth of the pending write events queue.
+    void recordPendingWriteEventsQueueDepthLocked();
+
+    //! Clear all event stats. Must be called with mEventQueueWriteMutex held.
+    void resetEventStatsLocked();
+
+    /**
+     * Write the event and wakelock stats in a human readable form.
+     *
+     * @param stream The stream to write to.
+     */
+    void dumpStats(std::ostream& stream);
+
+    /**
+     * Write the event and wakelock stats as one "key=value ..." record per line, which is what
+     * the --stats debug argument outputs.
+     *
+     * @param stream The stream to write to.
+     */
+    void dumpStatsMachineReadable(std::ostream& stream);
+
+    /**
+     * Count the number of wakeup events in the first n events of the array.
      *
-     * @param events The vector of Event objects.
+     * @param events The array of Event objects, with the subhal index set on their handles.
      * @param n The end index not inclusive of events to consider.
      *
      * @return The number of wakeup events of the considered events.
      */
-    size_t countNumWakeupEvents(const std::vector<Event>& events, size_t n);
+    size_t countNumWakeupEvents(const Event* events, size_t n);
 
     /*
      * Clear out the subhal index bytes from a sensorHandle.
@@ -404,8 +515,7 @@ class HalProxyCallback : public IHalProxyCallback {
     HalProxy* mHalProxy;
     int32_t mSubHalIndex;
 
-    std::vector<Event> processEvents(const std::vector<Event>& events,
-                                     size_t* numWakeupEvents) const;
+    size_t countNumWakeupEvents(const std::vector<Event>& events) const;
 };
 
 }  // namespace implementation
@@ -15,7 +15,9 @@
 
 #include <gtest/gtest.h>
 
+#include <android-base/file.h>
 #include <android/hardware/sensors/2.0/types.h>
+#include <cutils/native_handle.h>
 #include <fmq/MessageQueue.h>
 
 #include "HalProxy.h"
@@ -30,6 +32,7 @@
 namespace {
 
 using ::android::hardware::EventFlag;
+using ::android::hardware::hidl_handle;
 using ::android::hardware::hidl_vec;
 using ::android::hardware::MessageQueue;
 using ::android::hardware::Return;
@@ -726,8 +729,7 @@ TEST(HalProxyTest, PostedEventSensorHandleSubHalIndexValid) {
 
 TEST(HalProxyTest, FillAndDrainPendingQueueTest) {
     constexpr size_t kQueueSize = 5;
-    // TODO: Make this constant linked to same limit in HalProxy.h
-    constexpr size_t kMaxPendingQueueSize = 100000;
+    constexpr size_t kMaxPendingQueueSize = HalProxy::kMaxSizePendingWriteEventsQueue;
     AllSensorsSubHal subhal;
     std::vector<ISensorsSubHal*> subHals{&subhal};
 
@@ -763,6 +765,84 @@ TEST(HalProxyTest, FillAndDrainPendingQueueTest) {
     EXPECT_TRUE(readEventsOutOfQueue(1, eventQueue, eventQueueFlag));
 }
 
+TEST(HalProxyTest, PendingQueuePreservesOrderAndSubHalIndex) {
+    constexpr size_t kQueueSize = 5;
+    constexpr size_t kNumEvents = 8;
+    constexpr int64_t kReadBlockingTimeout = INT64_C(500000000);
+    constexpr int32_t subhal2Index = 1;
+    AllSensorsSubHal subhal1;
+    AllSensorsSubHal subhal2;
+    std::vector<ISensorsSubHal*> subHals{&subhal1, &subhal2};
+
+    std::unique_ptr<EventMessageQueue> eventQueue = makeEventFMQ(kQueueSize);
+    std::unique_ptr<WakeupMessageQueue> wakeLockQueue = makeWakelockFMQ(kQueueSize);
+    ::android::sp<ISensorsCallback> callback = new SensorsCallback();
+    EventFlag* eventQueueFlag;
+    EventFlag::createEventFlag(eventQueue->getEventFlagWord(), &eventQueueFlag);
+    HalProxy proxy(subHals);
+    proxy.initialize(*eventQueue->getDesc(), *wakeLockQueue->getDesc(), callback);
+
+    std::vector<Event> events = makeMultipleAccelerometerEvents(kNumEvents);
+    for (size_t i = 0; i < kNumEvents; i++) {
+        events[i].timestamp = i;
+    }
+    subhal2.postEvents(events, false);
+
+    // The first kQueueSize events go straight to the fmq and the rest through the pending queue
+    std::vector<Event> eventsOut(kNumEvents);
+    ASSERT_TRUE(eventQueue->readBlocking(
+            eventsOut.data(), kQueueSize, static_cast<uint32_t>(EventQueueFlagBits::EVENTS_READ),
+            static_cast<uint32_t>(EventQueueFlagBits::READ_AND_PROCESS), kReadBlockingTimeout,
+            eventQueueFlag));
+    ASSERT_TRUE(eventQueue->readBlocking(
+            eventsOut.data() + kQueueSize, kNumEvents - kQueueSize,
+            static_cast<uint32_t>(EventQueueFlagBits::EVENTS_READ),
+            static_cast<uint32_t>(EventQueueFlagBits::READ_AND_PROCESS), kReadBlockingTimeout,
+            eventQueueFlag));
+
+    for (size_t i = 0; i < kNumEvents; i++) {
+        EXPECT_EQ(eventsOut[i].timestamp, static_cast<int64_t>(i));
+        EXPECT_EQ(eventsOut[i].sensorHandle, (subhal2Index << 24) | events[i].sensorHandle);
+    }
+}
+
+TEST(HalProxyTest, DebugStatsCountDroppedEventsPerSubHal) {
+    constexpr size_t kQueueSize = 5;
+    constexpr size_t kMaxPendingQueueSize = HalProxy::kMaxSizePendingWriteEventsQueue;
+    constexpr size_t kNumDroppedEvents = 3;
+    AllSensorsSubHal subhal1;
+    AllSensorsSubHal subhal2;
+    std::vector<ISensorsSubHal*> subHals{&subhal1, &subhal2};
+
+    std::unique_ptr<EventMessageQueue> eventQueue = makeEventFMQ(kQueueSize);
+    std::unique_ptr<WakeupMessageQueue> wakeLockQueue = makeWakelockFMQ(kQueueSize);
+    ::android::sp<ISensorsCallback> callback = new SensorsCallback();
+    HalProxy proxy(subHals);
+    proxy.initialize(*eventQueue->getDesc(), *wakeLockQueue->getDesc(), callback);
+
+    // Fill the fmq and the pending queue then overflow the pending queue from the second subhal
+    std::vector<Event> events = makeMultipleAccelerometerEvents(kQueueSize);
+    subhal1.postEvents(events, false);
+    events = makeMultipleAccelerometerEvents(kMaxPendingQueueSize);
+    subhal1.postEvents(events, false);
+    events = makeMultipleAccelerometerEvents(kNumDroppedEvents);
+    subhal2.postEvents(events, false);
+
+    TemporaryFile dumpFile;
+    native_handle_t* handle = native_handle_create(1 /* numFds */, 0 /* numInts */);
+    handle->data[0] = dumpFile.fd;
+    proxy.debug(hidl_handle(handle), {"--stats"});
+    native_handle_delete(handle);
+
+    std::string dump;
+    ASSERT_TRUE(::android::base::ReadFileToString(dumpFile.path, &dump));
+    std::string subHal2Stats = dump.substr(dump.find("subhal index=1 "));
+    EXPECT_NE(subHal2Stats.find(" written=0 "), std::string::npos) << dump;
+    EXPECT_NE(subHal2Stats.find(" dropped=" + std::to_string(kNumDroppedEvents) + " "),
+              std::string::npos)
+            << dump;
+}
+
 // Helper implementations follow
 void testSensorsListFromProxyAndSubHal(const std::vector<SensorInfo>& proxySensorsList,
                                        const std::vector<SensorInfo>& subHalSensorsList) {
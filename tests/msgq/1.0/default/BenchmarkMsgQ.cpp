@@ -17,7 +17,9 @@
 #include "BenchmarkMsgQ.h"
 #include <iostream>
 #include <thread>
+#include <vector>
 #include <fmq/MessageQueue.h>
+#include "LatencyStats.h"
 
 namespace android {
 namespace hardware {
@@ -86,28 +88,33 @@ Return<void> BenchmarkMsgQ::benchmarkPingPong(uint32_t numIter) {
 Return<void> BenchmarkMsgQ::benchmarkServiceWriteClientRead(uint32_t numIter) {
     if (mTimeData) delete[] mTimeData;
     mTimeData = new (std::nothrow) int64_t[numIter];
+    mNumTimeData = mTimeData ? numIter : 0;
     std::thread(QueueWriter<kSynchronizedReadWrite>, mFmqOutbox,
                 mTimeData, numIter).detach();
     return Void();
 }
 
 Return<void> BenchmarkMsgQ::sendTimeData(const hidl_vec<int64_t>& clientRcvTimeArray) {
-    int64_t accumulatedTime = 0;
+    std::vector<int64_t> delays;
+    delays.reserve(clientRcvTimeArray.size());
 
-    for (uint32_t i = 0; i < clientRcvTimeArray.size(); i++) {
+    for (uint32_t i = 0; i < clientRcvTimeArray.size() && i < mNumTimeData; i++) {
         std::chrono::time_point<std::chrono::high_resolution_clock>
                 clientRcvTime((std::chrono::high_resolution_clock::duration(
                         clientRcvTimeArray[i])));
         std::chrono::time_point<std::chrono::high_resolution_clock>serverSendTime(
                 (std::chrono::high_resolution_clock::duration(mTimeData[i])));
-        accumulatedTime += static_cast<int64_t>(
+        delays.push_back(static_cast<int64_t>(
                 std::chrono::duration_cast<std::chrono::nanoseconds>(clientRcvTime -
-                                                                     serverSendTime).count());
+                                                                     serverSendTime).count()));
     }
 
-    accumulatedTime /= clientRcvTimeArray.size();
-    std::cout << "Average service to client write to read delay::"
-         << accumulatedTime << "ns" << std::endl;
+    /*
+     * One JSON object per line, so that runs can be collected by scripts.
+     */
+    std::cout << "{\"benchmark\":\"ServiceWriteClientRead\",\"packet_size\":" << kPacketSize64
+              << ",\"latency\":" << LatencyStats::compute(&delays).toJson() << "}"
+              << std::endl;
     return Void();
 }
 
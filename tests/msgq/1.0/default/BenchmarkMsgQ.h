@@ -85,7 +85,8 @@ struct BenchmarkMsgQ : public IBenchmarkMsgQ {
 private:
     android::hardware::MessageQueue<uint8_t, kSynchronizedReadWrite>* mFmqInbox;
     android::hardware::MessageQueue<uint8_t, kSynchronizedReadWrite>* mFmqOutbox;
-    int64_t* mTimeData;
+    int64_t* mTimeData = nullptr;
+    uint32_t mNumTimeData = 0;
 };
 
 extern "C" IBenchmarkMsgQ* HIDL_FETCH_IBenchmarkMsgQ(const char* name);
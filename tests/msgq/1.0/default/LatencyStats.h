@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HARDWARE_TESTS_MSGQ_V1_0_LATENCYSTATS_H
+#define ANDROID_HARDWARE_TESTS_MSGQ_V1_0_LATENCYSTATS_H
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace tests {
+namespace msgq {
+namespace V1_0 {
+namespace implementation {
+
+/*
+ * Summary of a set of latency samples, in ns.
+ */
+struct LatencyStats {
+    size_t count = 0;
+    int64_t average = 0;
+    int64_t p50 = 0;
+    int64_t p99 = 0;
+    int64_t p999 = 0;
+    int64_t max = 0;
+
+    /*
+     * Computes the summary of the samples. The samples are reordered.
+     */
+    static LatencyStats compute(std::vector<int64_t>* samples) {
+        LatencyStats stats;
+        stats.count = samples->size();
+        if (samples->empty()) return stats;
+        int64_t total = 0;
+        for (int64_t sample : *samples) {
+            total += sample;
+        }
+        stats.average = total / static_cast<int64_t>(samples->size());
+        // Select the percentiles in increasing order, so that each selection
+        // only has to look at the samples above the previous one.
+        auto begin = samples->begin();
+        for (auto percentile : {std::make_pair(500, &stats.p50),
+                                std::make_pair(990, &stats.p99),
+                                std::make_pair(999, &stats.p999),
+                                std::make_pair(1000, &stats.max)}) {
+            auto nth = samples->begin() +
+                    std::min(samples->size() - 1, samples->size() * percentile.first / 1000);
+            std::nth_element(begin, nth, samples->end());
+            *percentile.second = *nth;
+            begin = nth;
+        }
+        return stats;
+    }
+
+    /*
+     * Formats the summary as a single line JSON object.
+     */
+    std::string toJson() const {
+        return "{\"count\":" + std::to_string(count) +
+               ",\"avg_ns\":" + std::to_string(average) +
+               ",\"p50_ns\":" + std::to_string(p50) +
+               ",\"p99_ns\":" + std::to_string(p99) +
+               ",\"p999_ns\":" + std::to_string(p999) +
+               ",\"max_ns\":" + std::to_string(max) + "}";
+    }
+};
+
+}  // namespace implementation
+}  // namespace V1_0
+}  // namespace msgq
+}  // namespace tests
+}  // namespace hardware
+}  // namespace android
+
+#endif  // ANDROID_HARDWARE_TESTS_MSGQ_V1_0_LATENCYSTATS_H
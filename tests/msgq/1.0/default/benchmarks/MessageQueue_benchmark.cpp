@@ -0,0 +1,342 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Measures FMQ throughput and write to read latency between threads, for:
+ * - synchronized and unsynchronized queues,
+ * - waiting on the EventFlag or spinning when the queue is full or empty,
+ * - the copying read()/write() against beginRead()/beginWrite() in place,
+ * - packets from 8 B to 64 KiB, queues from 4 to 64 packets deep,
+ * - one to four readers of an unsynchronized queue.
+ *
+ * Each iteration writes one packet. The first 8 bytes of each packet carry the
+ * time it was written, from which the readers sample the latency. Run with
+ * --benchmark_format=json or --benchmark_out=<file> for machine-readable
+ * results; the latency percentiles are reported as the p50_ns, p99_ns and
+ * p999_ns counters.
+ */
+
+#include <benchmark/benchmark.h>
+#include <fmq/EventFlag.h>
+#include <fmq/MessageQueue.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "LatencyStats.h"
+
+namespace android {
+namespace hardware {
+namespace tests {
+namespace msgq {
+namespace V1_0 {
+namespace implementation {
+
+using android::hardware::EventFlag;
+using android::hardware::kSynchronizedReadWrite;
+using android::hardware::kUnsynchronizedWrite;
+using android::hardware::MessageQueue;
+using android::hardware::MQFlavor;
+
+enum class Api { kCopy, kZeroCopy };
+enum class Wait { kSpin, kEventFlag };
+
+/*
+ * The EventFlag bits, as used by the audio HAL data path.
+ */
+static constexpr uint32_t kNotEmpty = 1 << 0;
+static constexpr uint32_t kNotFull = 1 << 1;
+/*
+ * Bounds an EventFlag wait, so that the reader notices the end of the run.
+ */
+static constexpr int64_t kWaitTimeoutNs = 10 * 1000 * 1000;
+/*
+ * A spinning thread yields after this many failed attempts, so that the run
+ * still makes progress when there are more threads than CPUs.
+ */
+static constexpr int kSpinsBeforeYield = 256;
+static constexpr size_t kMaxLatencySamples = 1 << 20;
+static constexpr uint8_t kPayloadByte = 0xa5;
+
+static int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+}
+
+/*
+ * Either waits for |bit| on |eventFlag|, or spins.
+ */
+class Waiter {
+  public:
+    explicit Waiter(EventFlag* eventFlag) : mEventFlag(eventFlag) {}
+
+    void wait(uint32_t bit) {
+        if (mEventFlag != nullptr) {
+            uint32_t efState = 0;
+            mEventFlag->wait(bit, &efState, kWaitTimeoutNs, true /* retry */);
+        } else if (++mSpins == kSpinsBeforeYield) {
+            mSpins = 0;
+            std::this_thread::yield();
+        }
+    }
+
+    void wake(uint32_t bit) {
+        if (mEventFlag != nullptr) {
+            mEventFlag->wake(bit);
+        }
+    }
+
+  private:
+    EventFlag* mEventFlag;
+    int mSpins = 0;
+};
+
+template <MQFlavor flavor>
+static bool tryWritePacket(MessageQueue<uint8_t, flavor>* mq, Api api, uint8_t* packet,
+                           size_t size) {
+    const int64_t timestamp = nowNs();
+    if (api == Api::kCopy) {
+        memcpy(packet, &timestamp, sizeof(timestamp));
+        return mq->write(packet, size);
+    }
+    // Produce the whole payload in place, across both regions of the ring, as
+    // the copy above writes the whole packet.
+    typename MessageQueue<uint8_t, flavor>::MemTransaction tx;
+    if (!mq->beginWrite(size, &tx)) {
+        return false;
+    }
+    for (const auto& region : {tx.getFirstRegion(), tx.getSecondRegion()}) {
+        if (region.getLength() > 0) {
+            memset(region.getAddress(), kPayloadByte, region.getLength());
+        }
+    }
+    tx.copyTo(reinterpret_cast<const uint8_t*>(&timestamp), 0, sizeof(timestamp));
+    return mq->commitWrite(size);
+}
+
+template <MQFlavor flavor>
+static bool tryReadPacket(MessageQueue<uint8_t, flavor>* mq, Api api, uint8_t* packet,
+                          size_t size, int64_t* timestamp) {
+    if (api == Api::kCopy) {
+        if (!mq->read(packet, size)) {
+            return false;
+        }
+        memcpy(timestamp, packet, sizeof(*timestamp));
+        return true;
+    }
+    // Consume the whole payload in place, across both regions of the ring, as
+    // the copy above reads the whole packet.
+    typename MessageQueue<uint8_t, flavor>::MemTransaction tx;
+    if (!mq->beginRead(size, &tx)) {
+        return false;
+    }
+    uint32_t sum = 0;
+    for (const auto& region : {tx.getFirstRegion(), tx.getSecondRegion()}) {
+        const uint8_t* data = region.getAddress();
+        for (size_t i = 0; i < region.getLength(); i++) {
+            sum += data[i];
+        }
+    }
+    benchmark::DoNotOptimize(sum);
+    tx.copyFrom(reinterpret_cast<uint8_t*>(timestamp), 0, sizeof(*timestamp));
+    return mq->commitRead(size);
+}
+
+struct Reader {
+    std::unique_ptr<MessageQueue<uint8_t, kSynchronizedReadWrite>> syncMq;
+    std::unique_ptr<MessageQueue<uint8_t, kUnsynchronizedWrite>> unsyncMq;
+    std::atomic<uint64_t> packetsRead{0};
+    std::vector<int64_t> latencies;
+    std::thread thread;
+};
+
+template <MQFlavor flavor>
+static MessageQueue<uint8_t, flavor>* readerQueue(Reader* reader);
+
+template <>
+MessageQueue<uint8_t, kSynchronizedReadWrite>* readerQueue(Reader* reader) {
+    return reader->syncMq.get();
+}
+
+template <>
+MessageQueue<uint8_t, kUnsynchronizedWrite>* readerQueue(Reader* reader) {
+    return reader->unsyncMq.get();
+}
+
+template <MQFlavor flavor>
+static void setReaderQueue(Reader* reader, const typename MessageQueue<uint8_t, flavor>::Descriptor&);
+
+template <>
+void setReaderQueue<kSynchronizedReadWrite>(
+        Reader* reader, const MessageQueue<uint8_t, kSynchronizedReadWrite>::Descriptor& desc) {
+    reader->syncMq.reset(new MessageQueue<uint8_t, kSynchronizedReadWrite>(desc));
+}
+
+template <>
+void setReaderQueue<kUnsynchronizedWrite>(
+        Reader* reader, const MessageQueue<uint8_t, kUnsynchronizedWrite>::Descriptor& desc) {
+    reader->unsyncMq.reset(new MessageQueue<uint8_t, kUnsynchronizedWrite>(desc));
+}
+
+/*
+ * Arguments: packet size in bytes, number of readers, queue depth in packets.
+ */
+template <MQFlavor flavor, Api api, Wait wait>
+static void BM_MessageQueue(benchmark::State& state) {
+    const size_t packetSize = state.range(0);
+    const size_t numReaders = state.range(1);
+    const size_t depth = state.range(2);
+
+    MessageQueue<uint8_t, flavor> mq(packetSize * depth, wait == Wait::kEventFlag);
+    if (!mq.isValid()) {
+        state.SkipWithError("Failed to create the FMQ");
+        return;
+    }
+    EventFlag* eventFlag = nullptr;
+    if (wait == Wait::kEventFlag &&
+        EventFlag::createEventFlag(mq.getEventFlagWord(), &eventFlag) != ::android::OK) {
+        state.SkipWithError("Failed to create the EventFlag");
+        return;
+    }
+
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> packetsWritten{0};
+    std::vector<std::unique_ptr<Reader>> readers;
+    for (size_t i = 0; i < numReaders; i++) {
+        readers.emplace_back(new Reader());
+        Reader* reader = readers.back().get();
+        setReaderQueue<flavor>(reader, *mq.getDesc());
+        reader->latencies.reserve(kMaxLatencySamples / numReaders);
+    }
+    for (auto& readerPtr : readers) {
+        Reader* reader = readerPtr.get();
+        reader->thread = std::thread([&, reader] {
+            MessageQueue<uint8_t, flavor>* readerMq = readerQueue<flavor>(reader);
+            std::vector<uint8_t> packet(packetSize);
+            Waiter waiter(eventFlag);
+            while (true) {
+                int64_t timestamp;
+                if (tryReadPacket(readerMq, api, packet.data(), packetSize, &timestamp)) {
+                    waiter.wake(kNotFull);
+                    if (reader->latencies.size() < reader->latencies.capacity()) {
+                        reader->latencies.push_back(nowNs() - timestamp);
+                    }
+                    reader->packetsRead.store(reader->packetsRead + 1, std::memory_order_release);
+                    continue;
+                }
+                if (stop.load(std::memory_order_acquire) &&
+                    reader->packetsRead >= packetsWritten.load(std::memory_order_acquire)) {
+                    break;
+                }
+                waiter.wait(kNotEmpty);
+            }
+        });
+    }
+
+    std::vector<uint8_t> packet(packetSize, kPayloadByte);
+    Waiter waiter(eventFlag);
+    uint64_t written = 0;
+    for (auto _ : state) {
+        if (flavor == kUnsynchronizedWrite) {
+            // An unsynchronized writer never fails, so wait for the slowest
+            // reader to make room instead of overwriting unread packets.
+            for (auto& reader : readers) {
+                while (written - reader->packetsRead.load(std::memory_order_acquire) >= depth) {
+                    waiter.wait(kNotFull);
+                }
+            }
+        }
+        while (!tryWritePacket(&mq, api, packet.data(), packetSize)) {
+            waiter.wait(kNotFull);
+        }
+        waiter.wake(kNotEmpty);
+        packetsWritten.store(++written, std::memory_order_release);
+    }
+
+    stop.store(true, std::memory_order_release);
+    waiter.wake(kNotEmpty);
+    std::vector<int64_t> latencies;
+    for (auto& reader : readers) {
+        reader->thread.join();
+        latencies.insert(latencies.end(), reader->latencies.begin(), reader->latencies.end());
+    }
+    if (eventFlag != nullptr) {
+        EventFlag::deleteEventFlag(&eventFlag);
+    }
+
+    const LatencyStats stats = LatencyStats::compute(&latencies);
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * packetSize);
+    state.counters["p50_ns"] = stats.p50;
+    state.counters["p99_ns"] = stats.p99;
+    state.counters["p999_ns"] = stats.p999;
+}
+
+static const std::vector<int64_t> kPacketSizes = {8, 64, 512, 4096, 32768, 65536};
+
+static void SingleReaderArgs(benchmark::internal::Benchmark* b) {
+    b->ArgNames({"size", "readers", "depth"});
+    for (int64_t size : kPacketSizes) {
+        for (int64_t depth : {4, 64}) {
+            b->Args({size, 1, depth});
+        }
+    }
+}
+
+static void MultipleReaderArgs(benchmark::internal::Benchmark* b) {
+    b->ArgNames({"size", "readers", "depth"});
+    for (int64_t size : kPacketSizes) {
+        for (int64_t readers : {1, 2, 4}) {
+            b->Args({size, readers, 64});
+        }
+    }
+}
+
+// A synchronized queue has a single reader.
+BENCHMARK_TEMPLATE(BM_MessageQueue, kSynchronizedReadWrite, Api::kCopy, Wait::kSpin)
+        ->Apply(SingleReaderArgs)
+        ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_MessageQueue, kSynchronizedReadWrite, Api::kCopy, Wait::kEventFlag)
+        ->Apply(SingleReaderArgs)
+        ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_MessageQueue, kSynchronizedReadWrite, Api::kZeroCopy, Wait::kSpin)
+        ->Apply(SingleReaderArgs)
+        ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_MessageQueue, kSynchronizedReadWrite, Api::kZeroCopy, Wait::kEventFlag)
+        ->Apply(SingleReaderArgs)
+        ->UseRealTime();
+// Readers of an unsynchronized queue can't share the kNotFull bit, so they
+// only spin.
+BENCHMARK_TEMPLATE(BM_MessageQueue, kUnsynchronizedWrite, Api::kCopy, Wait::kSpin)
+        ->Apply(MultipleReaderArgs)
+        ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_MessageQueue, kUnsynchronizedWrite, Api::kZeroCopy, Wait::kSpin)
+        ->Apply(MultipleReaderArgs)
+        ->UseRealTime();
+
+}  // namespace implementation
+}  // namespace V1_0
+}  // namespace msgq
+}  // namespace tests
+}  // namespace hardware
+}  // namespace android
+
+BENCHMARK_MAIN();
@@ -28,6 +28,9 @@ namespace implementation {
 
 #define WAIT_TIMEOUT 3000000000
 
+// Packets read from the frontend source file and dispatched to the filters per iteration
+const size_t FRONTEND_INPUT_PACKETS_PER_BLOCK = 1024;
+
 Demux::Demux(uint32_t demuxId, sp<Tuner> tuner) {
     mDemuxId = demuxId;
     mTunerService = tuner;
@@ -61,15 +64,18 @@ Return<void> Demux::openFilter(const DemuxFilterType& type, uint32_t bufferSize,
 
     uint32_t filterId;
 
-    if (!mUnusedFilterIds.empty()) {
-        filterId = *mUnusedFilterIds.begin();
+    {
+        std::lock_guard<std::mutex> lock(mFilterLock);
+        if (!mUnusedFilterIds.empty()) {
+            filterId = *mUnusedFilterIds.begin();
 
-        mUnusedFilterIds.erase(filterId);
-    } else {
-        filterId = ++mLastUsedFilterId;
-    }
+            mUnusedFilterIds.erase(filterId);
+        } else {
+            filterId = ++mLastUsedFilterId;
+        }
 
-    mUsedFilterIds.insert(filterId);
+        mUsedFilterIds.insert(filterId);
+    }
 
     if (cb == nullptr) {
         ALOGW("callback can't be null");
@@ -84,7 +90,11 @@ Return<void> Demux::openFilter(const DemuxFilterType& type, uint32_t bufferSize,
         return Void();
     }
 
-    mFilters[filterId] = filter;
+    {
+        std::lock_guard<std::mutex> lock(mFilterLock);
+        mFilters[filterId] = filter;
+        mPidTableDirty = true;
+    }
 
     _hidl_cb(Result::SUCCESS, filter);
     return Void();
@@ -120,9 +130,11 @@ Return<void> Demux::getAvSyncTime(AvSyncHwId /* avSyncHwId */, getAvSyncTime_cb
 Return<Result> Demux::close() {
     ALOGV("%s", __FUNCTION__);
 
+    std::lock_guard<std::mutex> lock(mFilterLock);
     mUnusedFilterIds.clear();
     mUsedFilterIds.clear();
     mLastUsedFilterId = -1;
+    mPidTableDirty = true;
 
     return Result::SUCCESS;
 }
@@ -166,34 +178,52 @@ Result Demux::removeFilter(uint32_t filterId) {
     ALOGV("%s", __FUNCTION__);
 
     // resetFilterRecords(filterId);
+    std::lock_guard<std::mutex> lock(mFilterLock);
     mUsedFilterIds.erase(filterId);
     mRecordFilterIds.erase(filterId);
     mUnusedFilterIds.insert(filterId);
     mFilters.erase(filterId);
+    mPidTableDirty = true;
 
     return Result::SUCCESS;
 }
 
-void Demux::startBroadcastTsFilter(vector<uint8_t> data) {
-    set<uint32_t>::iterator it;
-    for (it = mUsedFilterIds.begin(); it != mUsedFilterIds.end(); it++) {
-        uint16_t pid = ((data[1] & 0x1f) << 8) | ((data[2] & 0xff));
-        if (DEBUG_FILTER) {
-            ALOGW("start ts filter pid: %d", pid);
-        }
-        if (pid == mFilters[*it]->getTpid()) {
-            mFilters[*it]->updateFilterOutput(data);
+void Demux::onFilterTpidChanged() {
+    std::lock_guard<std::mutex> lock(mFilterLock);
+    mPidTableDirty = true;
+}
+
+void Demux::updatePidTableLocked() {
+    if (!mPidTableDirty) {
+        return;
+    }
+    mPidTable.clear();
+    for (uint32_t filterId : mUsedFilterIds) {
+        auto filter = mFilters.find(filterId);
+        if (filter != mFilters.end() && filter->second != nullptr) {
+            mPidTable.add(filter->second->getTpid(), filter->second);
         }
     }
+    mPidTableDirty = false;
+}
+
+void Demux::startBroadcastTsFilter(const uint8_t* block, size_t size) {
+    std::lock_guard<std::mutex> lock(mFilterLock);
+    updatePidTableLocked();
+    mPidTable.dispatch(block, size, TS_PACKET_SIZE,
+                       [](const sp<Filter>& filter, const uint8_t* packet) {
+                           filter->updateFilterOutput(packet, TS_PACKET_SIZE);
+                       });
 }
 
-void Demux::sendFrontendInputToRecord(vector<uint8_t> data) {
+void Demux::sendFrontendInputToRecord(const uint8_t* block, size_t size) {
+    std::lock_guard<std::mutex> lock(mFilterLock);
     set<uint32_t>::iterator it;
     for (it = mRecordFilterIds.begin(); it != mRecordFilterIds.end(); it++) {
         if (DEBUG_FILTER) {
             ALOGW("update record filter output");
         }
-        mFilters[*it]->updateRecordOutput(data);
+        mFilters[*it]->updateRecordOutput(block, size);
     }
 }
 
@@ -226,8 +256,8 @@ Result Demux::startFilterHandler(uint32_t filterId) {
     return mFilters[filterId]->startFilterHandler();
 }
 
-void Demux::updateFilterOutput(uint16_t filterId, vector<uint8_t> data) {
-    mFilters[filterId]->updateFilterOutput(data);
+void Demux::updateFilterOutput(uint16_t filterId, const uint8_t* data, size_t size) {
+    mFilters[filterId]->updateFilterOutput(data, size);
 }
 
 uint16_t Demux::getFilterTpid(uint32_t filterId) {
@@ -252,56 +282,42 @@ void Demux::frontendInputThreadLoop() {
     mFrontendInputThreadRunning = true;
     mKeepFetchingDataFromFrontend = true;
 
-    // open the stream and get its length
-    std::ifstream inputData(mFrontendSourceFile, std::ifstream::binary);
     // TODO take the packet size from the frontend setting
-    int packetSize = 188;
-    int writePacketAmount = 6;
-    char* buffer = new char[packetSize];
+    TsBlockReader inputData(TS_PACKET_SIZE, FRONTEND_INPUT_PACKETS_PER_BLOCK);
     ALOGW("[Demux] Frontend input thread loop start %s", mFrontendSourceFile.c_str());
-    if (!inputData.is_open()) {
+    if (!inputData.open(mFrontendSourceFile)) {
         mFrontendInputThreadRunning = false;
         ALOGW("[Demux] Error %s", strerror(errno));
     }
 
     while (mFrontendInputThreadRunning) {
-        // move the stream pointer for packet size * 6 every read until the end
+        // read a block of packets every time until the end
         while (mKeepFetchingDataFromFrontend) {
-            for (int i = 0; i < writePacketAmount; i++) {
-                inputData.read(buffer, packetSize);
-                if (!inputData) {
-                    mKeepFetchingDataFromFrontend = false;
-                    mFrontendInputThreadRunning = false;
-                    break;
-                }
-                // filter and dispatch filter output
-                vector<uint8_t> byteBuffer;
-                byteBuffer.resize(packetSize);
-                for (int index = 0; index < byteBuffer.size(); index++) {
-                    byteBuffer[index] = static_cast<uint8_t>(buffer[index]);
-                }
-                if (mIsRecording) {
-                    // Feed the data into the Dvr recording input
-                    sendFrontendInputToRecord(byteBuffer);
-                } else {
-                    // Feed the data into the broadcast demux filter
-                    startBroadcastTsFilter(byteBuffer);
-                }
+            const uint8_t* block;
+            size_t size = inputData.readBlock(&block);
+            if (size == 0) {
+                mKeepFetchingDataFromFrontend = false;
+                mFrontendInputThreadRunning = false;
+                break;
             }
+            // filter and dispatch filter output
             if (mIsRecording) {
+                // Feed the data into the Dvr recording input
+                sendFrontendInputToRecord(block, size);
                 // Dispatch the data into the broadcasting filters.
                 startRecordFilterDispatcher();
             } else {
+                // Feed the data into the broadcast demux filter
+                startBroadcastTsFilter(block, size);
                 // Dispatch the data into the broadcasting filters.
                 startBroadcastFilterDispatcher();
             }
-            usleep(100);
+            // Keep the simulated input rate of 6 packets per 100us
+            usleep(100 * (size / TS_PACKET_SIZE) / 6);
         }
     }
 
     ALOGW("[Demux] Frontend Input thread end.");
-    delete[] buffer;
-    inputData.close();
 }
 
 void Demux::stopFrontendInput() {
@@ -320,7 +336,10 @@ bool Demux::attachRecordFilter(int filterId) {
         return false;
     }
 
-    mRecordFilterIds.insert(filterId);
+    {
+        std::lock_guard<std::mutex> lock(mFilterLock);
+        mRecordFilterIds.insert(filterId);
+    }
     mFilters[filterId]->attachFilterToRecord(mDvr);
 
     return true;
@@ -331,7 +350,10 @@ bool Demux::detachRecordFilter(int filterId) {
         return false;
     }
 
-    mRecordFilterIds.erase(filterId);
+    {
+        std::lock_guard<std::mutex> lock(mFilterLock);
+        mRecordFilterIds.erase(filterId);
+    }
     mFilters[filterId]->detachFilterFromRecord();
 
     return true;
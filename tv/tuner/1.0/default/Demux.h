@@ -25,6 +25,7 @@
 #include "Filter.h"
 #include "Frontend.h"
 #include "TimeFilter.h"
+#include "TsDemuxEngine.h"
 #include "Tuner.h"
 
 using namespace std;
@@ -86,9 +87,14 @@ class Demux : public IDemux {
     bool attachRecordFilter(int filterId);
     bool detachRecordFilter(int filterId);
     Result startFilterHandler(uint32_t filterId);
-    void updateFilterOutput(uint16_t filterId, vector<uint8_t> data);
+    void updateFilterOutput(uint16_t filterId, const uint8_t* data, size_t size);
     uint16_t getFilterTpid(uint32_t filterId);
     void setIsRecording(bool isRecording);
+    /**
+     * Called when a filter's tpid changes so that the PID table is rebuilt before
+     * the next block of frontend input is dispatched.
+     */
+    void onFilterTpidChanged();
 
   private:
     // Tuner service
@@ -123,9 +129,14 @@ class Demux : public IDemux {
      * Note that recording filters are not included.
      */
     bool startBroadcastFilterDispatcher();
-    void startBroadcastTsFilter(vector<uint8_t> data);
+    /**
+     * Route every packet of a block of frontend input to the filters of its PID.
+     * Filters get pointers into the block instead of a copy per packet.
+     */
+    void startBroadcastTsFilter(const uint8_t* block, size_t size);
+    void updatePidTableLocked();
 
-    void sendFrontendInputToRecord(vector<uint8_t> data);
+    void sendFrontendInputToRecord(const uint8_t* block, size_t size);
     bool startRecordFilterDispatcher();
 
     uint32_t mDemuxId;
@@ -157,6 +168,11 @@ class Demux : public IDemux {
      * The array number is the filter ID.
      */
     std::map<uint32_t, sp<Filter>> mFilters;
+    /**
+     * PID to the filters of mUsedFilterIds, started or not, rebuilt when mPidTableDirty is set.
+     */
+    TsPidTable<sp<Filter>> mPidTable;
+    bool mPidTableDirty = true;
 
     /**
      * Local reference to the opened DVR object.
@@ -182,11 +198,11 @@ class Demux : public IDemux {
      * Lock to protect writes to the input status
      */
     std::mutex mFrontendInputThreadLock;
-
-    // temp handle single PES filter
-    // TODO handle mulptiple Pes filters
-    int mPesSizeLeft = 0;
-    vector<uint8_t> mPesOutput;
+    /**
+     * Lock to protect mFilters, mUsedFilterIds and the PID table between the binder threads
+     * and the frontend input thread
+     */
+    std::mutex mFilterLock;
 
     const bool DEBUG_FILTER = false;
 };
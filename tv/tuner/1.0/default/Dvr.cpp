@@ -268,15 +268,15 @@ bool Dvr::readPlaybackFMQ() {
     return true;
 }
 
-void Dvr::startTpidFilter(vector<uint8_t> data) {
+void Dvr::startTpidFilter(const vector<uint8_t>& data) {
     std::map<uint32_t, sp<IFilter>>::iterator it;
+    uint16_t pid = getTsPacketPid(data.data());
+    if (DEBUG_DVR) {
+        ALOGW("[Dvr] start ts filter pid: %d", pid);
+    }
     for (it = mFilters.begin(); it != mFilters.end(); it++) {
-        uint16_t pid = ((data[1] & 0x1f) << 8) | ((data[2] & 0xff));
-        if (DEBUG_DVR) {
-            ALOGW("[Dvr] start ts filter pid: %d", pid);
-        }
         if (pid == mDemux->getFilterTpid(it->first)) {
-            mDemux->updateFilterOutput(it->first, data);
+            mDemux->updateFilterOutput(it->first, data.data(), data.size());
         }
     }
 }
@@ -104,7 +104,7 @@ class Dvr : public IDvr {
      * Each filter handler handles the data filtering/output writing/filterEvent updating.
      */
     bool readPlaybackFMQ();
-    void startTpidFilter(vector<uint8_t> data);
+    void startTpidFilter(const vector<uint8_t>& data);
     bool startFilterDispatcher();
     static void* __threadLoopPlayback(void* user);
     static void* __threadLoopRecord(void* user);
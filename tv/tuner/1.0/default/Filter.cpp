@@ -71,6 +71,14 @@ Return<Result> Filter::configure(const DemuxFilterSettings& settings) {
     switch (mType.mainType) {
         case DemuxFilterMainType::TS:
             mTpid = settings.ts().tpid;
+            if (mPayloadAssembler != nullptr &&
+                settings.ts().filterSettings.getDiscriminator() ==
+                        DemuxTsFilterSettings::FilterSettings::hidl_discriminator::section) {
+                mPayloadAssembler->setCheckCrc(settings.ts().filterSettings.section().isCheckCrc);
+            }
+            if (mDemux != nullptr) {
+                mDemux->onFilterTpidChanged();
+            }
             break;
         case DemuxFilterMainType::MMTP:
             /*mmtpSettings*/
@@ -110,6 +118,16 @@ Return<Result> Filter::stop() {
 Return<Result> Filter::flush() {
     ALOGV("%s", __FUNCTION__);
 
+    // The units in progress can't be completed after the flushed data
+    {
+        std::lock_guard<std::mutex> outputLock(mFilterOutputLock);
+        std::lock_guard<std::mutex> writeLock(mWriteLock);
+        mFilterOutput.clear();
+        if (mPayloadAssembler != nullptr) {
+            mPayloadAssembler->reset();
+        }
+    }
+
     // temp implementation to flush the FMQ
     int size = mFilterMQ->availableToRead();
     char* buffer = new char[size];
@@ -149,6 +167,21 @@ bool Filter::createFilterMQ() {
         return false;
     }
 
+    if (mType.mainType == DemuxFilterMainType::TS) {
+        switch (mType.subType.tsFilterType()) {
+            case DemuxTsFilterType::SECTION:
+                mPayloadAssembler.reset(
+                        new TsPayloadAssembler(TsPayloadType::SECTION, mFilterMQ.get()));
+                break;
+            case DemuxTsFilterType::PES:
+                mPayloadAssembler.reset(
+                        new TsPayloadAssembler(TsPayloadType::PES, mFilterMQ.get()));
+                break;
+            default:
+                break;
+        }
+    }
+
     return true;
 }
 
@@ -263,16 +296,20 @@ uint16_t Filter::getTpid() {
     return mTpid;
 }
 
-void Filter::updateFilterOutput(vector<uint8_t> data) {
+void Filter::updateFilterOutput(const uint8_t* data, size_t size) {
     std::lock_guard<std::mutex> lock(mFilterOutputLock);
-    ALOGD("[Filter] filter output updated");
-    mFilterOutput.insert(mFilterOutput.end(), data.begin(), data.end());
+    if (DEBUG_FILTER) {
+        ALOGD("[Filter] filter output updated");
+    }
+    mFilterOutput.insert(mFilterOutput.end(), data, data + size);
 }
 
-void Filter::updateRecordOutput(vector<uint8_t> data) {
+void Filter::updateRecordOutput(const uint8_t* data, size_t size) {
     std::lock_guard<std::mutex> lock(mRecordFilterOutputLock);
-    ALOGD("[Filter] record filter output updated");
-    mRecordFilterOutput.insert(mRecordFilterOutput.end(), data.begin(), data.end());
+    if (DEBUG_FILTER) {
+        ALOGD("[Filter] record filter output updated");
+    }
+    mRecordFilterOutput.insert(mRecordFilterOutput.end(), data, data + size);
 }
 
 Result Filter::startFilterHandler() {
@@ -324,87 +361,92 @@ Result Filter::startFilterHandler() {
 }
 
 Result Filter::startSectionFilterHandler() {
-    if (mFilterOutput.empty()) {
-        return Result::SUCCESS;
-    }
-    if (!writeSectionsAndCreateEvent(mFilterOutput)) {
-        ALOGD("[Filter] filter %d fails to write into FMQ. Ending thread", mFilterId);
-        return Result::UNKNOWN_ERROR;
-    }
-
-    mFilterOutput.clear();
-
-    return Result::SUCCESS;
+    return startPayloadFilterHandler();
 }
 
 Result Filter::startPesFilterHandler() {
-    std::lock_guard<std::mutex> lock(mFilterEventLock);
+    return startPayloadFilterHandler();
+}
+
+Result Filter::startPayloadFilterHandler() {
     if (mFilterOutput.empty()) {
         return Result::SUCCESS;
     }
+    if (mPayloadAssembler == nullptr) {
+        mFilterOutput.clear();
+        return Result::INVALID_STATE;
+    }
 
-    for (int i = 0; i < mFilterOutput.size(); i += 188) {
-        if (mPesSizeLeft == 0) {
-            uint32_t prefix = (mFilterOutput[i + 4] << 16) | (mFilterOutput[i + 5] << 8) |
-                              mFilterOutput[i + 6];
-            if (DEBUG_FILTER) {
-                ALOGD("[Filter] prefix %d", prefix);
-            }
-            if (prefix == 0x000001) {
-                // TODO handle mulptiple Pes filters
-                mPesSizeLeft = (mFilterOutput[i + 8] << 8) | mFilterOutput[i + 9];
-                mPesSizeLeft += 6;
-                if (DEBUG_FILTER) {
-                    ALOGD("[Filter] pes data length %d", mPesSizeLeft);
-                }
-            } else {
-                continue;
-            }
+    std::lock_guard<std::mutex> lock(mFilterEventLock);
+    mPayloadUnits.clear();
+    {
+        std::lock_guard<std::mutex> lock(mWriteLock);
+        for (size_t i = 0; i + TS_PACKET_SIZE <= mFilterOutput.size(); i += TS_PACKET_SIZE) {
+            mPayloadAssembler->pushPacket(&mFilterOutput[i], &mPayloadUnits);
         }
+    }
+    mFilterOutput.clear();
+    if (mPayloadUnits.empty()) {
+        return Result::SUCCESS;
+    }
 
-        int endPoint = min(184, mPesSizeLeft);
-        // append data and check size
-        vector<uint8_t>::const_iterator first = mFilterOutput.begin() + i + 4;
-        vector<uint8_t>::const_iterator last = mFilterOutput.begin() + i + 4 + endPoint;
-        mPesOutput.insert(mPesOutput.end(), first, last);
-        // size does not match then continue
-        mPesSizeLeft -= endPoint;
-        if (DEBUG_FILTER) {
-            ALOGD("[Filter] pes data left %d", mPesSizeLeft);
-        }
-        if (mPesSizeLeft > 0) {
-            continue;
-        }
-        // size match then create event
-        if (!writeDataToFilterMQ(mPesOutput)) {
-            ALOGD("[Filter] pes data write failed");
-            mFilterOutput.clear();
-            return Result::INVALID_STATE;
+    int size = mFilterEvent.events.size();
+    mFilterEvent.events.resize(size + mPayloadUnits.size());
+    for (const TsPayloadUnit& unit : mPayloadUnits) {
+        // The assembler drops the units longer than the 16 bit dataLength
+        uint16_t dataLength = static_cast<uint16_t>(unit.size);
+        if (mType.subType.tsFilterType() == DemuxTsFilterType::PES) {
+            DemuxFilterPesEvent pesEvent;
+            pesEvent = {
+                    .streamId = unit.header[3],
+                    .dataLength = dataLength,
+            };
+            mFilterEvent.events[size++].pes(pesEvent);
+        } else {
+            // The version and section number are only present with section_syntax_indicator
+            bool sectionSyntaxIndicator = unit.header[1] & 0x80;
+            DemuxFilterSectionEvent secEvent;
+            secEvent = {
+                    .tableId = unit.header[0],
+                    .version = static_cast<uint16_t>(
+                            sectionSyntaxIndicator ? (unit.header[5] >> 1) & 0x1f : 0),
+                    .sectionNum =
+                            static_cast<uint16_t>(sectionSyntaxIndicator ? unit.header[6] : 0),
+                    .dataLength = dataLength,
+            };
+            mFilterEvent.events[size++].section(secEvent);
         }
-        maySendFilterStatusCallback();
-        DemuxFilterPesEvent pesEvent;
-        pesEvent = {
-                // temp dump meta data
-                .streamId = mPesOutput[3],
-                .dataLength = static_cast<uint16_t>(mPesOutput.size()),
-        };
         if (DEBUG_FILTER) {
-            ALOGD("[Filter] assembled pes data length %d", pesEvent.dataLength);
+            ALOGD("[Filter] assembled unit of pid %d length %d", unit.pid, unit.size);
         }
-
-        int size = mFilterEvent.events.size();
-        mFilterEvent.events.resize(size + 1);
-        mFilterEvent.events[size].pes(pesEvent);
-        mPesOutput.clear();
     }
-
-    mFilterOutput.clear();
+    maySendFilterStatusCallback();
 
     return Result::SUCCESS;
 }
 
 Result Filter::startTsFilterHandler() {
-    // TODO handle starting TS filter
+    std::lock_guard<std::mutex> lock(mWriteLock);
+    if (mFilterOutput.empty()) {
+        return Result::SUCCESS;
+    }
+
+    // Only whole packets go into the FMQ, the rest is dropped as an overflow
+    size_t size = min(mFilterOutput.size(), static_cast<size_t>(mFilterMQ->availableToWrite()));
+    size -= size % TS_PACKET_SIZE;
+    FilterMQ::MemTransaction tx;
+    if (size > 0 && mFilterMQ->beginWrite(size, &tx)) {
+        size_t firstLength = min(size, tx.getFirstRegion().getLength());
+        memcpy(tx.getFirstRegion().getAddress(), mFilterOutput.data(), firstLength);
+        if (size > firstLength) {
+            memcpy(tx.getSecondRegion().getAddress(), mFilterOutput.data() + firstLength,
+                   size - firstLength);
+        }
+        mFilterMQ->commitWrite(size);
+    }
+    mFilterOutput.clear();
+    maySendFilterStatusCallback();
+
     return Result::SUCCESS;
 }
 
@@ -456,35 +498,6 @@ Result Filter::startTemiFilterHandler() {
     return Result::SUCCESS;
 }
 
-bool Filter::writeSectionsAndCreateEvent(vector<uint8_t> data) {
-    // TODO check how many sections has been read
-    ALOGD("[Filter] section hander");
-    std::lock_guard<std::mutex> lock(mFilterEventLock);
-    if (!writeDataToFilterMQ(data)) {
-        return false;
-    }
-    int size = mFilterEvent.events.size();
-    mFilterEvent.events.resize(size + 1);
-    DemuxFilterSectionEvent secEvent;
-    secEvent = {
-            // temp dump meta data
-            .tableId = 0,
-            .version = 1,
-            .sectionNum = 1,
-            .dataLength = static_cast<uint16_t>(data.size()),
-    };
-    mFilterEvent.events[size].section(secEvent);
-    return true;
-}
-
-bool Filter::writeDataToFilterMQ(const std::vector<uint8_t>& data) {
-    std::lock_guard<std::mutex> lock(mWriteLock);
-    if (mFilterMQ->write(data.data(), data.size())) {
-        return true;
-    }
-    return false;
-}
-
 void Filter::attachFilterToRecord(const sp<Dvr> dvr) {
     mDvr = dvr;
 }
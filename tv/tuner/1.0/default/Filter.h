@@ -24,6 +24,7 @@
 #include "Demux.h"
 #include "Dvr.h"
 #include "Frontend.h"
+#include "TsDemuxEngine.h"
 
 using namespace std;
 
@@ -81,8 +82,8 @@ class Filter : public IFilter {
      */
     bool createFilterMQ();
     uint16_t getTpid();
-    void updateFilterOutput(vector<uint8_t> data);
-    void updateRecordOutput(vector<uint8_t> data);
+    void updateFilterOutput(const uint8_t* data, size_t size);
+    void updateRecordOutput(const uint8_t* data, size_t size);
     Result startFilterHandler();
     Result startRecordFilterHandler();
     void attachFilterToRecord(const sp<Dvr> dvr);
@@ -103,12 +104,19 @@ class Filter : public IFilter {
     DemuxFilterType mType;
     DemuxFilterSettings mFilterSettings;
 
-    uint16_t mTpid;
+    // 0xFFFF is outside of the 13 bit PID range, so an unconfigured filter matches no packet
+    uint16_t mTpid = 0xFFFF;
     sp<IFilter> mDataSource;
     bool mIsDataSourceDemux = true;
     vector<uint8_t> mFilterOutput;
     vector<uint8_t> mRecordFilterOutput;
     unique_ptr<FilterMQ> mFilterMQ;
+    /**
+     * Reassembles the PES packets or sections of the filter output into the filter FMQ.
+     * Only created for the PES and section filters.
+     */
+    unique_ptr<TsPayloadAssembler> mPayloadAssembler;
+    vector<TsPayloadUnit> mPayloadUnits;
     EventFlag* mFilterEventFlag;
     DemuxFilterEvent mFilterEvent;
 
@@ -138,6 +146,7 @@ class Filter : public IFilter {
      */
     Result startSectionFilterHandler();
     Result startPesFilterHandler();
+    Result startPayloadFilterHandler();
     Result startTsFilterHandler();
     Result startMediaFilterHandler();
     Result startPcrFilterHandler();
@@ -145,9 +154,7 @@ class Filter : public IFilter {
     Result startFilterLoop();
 
     void deleteEventFlag();
-    bool writeDataToFilterMQ(const std::vector<uint8_t>& data);
     bool readDataFromMQ();
-    bool writeSectionsAndCreateEvent(vector<uint8_t> data);
     void maySendFilterStatusCallback();
     DemuxFilterStatus checkFilterStatusChange(uint32_t availableToWrite, uint32_t availableToRead,
                                               uint32_t highThreshold, uint32_t lowThreshold);
@@ -176,11 +183,6 @@ class Filter : public IFilter {
     std::mutex mFilterThreadLock;
     std::mutex mFilterOutputLock;
     std::mutex mRecordFilterOutputLock;
-
-    // temp handle single PES filter
-    // TODO handle mulptiple Pes filters
-    int mPesSizeLeft = 0;
-    vector<uint8_t> mPesOutput;
 };
 
 }  // namespace implementation
@@ -0,0 +1,413 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "android.hardware.tv.tuner@1.0-TsDemuxEngine"
+
+#include "TsDemuxEngine.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <utils/Log.h>
+#include <algorithm>
+
+namespace android {
+namespace hardware {
+namespace tv {
+namespace tuner {
+namespace V1_0 {
+namespace implementation {
+
+TsBlockReader::TsBlockReader(size_t packetSize, size_t packetsPerBlock)
+    : mPacketSize(packetSize), mBlock(packetSize * packetsPerBlock) {}
+
+bool TsBlockReader::open(const std::string& path) {
+    mFd.reset(TEMP_FAILURE_RETRY(::open(path.c_str(), O_RDONLY | O_CLOEXEC)));
+    mBlockSize = 0;
+    mPartialPacketSize = 0;
+    if (mFd < 0) {
+        return false;
+    }
+    posix_fadvise(mFd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    return true;
+}
+
+size_t TsBlockReader::readBlock(const uint8_t** block) {
+    if (mFd < 0) {
+        return 0;
+    }
+
+    // Move the partial packet left over by the last block to the front
+    if (mPartialPacketSize > 0) {
+        memmove(mBlock.data(), mBlock.data() + mBlockSize, mPartialPacketSize);
+    }
+    size_t size = mPartialPacketSize;
+    while (size < mBlock.size()) {
+        ssize_t n = TEMP_FAILURE_RETRY(read(mFd, mBlock.data() + size, mBlock.size() - size));
+        if (n < 0) {
+            ALOGW("[TsBlockReader] read failed: %s", strerror(errno));
+            break;
+        }
+        if (n == 0) {
+            break;
+        }
+        size += n;
+    }
+
+    mBlockSize = size - size % mPacketSize;
+    mPartialPacketSize = size - mBlockSize;
+    *block = mBlock.data();
+    return mBlockSize;
+}
+
+namespace {
+
+const uint8_t TS_SYNC_BYTE = 0x47;
+const size_t PES_HEADER_SIZE = 6;
+const size_t SECTION_HEADER_SIZE = 3;
+const uint8_t SECTION_STUFFING_BYTE = 0xff;
+
+// CRC_32 of ISO/IEC 13818-1 Annex A, polynomial 0x04c11db7, MSB first, no final xor.
+uint32_t updateCrc32(uint32_t crc, const uint8_t* data, size_t size) {
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> table;
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t value = i << 24;
+            for (int bit = 0; bit < 8; bit++) {
+                value = (value & 0x80000000) ? (value << 1) ^ 0x04c11db7 : value << 1;
+            }
+            table[i] = value;
+        }
+        return table;
+    }();
+    for (size_t i = 0; i < size; i++) {
+        crc = (crc << 8) ^ table[((crc >> 24) ^ data[i]) & 0xff];
+    }
+    return crc;
+}
+
+}  // namespace
+
+TsPayloadAssembler::TsPayloadAssembler(TsPayloadType type, TsPayloadQueue* queue)
+    : mType(type), mQueue(queue) {}
+
+void TsPayloadAssembler::reset() {
+    // Nothing was committed for the reserved unit, dropping the reservation discards it
+    mReservationPid = -1;
+    mPidStates.clear();
+    mPendingUnits.clear();
+}
+
+void TsPayloadAssembler::pushPacket(const uint8_t* packet, std::vector<TsPayloadUnit>* units) {
+    bool transportError = packet[1] & 0x80;
+    if (packet[0] != TS_SYNC_BYTE || transportError) {
+        return;
+    }
+    uint16_t pid = getTsPacketPid(packet);
+    bool unitStart = packet[1] & 0x40;
+    uint8_t adaptationFieldControl = (packet[3] >> 4) & 0x03;
+    int continuityCounter = packet[3] & 0x0f;
+    PidState& state = mPidStates[pid];
+
+    size_t offset = 4;
+    bool discontinuity = false;
+    if (adaptationFieldControl & 0x02) {
+        size_t adaptationFieldLength = packet[4];
+        if (adaptationFieldLength > 0) {
+            discontinuity = packet[5] & 0x80;
+        }
+        offset += 1 + adaptationFieldLength;
+        if (offset > TS_PACKET_SIZE) {
+            abortUnit(pid, state, units);
+            return;
+        }
+    }
+    // The continuity counter only increments on packets with a payload
+    if (!(adaptationFieldControl & 0x01)) {
+        return;
+    }
+    if (state.continuityCounter >= 0 && !discontinuity) {
+        if (continuityCounter == state.continuityCounter) {
+            // A duplicate packet, its payload was consumed already
+            return;
+        }
+        if (continuityCounter != ((state.continuityCounter + 1) & 0x0f)) {
+            abortUnit(pid, state, units);
+        }
+    }
+    state.continuityCounter = continuityCounter;
+
+    switch (mType) {
+        case TsPayloadType::PES:
+            pushPesPayload(pid, state, packet + offset, TS_PACKET_SIZE - offset, unitStart, units);
+            break;
+        case TsPayloadType::SECTION:
+            pushSectionPayload(pid, state, packet + offset, TS_PACKET_SIZE - offset, unitStart,
+                               units);
+            break;
+    }
+}
+
+void TsPayloadAssembler::pushPesPayload(uint16_t pid, PidState& state, const uint8_t* payload,
+                                        size_t size, bool unitStart,
+                                        std::vector<TsPayloadUnit>* units) {
+    if (unitStart) {
+        if (state.state == UnitState::BODY && state.unitSize == 0) {
+            finishUnit(pid, state, units);
+        } else {
+            abortUnit(pid, state, units);
+        }
+        state.state = UnitState::HEADER;
+        state.headerSize = 0;
+    }
+    if (state.state == UnitState::HEADER || state.state == UnitState::BODY) {
+        // Whatever follows the end of a bounded PES packet is stuffing
+        consumeUnitBytes(pid, state, payload, size, units);
+    }
+}
+
+void TsPayloadAssembler::pushSectionPayload(uint16_t pid, PidState& state, const uint8_t* payload,
+                                            size_t size, bool unitStart,
+                                            std::vector<TsPayloadUnit>* units) {
+    if (!unitStart) {
+        if (state.state == UnitState::HEADER || state.state == UnitState::BODY) {
+            consumeUnitBytes(pid, state, payload, size, units);
+        }
+        return;
+    }
+
+    if (size == 0) {
+        return;
+    }
+    size_t pointerField = payload[0];
+    payload++;
+    size--;
+    if (pointerField > size) {
+        abortUnit(pid, state, units);
+        return;
+    }
+    // The bytes before the pointer end the section in progress
+    if (state.state == UnitState::HEADER || state.state == UnitState::BODY) {
+        consumeUnitBytes(pid, state, payload, pointerField, units);
+    }
+    abortUnit(pid, state, units);
+    payload += pointerField;
+    size -= pointerField;
+
+    // Several sections can start in the same packet, the rest of it is stuffing
+    while (size > 0 && payload[0] != SECTION_STUFFING_BYTE) {
+        state.state = UnitState::HEADER;
+        state.headerSize = 0;
+        size_t consumed = consumeUnitBytes(pid, state, payload, size, units);
+        if (state.state != UnitState::IDLE) {
+            // The section continues in the next packets, or was dropped
+            break;
+        }
+        payload += consumed;
+        size -= consumed;
+    }
+}
+
+size_t TsPayloadAssembler::consumeUnitBytes(uint16_t pid, PidState& state, const uint8_t* data,
+                                            size_t size, std::vector<TsPayloadUnit>* units) {
+    size_t consumed = 0;
+    if (state.state == UnitState::HEADER) {
+        size_t headerSize = mType == TsPayloadType::PES ? PES_HEADER_SIZE : SECTION_HEADER_SIZE;
+        size_t length = std::min(headerSize - state.headerSize, size);
+        memcpy(state.header + state.headerSize, data, length);
+        state.headerSize += length;
+        consumed += length;
+        if (state.headerSize < headerSize) {
+            return consumed;
+        }
+        if (!startUnit(pid, state)) {
+            abortUnit(pid, state, units);
+            state.state = UnitState::SKIP;
+            return size;
+        }
+    }
+    if (state.state != UnitState::BODY) {
+        return size;
+    }
+
+    size_t length = size - consumed;
+    if (state.unitSize != 0) {
+        length = std::min(length, state.unitSize - state.written);
+    }
+    if (!writeUnitBytes(state, data + consumed, length)) {
+        abortUnit(pid, state, units);
+        state.state = UnitState::SKIP;
+        return size;
+    }
+    consumed += length;
+    if (state.unitSize != 0 && state.written == state.unitSize) {
+        finishUnit(pid, state, units);
+    }
+    return consumed;
+}
+
+bool TsPayloadAssembler::startUnit(uint16_t pid, PidState& state) {
+    const uint8_t* header = state.header;
+    switch (mType) {
+        case TsPayloadType::PES: {
+            if (header[0] != 0x00 || header[1] != 0x00 || header[2] != 0x01) {
+                return false;
+            }
+            size_t pesPacketLength = (header[4] << 8) | header[5];
+            state.unitSize = pesPacketLength == 0 ? 0 : PES_HEADER_SIZE + pesPacketLength;
+            if (state.unitSize > MAX_UNIT_SIZE) {
+                return false;
+            }
+            break;
+        }
+        case TsPayloadType::SECTION: {
+            size_t sectionLength = ((header[1] & 0x0f) << 8) | header[2];
+            state.unitSize = SECTION_HEADER_SIZE + sectionLength;
+            if (state.unitSize > MAX_SECTION_SIZE) {
+                return false;
+            }
+            break;
+        }
+    }
+
+    state.written = 0;
+    state.crc = 0xffffffff;
+    state.checkCrc = mCheckCrc;
+    if (mReservationPid < 0) {
+        size_t availableToWrite = mQueue->availableToWrite();
+        size_t reservationSize =
+                state.unitSize == 0 ? std::min(availableToWrite, MAX_UNIT_SIZE) : state.unitSize;
+        if (reservationSize == 0 || reservationSize > availableToWrite ||
+            !mQueue->beginWrite(reservationSize, &mReservation)) {
+            return false;
+        }
+        mReservationPid = pid;
+        mReservationSize = reservationSize;
+        state.staged = false;
+    } else {
+        state.staged = true;
+        state.staging.clear();
+    }
+    state.state = UnitState::BODY;
+    return writeUnitBytes(state, state.header, state.headerSize);
+}
+
+bool TsPayloadAssembler::writeUnitBytes(PidState& state, const uint8_t* data, size_t size) {
+    if (size == 0) {
+        return true;
+    }
+    // Only reachable by an unbounded PES packet
+    if (state.written + size > MAX_UNIT_SIZE) {
+        return false;
+    }
+    if (state.written < TsPayloadUnit::HEADER_SIZE) {
+        // memmove since the header itself is written from state.header when the unit starts
+        size_t length = std::min(TsPayloadUnit::HEADER_SIZE - state.written, size);
+        memmove(state.header + state.written, data, length);
+    }
+    if (mType == TsPayloadType::SECTION && state.checkCrc) {
+        state.crc = updateCrc32(state.crc, data, size);
+    }
+    if (state.staged) {
+        state.staging.insert(state.staging.end(), data, data + size);
+    } else {
+        if (state.written + size > mReservationSize) {
+            return false;
+        }
+        copyToReservation(state.written, data, size);
+    }
+    state.written += size;
+    return true;
+}
+
+void TsPayloadAssembler::finishUnit(uint16_t pid, PidState& state,
+                                    std::vector<TsPayloadUnit>* units) {
+    bool sectionSyntaxIndicator = state.header[1] & 0x80;
+    if (mType == TsPayloadType::SECTION && state.checkCrc && sectionSyntaxIndicator &&
+        state.crc != 0) {
+        // The CRC_32 field makes the CRC of the whole section 0
+        abortUnit(pid, state, units);
+        return;
+    }
+
+    TsPayloadUnit unit;
+    unit.pid = pid;
+    unit.size = state.written;
+    memcpy(unit.header, state.header, sizeof(unit.header));
+    state.state = UnitState::IDLE;
+
+    if (!state.staged) {
+        mQueue->commitWrite(state.written);
+        mReservationPid = -1;
+        units->push_back(unit);
+        flushPendingUnits(units);
+    } else if (mReservationPid < 0) {
+        writeStagedUnit(unit, state.staging, units);
+    } else {
+        mPendingUnits.emplace_back(unit, state.staging);
+    }
+}
+
+void TsPayloadAssembler::abortUnit(uint16_t pid, PidState& state,
+                                   std::vector<TsPayloadUnit>* units) {
+    if (state.state == UnitState::HEADER || state.state == UnitState::BODY) {
+        mDroppedUnitCount++;
+    }
+    if (state.state == UnitState::BODY && !state.staged && mReservationPid == pid) {
+        mReservationPid = -1;
+        flushPendingUnits(units);
+    }
+    state.state = UnitState::IDLE;
+}
+
+void TsPayloadAssembler::writeStagedUnit(const TsPayloadUnit& unit,
+                                         const std::vector<uint8_t>& data,
+                                         std::vector<TsPayloadUnit>* units) {
+    if (!mQueue->write(data.data(), data.size())) {
+        mDroppedUnitCount++;
+        return;
+    }
+    units->push_back(unit);
+}
+
+void TsPayloadAssembler::flushPendingUnits(std::vector<TsPayloadUnit>* units) {
+    while (mReservationPid < 0 && !mPendingUnits.empty()) {
+        writeStagedUnit(mPendingUnits.front().first, mPendingUnits.front().second, units);
+        mPendingUnits.pop_front();
+    }
+}
+
+void TsPayloadAssembler::copyToReservation(size_t offset, const uint8_t* data, size_t size) {
+    auto firstRegion = mReservation.getFirstRegion();
+    size_t firstLength = firstRegion.getLength();
+    if (offset < firstLength) {
+        size_t length = std::min(size, firstLength - offset);
+        memcpy(firstRegion.getAddress() + offset, data, length);
+        data += length;
+        size -= length;
+        offset += length;
+    }
+    if (size > 0) {
+        memcpy(mReservation.getSecondRegion().getAddress() + offset - firstLength, data, size);
+    }
+}
+
+}  // namespace implementation
+}  // namespace V1_0
+}  // namespace tuner
+}  // namespace tv
+}  // namespace hardware
+}  // namespace android
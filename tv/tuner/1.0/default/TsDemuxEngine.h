@@ -0,0 +1,238 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HARDWARE_TV_TUNER_V1_0_TSDEMUXENGINE_H_
+#define ANDROID_HARDWARE_TV_TUNER_V1_0_TSDEMUXENGINE_H_
+
+#include <android-base/unique_fd.h>
+#include <fmq/MessageQueue.h>
+#include <array>
+#include <atomic>
+#include <deque>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace tv {
+namespace tuner {
+namespace V1_0 {
+namespace implementation {
+
+using ::android::hardware::kSynchronizedReadWrite;
+using ::android::hardware::MessageQueue;
+
+using TsPayloadQueue = MessageQueue<uint8_t, kSynchronizedReadWrite>;
+
+const size_t TS_PACKET_SIZE = 188;
+// The PID is a 13 bit field
+const size_t TS_PID_COUNT = 8192;
+
+inline uint16_t getTsPacketPid(const uint8_t* packet) {
+    return ((packet[1] & 0x1f) << 8) | packet[2];
+}
+
+/**
+ * Reads a TS source in large blocks of whole packets instead of one packet per read.
+ * A block stays valid until the next readBlock() call, so packets can be handed around
+ * as pointers into it.
+ */
+class TsBlockReader {
+  public:
+    // 1024 packets, about 188KB per read
+    static const size_t DEFAULT_PACKETS_PER_BLOCK = 1024;
+
+    TsBlockReader(size_t packetSize = TS_PACKET_SIZE,
+                  size_t packetsPerBlock = DEFAULT_PACKETS_PER_BLOCK);
+
+    bool open(const std::string& path);
+
+    /**
+     * Read the next block.
+     *
+     * Return the size in bytes of the whole packets at *block, 0 at the end of the source
+     * or on error. A trailing partial packet is kept for the next block.
+     */
+    size_t readBlock(const uint8_t** block);
+
+  private:
+    const size_t mPacketSize;
+    android::base::unique_fd mFd;
+    std::vector<uint8_t> mBlock;
+    size_t mBlockSize = 0;
+    size_t mPartialPacketSize = 0;
+};
+
+/**
+ * Maps every PID to the targets (e.g. filters) that want its packets, so dispatching a packet
+ * is one table lookup instead of a comparison against every open filter.
+ */
+template <typename Target>
+class TsPidTable {
+  public:
+    void clear() {
+        for (auto& targets : mTargets) {
+            targets.clear();
+        }
+    }
+
+    // PIDs outside of the 13 bit range, e.g. of a filter not configured yet, are ignored.
+    void add(uint16_t pid, const Target& target) {
+        if (pid < TS_PID_COUNT) {
+            mTargets[pid].push_back(target);
+        }
+    }
+
+    const std::vector<Target>& lookup(uint16_t pid) const { return mTargets[pid % TS_PID_COUNT]; }
+
+    /**
+     * Call onPacket(target, packet) for each packet in the block and each target registered
+     * for its PID. The packet points into the block, nothing is copied.
+     */
+    template <typename OnPacket>
+    void dispatch(const uint8_t* block, size_t size, size_t packetSize,
+                  OnPacket&& onPacket) const {
+        for (size_t offset = 0; offset + packetSize <= size; offset += packetSize) {
+            const uint8_t* packet = block + offset;
+            for (const Target& target : mTargets[getTsPacketPid(packet)]) {
+                onPacket(target, packet);
+            }
+        }
+    }
+
+  private:
+    std::array<std::vector<Target>, TS_PID_COUNT> mTargets;
+};
+
+enum class TsPayloadType {
+    PES,
+    SECTION,
+};
+
+/**
+ * A PES packet or a PSI section written into the output queue by TsPayloadAssembler.
+ */
+struct TsPayloadUnit {
+    static const size_t HEADER_SIZE = 8;
+
+    uint16_t pid;
+    uint32_t size;
+    // The first bytes of the unit, e.g. the PES stream id or the section table id and version
+    uint8_t header[HEADER_SIZE];
+};
+
+/**
+ * Reassembles the PES packets or PSI sections carried by TS packets.
+ *
+ * Every PID gets its own continuity counter and reassembly state. The payload is copied from
+ * the TS packets straight into space reserved in the output queue with beginWrite() and only
+ * committed once the unit is complete, so readers never see a partial unit. Units broken by a
+ * lost packet, failing the CRC check, longer than MAX_UNIT_SIZE or not fitting in the queue are
+ * dropped.
+ *
+ * Only one unit can hold a reservation in the queue at a time. A unit of another PID starting
+ * meanwhile is reassembled in a staging buffer of its PID and written after the reserved one.
+ *
+ * Not thread safe, the owner must synchronize calls with the other writers of the queue.
+ * Only setCheckCrc() can be called concurrently with them.
+ */
+class TsPayloadAssembler {
+  public:
+    // section_length is at most 4093 bytes, following the 3 bytes section header
+    static const size_t MAX_SECTION_SIZE = 4096;
+    // The length of a unit in the filter events is a 16 bit field
+    static constexpr size_t MAX_UNIT_SIZE = UINT16_MAX;
+
+    TsPayloadAssembler(TsPayloadType type, TsPayloadQueue* queue);
+
+    // Whether sections with section_syntax_indicator set are checked against their CRC_32.
+    // Takes effect from the next section started.
+    void setCheckCrc(bool checkCrc) { mCheckCrc = checkCrc; }
+
+    // Drop all the units in progress and forget the continuity counters
+    void reset();
+
+    /**
+     * Consume one TS packet of TS_PACKET_SIZE bytes.
+     *
+     * The units completed and committed to the queue by this packet are appended to units.
+     */
+    void pushPacket(const uint8_t* packet, std::vector<TsPayloadUnit>* units);
+
+    uint64_t getDroppedUnitCount() const { return mDroppedUnitCount; }
+
+  private:
+    enum class UnitState {
+        IDLE,
+        // Collecting the PES or section header to learn the unit size
+        HEADER,
+        BODY,
+        // The unit was dropped, skip its payload until the next unit start
+        SKIP,
+    };
+
+    struct PidState {
+        int continuityCounter = -1;
+        UnitState state = UnitState::IDLE;
+        uint8_t header[TsPayloadUnit::HEADER_SIZE];
+        size_t headerSize = 0;
+        // 0 for a PES packet of unbounded length, which ends at the next unit start
+        size_t unitSize = 0;
+        size_t written = 0;
+        uint32_t crc = 0;
+        bool checkCrc = false;
+        bool staged = false;
+        std::vector<uint8_t> staging;
+    };
+
+    void pushPesPayload(uint16_t pid, PidState& state, const uint8_t* payload, size_t size,
+                        bool unitStart, std::vector<TsPayloadUnit>* units);
+    void pushSectionPayload(uint16_t pid, PidState& state, const uint8_t* payload, size_t size,
+                            bool unitStart, std::vector<TsPayloadUnit>* units);
+    size_t consumeUnitBytes(uint16_t pid, PidState& state, const uint8_t* data, size_t size,
+                            std::vector<TsPayloadUnit>* units);
+    bool startUnit(uint16_t pid, PidState& state);
+    bool writeUnitBytes(PidState& state, const uint8_t* data, size_t size);
+    void finishUnit(uint16_t pid, PidState& state, std::vector<TsPayloadUnit>* units);
+    void abortUnit(uint16_t pid, PidState& state, std::vector<TsPayloadUnit>* units);
+    void writeStagedUnit(const TsPayloadUnit& unit, const std::vector<uint8_t>& data,
+                         std::vector<TsPayloadUnit>* units);
+    void flushPendingUnits(std::vector<TsPayloadUnit>* units);
+    void copyToReservation(size_t offset, const uint8_t* data, size_t size);
+
+    const TsPayloadType mType;
+    TsPayloadQueue* const mQueue;
+    std::atomic<bool> mCheckCrc{true};
+    std::map<uint16_t, PidState> mPidStates;
+    // The PID whose unit is written straight into mReservation, -1 if there is none
+    int mReservationPid = -1;
+    TsPayloadQueue::MemTransaction mReservation;
+    size_t mReservationSize = 0;
+    // Staged units completed while the queue was reserved, in completion order
+    std::deque<std::pair<TsPayloadUnit, std::vector<uint8_t>>> mPendingUnits;
+    uint64_t mDroppedUnitCount = 0;
+};
+
+}  // namespace implementation
+}  // namespace V1_0
+}  // namespace tuner
+}  // namespace tv
+}  // namespace hardware
+}  // namespace android
+
+#endif  // ANDROID_HARDWARE_TV_TUNER_V1_0_TSDEMUXENGINE_H_
@@ -0,0 +1,218 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "TsDemuxBenchmark"
+
+#include <benchmark/benchmark.h>
+
+#include <stdio.h>
+#include <unistd.h>
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "../TsDemuxEngine.h"
+
+namespace android {
+namespace hardware {
+namespace tv {
+namespace tuner {
+namespace V1_0 {
+namespace implementation {
+namespace {
+
+// About 256MB of input, 64 PIDs interleaved packet by packet.
+constexpr size_t kNumPackets = 256 * 1024 * 1024 / TS_PACKET_SIZE;
+constexpr uint16_t kNumPids = 64;
+
+const std::string& getTsFile() {
+    static const std::string path = [] {
+        std::string path = "/data/local/tmp/ts_demux_benchmark.ts";
+        FILE* file = fopen(path.c_str(), "we");
+        if (file == nullptr) {
+            return std::string();
+        }
+        std::vector<uint8_t> packet(TS_PACKET_SIZE, 0xff);
+        packet[0] = 0x47;
+        for (size_t i = 0; i < kNumPackets; i++) {
+            uint16_t pid = i % kNumPids;
+            packet[1] = (pid >> 8) & 0x1f;
+            packet[2] = pid & 0xff;
+            packet[3] = 0x10 | (i & 0x0f);
+            if (fwrite(packet.data(), packet.size(), 1, file) != 1) {
+                fclose(file);
+                unlink(path.c_str());
+                return std::string();
+            }
+        }
+        fclose(file);
+        return path;
+    }();
+    return path;
+}
+
+// Stands in for a Filter, keeping only the output buffer.
+struct FilterOutput {
+    uint16_t tpid;
+    std::vector<uint8_t> output;
+};
+
+std::vector<FilterOutput> makeFilters(size_t numFilters) {
+    std::vector<FilterOutput> filters(numFilters);
+    for (size_t i = 0; i < numFilters; i++) {
+        filters[i].tpid = i % kNumPids;
+        filters[i].output.reserve(TsBlockReader::DEFAULT_PACKETS_PER_BLOCK * TS_PACKET_SIZE);
+    }
+    return filters;
+}
+
+// The previous frontend input loop: one packet read and copied at a time, every filter compared.
+void BM_PerPacketDemux(benchmark::State& state) {
+    const std::string& path = getTsFile();
+    if (path.empty()) {
+        state.SkipWithError("failed to create the ts file");
+        return;
+    }
+    auto filters = makeFilters(state.range(0));
+    size_t numPackets = 0;
+    for (auto _ : state) {
+        std::ifstream input(path, std::ifstream::binary);
+        std::vector<uint8_t> packet(TS_PACKET_SIZE);
+        size_t packetsSinceFlush = 0;
+        while (input.read(reinterpret_cast<char*>(packet.data()), TS_PACKET_SIZE)) {
+            std::vector<uint8_t> data(packet);
+            uint16_t pid = getTsPacketPid(data.data());
+            for (auto& filter : filters) {
+                if (filter.tpid == pid) {
+                    filter.output.insert(filter.output.end(), data.begin(), data.end());
+                }
+            }
+            numPackets++;
+            if (++packetsSinceFlush == TsBlockReader::DEFAULT_PACKETS_PER_BLOCK) {
+                for (auto& filter : filters) {
+                    filter.output.clear();
+                }
+                packetsSinceFlush = 0;
+            }
+        }
+    }
+    state.SetItemsProcessed(numPackets);
+}
+BENCHMARK(BM_PerPacketDemux)->Arg(1)->Arg(8)->Arg(32)->Unit(benchmark::kMillisecond);
+
+// The block reader and PID table used by the Demux.
+void BM_BlockDemux(benchmark::State& state) {
+    const std::string& path = getTsFile();
+    if (path.empty()) {
+        state.SkipWithError("failed to create the ts file");
+        return;
+    }
+    auto filters = makeFilters(state.range(0));
+    TsPidTable<FilterOutput*> pidTable;
+    for (auto& filter : filters) {
+        pidTable.add(filter.tpid, &filter);
+    }
+    size_t numPackets = 0;
+    for (auto _ : state) {
+        TsBlockReader reader;
+        if (!reader.open(path)) {
+            state.SkipWithError("failed to open the ts file");
+            break;
+        }
+        const uint8_t* block;
+        size_t size;
+        while ((size = reader.readBlock(&block)) > 0) {
+            pidTable.dispatch(block, size, TS_PACKET_SIZE,
+                              [](FilterOutput* filter, const uint8_t* packet) {
+                                  filter->output.insert(filter->output.end(), packet,
+                                                        packet + TS_PACKET_SIZE);
+                              });
+            numPackets += size / TS_PACKET_SIZE;
+            for (auto& filter : filters) {
+                filter.output.clear();
+            }
+        }
+    }
+    state.SetItemsProcessed(numPackets);
+}
+BENCHMARK(BM_BlockDemux)->Arg(1)->Arg(8)->Arg(32)->Unit(benchmark::kMillisecond);
+
+// 16MB of video PES packets of 64KB each, as carried by a single PID.
+std::vector<uint8_t> makePesPackets() {
+    const size_t pesSize = 64 * 1024;
+    const size_t streamSize = 16 * 1024 * 1024;
+    std::vector<uint8_t> packets;
+    uint8_t continuityCounter = 0;
+    while (packets.size() < streamSize) {
+        std::vector<uint8_t> pes(pesSize, 0x5a);
+        pes[0] = 0x00;
+        pes[1] = 0x00;
+        pes[2] = 0x01;
+        pes[3] = 0xe0;
+        pes[4] = ((pesSize - 6) >> 8) & 0xff;
+        pes[5] = (pesSize - 6) & 0xff;
+        for (size_t offset = 0; offset < pes.size(); offset += TS_PACKET_SIZE - 4) {
+            std::vector<uint8_t> packet(TS_PACKET_SIZE, 0xff);
+            packet[0] = 0x47;
+            packet[1] = offset == 0 ? 0x40 : 0x00;
+            packet[2] = 0x20;
+            packet[3] = 0x10 | (continuityCounter++ & 0x0f);
+            size_t size = std::min(TS_PACKET_SIZE - 4, pes.size() - offset);
+            std::copy(pes.begin() + offset, pes.begin() + offset + size, packet.begin() + 4);
+            packets.insert(packets.end(), packet.begin(), packet.end());
+        }
+    }
+    return packets;
+}
+
+// PES reassembly into the filter FMQ, reported in bytes/s of TS input.
+void BM_PesReassembly(benchmark::State& state) {
+    static const std::vector<uint8_t> packets = makePesPackets();
+    TsPayloadQueue queue(1024 * 1024);
+    if (!queue.isValid()) {
+        state.SkipWithError("failed to create the queue");
+        return;
+    }
+    TsPayloadAssembler assembler(TsPayloadType::PES, &queue);
+    std::vector<TsPayloadUnit> units;
+    std::vector<uint8_t> readBuffer(1024 * 1024);
+    for (auto _ : state) {
+        for (size_t offset = 0; offset < packets.size(); offset += TS_PACKET_SIZE) {
+            assembler.pushPacket(packets.data() + offset, &units);
+            if (!units.empty()) {
+                // Stand in for the client draining the FMQ
+                queue.read(readBuffer.data(), queue.availableToRead());
+                units.clear();
+            }
+        }
+    }
+    if (assembler.getDroppedUnitCount() > 0) {
+        state.SkipWithError("units were dropped");
+    }
+    state.SetBytesProcessed(state.iterations() * packets.size());
+}
+BENCHMARK(BM_PesReassembly)->Unit(benchmark::kMillisecond);
+
+}  // namespace
+}  // namespace implementation
+}  // namespace V1_0
+}  // namespace tuner
+}  // namespace tv
+}  // namespace hardware
+}  // namespace android
+
+BENCHMARK_MAIN();
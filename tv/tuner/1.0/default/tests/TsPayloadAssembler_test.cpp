@@ -0,0 +1,276 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "TsDemuxEngine.h"
+
+namespace android {
+namespace hardware {
+namespace tv {
+namespace tuner {
+namespace V1_0 {
+namespace implementation {
+
+namespace {
+
+using Packet = std::vector<uint8_t>;
+using Bytes = std::vector<uint8_t>;
+
+constexpr uint16_t kPid = 0x101;
+constexpr size_t kQueueSize = 1 << 18;
+
+uint32_t computeCrc32(const uint8_t* data, size_t size) {
+    uint32_t crc = 0xffffffff;
+    for (size_t i = 0; i < size; i++) {
+        crc ^= static_cast<uint32_t>(data[i]) << 24;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04c11db7 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+// A long section with section_syntax_indicator set, version 3, section number 7 and its CRC_32
+Bytes makeSection(uint8_t tableId, size_t bodySize) {
+    Bytes section(8 + bodySize + 4);
+    size_t sectionLength = section.size() - 3;
+    section[0] = tableId;
+    section[1] = 0xb0 | (sectionLength >> 8);
+    section[2] = sectionLength & 0xff;
+    section[5] = 0xc1 | (3 << 1);
+    section[6] = 7;
+    for (size_t i = 0; i < bodySize; i++) {
+        section[8 + i] = i;
+    }
+    uint32_t crc = computeCrc32(section.data(), section.size() - 4);
+    for (int i = 0; i < 4; i++) {
+        section[section.size() - 4 + i] = crc >> (24 - 8 * i);
+    }
+    return section;
+}
+
+// A PES packet, PES_packet_length is 0 if unbounded
+Bytes makePes(uint8_t streamId, size_t bodySize, bool unbounded = false) {
+    Bytes pes(6 + bodySize);
+    pes[2] = 0x01;
+    pes[3] = streamId;
+    if (!unbounded) {
+        pes[4] = bodySize >> 8;
+        pes[5] = bodySize & 0xff;
+    }
+    for (size_t i = 0; i < bodySize; i++) {
+        pes[6 + i] = i * 7;
+    }
+    return pes;
+}
+
+class TsPayloadAssemblerTest : public ::testing::Test {
+  protected:
+    void SetUp() override { mQueue.reset(new TsPayloadQueue(kQueueSize, false)); }
+
+    // A TS packet of kPid with the next continuity counter, padded with 0xff
+    Packet makePacket(bool unitStart, const uint8_t* payload, size_t size) {
+        Packet packet(TS_PACKET_SIZE, 0xff);
+        packet[0] = 0x47;
+        packet[1] = (unitStart ? 0x40 : 0x00) | (kPid >> 8);
+        packet[2] = kPid & 0xff;
+        packet[3] = 0x10 | (mContinuityCounter++ & 0x0f);
+        memcpy(packet.data() + 4, payload, std::min(size, TS_PACKET_SIZE - 4));
+        return packet;
+    }
+
+    // Split a unit into packets, with a pointer_field of 0 in the first one for sections
+    std::vector<Packet> packetize(const Bytes& unit, bool section) {
+        std::vector<Packet> packets;
+        size_t offset = 0;
+        while (offset < unit.size()) {
+            Bytes payload;
+            if (offset == 0 && section) {
+                payload.push_back(0);
+            }
+            size_t size = std::min(TS_PACKET_SIZE - 4 - payload.size(), unit.size() - offset);
+            payload.insert(payload.end(), unit.begin() + offset, unit.begin() + offset + size);
+            packets.push_back(makePacket(offset == 0, payload.data(), payload.size()));
+            offset += size;
+        }
+        return packets;
+    }
+
+    void push(TsPayloadAssembler& assembler, const std::vector<Packet>& packets) {
+        for (const Packet& packet : packets) {
+            assembler.pushPacket(packet.data(), &mUnits);
+        }
+    }
+
+    Bytes readUnit(const TsPayloadUnit& unit) {
+        Bytes data(unit.size);
+        EXPECT_TRUE(mQueue->read(data.data(), data.size()));
+        return data;
+    }
+
+    std::unique_ptr<TsPayloadQueue> mQueue;
+    std::vector<TsPayloadUnit> mUnits;
+    uint8_t mContinuityCounter = 0;
+};
+
+TEST_F(TsPayloadAssemblerTest, SectionSpanningPackets) {
+    TsPayloadAssembler assembler(TsPayloadType::SECTION, mQueue.get());
+    Bytes section = makeSection(0x42, 1000);
+    push(assembler, packetize(section, true));
+
+    ASSERT_EQ(1u, mUnits.size());
+    EXPECT_EQ(kPid, mUnits[0].pid);
+    EXPECT_EQ(section.size(), mUnits[0].size);
+    EXPECT_EQ(0x42, mUnits[0].header[0]);
+    EXPECT_EQ(section, readUnit(mUnits[0]));
+    EXPECT_EQ(0u, mQueue->availableToRead());
+}
+
+TEST_F(TsPayloadAssemblerTest, SectionCrcMismatchIsDropped) {
+    TsPayloadAssembler assembler(TsPayloadType::SECTION, mQueue.get());
+    Bytes section = makeSection(0x42, 300);
+    section[100] ^= 0x01;
+    push(assembler, packetize(section, true));
+
+    EXPECT_TRUE(mUnits.empty());
+    EXPECT_EQ(1u, assembler.getDroppedUnitCount());
+    EXPECT_EQ(0u, mQueue->availableToRead());
+
+    // Unless the CRC check is disabled
+    assembler.setCheckCrc(false);
+    push(assembler, packetize(section, true));
+    ASSERT_EQ(1u, mUnits.size());
+    EXPECT_EQ(section, readUnit(mUnits[0]));
+}
+
+TEST_F(TsPayloadAssemblerTest, ContinuityCounterGapDropsUnit) {
+    TsPayloadAssembler assembler(TsPayloadType::SECTION, mQueue.get());
+    Bytes first = makeSection(0x42, 500);
+    std::vector<Packet> packets = packetize(first, true);
+    packets.erase(packets.begin() + 1);
+    push(assembler, packets);
+
+    EXPECT_TRUE(mUnits.empty());
+    EXPECT_EQ(1u, assembler.getDroppedUnitCount());
+
+    // The next unit start resynchronizes
+    Bytes second = makeSection(0x43, 500);
+    push(assembler, packetize(second, true));
+    ASSERT_EQ(1u, mUnits.size());
+    EXPECT_EQ(second, readUnit(mUnits[0]));
+}
+
+TEST_F(TsPayloadAssemblerTest, DuplicatePacketIsIgnored) {
+    TsPayloadAssembler assembler(TsPayloadType::SECTION, mQueue.get());
+    Bytes section = makeSection(0x42, 500);
+    std::vector<Packet> packets = packetize(section, true);
+    packets.insert(packets.begin() + 1, packets[1]);
+    push(assembler, packets);
+
+    ASSERT_EQ(1u, mUnits.size());
+    EXPECT_EQ(section, readUnit(mUnits[0]));
+    EXPECT_EQ(0u, assembler.getDroppedUnitCount());
+}
+
+TEST_F(TsPayloadAssemblerTest, PointerFieldEndsPreviousSection) {
+    TsPayloadAssembler assembler(TsPayloadType::SECTION, mQueue.get());
+    Bytes first = makeSection(0x42, 200);
+    Bytes second = makeSection(0x43, 20);
+    Bytes third = makeSection(0x44, 20);
+
+    // The first packet carries the start of the first section
+    size_t firstSize = TS_PACKET_SIZE - 5;
+    Bytes payload = {0};
+    payload.insert(payload.end(), first.begin(), first.begin() + firstSize);
+    push(assembler, {makePacket(true, payload.data(), payload.size())});
+    EXPECT_TRUE(mUnits.empty());
+
+    // The second one the rest of it before the pointer, then two whole sections
+    size_t rest = first.size() - firstSize;
+    payload = {static_cast<uint8_t>(rest)};
+    payload.insert(payload.end(), first.begin() + firstSize, first.end());
+    payload.insert(payload.end(), second.begin(), second.end());
+    payload.insert(payload.end(), third.begin(), third.end());
+    push(assembler, {makePacket(true, payload.data(), payload.size())});
+
+    ASSERT_EQ(3u, mUnits.size());
+    EXPECT_EQ(first, readUnit(mUnits[0]));
+    EXPECT_EQ(second, readUnit(mUnits[1]));
+    EXPECT_EQ(third, readUnit(mUnits[2]));
+    EXPECT_EQ(0u, assembler.getDroppedUnitCount());
+}
+
+TEST_F(TsPayloadAssemblerTest, PointerFieldBeyondPayloadIsDropped) {
+    TsPayloadAssembler assembler(TsPayloadType::SECTION, mQueue.get());
+    Bytes payload(TS_PACKET_SIZE - 4, 0xff);
+    payload[0] = TS_PACKET_SIZE;
+    push(assembler, {makePacket(true, payload.data(), payload.size())});
+
+    EXPECT_TRUE(mUnits.empty());
+    EXPECT_EQ(0u, mQueue->availableToRead());
+}
+
+TEST_F(TsPayloadAssemblerTest, PesSpanningPackets) {
+    TsPayloadAssembler assembler(TsPayloadType::PES, mQueue.get());
+    Bytes pes = makePes(0xe0, 1000);
+    push(assembler, packetize(pes, false));
+
+    ASSERT_EQ(1u, mUnits.size());
+    EXPECT_EQ(pes.size(), mUnits[0].size);
+    EXPECT_EQ(0xe0, mUnits[0].header[3]);
+    EXPECT_EQ(pes, readUnit(mUnits[0]));
+}
+
+TEST_F(TsPayloadAssemblerTest, UnboundedPesEndsAtNextUnitStart) {
+    TsPayloadAssembler assembler(TsPayloadType::PES, mQueue.get());
+    // A multiple of the packet payload, so that there is no stuffing to strip
+    Bytes first = makePes(0xe0, 3 * (TS_PACKET_SIZE - 4) - 6, true);
+    Bytes second = makePes(0xe0, 100);
+    push(assembler, packetize(first, false));
+    EXPECT_TRUE(mUnits.empty());
+
+    push(assembler, packetize(second, false));
+    ASSERT_EQ(2u, mUnits.size());
+    EXPECT_EQ(first, readUnit(mUnits[0]));
+    EXPECT_EQ(second, readUnit(mUnits[1]));
+}
+
+TEST_F(TsPayloadAssemblerTest, PesLongerThanEventLengthIsDropped) {
+    TsPayloadAssembler assembler(TsPayloadType::PES, mQueue.get());
+    // PES_packet_length 0xffff plus the header does not fit in the 16 bit event length
+    push(assembler, packetize(makePes(0xe0, 0xffff), false));
+    EXPECT_TRUE(mUnits.empty());
+    EXPECT_EQ(1u, assembler.getDroppedUnitCount());
+
+    push(assembler, packetize(makePes(0xe0, 0x10000, true), false));
+    push(assembler, packetize(makePes(0xe0, 100), false));
+    ASSERT_EQ(1u, mUnits.size());
+    EXPECT_EQ(2u, assembler.getDroppedUnitCount());
+    EXPECT_EQ(mUnits[0].size, mQueue->availableToRead());
+}
+
+}  // namespace
+
+}  // namespace implementation
+}  // namespace V1_0
+}  // namespace tuner
+}  // namespace tv
+}  // namespace hardware
+}  // namespace android
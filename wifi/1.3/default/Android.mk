@@ -42,6 +42,7 @@ LOCAL_SRC_FILES := \
     hidl_struct_util.cpp \
     hidl_sync_util.cpp \
     ringbuffer.cpp \
+    tombstone_util.cpp \
     wifi.cpp \
     wifi_ap_iface.cpp \
     wifi_chip.cpp \
@@ -138,6 +139,7 @@ LOCAL_PROPRIETARY_MODULE := true
 LOCAL_CPPFLAGS := -Wall -Werror -Wextra
 LOCAL_SRC_FILES := \
     tests/hidl_struct_util_unit_tests.cpp \
+    tests/hidl_sync_util_unit_tests.cpp \
     tests/main.cpp \
     tests/mock_interface_tool.cpp \
     tests/mock_wifi_feature_flags.cpp \
@@ -145,6 +147,7 @@ LOCAL_SRC_FILES := \
     tests/mock_wifi_legacy_hal.cpp \
     tests/mock_wifi_mode_controller.cpp \
     tests/ringbuffer_unit_tests.cpp \
+    tests/tombstone_util_unit_tests.cpp \
     tests/wifi_ap_iface_unit_tests.cpp \
     tests/wifi_nan_iface_unit_tests.cpp \
     tests/wifi_chip_unit_tests.cpp \
@@ -167,3 +170,17 @@ LOCAL_SHARED_LIBRARIES := \
     android.hardware.wifi@1.2 \
     android.hardware.wifi@1.3
 include $(BUILD_NATIVE_TEST)
+
+###
+### android.hardware.wifi ringbuffer benchmark.
+###
+include $(CLEAR_VARS)
+LOCAL_MODULE := android.hardware.wifi@1.0-service-ringbuffer-benchmark
+LOCAL_PROPRIETARY_MODULE := true
+LOCAL_CPPFLAGS := -Wall -Werror -Wextra
+LOCAL_SRC_FILES := \
+    benchmarks/ringbuffer_benchmark.cpp \
+    ringbuffer.cpp
+LOCAL_SHARED_LIBRARIES := \
+    libbase
+include $(BUILD_NATIVE_BENCHMARK)
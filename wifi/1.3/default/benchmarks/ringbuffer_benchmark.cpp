@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2019, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <list>
+#include <vector>
+
+#include <android-base/unique_fd.h>
+#include <benchmark/benchmark.h>
+
+#include "ringbuffer.h"
+
+namespace android {
+namespace hardware {
+namespace wifi {
+namespace V1_3 {
+namespace implementation {
+namespace {
+
+// Same as the per ring limit in wifi_chip.cpp.
+constexpr size_t kMaxBufferSizeBytes = 1024 * 1024 * 3;
+
+// The previous implementation, one heap allocated node per record.
+class ListRingbuffer {
+   public:
+    explicit ListRingbuffer(size_t maxSize) : size_(0), maxSize_(maxSize) {}
+
+    void append(const std::vector<uint8_t>& input) {
+        if (input.size() == 0 || input.size() > maxSize_) {
+            return;
+        }
+        data_.push_back(input);
+        size_ += input.size();
+        while (size_ > maxSize_) {
+            size_ -= data_.front().size();
+            data_.pop_front();
+        }
+    }
+
+    void writeToFd(int fd) const {
+        for (const auto& cur_block : data_) {
+            if (write(fd, cur_block.data(), cur_block.size()) == -1) {
+                return;
+            }
+        }
+    }
+
+   private:
+    std::list<std::vector<uint8_t>> data_;
+    size_t size_;
+    size_t maxSize_;
+};
+
+// Appends records of state.range(0) bytes to a ring that is already full, so
+// every append also evicts old records as it does with verbose logging on.
+template <typename Buffer>
+void BM_Append(benchmark::State& state) {
+    Buffer buffer(kMaxBufferSizeBytes);
+    const std::vector<uint8_t> record(state.range(0), 'x');
+    for (size_t size = 0; size < kMaxBufferSizeBytes; size += record.size()) {
+        buffer.append(record);
+    }
+    for (auto _ : state) {
+        buffer.append(record);
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * record.size());
+}
+BENCHMARK_TEMPLATE(BM_Append, ListRingbuffer)
+    ->Arg(64)
+    ->Arg(256)
+    ->Arg(1024)
+    ->Arg(4096);
+BENCHMARK_TEMPLATE(BM_Append, Ringbuffer)
+    ->Arg(64)
+    ->Arg(256)
+    ->Arg(1024)
+    ->Arg(4096);
+
+// Writes a full ring of state.range(0) byte records to /dev/null.
+template <typename Buffer>
+void BM_WriteToFd(benchmark::State& state) {
+    Buffer buffer(kMaxBufferSizeBytes);
+    const std::vector<uint8_t> record(state.range(0), 'x');
+    for (size_t size = 0; size < kMaxBufferSizeBytes; size += record.size()) {
+        buffer.append(record);
+    }
+    base::unique_fd fd(open("/dev/null", O_WRONLY | O_CLOEXEC));
+    if (fd == -1) {
+        state.SkipWithError("failed to open /dev/null");
+        return;
+    }
+    for (auto _ : state) {
+        buffer.writeToFd(fd);
+    }
+    state.SetBytesProcessed(state.iterations() * kMaxBufferSizeBytes);
+}
+BENCHMARK_TEMPLATE(BM_WriteToFd, ListRingbuffer)->Arg(64)->Arg(1024);
+BENCHMARK_TEMPLATE(BM_WriteToFd, Ringbuffer)->Arg(64)->Arg(1024);
+
+}  // namespace
+}  // namespace implementation
+}  // namespace V1_3
+}  // namespace wifi
+}  // namespace hardware
+}  // namespace android
+
+BENCHMARK_MAIN();
@@ -17,6 +17,7 @@
 #ifndef HIDL_CALLBACK_UTIL_H_
 #define HIDL_CALLBACK_UTIL_H_
 
+#include <mutex>
 #include <set>
 
 #include <hidl/HidlSupport.h>
@@ -58,6 +59,8 @@ namespace hidl_callback_util {
 template <typename CallbackType>
 // Provides a class to manage callbacks for the various HIDL interfaces and
 // handle the death of the process hosting each callback.
+// The callbacks are registered from the HIDL thread and read from the legacy
+// HAL's event loop, so access to them is guarded by a lock of its own.
 class HidlCallbackHandler {
    public:
     HidlCallbackHandler()
@@ -71,6 +74,7 @@ class HidlCallbackHandler {
         // (callback proxy's raw pointer) to track the death of individual
         // clients.
         uint64_t cookie = reinterpret_cast<uint64_t>(cb.get());
+        const std::lock_guard<std::mutex> lock(cb_set_lock_);
         if (cb_set_.find(cb) != cb_set_.end()) {
             LOG(WARNING) << "Duplicate death notification registration";
             return true;
@@ -83,13 +87,16 @@ class HidlCallbackHandler {
         return true;
     }
 
-    const std::set<android::sp<CallbackType>>& getCallbacks() {
+    // Returns a copy, so the callbacks can be invoked without holding the lock.
+    std::set<android::sp<CallbackType>> getCallbacks() {
+        const std::lock_guard<std::mutex> lock(cb_set_lock_);
         return cb_set_;
     }
 
     // Death notification for callbacks.
     void onObjectDeath(uint64_t cookie) {
         CallbackType* cb = reinterpret_cast<CallbackType*>(cookie);
+        const std::lock_guard<std::mutex> lock(cb_set_lock_);
         const auto& iter = cb_set_.find(cb);
         if (iter == cb_set_.end()) {
             LOG(ERROR) << "Unknown callback death notification received";
@@ -100,6 +107,7 @@ class HidlCallbackHandler {
     }
 
     void invalidate() {
+        const std::lock_guard<std::mutex> lock(cb_set_lock_);
         for (const sp<CallbackType>& cb : cb_set_) {
             if (!cb->unlinkToDeath(death_handler_)) {
                 LOG(ERROR) << "Failed to deregister death notification";
@@ -109,6 +117,7 @@ class HidlCallbackHandler {
     }
 
    private:
+    std::mutex cb_set_lock_;
     std::set<sp<CallbackType>> cb_set_;
     sp<HidlDeathHandler<CallbackType>> death_handler_;
 
@@ -17,6 +17,8 @@
 #ifndef HIDL_SYNC_UTIL_H_
 #define HIDL_SYNC_UTIL_H_
 
+#include <functional>
+#include <memory>
 #include <mutex>
 
 // Utility that provides a global lock to synchronize access between
@@ -28,6 +30,50 @@ namespace V1_3 {
 namespace implementation {
 namespace hidl_sync_util {
 std::unique_lock<std::recursive_mutex> acquireGlobalLock();
+
+/**
+ * Holds a callback which is set and reset from the HIDL thread and invoked
+ * from the legacy HAL's event loop without taking the global lock.
+ * An invocation keeps its own reference to the callback, so the slot can be
+ * reset or replaced while the callback is running.
+ */
+template <typename Signature>
+class CallbackSlot {
+   public:
+    CallbackSlot& operator=(const std::function<Signature>& callback) {
+        std::shared_ptr<const std::function<Signature>> new_callback;
+        if (callback) {
+            new_callback =
+                std::make_shared<const std::function<Signature>>(callback);
+        }
+        std::atomic_store(&callback_, std::move(new_callback));
+        return *this;
+    }
+
+    CallbackSlot& operator=(std::nullptr_t) {
+        std::atomic_store(&callback_,
+                          std::shared_ptr<const std::function<Signature>>());
+        return *this;
+    }
+
+    explicit operator bool() const {
+        return std::atomic_load(&callback_) != nullptr;
+    }
+
+    // Invokes the callback if one is set. Returns false if the slot is empty.
+    template <typename... Args>
+    bool invoke(Args&&... args) const {
+        const auto callback = std::atomic_load(&callback_);
+        if (!callback) {
+            return false;
+        }
+        (*callback)(std::forward<Args>(args)...);
+        return true;
+    }
+
+   private:
+    std::shared_ptr<const std::function<Signature>> callback_;
+};
 }  // namespace hidl_sync_util
 }  // namespace implementation
 }  // namespace V1_3
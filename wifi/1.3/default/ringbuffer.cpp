@@ -14,6 +14,12 @@
  * limitations under the License.
  */
 
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+
 #include <android-base/logging.h>
 
 #include "ringbuffer.h"
@@ -24,27 +30,100 @@ namespace wifi {
 namespace V1_3 {
 namespace implementation {
 
-Ringbuffer::Ringbuffer(size_t maxSize) : size_(0), maxSize_(maxSize) {}
+Ringbuffer::Ringbuffer(size_t maxSize)
+    : head_(0), size_(0), maxSize_(maxSize) {}
 
 void Ringbuffer::append(const std::vector<uint8_t>& input) {
-    if (input.size() == 0) {
+    append(input.data(), input.size());
+}
+
+void Ringbuffer::append(const uint8_t* input, size_t size) {
+    if (size == 0) {
         return;
     }
-    if (input.size() > maxSize_) {
-        LOG(INFO) << "Oversized message of " << input.size()
-                  << " bytes is dropped";
+    if (size > maxSize_) {
+        LOG(INFO) << "Oversized message of " << size << " bytes is dropped";
         return;
     }
-    data_.push_back(input);
-    size_ += input.size() * sizeof(input[0]);
-    while (size_ > maxSize_) {
-        size_ -= data_.front().size() * sizeof(data_.front()[0]);
-        data_.pop_front();
+    if (!buffer_) {
+        // Default initialized, pages are only touched when written to.
+        buffer_.reset(new uint8_t[maxSize_]);
+    }
+    while (size_ + size > maxSize_) {
+        head_ = (head_ + record_sizes_.front()) % maxSize_;
+        size_ -= record_sizes_.front();
+        record_sizes_.pop_front();
+    }
+    if (size_ == 0) {
+        head_ = 0;
+    }
+    size_t tail = (head_ + size_) % maxSize_;
+    size_t first_size = std::min(size, maxSize_ - tail);
+    memcpy(buffer_.get() + tail, input, first_size);
+    memcpy(buffer_.get(), input + first_size, size - first_size);
+    record_sizes_.push_back(size);
+    size_ += size;
+}
+
+std::list<std::vector<uint8_t>> Ringbuffer::getData() const {
+    std::list<std::vector<uint8_t>> data;
+    size_t offset = head_;
+    for (size_t record_size : record_sizes_) {
+        std::vector<uint8_t> record(record_size);
+        size_t first_size = std::min(record_size, maxSize_ - offset);
+        memcpy(record.data(), buffer_.get() + offset, first_size);
+        memcpy(record.data() + first_size, buffer_.get(),
+               record_size - first_size);
+        data.push_back(std::move(record));
+        offset = (offset + record_size) % maxSize_;
     }
+    return data;
 }
 
-const std::list<std::vector<uint8_t>>& Ringbuffer::getData() const {
-    return data_;
+Ringbuffer Ringbuffer::snapshot() const {
+    Ringbuffer copy(maxSize_);
+    if (empty()) {
+        return copy;
+    }
+    // Only the bytes held are copied, moved to the front of the copy.
+    copy.buffer_.reset(new uint8_t[maxSize_]);
+    size_t first_size = std::min(size_, maxSize_ - head_);
+    memcpy(copy.buffer_.get(), buffer_.get() + head_, first_size);
+    memcpy(copy.buffer_.get() + first_size, buffer_.get(), size_ - first_size);
+    copy.record_sizes_ = record_sizes_;
+    copy.size_ = size_;
+    return copy;
+}
+
+bool Ringbuffer::writeToFd(int fd) const {
+    if (empty()) {
+        return true;
+    }
+    size_t first_size = std::min(size_, maxSize_ - head_);
+    struct iovec iov[2] = {
+        {buffer_.get() + head_, first_size},
+        {buffer_.get(), size_ - first_size},
+    };
+    int iovcnt = size_ > first_size ? 2 : 1;
+    struct iovec* cur_iov = iov;
+    while (iovcnt > 0) {
+        ssize_t written = TEMP_FAILURE_RETRY(writev(fd, cur_iov, iovcnt));
+        if (written < 0) {
+            return false;
+        }
+        // Skip what a short write got through and retry the rest.
+        while (iovcnt > 0 && static_cast<size_t>(written) >= cur_iov->iov_len) {
+            written -= cur_iov->iov_len;
+            cur_iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            cur_iov->iov_base =
+                static_cast<uint8_t*>(cur_iov->iov_base) + written;
+            cur_iov->iov_len -= written;
+        }
+    }
+    return true;
 }
 
 }  // namespace implementation
@@ -17,7 +17,9 @@
 #ifndef RINGBUFFER_H_
 #define RINGBUFFER_H_
 
+#include <deque>
 #include <list>
+#include <memory>
 #include <vector>
 
 namespace android {
@@ -28,6 +30,10 @@ namespace implementation {
 
 /**
  * Ringbuffer object used to store debug data.
+ *
+ * Records are stored back to back in a single buffer of |maxSize| bytes, so
+ * appending a record does not allocate and the whole content can be written
+ * out with at most two iovecs.
  */
 class Ringbuffer {
    public:
@@ -36,10 +42,31 @@ class Ringbuffer {
     // Appends the data buffer and deletes from the front until buffer is
     // within |maxSize_|.
     void append(const std::vector<uint8_t>& input);
-    const std::list<std::vector<uint8_t>>& getData() const;
+    void append(const uint8_t* input, size_t size);
+
+    bool empty() const { return size_ == 0; }
+    // Total bytes of all the records held.
+    size_t size() const { return size_; }
+
+    // Returns a copy of the records, oldest first.
+    std::list<std::vector<uint8_t>> getData() const;
+
+    // Returns a copy of the ring holding the same records, e.g. to write them
+    // out after releasing the lock guarding this one.
+    Ringbuffer snapshot() const;
+
+    // Writes the records, oldest first, to |fd| with writev().
+    // Returns false if the write fails.
+    bool writeToFd(int fd) const;
 
    private:
-    std::list<std::vector<uint8_t>> data_;
+    // Lazily allocated on the first append, rings that never get data cost
+    // nothing.
+    std::unique_ptr<uint8_t[]> buffer_;
+    // Size of each record held, oldest first.
+    std::deque<size_t> record_sizes_;
+    // Offset of the oldest record in |buffer_|.
+    size_t head_;
     size_t size_;
     size_t maxSize_;
 };
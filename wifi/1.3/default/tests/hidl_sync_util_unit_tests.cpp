@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2019, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <gmock/gmock.h>
+
+#include "hidl_return_util.h"
+#include "hidl_sync_util.h"
+
+using testing::Test;
+
+namespace {
+constexpr auto kCallbackDuration = std::chrono::milliseconds(20);
+constexpr int kNumCallbackThreads = 4;
+constexpr int kNumHidlCalls = 50;
+}  // namespace
+
+namespace android {
+namespace hardware {
+namespace wifi {
+namespace V1_3 {
+namespace implementation {
+using hidl_return_util::validateAndCall;
+using hidl_sync_util::CallbackSlot;
+
+class CallbackSlotTest : public Test {
+   public:
+    CallbackSlot<void(int)> slot_;
+};
+
+TEST_F(CallbackSlotTest, InvokeEmptySlot) {
+    ASSERT_FALSE(slot_);
+    ASSERT_FALSE(slot_.invoke(1));
+}
+
+TEST_F(CallbackSlotTest, InvokeSetSlot) {
+    int value = 0;
+    slot_ = [&value](int new_value) { value = new_value; };
+    ASSERT_TRUE(slot_);
+    ASSERT_TRUE(slot_.invoke(5));
+    ASSERT_EQ(5, value);
+}
+
+TEST_F(CallbackSlotTest, SetEmptyFunctionClearsSlot) {
+    slot_ = [](int) {};
+    slot_ = std::function<void(int)>();
+    ASSERT_FALSE(slot_);
+}
+
+TEST_F(CallbackSlotTest, ResetFromCallbackKeepsCallbackAlive) {
+    auto state = std::make_shared<int>(0);
+    slot_ = [this, state](int value) {
+        slot_ = nullptr;
+        // |state| is owned by this callback, so this would be a use after free
+        // if resetting the slot destroyed the running callback.
+        *state = value;
+    };
+    ASSERT_TRUE(slot_.invoke(7));
+    ASSERT_FALSE(slot_);
+    ASSERT_EQ(7, *state);
+    ASSERT_EQ(1, state.use_count());
+}
+
+// Stands in for a HIDL object whose methods replace a callback that the
+// event loop is invoking.
+class FakeHidlObject {
+   public:
+    bool isValid() { return true; }
+
+    WifiStatus registerCallbackInternal() {
+        slot_ = [](int) { std::this_thread::sleep_for(kCallbackDuration); };
+        return createWifiStatus(WifiStatusCode::SUCCESS);
+    }
+
+    CallbackSlot<void(int)> slot_;
+};
+
+// A burst of slow callbacks from the event loop must not hold up HIDL calls.
+TEST(HidlSyncUtilStressTest, HidlCallLatencyWhileCallbacksFlood) {
+    FakeHidlObject object;
+    object.registerCallbackInternal();
+
+    std::atomic<bool> stop{false};
+    std::atomic<int> num_callbacks{0};
+    std::vector<std::thread> callback_threads;
+    for (int i = 0; i < kNumCallbackThreads; i++) {
+        callback_threads.emplace_back([&object, &stop, &num_callbacks] {
+            while (!stop) {
+                object.slot_.invoke(0);
+                num_callbacks++;
+            }
+        });
+    }
+
+    std::vector<std::chrono::steady_clock::duration> latencies;
+    for (int i = 0; i < kNumHidlCalls; i++) {
+        const auto start = std::chrono::steady_clock::now();
+        validateAndCall(&object, WifiStatusCode::ERROR_UNKNOWN,
+                        &FakeHidlObject::registerCallbackInternal,
+                        [](const WifiStatus& status) {
+                            ASSERT_EQ(WifiStatusCode::SUCCESS, status.code);
+                        });
+        latencies.push_back(std::chrono::steady_clock::now() - start);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    stop = true;
+    for (auto& thread : callback_threads) {
+        thread.join();
+    }
+
+    ASSERT_GT(num_callbacks, 0);
+    std::sort(latencies.begin(), latencies.end());
+    // With callbacks holding the global lock, most of the calls would wait for
+    // a callback to finish.
+    const auto p90_latency =
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            latencies[latencies.size() * 9 / 10]);
+    EXPECT_LT(p90_latency.count(), (kCallbackDuration / 2).count());
+}
+
+}  // namespace implementation
+}  // namespace V1_3
+}  // namespace wifi
+}  // namespace hardware
+}  // namespace android
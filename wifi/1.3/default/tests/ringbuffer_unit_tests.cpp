@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include <android-base/file.h>
 #include <gmock/gmock.h>
 
 #include "ringbuffer.h"
@@ -90,6 +91,70 @@ TEST_F(RingbufferTest, OversizedAppendDoesNotDropExistingData) {
     ASSERT_EQ(1u, buffer_.getData().size());
     EXPECT_EQ(input, buffer_.getData().front());
 }
+
+TEST_F(RingbufferTest, RecordsWrapAroundTheEndOfTheBuffer) {
+    const std::vector<uint8_t> input = {'0', '1', '2', '3'};
+    const std::vector<uint8_t> input2 = {'4', '5', '6', '7'};
+    const std::vector<uint8_t> input3 = {'8', '9', 'a', 'b'};
+    buffer_.append(input);
+    buffer_.append(input2);
+    // Only fits by wrapping around after dropping |input|.
+    buffer_.append(input3);
+    ASSERT_EQ(2u, buffer_.getData().size());
+    EXPECT_EQ(input2, buffer_.getData().front());
+    EXPECT_EQ(input3, buffer_.getData().back());
+    EXPECT_EQ(input2.size() + input3.size(), buffer_.size());
+}
+
+TEST_F(RingbufferTest, SnapshotHoldsTheSameRecords) {
+    const std::vector<uint8_t> input = {'0', '1', '2', '3'};
+    const std::vector<uint8_t> input2 = {'4', '5', '6', '7'};
+    const std::vector<uint8_t> input3 = {'8', '9', 'a', 'b'};
+    buffer_.append(input);
+    buffer_.append(input2);
+    buffer_.append(input3);
+
+    Ringbuffer snapshot = buffer_.snapshot();
+    EXPECT_EQ(buffer_.getData(), snapshot.getData());
+    EXPECT_EQ(buffer_.size(), snapshot.size());
+
+    // The snapshot is independent of the ring, and wraps around the same way.
+    buffer_.append(input);
+    snapshot.append(input3);
+    ASSERT_EQ(2u, snapshot.getData().size());
+    EXPECT_EQ(input3, snapshot.getData().front());
+    EXPECT_EQ(input3, snapshot.getData().back());
+    EXPECT_EQ(input, buffer_.getData().back());
+}
+
+TEST_F(RingbufferTest, SnapshotOfEmptyBufferIsEmpty) {
+    Ringbuffer snapshot = buffer_.snapshot();
+    EXPECT_TRUE(snapshot.empty());
+    EXPECT_TRUE(snapshot.getData().empty());
+}
+
+TEST_F(RingbufferTest, WriteToFdWritesRecordsInOrder) {
+    const std::vector<uint8_t> input = {'0', '1', '2', '3'};
+    const std::vector<uint8_t> input2 = {'4', '5', '6', '7'};
+    const std::vector<uint8_t> input3 = {'8', '9', 'a', 'b'};
+    buffer_.append(input);
+    buffer_.append(input2);
+    buffer_.append(input3);
+
+    TemporaryFile file;
+    ASSERT_TRUE(buffer_.writeToFd(file.fd));
+    std::string content;
+    ASSERT_TRUE(android::base::ReadFileToString(file.path, &content));
+    EXPECT_EQ("456789ab", content);
+}
+
+TEST_F(RingbufferTest, WriteToFdOfEmptyBufferWritesNothing) {
+    TemporaryFile file;
+    ASSERT_TRUE(buffer_.writeToFd(file.fd));
+    std::string content;
+    ASSERT_TRUE(android::base::ReadFileToString(file.path, &content));
+    EXPECT_TRUE(content.empty());
+}
 }  // namespace implementation
 }  // namespace V1_3
 }  // namespace wifi
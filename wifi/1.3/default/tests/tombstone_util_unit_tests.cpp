@@ -0,0 +1,236 @@
+/*
+ * Copyright (C) 2019, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <android-base/file.h>
+#include <android-base/unique_fd.h>
+#include <gmock/gmock.h>
+
+#include "tombstone_util.h"
+
+using android::base::Pipe;
+using android::base::ReadFdToString;
+using android::base::ReadFileToString;
+using android::base::TemporaryDir;
+using android::base::TemporaryFile;
+using android::base::unique_fd;
+using android::base::WriteStringToFile;
+using testing::Test;
+
+namespace {
+// Offsets of the fields used from a cpio "new ASCII" header.
+constexpr size_t kCpioHeaderSize = 110;
+constexpr size_t kCpioFileSizeOffset = 54;
+constexpr size_t kCpioNameSizeOffset = 94;
+constexpr char kCpioTrailerName[] = "TRAILER!!!";
+
+size_t alignTo4(size_t offset) { return (offset + 3) & ~3; }
+
+// Parses |archive| into a map of file name to content. Returns false if the
+// archive is malformed.
+bool parseCpioArchive(const std::string& archive,
+                      std::map<std::string, std::string>* files) {
+    size_t offset = 0;
+    while (offset + kCpioHeaderSize <= archive.size()) {
+        if (archive.compare(offset, 6, "070701") != 0) {
+            return false;
+        }
+        const size_t file_size = std::stoul(
+            archive.substr(offset + kCpioFileSizeOffset, 8), nullptr, 16);
+        const size_t name_size = std::stoul(
+            archive.substr(offset + kCpioNameSizeOffset, 8), nullptr, 16);
+        offset += kCpioHeaderSize;
+        if (name_size == 0 || offset + name_size > archive.size()) {
+            return false;
+        }
+        // The name size includes the null terminator.
+        const std::string name = archive.substr(offset, name_size - 1);
+        if (name == kCpioTrailerName) {
+            return true;
+        }
+        offset = alignTo4(offset + name_size);
+        if (offset + file_size > archive.size()) {
+            return false;
+        }
+        (*files)[name] = archive.substr(offset, file_size);
+        offset = alignTo4(offset + file_size);
+    }
+    return false;
+}
+
+void setFileAge(const std::string& path, time_t age_seconds) {
+    const struct timespec times[2] = {{time(0) - age_seconds, 0},
+                                      {time(0) - age_seconds, 0}};
+    ASSERT_EQ(0, utimensat(AT_FDCWD, path.c_str(), times, 0));
+}
+}  // namespace
+
+namespace android {
+namespace hardware {
+namespace wifi {
+namespace V1_3 {
+namespace implementation {
+
+class TombstoneUtilTest : public Test {
+   public:
+    std::string writeFile(const std::string& name, const std::string& data) {
+        const std::string path = std::string(dir_.path) + "/" + name;
+        EXPECT_TRUE(WriteStringToFile(data, path));
+        return path;
+    }
+
+    TemporaryDir dir_;
+};
+
+TEST_F(TombstoneUtilTest, ArchiveContainsAllFiles) {
+    const std::map<std::string, std::string> expected_files = {
+        {"empty", ""},
+        {"a", "12345"},
+        {"ring_buffer", std::string(100 * 1024 + 3, 'x')}};
+    for (const auto& file : expected_files) {
+        writeFile(file.first, file.second);
+    }
+    TemporaryFile out;
+    ASSERT_EQ(0u, tombstone_util::cpioArchiveFilesInDir(out.fd, dir_.path));
+
+    std::string archive;
+    ASSERT_TRUE(ReadFileToString(out.path, &archive));
+    std::map<std::string, std::string> files;
+    ASSERT_TRUE(parseCpioArchive(archive, &files));
+    EXPECT_EQ(expected_files, files);
+}
+
+TEST_F(TombstoneUtilTest, ArchiveOfEmptyDirHasOnlyTrailer) {
+    TemporaryFile out;
+    ASSERT_EQ(0u, tombstone_util::cpioArchiveFilesInDir(out.fd, dir_.path));
+
+    std::string archive;
+    ASSERT_TRUE(ReadFileToString(out.path, &archive));
+    std::map<std::string, std::string> files;
+    ASSERT_TRUE(parseCpioArchive(archive, &files));
+    EXPECT_TRUE(files.empty());
+}
+
+TEST_F(TombstoneUtilTest, ArchiveOfMissingDirFails) {
+    TemporaryFile out;
+    EXPECT_NE(0u, tombstone_util::cpioArchiveFilesInDir(
+                      out.fd, std::string(dir_.path) + "/missing"));
+}
+
+TEST_F(TombstoneUtilTest, WorkerStreamsArchiveIntoPipe) {
+    writeFile("a", "12345");
+    writeFile("b", std::string(256 * 1024, 'y'));
+    unique_fd read_fd;
+    unique_fd write_fd;
+    ASSERT_TRUE(Pipe(&read_fd, &write_fd));
+    tombstone_util::CpioArchiveWorker worker;
+    ASSERT_TRUE(worker.archiveFilesInDir(std::move(write_fd), dir_.path));
+
+    // Returns once the worker has closed the write end.
+    std::string archive;
+    ASSERT_TRUE(ReadFdToString(read_fd, &archive));
+    std::map<std::string, std::string> files;
+    ASSERT_TRUE(parseCpioArchive(archive, &files));
+    EXPECT_EQ(2u, files.size());
+    EXPECT_EQ("12345", files["a"]);
+    EXPECT_EQ(std::string(256 * 1024, 'y'), files["b"]);
+}
+
+TEST_F(TombstoneUtilTest, WorkerWritesOneArchiveAtATime) {
+    // Larger than a pipe buffer, so that the first archive blocks until read.
+    writeFile("a", std::string(256 * 1024, 'y'));
+    tombstone_util::CpioArchiveWorker worker;
+    std::vector<unique_fd> read_fds;
+    for (size_t i = 0;
+         i < 1 + tombstone_util::CpioArchiveWorker::kMaxPendingArchives; i++) {
+        unique_fd read_fd;
+        unique_fd write_fd;
+        ASSERT_TRUE(Pipe(&read_fd, &write_fd));
+        ASSERT_TRUE(worker.archiveFilesInDir(std::move(write_fd), dir_.path));
+        if (i == 0) {
+            // Wait for the worker to start on the first archive, so that the
+            // others are all pending.
+            struct pollfd pfd = {read_fd, POLLIN, 0};
+            ASSERT_EQ(1, poll(&pfd, 1, -1));
+        }
+        read_fds.push_back(std::move(read_fd));
+    }
+
+    // Refused while the queue is full, which closes the fd.
+    unique_fd read_fd;
+    unique_fd write_fd;
+    ASSERT_TRUE(Pipe(&read_fd, &write_fd));
+    EXPECT_FALSE(worker.archiveFilesInDir(std::move(write_fd), dir_.path));
+    std::string archive;
+    ASSERT_TRUE(ReadFdToString(read_fd, &archive));
+    EXPECT_TRUE(archive.empty());
+
+    for (const unique_fd& fd : read_fds) {
+        ASSERT_TRUE(ReadFdToString(fd, &archive));
+        std::map<std::string, std::string> files;
+        ASSERT_TRUE(parseCpioArchive(archive, &files));
+        EXPECT_EQ(1u, files.size());
+    }
+}
+
+TEST_F(TombstoneUtilTest, StoppedWorkerRefusesArchives) {
+    tombstone_util::CpioArchiveWorker worker;
+    worker.stop();
+    unique_fd read_fd;
+    unique_fd write_fd;
+    ASSERT_TRUE(Pipe(&read_fd, &write_fd));
+    EXPECT_FALSE(worker.archiveFilesInDir(std::move(write_fd), dir_.path));
+    std::string archive;
+    ASSERT_TRUE(ReadFdToString(read_fd, &archive));
+    EXPECT_TRUE(archive.empty());
+}
+
+TEST_F(TombstoneUtilTest, RemoveOldFilesKeepsNewestFiles) {
+    for (int i = 0; i < 5; i++) {
+        setFileAge(writeFile("file" + std::to_string(i), "data"), 10 * i);
+    }
+    ASSERT_TRUE(tombstone_util::removeOldFiles(dir_.path, 3, 60 * 60));
+
+    for (int i = 0; i < 5; i++) {
+        const std::string path =
+            std::string(dir_.path) + "/file" + std::to_string(i);
+        EXPECT_EQ(i < 3, access(path.c_str(), F_OK) == 0) << path;
+    }
+}
+
+TEST_F(TombstoneUtilTest, RemoveOldFilesRemovesExpiredFiles) {
+    const std::string new_file = writeFile("new", "data");
+    const std::string old_file = writeFile("old", "data");
+    setFileAge(old_file, 2 * 60 * 60);
+    ASSERT_TRUE(tombstone_util::removeOldFiles(dir_.path, 10, 60 * 60));
+
+    EXPECT_EQ(0, access(new_file.c_str(), F_OK));
+    EXPECT_NE(0, access(old_file.c_str(), F_OK));
+}
+}  // namespace implementation
+}  // namespace V1_3
+}  // namespace wifi
+}  // namespace hardware
+}  // namespace android
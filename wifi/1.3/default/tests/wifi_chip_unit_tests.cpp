@@ -14,6 +14,9 @@
  * limitations under the License.
  */
 
+#include <atomic>
+#include <thread>
+
 #include <android-base/logging.h>
 #include <android-base/macros.h>
 #include <cutils/properties.h>
@@ -864,6 +867,38 @@ TEST_F(WifiChip_MultiIfaceTest, CreateApStartsWithIdx1) {
     ASSERT_EQ(createIface(IfaceType::STA), "wlan2");
     ASSERT_EQ(createIface(IfaceType::STA), "wlan3");
 }
+
+// Radio mode change callbacks arrive on the legacy HAL's event loop without
+// the global lock, concurrently with the HIDL calls.
+TEST_F(WifiChip_MultiIfaceTest, CreateAndRemoveStaWhileRadioModeChangesFlood) {
+    legacy_hal::on_radio_mode_change_callback radio_mode_change_callback;
+    EXPECT_CALL(*legacy_hal_,
+                registerRadioModeChangeCallbackHandler(testing::_, testing::_))
+        .WillOnce(testing::DoAll(
+            testing::SaveArg<1>(&radio_mode_change_callback),
+            testing::Return(legacy_hal::WIFI_SUCCESS)));
+    findModeAndConfigureForIfaceType(IfaceType::STA);
+    ASSERT_TRUE(radio_mode_change_callback != nullptr);
+
+    std::atomic<bool> stop{false};
+    std::atomic<int> num_callbacks{0};
+    std::thread event_loop([&radio_mode_change_callback, &stop,
+                            &num_callbacks] {
+        const std::vector<legacy_hal::WifiMacInfo> mac_infos(2);
+        while (!stop) {
+            radio_mode_change_callback(mac_infos);
+            num_callbacks++;
+        }
+    });
+    for (int i = 0; i < 100; i++) {
+        const std::string iface_name = createIface(IfaceType::STA);
+        EXPECT_EQ("wlan0", iface_name);
+        removeIface(IfaceType::STA, iface_name);
+    }
+    stop = true;
+    event_loop.join();
+    ASSERT_GT(num_callbacks, 0);
+}
 }  // namespace implementation
 }  // namespace V1_3
 }  // namespace wifi
@@ -0,0 +1,371 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <utility>
+#include <vector>
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+
+#include "tombstone_util.h"
+
+namespace {
+using android::base::unique_fd;
+using android::base::WriteFully;
+
+constexpr char kCpioMagic[] = "070701";
+// Size of the buffer used when sendfile() can't be used for |out_fd|.
+constexpr size_t kCopyBufferSize = 32 * 1024;
+// Largest chunk handed to a single sendfile() call.
+constexpr size_t kMaxSendfileSize = 1024 * 1024 * 1024;
+
+bool cpioWritePadding(int out_fd, size_t len) {
+    const uint32_t zero = 0;
+    const size_t padding = (4 - len % 4) % 4;
+    return padding == 0 || WriteFully(out_fd, &zero, padding);
+}
+
+// Helper function for |cpioArchiveFilesInDir|
+bool cpioWriteHeader(int out_fd, const struct stat& st, const char* file_name) {
+    // The cpio FreeBSD file header expects the null character to be included
+    // in the length.
+    const size_t file_name_len = strlen(file_name) + 1;
+    std::array<char, 128> header;
+    const int header_len = snprintf(
+        header.data(), header.size(),
+        "%s%08X%08X%08X%08X%08X%08X%08X%08X%08X%08X%08X%08X%08X", kCpioMagic,
+        static_cast<int>(st.st_ino), st.st_mode, st.st_uid, st.st_gid,
+        static_cast<int>(st.st_nlink), static_cast<int>(st.st_mtime),
+        static_cast<int>(st.st_size), major(st.st_dev), minor(st.st_dev),
+        major(st.st_rdev), minor(st.st_rdev),
+        static_cast<uint32_t>(file_name_len), 0);
+    if (!WriteFully(out_fd, header.data(), header_len)) {
+        PLOG(ERROR) << "Error writing cpio header to file " << file_name;
+        return false;
+    }
+    if (!WriteFully(out_fd, file_name, file_name_len)) {
+        PLOG(ERROR) << "Error writing filename to file " << file_name;
+        return false;
+    }
+    // NUL Pad header up to 4 multiple bytes.
+    if (!cpioWritePadding(out_fd, header_len + file_name_len)) {
+        PLOG(ERROR) << "Error padding 0s to file " << file_name;
+        return false;
+    }
+    return true;
+}
+
+// Copies |*remaining| bytes from |fd_read| to |out_fd| through a bounded
+// buffer, counting down |*remaining| as they are written.
+bool copyFileContentWithBuffer(int fd_read, int out_fd, off_t* remaining) {
+    std::array<char, kCopyBufferSize> read_buf;
+    while (*remaining > 0) {
+        const ssize_t bytes_read = TEMP_FAILURE_RETRY(read(
+            fd_read, read_buf.data(),
+            std::min(read_buf.size(), static_cast<size_t>(*remaining))));
+        if (bytes_read == -1) {
+            PLOG(ERROR) << "Error reading file";
+            return false;
+        }
+        if (bytes_read == 0) {
+            LOG(ERROR) << "Unexpected end of file";
+            return false;
+        }
+        if (!WriteFully(out_fd, read_buf.data(), bytes_read)) {
+            PLOG(ERROR) << "Error writing data to file";
+            return false;
+        }
+        *remaining -= bytes_read;
+    }
+    return true;
+}
+
+// Copies |*remaining| bytes from |fd_read| to |out_fd|, counting down
+// |*remaining| as they are written.
+bool copyFileContent(int fd_read, int out_fd, off_t* remaining) {
+    const off_t size = *remaining;
+    while (*remaining > 0) {
+        const ssize_t bytes_sent = TEMP_FAILURE_RETRY(sendfile(
+            out_fd, fd_read, nullptr,
+            std::min(kMaxSendfileSize, static_cast<size_t>(*remaining))));
+        if (bytes_sent == -1) {
+            // sendfile() does not support every kind of |out_fd|, fall back
+            // to copying through user space if it fails right away.
+            if ((errno == EINVAL || errno == ENOSYS) && *remaining == size) {
+                return copyFileContentWithBuffer(fd_read, out_fd, remaining);
+            }
+            PLOG(ERROR) << "Error sending file data";
+            return false;
+        }
+        if (bytes_sent == 0) {
+            LOG(ERROR) << "Unexpected end of file";
+            return false;
+        }
+        *remaining -= bytes_sent;
+    }
+    return true;
+}
+
+bool cpioWriteZeros(int out_fd, off_t size) {
+    static const std::array<char, kCopyBufferSize> zeros{};
+    while (size > 0) {
+        const size_t len = std::min(zeros.size(), static_cast<size_t>(size));
+        if (!WriteFully(out_fd, zeros.data(), len)) {
+            return false;
+        }
+        size -= len;
+    }
+    return true;
+}
+
+// Helper function for |cpioArchiveFilesInDir|
+// If the file can't be read up to |size|, e.g. because it was truncated after
+// its header was written, the rest of its entry is filled with zeros and
+// |*complete| is set to false, so that the archive stays readable.
+// Returns false if |out_fd| can't be written to.
+bool cpioWriteFileContent(int fd_read, int out_fd, off_t size,
+                          bool* complete) {
+    off_t remaining = size;
+    *complete = copyFileContent(fd_read, out_fd, &remaining);
+    if (!*complete && !cpioWriteZeros(out_fd, remaining)) {
+        PLOG(ERROR) << "Error filling in file data";
+        return false;
+    }
+    if (!cpioWritePadding(out_fd, size)) {
+        PLOG(ERROR) << "Error padding 0s to file";
+        return false;
+    }
+    return true;
+}
+
+// Helper function for |cpioArchiveFilesInDir|
+bool cpioWriteFileTrailer(int out_fd) {
+    std::array<char, 4096> read_buf;
+    read_buf.fill(0);
+    if (!WriteFully(out_fd, read_buf.data(),
+                    sprintf(read_buf.data(), "070701%040X%056X%08XTRAILER!!!",
+                            1, 0x0b, 0) +
+                        4)) {
+        PLOG(ERROR) << "Error writing trailing bytes";
+        return false;
+    }
+    return true;
+}
+// Logic obtained from //external/toybox/toys/posix/cpio.c "Output cpio archive"
+// portion
+// Stops adding files once |*cancelled| is set, if |cancelled| is not null.
+size_t cpioArchiveFilesInDirInternal(int out_fd, const std::string& input_dir,
+                                     const std::atomic<bool>* cancelled) {
+    size_t n_error = 0;
+    std::unique_ptr<DIR, decltype(&closedir)> dir_dump(
+        opendir(input_dir.c_str()), closedir);
+    if (!dir_dump) {
+        PLOG(ERROR) << "Failed to open directory";
+        return ++n_error;
+    }
+    const int dir_fd = dirfd(dir_dump.get());
+    struct dirent* dp;
+    while ((dp = readdir(dir_dump.get()))) {
+        if (cancelled && *cancelled) {
+            LOG(INFO) << "Archive of " << input_dir << " cancelled";
+            break;
+        }
+        if (dp->d_type != DT_REG) {
+            continue;
+        }
+        unique_fd fd_read(TEMP_FAILURE_RETRY(
+            openat(dir_fd, dp->d_name, O_RDONLY | O_CLOEXEC)));
+        if (fd_read == -1) {
+            // The file may have been deleted by |removeOldFiles| since the
+            // directory was read.
+            if (errno != ENOENT) {
+                PLOG(ERROR) << "Failed to open file " << input_dir
+                            << dp->d_name;
+                n_error++;
+            }
+            continue;
+        }
+        struct stat st;
+        if (fstat(fd_read, &st) == -1) {
+            PLOG(ERROR) << "Failed to get file stat for " << input_dir
+                        << dp->d_name;
+            n_error++;
+            continue;
+        }
+        bool complete;
+        if (!cpioWriteHeader(out_fd, st, dp->d_name) ||
+            !cpioWriteFileContent(fd_read, out_fd, st.st_size, &complete)) {
+            return ++n_error;
+        }
+        if (!complete) {
+            n_error++;
+        }
+    }
+    if (!cpioWriteFileTrailer(out_fd)) {
+        return ++n_error;
+    }
+    return n_error;
+}
+
+}  // namespace
+
+namespace android {
+namespace hardware {
+namespace wifi {
+namespace V1_3 {
+namespace implementation {
+namespace tombstone_util {
+
+bool removeOldFiles(const std::string& dir, uint32_t max_file_num,
+                    uint32_t max_file_age_seconds) {
+    const time_t delete_files_before = time(0) - max_file_age_seconds;
+    std::unique_ptr<DIR, decltype(&closedir)> dir_dump(opendir(dir.c_str()),
+                                                       closedir);
+    if (!dir_dump) {
+        PLOG(ERROR) << "Failed to open directory";
+        return false;
+    }
+    const int dir_fd = dirfd(dir_dump.get());
+    // The newest files seen so far, with the oldest of them on top.
+    using FileEntry = std::pair<time_t, std::string>;
+    std::priority_queue<FileEntry, std::vector<FileEntry>,
+                        std::greater<FileEntry>>
+        newest_files;
+    struct dirent* dp;
+    bool success = true;
+    while ((dp = readdir(dir_dump.get()))) {
+        if (dp->d_type != DT_REG) {
+            continue;
+        }
+        struct stat cur_file_stat;
+        if (fstatat(dir_fd, dp->d_name, &cur_file_stat, 0) == -1) {
+            PLOG(ERROR) << "Failed to get file stat for " << dir << dp->d_name;
+            success = false;
+            continue;
+        }
+        FileEntry cur_file(cur_file_stat.st_mtime, dp->d_name);
+        if (cur_file.first >= delete_files_before) {
+            newest_files.push(std::move(cur_file));
+            if (newest_files.size() <= max_file_num) {
+                continue;
+            }
+            // Delete the oldest of the files kept instead.
+            cur_file = newest_files.top();
+            newest_files.pop();
+        }
+        if (unlinkat(dir_fd, cur_file.second.c_str(), 0) != 0) {
+            PLOG(ERROR) << "Error deleting file";
+            success = false;
+        }
+    }
+    return success;
+}
+
+size_t cpioArchiveFilesInDir(int out_fd, const std::string& input_dir) {
+    return cpioArchiveFilesInDirInternal(out_fd, input_dir, nullptr);
+}
+
+CpioArchiveWorker::~CpioArchiveWorker() { stop(); }
+
+bool CpioArchiveWorker::archiveFilesInDir(unique_fd out_fd,
+                                          const std::string& input_dir) {
+    std::lock_guard<std::mutex> lock(lock_);
+    if (stopped_) {
+        LOG(ERROR) << "Archive worker stopped";
+        return false;
+    }
+    if (pending_.size() >= kMaxPendingArchives) {
+        LOG(ERROR) << "Too many archives pending, dropping this one";
+        return false;
+    }
+    pending_.emplace_back(std::move(out_fd), input_dir);
+    if (!thread_.joinable()) {
+        thread_ = std::thread(&CpioArchiveWorker::run, this);
+    } else {
+        cv_.notify_one();
+    }
+    return true;
+}
+
+void CpioArchiveWorker::stop() {
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        stopped_ = true;
+        // Closing the fds tells their readers that no archive is coming.
+        pending_.clear();
+    }
+    cancelled_ = true;
+    cv_.notify_one();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void CpioArchiveWorker::run() {
+    // The reader may go away before the archive is complete. Get EPIPE from
+    // the writes instead of the process being killed by SIGPIPE.
+    sigset_t sigpipe_set;
+    sigemptyset(&sigpipe_set);
+    sigaddset(&sigpipe_set, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &sigpipe_set, nullptr);
+
+    std::unique_lock<std::mutex> lock(lock_);
+    while (true) {
+        cv_.wait(lock, [this] { return stopped_ || !pending_.empty(); });
+        if (stopped_) {
+            return;
+        }
+        std::pair<unique_fd, std::string> archive = std::move(pending_.front());
+        pending_.pop_front();
+        lock.unlock();
+
+        const size_t n_error = cpioArchiveFilesInDirInternal(
+            archive.first, archive.second, &cancelled_);
+        if (n_error != 0) {
+            LOG(ERROR) << n_error << " errors occured in cpio function";
+        }
+        fsync(archive.first);
+        // The reader sees the end of the archive once the fd is closed.
+        archive.first.reset();
+
+        lock.lock();
+    }
+}
+
+}  // namespace tombstone_util
+}  // namespace implementation
+}  // namespace V1_3
+}  // namespace wifi
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TOMBSTONE_UTIL_H_
+#define TOMBSTONE_UTIL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include <android-base/macros.h>
+#include <android-base/unique_fd.h>
+
+// Utility functions to manage the ring buffer files in the wifi tombstone
+// directory.
+namespace android {
+namespace hardware {
+namespace wifi {
+namespace V1_3 {
+namespace implementation {
+namespace tombstone_util {
+// Deletes the files in |dir| that are older than |max_file_age_seconds|, and
+// then the oldest ones in excess of |max_file_num|.
+// The directory is walked once, keeping track of only the |max_file_num|
+// newest files.
+bool removeOldFiles(const std::string& dir, uint32_t max_file_num,
+                    uint32_t max_file_age_seconds);
+
+// Archives all the regular files in |input_dir| into |out_fd| in the cpio
+// "new ASCII" format. File contents are copied by the kernel with sendfile()
+// where the file descriptors allow it.
+// Returns the number of errors encountered.
+size_t cpioArchiveFilesInDir(int out_fd, const std::string& input_dir);
+
+// Writes archives with |cpioArchiveFilesInDir| on a single worker thread, one
+// at a time, so that large tombstones don't block the caller.
+class CpioArchiveWorker {
+   public:
+    // Archives queued behind the one being written before new ones are
+    // refused.
+    static constexpr size_t kMaxPendingArchives = 4;
+
+    CpioArchiveWorker() = default;
+    ~CpioArchiveWorker();
+
+    // Queues an archive of |input_dir| into |out_fd|. |out_fd| is closed once
+    // the archive has been written, or right away if the archive is refused
+    // because the worker is stopped or too many archives are pending.
+    // Returns false if the archive is refused.
+    bool archiveFilesInDir(base::unique_fd out_fd,
+                           const std::string& input_dir);
+
+    // Drops the pending archives, ends the one being written after the
+    // current file and joins the worker thread. A write blocked on a reader
+    // that neither reads nor closes its end still holds up the join.
+    void stop();
+
+   private:
+    void run();
+
+    std::mutex lock_;
+    std::condition_variable cv_;
+    std::deque<std::pair<base::unique_fd, std::string>> pending_;
+    bool stopped_ = false;
+    std::atomic<bool> cancelled_{false};
+    std::thread thread_;
+
+    DISALLOW_COPY_AND_ASSIGN(CpioArchiveWorker);
+};
+}  // namespace tombstone_util
+}  // namespace implementation
+}  // namespace V1_3
+}  // namespace wifi
+}  // namespace hardware
+}  // namespace android
+
+#endif  // TOMBSTONE_UTIL_H_
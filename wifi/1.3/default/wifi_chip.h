@@ -17,14 +17,17 @@
 #ifndef WIFI_CHIP_H_
 #define WIFI_CHIP_H_
 
+#include <atomic>
 #include <list>
 #include <map>
+#include <mutex>
 
 #include <android-base/macros.h>
 #include <android/hardware/wifi/1.3/IWifiChip.h>
 
 #include "hidl_callback_util.h"
 #include "ringbuffer.h"
+#include "tombstone_util.h"
 #include "wifi_ap_iface.h"
 #include "wifi_feature_flags.h"
 #include "wifi_legacy_hal.h"
@@ -257,8 +260,12 @@ class WifiChip : public V1_3::IWifiChip {
     std::vector<sp<WifiP2pIface>> p2p_ifaces_;
     std::vector<sp<WifiStaIface>> sta_ifaces_;
     std::vector<sp<WifiRttController>> rtt_controllers_;
+    // Guards |ringbuffer_map_|, which is appended to from the legacy HAL's
+    // event loop.
+    std::mutex ringbuffer_map_lock_;
     std::map<std::string, Ringbuffer> ringbuffer_map_;
-    bool is_valid_;
+    // Read from the legacy HAL's event loop.
+    std::atomic<bool> is_valid_;
     // Members pertaining to chip configuration.
     uint32_t current_mode_id_;
     std::vector<IWifiChip::ChipMode> modes_;
@@ -268,6 +275,8 @@ class WifiChip : public V1_3::IWifiChip {
     bool debug_ring_buffer_cb_registered_;
     hidl_callback_util::HidlCallbackHandler<V1_2::IWifiChipEventCallback>
         event_cb_handler_;
+    // Streams the tombstone archives requested by |debug|.
+    tombstone_util::CpioArchiveWorker archive_worker_;
 
     DISALLOW_COPY_AND_ASSIGN(WifiChip);
 };
@@ -16,6 +16,7 @@
 
 #include <array>
 #include <chrono>
+#include <mutex>
 
 #include <android-base/logging.h>
 #include <cutils/properties.h>
@@ -56,8 +57,10 @@ namespace legacy_hal {
 // Legacy HAL functions accept "C" style function pointers, so use global
 // functions to pass to the legacy HAL function and store the corresponding
 // std::function methods to be invoked.
+// See THREADING.README for the locking of these callbacks.
 //
-// Callback to be invoked once |stop| is complete
+// Callback to be invoked once |stop| is complete. |stop| waits for this with
+// the global lock held, so unlike the other callbacks it takes the global lock.
 std::function<void(wifi_handle handle)> on_stop_complete_internal_callback;
 void onAsyncStopComplete(wifi_handle handle) {
     const auto lock = hidl_sync_util::acquireGlobalLock();
@@ -68,108 +71,96 @@ void onAsyncStopComplete(wifi_handle handle) {
     }
 }
 
+// The gscan and rtt callbacks reset themselves once the request completes.
+// These locks keep that from racing with the HIDL thread starting or stopping
+// the next request. All the other callbacks are invoked without any lock.
+std::mutex g_gscan_lock;
+std::mutex g_rtt_lock;
+
 // Callback to be invoked for driver dump.
-std::function<void(char*, int)> on_driver_memory_dump_internal_callback;
+hidl_sync_util::CallbackSlot<void(char*, int)>
+    on_driver_memory_dump_internal_callback;
 void onSyncDriverMemoryDump(char* buffer, int buffer_size) {
-    if (on_driver_memory_dump_internal_callback) {
-        on_driver_memory_dump_internal_callback(buffer, buffer_size);
-    }
+    on_driver_memory_dump_internal_callback.invoke(buffer, buffer_size);
 }
 
 // Callback to be invoked for firmware dump.
-std::function<void(char*, int)> on_firmware_memory_dump_internal_callback;
+hidl_sync_util::CallbackSlot<void(char*, int)>
+    on_firmware_memory_dump_internal_callback;
 void onSyncFirmwareMemoryDump(char* buffer, int buffer_size) {
-    if (on_firmware_memory_dump_internal_callback) {
-        on_firmware_memory_dump_internal_callback(buffer, buffer_size);
-    }
+    on_firmware_memory_dump_internal_callback.invoke(buffer, buffer_size);
 }
 
 // Callback to be invoked for Gscan events.
-std::function<void(wifi_request_id, wifi_scan_event)>
+hidl_sync_util::CallbackSlot<void(wifi_request_id, wifi_scan_event)>
     on_gscan_event_internal_callback;
 void onAsyncGscanEvent(wifi_request_id id, wifi_scan_event event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_gscan_event_internal_callback) {
-        on_gscan_event_internal_callback(id, event);
-    }
+    const std::lock_guard<std::mutex> lock(g_gscan_lock);
+    on_gscan_event_internal_callback.invoke(id, event);
 }
 
 // Callback to be invoked for Gscan full results.
-std::function<void(wifi_request_id, wifi_scan_result*, uint32_t)>
+hidl_sync_util::CallbackSlot<void(wifi_request_id, wifi_scan_result*,
+                                  uint32_t)>
     on_gscan_full_result_internal_callback;
 void onAsyncGscanFullResult(wifi_request_id id, wifi_scan_result* result,
                             uint32_t buckets_scanned) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_gscan_full_result_internal_callback) {
-        on_gscan_full_result_internal_callback(id, result, buckets_scanned);
-    }
+    on_gscan_full_result_internal_callback.invoke(id, result, buckets_scanned);
 }
 
 // Callback to be invoked for link layer stats results.
-std::function<void((wifi_request_id, wifi_iface_stat*, int, wifi_radio_stat*))>
+hidl_sync_util::CallbackSlot<void(wifi_request_id, wifi_iface_stat*, int,
+                                  wifi_radio_stat*)>
     on_link_layer_stats_result_internal_callback;
 void onSyncLinkLayerStatsResult(wifi_request_id id, wifi_iface_stat* iface_stat,
                                 int num_radios, wifi_radio_stat* radio_stat) {
-    if (on_link_layer_stats_result_internal_callback) {
-        on_link_layer_stats_result_internal_callback(id, iface_stat, num_radios,
-                                                     radio_stat);
-    }
+    on_link_layer_stats_result_internal_callback.invoke(id, iface_stat,
+                                                        num_radios, radio_stat);
 }
 
 // Callback to be invoked for rssi threshold breach.
-std::function<void((wifi_request_id, uint8_t*, int8_t))>
+hidl_sync_util::CallbackSlot<void(wifi_request_id, uint8_t*, int8_t)>
     on_rssi_threshold_breached_internal_callback;
 void onAsyncRssiThresholdBreached(wifi_request_id id, uint8_t* bssid,
                                   int8_t rssi) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_rssi_threshold_breached_internal_callback) {
-        on_rssi_threshold_breached_internal_callback(id, bssid, rssi);
-    }
+    on_rssi_threshold_breached_internal_callback.invoke(id, bssid, rssi);
 }
 
 // Callback to be invoked for ring buffer data indication.
-std::function<void(char*, char*, int, wifi_ring_buffer_status*)>
+hidl_sync_util::CallbackSlot<void(char*, char*, int,
+                                  wifi_ring_buffer_status*)>
     on_ring_buffer_data_internal_callback;
 void onAsyncRingBufferData(char* ring_name, char* buffer, int buffer_size,
                            wifi_ring_buffer_status* status) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_ring_buffer_data_internal_callback) {
-        on_ring_buffer_data_internal_callback(ring_name, buffer, buffer_size,
-                                              status);
-    }
+    on_ring_buffer_data_internal_callback.invoke(ring_name, buffer,
+                                                 buffer_size, status);
 }
 
 // Callback to be invoked for error alert indication.
-std::function<void(wifi_request_id, char*, int, int)>
+hidl_sync_util::CallbackSlot<void(wifi_request_id, char*, int, int)>
     on_error_alert_internal_callback;
 void onAsyncErrorAlert(wifi_request_id id, char* buffer, int buffer_size,
                        int err_code) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_error_alert_internal_callback) {
-        on_error_alert_internal_callback(id, buffer, buffer_size, err_code);
-    }
+    on_error_alert_internal_callback.invoke(id, buffer, buffer_size, err_code);
 }
 
 // Callback to be invoked for radio mode change indication.
-std::function<void(wifi_request_id, uint32_t, wifi_mac_info*)>
+hidl_sync_util::CallbackSlot<void(wifi_request_id, uint32_t, wifi_mac_info*)>
     on_radio_mode_change_internal_callback;
 void onAsyncRadioModeChange(wifi_request_id id, uint32_t num_macs,
                             wifi_mac_info* mac_infos) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_radio_mode_change_internal_callback) {
-        on_radio_mode_change_internal_callback(id, num_macs, mac_infos);
-    }
+    on_radio_mode_change_internal_callback.invoke(id, num_macs, mac_infos);
 }
 
 // Callback to be invoked for rtt results results.
-std::function<void(wifi_request_id, unsigned num_results,
-                   wifi_rtt_result* rtt_results[])>
+hidl_sync_util::CallbackSlot<void(wifi_request_id, unsigned num_results,
+                                  wifi_rtt_result* rtt_results[])>
     on_rtt_results_internal_callback;
 void onAsyncRttResults(wifi_request_id id, unsigned num_results,
                        wifi_rtt_result* rtt_results[]) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_rtt_results_internal_callback) {
-        on_rtt_results_internal_callback(id, num_results, rtt_results);
+    const std::lock_guard<std::mutex> lock(g_rtt_lock);
+    if (on_rtt_results_internal_callback.invoke(id, num_results,
+                                                rtt_results)) {
         on_rtt_results_internal_callback = nullptr;
     }
 }
@@ -178,157 +169,144 @@ void onAsyncRttResults(wifi_request_id id, unsigned num_results,
 // NOTE: These have very little conversions to perform before invoking the user
 // callbacks.
 // So, handle all of them here directly to avoid adding an unnecessary layer.
-std::function<void(transaction_id, const NanResponseMsg&)>
+hidl_sync_util::CallbackSlot<void(transaction_id, const NanResponseMsg&)>
     on_nan_notify_response_user_callback;
 void onAysncNanNotifyResponse(transaction_id id, NanResponseMsg* msg) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_nan_notify_response_user_callback && msg) {
-        on_nan_notify_response_user_callback(id, *msg);
+    if (msg) {
+        on_nan_notify_response_user_callback.invoke(id, *msg);
     }
 }
 
-std::function<void(const NanPublishRepliedInd&)>
+hidl_sync_util::CallbackSlot<void(const NanPublishRepliedInd&)>
     on_nan_event_publish_replied_user_callback;
 void onAysncNanEventPublishReplied(NanPublishRepliedInd* /* event */) {
     LOG(ERROR) << "onAysncNanEventPublishReplied triggered";
 }
 
-std::function<void(const NanPublishTerminatedInd&)>
+hidl_sync_util::CallbackSlot<void(const NanPublishTerminatedInd&)>
     on_nan_event_publish_terminated_user_callback;
 void onAysncNanEventPublishTerminated(NanPublishTerminatedInd* event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_nan_event_publish_terminated_user_callback && event) {
-        on_nan_event_publish_terminated_user_callback(*event);
+    if (event) {
+        on_nan_event_publish_terminated_user_callback.invoke(*event);
     }
 }
 
-std::function<void(const NanMatchInd&)> on_nan_event_match_user_callback;
+hidl_sync_util::CallbackSlot<void(const NanMatchInd&)>
+    on_nan_event_match_user_callback;
 void onAysncNanEventMatch(NanMatchInd* event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_nan_event_match_user_callback && event) {
-        on_nan_event_match_user_callback(*event);
+    if (event) {
+        on_nan_event_match_user_callback.invoke(*event);
     }
 }
 
-std::function<void(const NanMatchExpiredInd&)>
+hidl_sync_util::CallbackSlot<void(const NanMatchExpiredInd&)>
     on_nan_event_match_expired_user_callback;
 void onAysncNanEventMatchExpired(NanMatchExpiredInd* event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_nan_event_match_expired_user_callback && event) {
-        on_nan_event_match_expired_user_callback(*event);
+    if (event) {
+        on_nan_event_match_expired_user_callback.invoke(*event);
     }
 }
 
-std::function<void(const NanSubscribeTerminatedInd&)>
+hidl_sync_util::CallbackSlot<void(const NanSubscribeTerminatedInd&)>
     on_nan_event_subscribe_terminated_user_callback;
 void onAysncNanEventSubscribeTerminated(NanSubscribeTerminatedInd* event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_nan_event_subscribe_terminated_user_callback && event) {
-        on_nan_event_subscribe_terminated_user_callback(*event);
+    if (event) {
+        on_nan_event_subscribe_terminated_user_callback.invoke(*event);
     }
 }
 
-std::function<void(const NanFollowupInd&)> on_nan_event_followup_user_callback;
+hidl_sync_util::CallbackSlot<void(const NanFollowupInd&)>
+    on_nan_event_followup_user_callback;
 void onAysncNanEventFollowup(NanFollowupInd* event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_nan_event_followup_user_callback && event) {
-        on_nan_event_followup_user_callback(*event);
+    if (event) {
+        on_nan_event_followup_user_callback.invoke(*event);
     }
 }
 
-std::function<void(const NanDiscEngEventInd&)>
+hidl_sync_util::CallbackSlot<void(const NanDiscEngEventInd&)>
     on_nan_event_disc_eng_event_user_callback;
 void onAysncNanEventDiscEngEvent(NanDiscEngEventInd* event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_nan_event_disc_eng_event_user_callback && event) {
-        on_nan_event_disc_eng_event_user_callback(*event);
+    if (event) {
+        on_nan_event_disc_eng_event_user_callback.invoke(*event);
     }
 }
 
-std::function<void(const NanDisabledInd&)> on_nan_event_disabled_user_callback;
+hidl_sync_util::CallbackSlot<void(const NanDisabledInd&)>
+    on_nan_event_disabled_user_callback;
 void onAysncNanEventDisabled(NanDisabledInd* event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_nan_event_disabled_user_callback && event) {
-        on_nan_event_disabled_user_callback(*event);
+    if (event) {
+        on_nan_event_disabled_user_callback.invoke(*event);
     }
 }
 
-std::function<void(const NanTCAInd&)> on_nan_event_tca_user_callback;
+hidl_sync_util::CallbackSlot<void(const NanTCAInd&)>
+    on_nan_event_tca_user_callback;
 void onAysncNanEventTca(NanTCAInd* event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_nan_event_tca_user_callback && event) {
-        on_nan_event_tca_user_callback(*event);
+    if (event) {
+        on_nan_event_tca_user_callback.invoke(*event);
     }
 }
 
-std::function<void(const NanBeaconSdfPayloadInd&)>
+hidl_sync_util::CallbackSlot<void(const NanBeaconSdfPayloadInd&)>
     on_nan_event_beacon_sdf_payload_user_callback;
 void onAysncNanEventBeaconSdfPayload(NanBeaconSdfPayloadInd* event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_nan_event_beacon_sdf_payload_user_callback && event) {
-        on_nan_event_beacon_sdf_payload_user_callback(*event);
+    if (event) {
+        on_nan_event_beacon_sdf_payload_user_callback.invoke(*event);
     }
 }
 
-std::function<void(const NanDataPathRequestInd&)>
+hidl_sync_util::CallbackSlot<void(const NanDataPathRequestInd&)>
     on_nan_event_data_path_request_user_callback;
 void onAysncNanEventDataPathRequest(NanDataPathRequestInd* event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_nan_event_data_path_request_user_callback && event) {
-        on_nan_event_data_path_request_user_callback(*event);
+    if (event) {
+        on_nan_event_data_path_request_user_callback.invoke(*event);
     }
 }
-std::function<void(const NanDataPathConfirmInd&)>
+hidl_sync_util::CallbackSlot<void(const NanDataPathConfirmInd&)>
     on_nan_event_data_path_confirm_user_callback;
 void onAysncNanEventDataPathConfirm(NanDataPathConfirmInd* event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_nan_event_data_path_confirm_user_callback && event) {
-        on_nan_event_data_path_confirm_user_callback(*event);
+    if (event) {
+        on_nan_event_data_path_confirm_user_callback.invoke(*event);
     }
 }
 
-std::function<void(const NanDataPathEndInd&)>
+hidl_sync_util::CallbackSlot<void(const NanDataPathEndInd&)>
     on_nan_event_data_path_end_user_callback;
 void onAysncNanEventDataPathEnd(NanDataPathEndInd* event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_nan_event_data_path_end_user_callback && event) {
-        on_nan_event_data_path_end_user_callback(*event);
+    if (event) {
+        on_nan_event_data_path_end_user_callback.invoke(*event);
     }
 }
 
-std::function<void(const NanTransmitFollowupInd&)>
+hidl_sync_util::CallbackSlot<void(const NanTransmitFollowupInd&)>
     on_nan_event_transmit_follow_up_user_callback;
 void onAysncNanEventTransmitFollowUp(NanTransmitFollowupInd* event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_nan_event_transmit_follow_up_user_callback && event) {
-        on_nan_event_transmit_follow_up_user_callback(*event);
+    if (event) {
+        on_nan_event_transmit_follow_up_user_callback.invoke(*event);
     }
 }
 
-std::function<void(const NanRangeRequestInd&)>
+hidl_sync_util::CallbackSlot<void(const NanRangeRequestInd&)>
     on_nan_event_range_request_user_callback;
 void onAysncNanEventRangeRequest(NanRangeRequestInd* event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_nan_event_range_request_user_callback && event) {
-        on_nan_event_range_request_user_callback(*event);
+    if (event) {
+        on_nan_event_range_request_user_callback.invoke(*event);
     }
 }
 
-std::function<void(const NanRangeReportInd&)>
+hidl_sync_util::CallbackSlot<void(const NanRangeReportInd&)>
     on_nan_event_range_report_user_callback;
 void onAysncNanEventRangeReport(NanRangeReportInd* event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_nan_event_range_report_user_callback && event) {
-        on_nan_event_range_report_user_callback(*event);
+    if (event) {
+        on_nan_event_range_report_user_callback.invoke(*event);
     }
 }
 
-std::function<void(const NanDataPathScheduleUpdateInd&)>
+hidl_sync_util::CallbackSlot<void(const NanDataPathScheduleUpdateInd&)>
     on_nan_event_schedule_update_user_callback;
 void onAsyncNanEventScheduleUpdate(NanDataPathScheduleUpdateInd* event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_nan_event_schedule_update_user_callback && event) {
-        on_nan_event_schedule_update_user_callback(*event);
+    if (event) {
+        on_nan_event_schedule_update_user_callback.invoke(*event);
     }
 }
 // End of the free-standing "C" style callbacks.
@@ -533,6 +511,7 @@ wifi_error WifiLegacyHal::startGscan(
     const on_gscan_results_callback& on_results_user_callback,
     const on_gscan_full_result_callback& on_full_result_user_callback) {
     // If there is already an ongoing background scan, reject new scan requests.
+    std::unique_lock<std::mutex> lock(g_gscan_lock);
     if (on_gscan_event_internal_callback ||
         on_gscan_full_result_internal_callback) {
         return WIFI_ERROR_NOT_AVAILABLE;
@@ -577,11 +556,14 @@ wifi_error WifiLegacyHal::startGscan(
         }
     };
 
+    lock.unlock();
+
     wifi_scan_result_handler handler = {onAsyncGscanFullResult,
                                         onAsyncGscanEvent};
     wifi_error status = global_func_table_.wifi_start_gscan(
         id, getIfaceHandle(iface_name), params, handler);
     if (status != WIFI_SUCCESS) {
+        lock.lock();
         on_gscan_event_internal_callback = nullptr;
         on_gscan_full_result_internal_callback = nullptr;
     }
@@ -593,15 +575,18 @@ wifi_error WifiLegacyHal::stopGscan(const std::string& iface_name,
     // If there is no an ongoing background scan, reject stop requests.
     // TODO(b/32337212): This needs to be handled by the HIDL object because we
     // need to return the NOT_STARTED error code.
+    std::unique_lock<std::mutex> lock(g_gscan_lock);
     if (!on_gscan_event_internal_callback &&
         !on_gscan_full_result_internal_callback) {
         return WIFI_ERROR_NOT_AVAILABLE;
     }
+    lock.unlock();
     wifi_error status =
         global_func_table_.wifi_stop_gscan(id, getIfaceHandle(iface_name));
     // If the request Id is wrong, don't stop the ongoing background scan. Any
     // other error should be treated as the end of background scan.
     if (status != WIFI_ERROR_INVALID_REQUEST_ID) {
+        lock.lock();
         on_gscan_event_internal_callback = nullptr;
         on_gscan_full_result_internal_callback = nullptr;
     }
@@ -915,11 +900,10 @@ wifi_error WifiLegacyHal::registerRingBufferCallbackHandler(
     on_ring_buffer_data_internal_callback =
         [on_user_data_callback](char* ring_name, char* buffer, int buffer_size,
                                 wifi_ring_buffer_status* status) {
-            if (status && buffer) {
-                std::vector<uint8_t> buffer_vector(
-                    reinterpret_cast<uint8_t*>(buffer),
-                    reinterpret_cast<uint8_t*>(buffer) + buffer_size);
-                on_user_data_callback(ring_name, buffer_vector, *status);
+            if (status && buffer && buffer_size >= 0) {
+                on_user_data_callback(ring_name,
+                                      reinterpret_cast<uint8_t*>(buffer),
+                                      buffer_size, *status);
             }
         };
     wifi_error status = global_func_table_.wifi_set_log_handler(
@@ -1043,6 +1027,7 @@ wifi_error WifiLegacyHal::startRttRangeRequest(
     const std::string& iface_name, wifi_request_id id,
     const std::vector<wifi_rtt_config>& rtt_configs,
     const on_rtt_results_callback& on_results_user_callback) {
+    std::unique_lock<std::mutex> lock(g_rtt_lock);
     if (on_rtt_results_internal_callback) {
         return WIFI_ERROR_NOT_AVAILABLE;
     }
@@ -1063,11 +1048,14 @@ wifi_error WifiLegacyHal::startRttRangeRequest(
             on_results_user_callback(id, rtt_results_vec);
         };
 
+    lock.unlock();
+
     std::vector<wifi_rtt_config> rtt_configs_internal(rtt_configs);
     wifi_error status = global_func_table_.wifi_rtt_range_request(
         id, getIfaceHandle(iface_name), rtt_configs.size(),
         rtt_configs_internal.data(), {onAsyncRttResults});
     if (status != WIFI_SUCCESS) {
+        lock.lock();
         on_rtt_results_internal_callback = nullptr;
     }
     return status;
@@ -1076,9 +1064,11 @@ wifi_error WifiLegacyHal::startRttRangeRequest(
 wifi_error WifiLegacyHal::cancelRttRangeRequest(
     const std::string& iface_name, wifi_request_id id,
     const std::vector<std::array<uint8_t, 6>>& mac_addrs) {
+    std::unique_lock<std::mutex> lock(g_rtt_lock);
     if (!on_rtt_results_internal_callback) {
         return WIFI_ERROR_NOT_AVAILABLE;
     }
+    lock.unlock();
     static_assert(sizeof(mac_addr) == sizeof(std::array<uint8_t, 6>),
                   "MAC address size mismatch");
     // TODO: How do we handle partial cancels (i.e only a subset of enabled mac
@@ -1090,6 +1080,7 @@ wifi_error WifiLegacyHal::cancelRttRangeRequest(
     // If the request Id is wrong, don't stop the ongoing range request. Any
     // other error should be treated as the end of rtt ranging.
     if (status != WIFI_ERROR_INVALID_REQUEST_ID) {
+        lock.lock();
         on_rtt_results_internal_callback = nullptr;
     }
     return status;
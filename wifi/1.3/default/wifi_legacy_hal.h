@@ -133,9 +133,10 @@ using on_rssi_threshold_breached_callback =
 using on_rtt_results_callback = std::function<void(
     wifi_request_id, const std::vector<const wifi_rtt_result*>&)>;
 
-// Callback for ring buffer data.
+// Callback for ring buffer data. |data| is only valid for the duration of
+// the call, callee must copy it.
 using on_ring_buffer_data_callback =
-    std::function<void(const std::string&, const std::vector<uint8_t>&,
+    std::function<void(const std::string&, const uint8_t* data, size_t size,
                        const wifi_ring_buffer_status&)>;
 
 // Callback for alerts.
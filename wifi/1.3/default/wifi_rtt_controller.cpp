@@ -38,7 +38,10 @@ WifiRttController::WifiRttController(
 
 void WifiRttController::invalidate() {
     legacy_hal_.reset();
-    event_callbacks_.clear();
+    {
+        const std::lock_guard<std::mutex> lock(event_callbacks_lock_);
+        event_callbacks_.clear();
+    }
     is_valid_ = false;
 }
 
@@ -46,6 +49,7 @@ bool WifiRttController::isValid() { return is_valid_; }
 
 std::vector<sp<IWifiRttControllerEventCallback>>
 WifiRttController::getEventCallbacks() {
+    const std::lock_guard<std::mutex> lock(event_callbacks_lock_);
     return event_callbacks_;
 }
 
@@ -138,6 +142,7 @@ WifiRttController::getBoundIfaceInternal() {
 WifiStatus WifiRttController::registerEventCallbackInternal(
     const sp<IWifiRttControllerEventCallback>& callback) {
     // TODO(b/31632518): remove the callback when the client is destroyed
+    const std::lock_guard<std::mutex> lock(event_callbacks_lock_);
     event_callbacks_.emplace_back(callback);
     return createWifiStatus(WifiStatusCode::SUCCESS);
 }
@@ -17,6 +17,9 @@
 #ifndef WIFI_RTT_CONTROLLER_H_
 #define WIFI_RTT_CONTROLLER_H_
 
+#include <atomic>
+#include <mutex>
+
 #include <android-base/macros.h>
 #include <android/hardware/wifi/1.0/IWifiIface.h>
 #include <android/hardware/wifi/1.0/IWifiRttController.h>
@@ -91,8 +94,10 @@ class WifiRttController : public V1_0::IWifiRttController {
     std::string ifname_;
     sp<IWifiIface> bound_iface_;
     std::weak_ptr<legacy_hal::WifiLegacyHal> legacy_hal_;
+    std::mutex event_callbacks_lock_;
     std::vector<sp<IWifiRttControllerEventCallback>> event_callbacks_;
-    bool is_valid_;
+    // Read from the legacy HAL's event loop.
+    std::atomic<bool> is_valid_;
 
     DISALLOW_COPY_AND_ASSIGN(WifiRttController);
 };